@@ -29,6 +29,8 @@ SuilCheckLibrary(uuid
         INCLUDE uuid/uuid.h)
 SuilCheckLibrary(sqlite3
         LIBRARY sqlite3 libsqlite3)
+SuilCheckLibrary(z
+        INCLUDE zlib.h)
 
 SuilCheckLibrary(zmq
         INCLUDE zmq.h
@@ -0,0 +1,13 @@
+##
+# Suil package version
+##
+set(SUIL_PACKAGE_VERSION "0.0.0")
+set(SUIL_PACKAGE_MAJOR    0)
+set(SUIL_PACKAGE_MINOR    0)
+set(SUIL_PACKAGE_PATCH    0)
+
+set(SUIL_PACKAGE_LIBRARIES        ssl;crypto;uuid;sqlite3;pq;zmq;z;suil)
+set(SUIL_PACKAGE_STATIC_LIBRARIES ssl;crypto;uuid;sqlite3;pq;zmq;z;lua;suil)
+set(SUIL_PACKAGE_INCLUDES         /usr/include/postgresql)
+set(SUIL_PACKAGE_DEFINES           -DSUIL_DEBUG -DSUIL_TRACE_ENABLED -DSSL_SUPPORTED)
+set(SUIL_PACKAGE_HAVE_DOCKER      OFF)
@@ -12,6 +12,9 @@
 #include <string_view>
 #include <sstream>
 #include <type_traits>
+#include <charconv>
+#include <cmath>
+#include <limits>
 
 #include <iod/sio.hh>
 #include <iod/foreach.hh>
@@ -134,12 +137,34 @@ namespace iod {
 
         static const int LBS = 500;
 
+        // Memory owned by someone else, which a stringstream encodes straight into
+        // instead of building a std::string.
+        struct json_sink {
+            // At least n writable bytes, their actual count is stored in avail.
+            virtual char *reserve(size_t n, size_t &avail) = 0;
+
+            // n bytes were written at the start of the memory given by reserve.
+            virtual void commit(size_t n) = 0;
+        };
+
         struct stringstream {
 
             stringstream(int hint_size = 10)
                     : pos_(0) { str_.reserve(hint_size); }
 
+            stringstream(json_sink *sink)
+                    : pos_(0),
+                      out_(nullptr),
+                      cap_(0),
+                      sink_(sink) {}
+
             inline void append(const char t) {
+                if (sink_ != nullptr) {
+                    if (size_t(pos_) == cap_)
+                        flush(1);
+                    out_[pos_++] = t;
+                    return;
+                }
                 if (pos_ == LBS)
                     flush();
                 buf_[pos_] = t;
@@ -150,6 +175,14 @@ namespace iod {
                 const char *begin = s.data();
                 const char *end = s.data() + s.size();
 
+                if (sink_ != nullptr) {
+                    if (size_t(end - begin) > cap_ - pos_)
+                        flush(size_t(end - begin));
+                    memcpy(out_ + pos_, begin, end - begin);
+                    pos_ += end - begin;
+                    return;
+                }
+
                 while (int(end - begin) > (LBS - pos_)) {
                     flush();
                     int to_write = std::min(int(end - begin), LBS);
@@ -165,11 +198,28 @@ namespace iod {
             }
 
             inline void flush() {
+                if (sink_ != nullptr) {
+                    sync();
+                    return;
+                }
                 str_.resize(str_.size() + pos_);
                 memcpy(&(str_)[0] + str_.size() - pos_, buf_, pos_);
                 pos_ = 0;
             }
 
+            // Commits what was written to the sink and gets room for n more bytes.
+            inline void flush(size_t n) {
+                sync();
+                out_ = sink_->reserve(std::max(n, size_t(LBS)), cap_);
+            }
+
+            // Commits what was written to the sink.
+            inline void sync() {
+                if (pos_ > 0)
+                    sink_->commit(pos_);
+                pos_ = 0;
+            }
+
             const std::string &str() {
                 if (pos_ > 0)
                     flush();
@@ -185,6 +235,9 @@ namespace iod {
             int pos_;
             char buf_[LBS];
             std::string str_;
+            char *out_{nullptr};
+            size_t cap_{0};
+            json_sink *sink_{nullptr};
         };
 
 
@@ -232,18 +285,98 @@ namespace iod {
 
             template<typename T>
             my_ostringstream &operator<<(const T &t) {
-                std::string s = lexical_cast<std::string>(t);
-                (*this) << stringview(s.c_str(), s.size());
+                if constexpr (std::is_integral<T>::value and !std::is_same<T, bool>::value) {
+                    char buf[24];
+                    auto r = std::to_chars(buf, buf + sizeof(buf), t);
+                    S::append(stringview(buf, r.ptr));
+                }
+                else if constexpr (std::is_floating_point<T>::value) {
+                    append_real(t);
+                }
+                else {
+                    std::string s = lexical_cast<std::string>(t);
+                    (*this) << stringview(s.c_str(), s.size());
+                }
                 return *this;
             }
 
             inline my_ostringstream &operator<<(int t) {
-                std::string s = std::to_string(t);
-                S::append(stringview(s.c_str(), s.size()));
+                char buf[16];
+                auto r = std::to_chars(buf, buf + sizeof(buf), t);
+                S::append(stringview(buf, r.ptr));
                 return *this;
             }
+
+        private:
+            // The shortest representation reading back to the same value, JSON
+            // has none for infinities and NaN.
+            template<typename T>
+            inline void append_real(T t) {
+                if (!std::isfinite(t)) {
+                    S::append(stringview("null", 4));
+                    return;
+                }
+                char buf[48];
+#ifdef __cpp_lib_to_chars
+                auto r = std::to_chars(buf, buf + sizeof(buf), t);
+                S::append(stringview(buf, r.ptr));
+#else
+                int n = snprintf(buf, sizeof(buf), "%.*Lg", std::numeric_limits<T>::max_digits10, (long double) t);
+                S::append(stringview(buf, n));
+#endif
+            }
         };
 
+        // Finds the first byte in [p, end) which must be escaped in a JSON string.
+        typedef const char *(*json_escape_finder_t)(const char *, const char *);
+
+        inline const char *json_find_escape(const char *p, const char *end) {
+            while (p < end and (unsigned char)(*p) >= 0x20 and *p != '"' and *p != '\\')
+                p++;
+            return p;
+        }
+
+        // The finder used by the encoder, applications can register a vectorized one.
+        inline json_escape_finder_t& json_escape_finder() {
+            static json_escape_finder_t finder{json_find_escape};
+            return finder;
+        }
+
+        // Encodes a quoted string, runs of bytes which need no escaping are
+        // written at once.
+        template<typename S>
+        inline void json_escape_(const char *p, size_t len, S &ss) {
+            static const char HEX[] = "0123456789ABCDEF";
+            const char *end = p + len;
+            auto find = json_escape_finder();
+
+            ss << '"';
+            while (true) {
+                const char *e = find(p, end);
+                if (e != p)
+                    ss << stringview(p, e);
+                if (e == end)
+                    break;
+
+                switch (*e) {
+                    case '"':  ss << stringview("\\\"", 2); break;
+                    case '\\': ss << stringview("\\\\", 2); break;
+                    case '\n': ss << stringview("\\n", 2); break;
+                    case '\r': ss << stringview("\\r", 2); break;
+                    case '\t': ss << stringview("\\t", 2); break;
+                    case '\b': ss << stringview("\\b", 2); break;
+                    case '\f': ss << stringview("\\f", 2); break;
+                    default: {
+                        char u[6] = {'\\', 'u', '0', '0', HEX[(*e >> 4) & 0xf], HEX[*e & 0xf]};
+                        ss << stringview(u, 6);
+                        break;
+                    }
+                }
+                p = e + 1;
+            }
+            ss << '"';
+        }
+
         // Json encoder.
         // =============================================
         template<typename T, typename S, typename  std::enable_if<!std::is_base_of<jsonvalue, T>::value>::type* = nullptr>
@@ -273,7 +406,7 @@ namespace iod {
 
         template<typename S>
         inline void json_encode_(const char *t, S &ss) {
-            ss << '"' << t << '"';
+            json_escape_(t, strlen(t), ss);
         }
 
         template<typename S>
@@ -283,9 +416,7 @@ namespace iod {
 
         template<typename S>
         inline void json_encode_(const stringview &s, S &ss) {
-            ss << '"';
-            ss << s;
-            ss << '"';
+            json_escape_(s.data(), s.size(), ss);
         }
 
         template<typename S, typename SS>
@@ -297,14 +428,12 @@ namespace iod {
 
         template<typename S>
         inline void json_encode_(const std::string_view &s, S &ss) {
-            ss << '"';
-            ss << s;
-            ss << '"';
+            json_escape_(s.data(), s.size(), ss);
         }
 
         template<typename S>
         inline void json_encode_(const std::string &t, S &ss) {
-            json_encode_(t.c_str(), ss);
+            json_escape_(t.data(), t.size(), ss);
         }
 
         // Forward declaration.
@@ -381,6 +510,106 @@ namespace iod {
             ss << '}';
         }
 
+        // Json size estimate, a cheap guess of the size of an encoding used
+        // to size output buffers before encoding.
+        // =============================================
+        struct json_size {
+            size_t n{0};
+        };
+
+        template<typename T, typename = void>
+        struct json_has_meta : std::false_type {};
+
+        template<typename T>
+        struct json_has_meta<T, std::void_t<decltype(T::Meta)>> : std::true_type {};
+
+        // Forward declarations.
+        template<typename ...Tail>
+        inline void json_estimate_(const sio<Tail...> &o, json_size &sz);
+
+        template<typename T>
+        inline void json_estimate_(const std::vector<T> &v, json_size &sz);
+
+        template<typename T>
+        inline void json_estimate_(const T &t, json_size &sz) {
+            if constexpr (std::is_arithmetic<T>::value) {
+                sz.n += 8;
+            }
+            else if constexpr (std::is_base_of<MetaType, T>::value and json_has_meta<T>::value) {
+                sz.n += 2;
+                foreach(T::Meta) | [&](auto m) {
+                    sz.n += strlen(m.symbol().name()) + 4;
+                    json_estimate_(m.symbol().member_access(t), sz);
+                };
+            }
+            else {
+                sz.n += 16;
+            }
+        }
+
+        inline void json_estimate_(const char *t, json_size &sz) {
+            sz.n += strlen(t) + 2;
+        }
+
+        inline void json_estimate_(const stringview &s, json_size &sz) {
+            sz.n += s.size() + 2;
+        }
+
+        inline void json_estimate_(const std::string_view &s, json_size &sz) {
+            sz.n += s.size() + 2;
+        }
+
+        inline void json_estimate_(const std::string &s, json_size &sz) {
+            sz.n += s.size() + 2;
+        }
+
+        inline void json_estimate_(const json_string &s, json_size &sz) {
+            sz.n += s.str.size();
+        }
+
+        template<typename T>
+        inline void json_estimate_(const Nullable<T> &t, json_size &sz) {
+            if (t.isNull)
+                sz.n += 4;
+            else
+                json_estimate_(t.obj, sz);
+        }
+
+        template<typename T>
+        inline void json_estimate_(const std::vector<T> &v, json_size &sz) {
+            // large arrays are extrapolated from their first elements
+            static const size_t SAMPLE = 16;
+            sz.n += 2 + v.size();
+            if (v.size() <= SAMPLE) {
+                for (const auto &t : v)
+                    json_estimate_(t, sz);
+                return;
+            }
+
+            json_size sample;
+            for (size_t i = 0; i < SAMPLE; i++)
+                json_estimate_(v[i], sample);
+            sz.n += (sample.n * v.size()) / SAMPLE;
+        }
+
+        template<typename T>
+        inline void json_estimate_(const Object<T> &mp, json_size &sz) {
+            sz.n += 2;
+            for (const auto &e : mp) {
+                sz.n += e.first.size() + 5;
+                json_estimate_(e.second, sz);
+            }
+        }
+
+        template<typename ...Tail>
+        inline void json_estimate_(const sio<Tail...> &o, json_size &sz) {
+            sz.n += 2;
+            foreach(o) | [&](auto m) {
+                sz.n += strlen(m.symbol().name()) + 4;
+                json_estimate_(m.value(), sz);
+            };
+        }
+
         // Json decoder.
         // =============================================
 
@@ -402,15 +631,75 @@ namespace iod {
             T& t;
         };
 
+        // Builds the offsets of the structural characters of a JSON document (quotes,
+        // {}[]:, and the first byte of other values), returning false if the document
+        // cannot be indexed. None is registered by default, parsers then scan bytes
+        typedef bool (*json_indexer_t)(const char *, size_t, std::vector<uint32_t>&);
+
+        inline json_indexer_t& json_indexer() {
+            static json_indexer_t indexer{nullptr};
+            return indexer;
+        }
+
+        // documents smaller than this are not worth indexing
+        static constexpr size_t json_index_min = 256;
+
         struct json_parser {
             struct spaces_ {
             } spaces;
 
             inline json_parser(std::istringstream &_stream) : str(_stream.str()), pos(0) {}
 
-            inline json_parser(const std::string &_str) : str(_str.c_str(), _str.size()), pos(0) {}
+            inline json_parser(const std::string &_str) : str(_str.c_str(), _str.size()), pos(0) { index(); }
+
+            inline json_parser(const stringview &_str) : str(_str), pos(0) { index(); }
+
+            inline void index() {
+                auto indexer = json_indexer();
+                if (indexer != nullptr and size_t(str.size()) >= json_index_min) {
+                    if (!indexer(str.data(), size_t(str.size()), structurals))
+                        structurals.clear();
+                }
+            }
+
+            inline bool indexed() const { return !structurals.empty(); }
+
+            // The offset of the first structural character at or after off.
+            inline int next_structural(int off) {
+                size_t n = structurals.size();
+                while (scur > 0 and structurals[scur - 1] >= uint32_t(off)) scur--;
+                while (scur < n and structurals[scur] < uint32_t(off)) scur++;
+                return scur < n ? int(structurals[scur]) : int(str.size());
+            }
+
+            // The offset of the quote closing the string whose content starts
+            // at off, -1 if the document is not indexed.
+            inline int string_end(int off) {
+                if (!indexed()) return -1;
+                int end = next_structural(off);
+                return (end < int(str.size()) and str[end] == '"') ? end : -1;
+            }
 
-            inline json_parser(const stringview &_str) : str(_str), pos(0) {}
+            // The offset past the end of the value starting at off, -1 if the
+            // document is not indexed.
+            inline int value_end(int off) {
+                if (!indexed() or next_structural(off) != off) return -1;
+                size_t i = scur;
+                char c = str[off];
+                if (c == '"')
+                    return (i + 1 < structurals.size()) ? int(structurals[i + 1]) + 1 : -1;
+                if (c != '{' and c != '[')
+                    return next_structural(off + 1);
+
+                int depth = 0;
+                for (; i < structurals.size(); i++) {
+                    c = str[int(structurals[i])];
+                    if (c == '{' or c == '[') depth++;
+                    else if ((c == '}' or c == ']') and --depth == 0)
+                        return int(structurals[i]) + 1;
+                }
+                return -1;
+            }
 
             inline char peak() { return str[pos]; }
 
@@ -490,20 +779,23 @@ namespace iod {
 
                     if (_size == 0) {
                         int start = p.pos;
-                        int end = p.pos;
-
-                        while (!p.eof()) {
-                            while (p.str[end] != '"')
-                                end++;
-
-                            // Count the prev backslashes.
-                            int sb = end - 1;
-                            while (sb >= 0 and p.str[sb] == '\\')
-                                sb--;
-
-                            if ((end - sb) % 2) break;
-                            else
-                                end++;
+                        int end = p.string_end(start);
+
+                        if (end < 0) {
+                            end = start;
+                            while (!p.eof()) {
+                                while (p.str[end] != '"')
+                                    end++;
+
+                                // Count the prev backslashes.
+                                int sb = end - 1;
+                                while (sb >= 0 and p.str[sb] == '\\')
+                                    sb--;
+
+                                if ((end - sb) % 2) break;
+                                else
+                                    end++;
+                            }
                         }
                         pos = end;
                         _size = end-start;
@@ -565,9 +857,17 @@ namespace iod {
 
             inline json_parser &fill(std::string &t) {
                 int start = pos;
-                int end = pos;
+                int end = string_end(pos);
                 t.clear();
 
+                if (end >= 0 and memchr(str.data() + start, '\\', size_t(end - start)) == nullptr) {
+                    // nothing to unescape
+                    t.assign(str.data() + start, size_t(end - start));
+                    pos = end;
+                    return *this;
+                }
+                end = pos;
+
                 char buffer[128];
                 int buffer_pos = 0;
                 auto flush = [&]() {
@@ -601,7 +901,7 @@ namespace iod {
                     if (str[end] == '"') break;
 
                     end++;
-                    switch (str[end]) {
+                    switch (str[end++]) {
                         case '\'':
                             append_char('\'');
                             break;
@@ -639,7 +939,6 @@ namespace iod {
                             while (true) {
                                 if (str.size() < end + 4)
                                     throw json_error("Unexpected end of string when decoding an utf8 character");
-                                end++;
 
                                 auto decode_hex_c = [this](char c) {
                                     if (c >= '0' and c <= '9') return c - '0';
@@ -654,7 +953,7 @@ namespace iod {
                                 end += 4;
 
                                 if (str[end] == '\\' and str[end + 1] == 'u')
-                                    end += 1;
+                                    end += 2;
                                 else break;
                             }
                             break;
@@ -669,20 +968,23 @@ namespace iod {
 
             inline json_parser &fill(stringview &t) {
                 int start = pos;
-                int end = pos;
-
-                while (true) {
-                    while (!eof() and str[end] != '"')
-                        end++;
-
-                    // Count the prev backslashes.
-                    int sb = end - 1;
-                    while (sb >= 0 and str[sb] == '\\')
-                        sb--;
-
-                    if ((end - sb) % 2) break;
-                    else
-                        end++;
+                int end = string_end(pos);
+
+                if (end < 0) {
+                    end = pos;
+                    while (true) {
+                        while (!eof() and str[end] != '"')
+                            end++;
+
+                        // Count the prev backslashes.
+                        int sb = end - 1;
+                        while (sb >= 0 and str[sb] == '\\')
+                            sb--;
+
+                        if ((end - sb) % 2) break;
+                        else
+                            end++;
+                    }
                 }
 
                 t.str = str.data() + start;
@@ -773,11 +1075,11 @@ namespace iod {
             inline json_parser &fill(unsigned int &val) { return fill_int<unsigned int, 10>(val); }
 
             inline json_parser &fill(bool &t) {
-                if ((str.size()>(pos+4)) && (strncmp(&str[pos], "true", 4) ==0)) {
+                if ((str.size()>=(pos+4)) && (strncmp(&str[pos], "true", 4) ==0)) {
                     pos += 4;
                     t = true;
                 }
-                else if ((str.size()>(pos+5)) && (strncmp(&str[pos], "false", 5) ==0)) {
+                else if ((str.size()>=(pos+5)) && (strncmp(&str[pos], "false", 5) ==0)) {
                     pos += 5;
                     t =  false;
                 }
@@ -786,6 +1088,7 @@ namespace iod {
                     auto err = "cannot deserialize '" + str.substr(pos, max).to_std_string() + "' into boolean type";
                     throw std::runtime_error(err);
                 }
+                return *this;
             }
 
             template<typename T>
@@ -879,6 +1182,8 @@ namespace iod {
 
 
             inline json_parser &operator>>(spaces_) {
+                // bytes up to the next structural are whitespace
+                if (indexed() and !eof() and str[pos] < 33) pos = next_structural(pos);
                 while (!eof() and str[pos] < 33) pos++;
                 return *this;
             }
@@ -887,6 +1192,8 @@ namespace iod {
             const char *cur;
             stringview str;
             int pos;
+            std::vector<uint32_t> structurals;
+            size_t scur{0};
         };
 
         template<typename S>
@@ -1202,6 +1509,15 @@ namespace iod {
     }
     using encode_stream = json_internals::my_ostringstream<json_internals::stringstream>;
 
+    // The estimated size of the JSON encoding of t.
+    template<typename T>
+    inline size_t json_estimate(const T &t) {
+        // found by ADL, including overloads declared after this
+        json_internals::json_size sz;
+        json_estimate_(t, sz);
+        return sz.n;
+    }
+
     template <typename T>
     inline void zero(Nullable<T>& t) {
         t.isNull = true;
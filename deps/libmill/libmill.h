@@ -29,6 +29,7 @@
 #include <setjmp.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -488,6 +489,12 @@ struct mill_tcpsock_;
 MILL_EXPORT struct mill_tcpsock_ *mill_tcplisten_(
     struct mill_ipaddr addr,
     int backlog);
+MILL_EXPORT struct mill_tcpsock_ *mill_tcplisten2_(
+    struct mill_ipaddr addr,
+    int backlog,
+    int reuseport);
+MILL_EXPORT int mill_tcpfd_(
+    struct mill_tcpsock_ *s);
 MILL_EXPORT int mill_tcpport_(
     struct mill_tcpsock_ *s);
 MILL_EXPORT struct mill_tcpsock_ *mill_tcpaccept_(
@@ -510,6 +517,11 @@ MILL_EXPORT size_t mill_tcpsendfile_(
     size_t len,
     int64_t deadline
 );
+MILL_EXPORT size_t mill_tcpsendv_(
+    struct mill_tcpsock_ *s,
+    const struct iovec *iov,
+    int iovcnt,
+    int64_t deadline);
 MILL_EXPORT void mill_tcpflush_(
     struct mill_tcpsock_ *s,
     int64_t deadline);
@@ -539,11 +551,14 @@ MILL_EXPORT void mill_tcpclose_(
 #if defined MILL_USE_PREFIX
 typedef struct mill_tcpsock_ *mill_tcpsock;
 #define mill_tcplisten mill_tcplisten_
+#define mill_tcplisten2 mill_tcplisten2_
+#define mill_tcpfd mill_tcpfd_
 #define mill_tcpport mill_tcpport_
 #define mill_tcpaccept mill_tcpaccept_
 #define mill_tcpaddr mill_tcpaddr_
 #define mill_tcpconnect mill_tcpconnect_
 #define mill_tcpsend mill_tcpsend_
+#define mill_tcpsendv mill_tcpsendv_
 #define mill_tcpflush mill_tcpflush_
 #define mill_tcprecv mill_tcprecv_
 #define mill_tcprecvuntil mill_tcprecvuntil_
@@ -554,12 +569,15 @@ typedef struct mill_tcpsock_ *mill_tcpsock;
 #else
 typedef struct mill_tcpsock_ *tcpsock;
 #define tcplisten mill_tcplisten_
+#define tcplisten2 mill_tcplisten2_
+#define tcpfd mill_tcpfd_
 #define tcpport mill_tcpport_
 #define tcpaccept mill_tcpaccept_
 #define tcpaddr mill_tcpaddr_
 #define tcpconnect mill_tcpconnect_
 #define tcpsend mill_tcpsend_
 #define tcpsendfile mill_tcpsendfile_
+#define tcpsendv mill_tcpsendv_
 #define tcpflush mill_tcpflush_
 #define tcprecv mill_tcprecv_
 #define tcprecvuntil mill_tcprecvuntil_
@@ -688,6 +706,14 @@ MILL_EXPORT struct mill_sslsock_ *mill_ssllisten_(
     const char *cert_file,
     const char *key_file,
     int backlog);
+MILL_EXPORT struct mill_sslsock_ *mill_ssllisten2_(
+    struct mill_ipaddr addr,
+    const char *cert_file,
+    const char *key_file,
+    int backlog,
+    int reuseport);
+MILL_EXPORT int mill_sslfd_(
+    struct mill_sslsock_ *s);
 MILL_EXPORT int mill_sslport_(
     struct mill_sslsock_ *s);
 MILL_EXPORT struct mill_sslsock_ *mill_sslconnect_(
@@ -715,6 +741,11 @@ MILL_EXPORT ssize_t mill_sslsend_(
     const void *buf,
     int len,
     int64_t deadline);
+MILL_EXPORT ssize_t mill_sslsendv_(
+    struct mill_sslsock_ *s,
+    const struct iovec *iov,
+    int iovcnt,
+    int64_t deadline);
 MILL_EXPORT void mill_sslflush_(
     struct mill_sslsock_ *s,
     int64_t deadline);
@@ -724,6 +755,8 @@ MILL_EXPORT void mill_sslclose_(
 #if defined MILL_USE_PREFIX
 typedef struct mill_sslsock_ *mill_sslsock;
 #define mill_ssllisten mill_ssllisten_
+#define mill_ssllisten2 mill_ssllisten2_
+#define mill_sslfd mill_sslfd_
 #define mill_sslport mill_sslport_
 #define mill_sslconnect mill_sslconnect_
 #define mill_sslaccept mill_sslaccept_
@@ -731,11 +764,14 @@ typedef struct mill_sslsock_ *mill_sslsock;
 #define mill_sslrecv mill_sslrecv_
 #define mill_sslrecvuntil mill_sslrecvuntil_
 #define mill_sslsend mill_sslsend_
+#define mill_sslsendv mill_sslsendv_
 #define mill_sslflush mill_sslflush_
 #define mill_sslclose mill_sslclose_
 #else
 typedef struct mill_sslsock_ *sslsock;
 #define ssllisten mill_ssllisten_
+#define ssllisten2 mill_ssllisten2_
+#define sslfd mill_sslfd_
 #define sslport mill_sslport_
 #define sslconnect mill_sslconnect_
 #define sslaccept mill_sslaccept_
@@ -743,6 +779,7 @@ typedef struct mill_sslsock_ *sslsock;
 #define sslrecv mill_sslrecv_
 #define sslrecvuntil mill_sslrecvuntil_
 #define sslsend mill_sslsend_
+#define sslsendv mill_sslsendv_
 #define sslflush mill_sslflush_
 #define sslclose mill_sslclose_
 #endif
@@ -57,8 +57,15 @@ struct mill_sslconn {
     struct mill_sslsock_ sock;
     tcpsock s;
     BIO *bio;
+    /* Coalesces gathered writes into full records, allocated on demand. */
+    char *wbuf;
 };
 
+/* Maximum plain text length of a TLS record. */
+#ifndef MILL_SSL_RECLEN
+#define MILL_SSL_RECLEN 16384
+#endif
+
 /* Initialise OpenSSL library. */
 static void ssl_init(void) {
     static int initialised = 0;
@@ -76,6 +83,11 @@ static void ssl_init(void) {
 
 struct mill_sslsock_ *mill_ssllisten_(struct mill_ipaddr addr,
       const char *cert_file, const char *key_file, int backlog) {
+    return mill_ssllisten2_(addr, cert_file, key_file, backlog, 0);
+}
+
+struct mill_sslsock_ *mill_ssllisten2_(struct mill_ipaddr addr,
+      const char *cert_file, const char *key_file, int backlog, int reuseport) {
     ssl_init();
     /* Load certificates. */
     SSL_CTX *ctx = SSL_CTX_new(SSLv23_server_method());
@@ -90,7 +102,7 @@ struct mill_sslsock_ *mill_ssllisten_(struct mill_ipaddr addr,
     if(SSL_CTX_check_private_key(ctx) <= 0)
         return NULL;
     /* Open the listening socket. */
-    tcpsock s = tcplisten(addr, backlog);
+    tcpsock s = tcplisten2(addr, backlog, reuseport);
     if(!s) {
         /* TODO: close the context */
         return NULL;
@@ -110,6 +122,19 @@ struct mill_sslsock_ *mill_ssllisten_(struct mill_ipaddr addr,
     return &l->sock;
 }
 
+int mill_sslfd_(struct mill_sslsock_ *s) {
+    if(s->type == MILL_SSLLISTENER) {
+        struct mill_ssllistener *l = (struct mill_ssllistener*)s;
+        return tcpfd(l->s);
+    }
+    if(s->type == MILL_SSLCONN) {
+        struct mill_sslconn *c = (struct mill_sslconn*)s;
+        return tcpfd(c->s);
+    }
+    mill_assert(0);
+    return -1;
+}
+
 int mill_sslport_(struct mill_sslsock_ *s) {
     if(s->type == MILL_SSLLISTENER) {
         struct mill_ssllistener *l = (struct mill_ssllistener*)s;
@@ -170,6 +195,7 @@ void mill_sslclose_(struct mill_sslsock_ *s) {
         tcpclose(c->s);
         BIO_ssl_shutdown(c->bio);
         BIO_free_all(c->bio);
+        free(c->wbuf);
         free(c);
         break;
     default:
@@ -209,6 +235,7 @@ static struct mill_sslsock_ *ssl_conn_new(tcpsock s, SSL_CTX *ctx, int client) {
     c->sock.type = MILL_SSLCONN;
     c->bio = sbio;
     c->s = s;
+    c->wbuf = NULL;
     /* OPTIONAL: call ssl_handshake() to check/verify peer certificate */
     return &c->sock;
 }
@@ -275,6 +302,69 @@ ssize_t mill_sslsend_(struct mill_sslsock_ *s, const void *buf, int len,
     }
 }
 
+static int ssl_writeall(struct mill_sslconn *c, const char *buf, size_t len,
+      int64_t deadline) {
+    while(len) {
+        int rc = BIO_write(c->bio, buf, (int)len);
+        if(rc > 0) {
+            buf += rc;
+            len -= rc;
+            continue;
+        }
+        if(ssl_wait(c, deadline) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+ssize_t mill_sslsendv_(struct mill_sslsock_ *s, const struct iovec *iov,
+      int iovcnt, int64_t deadline) {
+    if(s->type != MILL_SSLCONN)
+        mill_panic("trying to use an unconnected socket");
+    struct mill_sslconn *c = (struct mill_sslconn*)s;
+    if(iovcnt < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Every write is a record of its own, small vectors are coalesced
+       so that they go out in as few records as possible. */
+    size_t wlen = 0, sent = 0;
+    int i;
+    for(i = 0; i != iovcnt; ++i) {
+        const char *base = (const char*)iov[i].iov_base;
+        size_t len = iov[i].iov_len;
+        if(wlen + len > MILL_SSL_RECLEN && wlen) {
+            if(ssl_writeall(c, c->wbuf, wlen, deadline) < 0)
+                return sent;
+            sent += wlen;
+            wlen = 0;
+        }
+        if(len >= MILL_SSL_RECLEN) {
+            if(ssl_writeall(c, base, len, deadline) < 0)
+                return sent;
+            sent += len;
+            continue;
+        }
+        if(!c->wbuf) {
+            c->wbuf = malloc(MILL_SSL_RECLEN);
+            if(!c->wbuf) {
+                errno = ENOMEM;
+                return sent;
+            }
+        }
+        memcpy(&c->wbuf[wlen], base, len);
+        wlen += len;
+    }
+    if(wlen) {
+        if(ssl_writeall(c, c->wbuf, wlen, deadline) < 0)
+            return sent;
+        sent += wlen;
+    }
+    errno = 0;
+    return sent;
+}
+
 void mill_sslflush_(struct mill_sslsock_ *s, int64_t deadline) {
     if(s->type != MILL_SSLCONN)
         mill_panic("trying to use an unconnected socket");
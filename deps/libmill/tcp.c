@@ -25,6 +25,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <netinet/in.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -32,6 +33,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/sendfile.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "debug.h"
@@ -48,6 +50,15 @@
 #define MILL_TCP_BUFLEN (1500 - 68)
 #endif
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* Number of vectors tcpsendv() can gather without allocating. */
+#ifndef MILL_TCP_IOVLEN
+#define MILL_TCP_IOVLEN 16
+#endif
+
 enum mill_tcptype {
    MILL_TCPLISTENER,
    MILL_TCPCONN
@@ -105,11 +116,33 @@ static void tcpconn_init(struct mill_tcpconn *conn, int fd) {
 }
 
 struct mill_tcpsock_ *mill_tcplisten_(ipaddr addr, int backlog) {
+    return mill_tcplisten2_(addr, backlog, 0);
+}
+
+struct mill_tcpsock_ *mill_tcplisten2_(ipaddr addr, int backlog, int reuseport) {
     /* Open the listening socket. */
     int s = socket(mill_ipfamily(addr), SOCK_STREAM, 0);
     if(s == -1)
         return NULL;
     mill_tcptune(s);
+    if(reuseport) {
+#ifdef SO_REUSEPORT
+        /* Allow multiple processes to bind to the same address, the kernel
+           load balances incoming connections between the sockets. */
+        int opt = 1;
+        int rc = setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof (opt));
+        if(rc != 0) {
+            int err = errno;
+            close(s);
+            errno = err;
+            return NULL;
+        }
+#else
+        close(s);
+        errno = ENOTSUP;
+        return NULL;
+#endif
+    }
 
     /* Start listening. */
     int rc = bind(s, (struct sockaddr*)&addr, mill_iplen(addr));
@@ -151,6 +184,19 @@ struct mill_tcpsock_ *mill_tcplisten_(ipaddr addr, int backlog) {
     return &l->sock;
 }
 
+int mill_tcpfd_(struct mill_tcpsock_ *s) {
+    if(s->type == MILL_TCPCONN) {
+        struct mill_tcpconn *c = (struct mill_tcpconn*)s;
+        return c->fd;
+    }
+    else if(s->type == MILL_TCPLISTENER) {
+        struct mill_tcplistener *l = (struct mill_tcplistener*)s;
+        return l->fd;
+    }
+    mill_assert(0);
+    return -1;
+}
+
 int mill_tcpport_(struct mill_tcpsock_ *s) {
     if(s->type == MILL_TCPCONN) {
         struct mill_tcpconn *c = (struct mill_tcpconn*)s;
@@ -348,6 +394,94 @@ size_t mill_tcpsendfile_(struct mill_tcpsock_ *s, int fd, off_t offset,
     return len;
 }
 
+size_t mill_tcpsendv_(struct mill_tcpsock_ *s, const struct iovec *iov,
+        int iovcnt, int64_t deadline) {
+    if(s->type != MILL_TCPCONN)
+        mill_panic("trying to send to an unconnected socket");
+    struct mill_tcpconn *conn = (struct mill_tcpconn*)s;
+    if(iovcnt < 0) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    /* Whatever is in the output buffer goes out first, in the same
+       gather write as the vectors which are sent in-place. */
+    struct iovec stackv[MILL_TCP_IOVLEN];
+    struct iovec *vec = stackv;
+    int cnt = iovcnt + 1;
+    if(cnt > MILL_TCP_IOVLEN) {
+        vec = malloc(sizeof(struct iovec) * cnt);
+        if(!vec) {
+            errno = ENOMEM;
+            return 0;
+        }
+    }
+    vec[0].iov_base = conn->obuf;
+    vec[0].iov_len = conn->olen;
+    memcpy(&vec[1], iov, sizeof(struct iovec) * iovcnt);
+
+    size_t len = 0;
+    int i;
+    for(i = 0; i != iovcnt; ++i)
+        len += iov[i].iov_len;
+
+    struct iovec *pos = vec;
+    size_t remaining = len + conn->olen;
+    size_t ret = len;
+    errno = 0;
+    while(remaining) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = pos;
+        msg.msg_iovlen = cnt > IOV_MAX ? IOV_MAX : cnt;
+        ssize_t sz = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if(sz == -1) {
+            /* Operating systems are inconsistent w.r.t. returning EPIPE and
+               ECONNRESET. Let's paper over it like this. */
+            if(errno == EPIPE) {
+                errno = ECONNRESET;
+                ret = 0;
+                break;
+            }
+            if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                ret = 0;
+                break;
+            }
+            int rc = fdwait(conn->fd, FDW_OUT, deadline);
+            if(rc == 0) {
+                errno = ETIMEDOUT;
+                ret = (remaining > len) ? 0 : len - remaining;
+                break;
+            }
+            continue;
+        }
+        remaining -= sz;
+        /* Skip the vectors that were completely sent. */
+        while(cnt && (size_t)sz >= pos->iov_len) {
+            sz -= pos->iov_len;
+            ++pos;
+            --cnt;
+        }
+        if(sz) {
+            pos->iov_base = (char*)pos->iov_base + sz;
+            pos->iov_len -= sz;
+        }
+    }
+    if(!remaining)
+        errno = 0;
+    /* Keep whatever part of the output buffer wasn't sent, it goes out first
+       next time. */
+    if(pos != vec)
+        conn->olen = 0;
+    else if(vec[0].iov_len != conn->olen) {
+        memmove(conn->obuf, vec[0].iov_base, vec[0].iov_len);
+        conn->olen = vec[0].iov_len;
+    }
+    if(vec != stackv)
+        free(vec);
+    return ret;
+}
+
 void mill_tcpflush_(struct mill_tcpsock_ *s, int64_t deadline) {
     if(s->type != MILL_TCPCONN)
         mill_panic("trying to send to an unconnected socket");
@@ -0,0 +1,132 @@
+//
+// Created by dc on 18/10/26.
+//
+
+#include "arena.h"
+
+namespace suil {
+
+    static inline size_t alignup(size_t off, size_t align) {
+        return (off + (align - 1)) & ~(align - 1);
+    }
+
+    Arena::Arena(size_t block)
+        : m_block(MAX(block, sizeof(Block)*4))
+    {}
+
+    Arena::Block* Arena::newblock(size_t size) {
+        auto *b = (Block *) ::malloc(sizeof(Block) + size);
+        if (b == nullptr)
+            throw Exception::allocationFailure("Arena::allocate failed ", std::string(errno_s));
+        b->next = nullptr;
+        b->size = size;
+        return b;
+    }
+
+    void* Arena::allocate(size_t size, size_t align) {
+        m_used += size;
+        if (size > (m_block >> 2)) {
+            // large allocations don't waste the rest of the current block
+            Block *b = newblock(size + align);
+            b->next  = m_large;
+            m_large  = b;
+            return b->data() + (alignup((uintptr_t) b->data(), align) - (uintptr_t) b->data());
+        }
+
+        size_t off = alignup(m_offset, align);
+        if (m_current == nullptr || (off + size) > m_current->size) {
+            // move to the next block, reusing those kept from previous rounds
+            Block *next = m_current? m_current->next : m_head;
+            if (next == nullptr) {
+                next = newblock(m_block);
+                if (m_current)
+                    m_current->next = next;
+                else
+                    m_head = next;
+            }
+            m_current = next;
+            off = 0;
+        }
+
+        m_offset = off + size;
+        return m_current->data() + off;
+    }
+
+    char* Arena::strndup(const char *str, size_t len) {
+        auto *s = (char *) allocate(len+1, 1);
+        memcpy(s, str, len);
+        s[len] = '\0';
+        return s;
+    }
+
+    void Arena::reset() {
+        while (m_large != nullptr) {
+            Block *b = m_large;
+            m_large = b->next;
+            ::free(b);
+        }
+        m_current = m_head;
+        m_offset  = 0;
+        m_used    = 0;
+    }
+
+    Arena::~Arena() {
+        reset();
+        while (m_head != nullptr) {
+            Block *b = m_head;
+            m_head = b->next;
+            ::free(b);
+        }
+        m_current = nullptr;
+    }
+}
+
+#ifdef unit_test
+#include <catch/catch.hpp>
+
+using namespace suil;
+
+TEST_CASE("suil::Arena", "[arena]")
+{
+    SECTION("Allocating from blocks") {
+        Arena arena(256);
+        auto *a = (char *) arena.allocate(10, 1);
+        auto *b = (char *) arena.allocate(8, 8);
+        REQUIRE(b == a + 16);
+        REQUIRE(((uintptr_t) b & 7) == 0);
+        REQUIRE(arena.used() == 18);
+        // the first block is full, the next one is chained
+        for (int i = 0; i < 8; i++)
+            arena.allocate(60, 1);
+        REQUIRE(arena.m_head->next != nullptr);
+        REQUIRE(arena.m_large == nullptr);
+
+        // blocks are reused after a reset
+        Arena::Block *second = arena.m_head->next;
+        arena.reset();
+        REQUIRE(arena.used() == 0);
+        REQUIRE(arena.allocate(10, 1) == a);
+        for (int i = 0; i < 5; i++)
+            arena.allocate(60, 1);
+        REQUIRE(arena.m_current == second);
+    }
+
+    SECTION("Large allocations") {
+        Arena arena(256);
+        auto *small = arena.allocate(16);
+        auto *large = (char *) arena.allocate(1024);
+        REQUIRE(arena.m_large != nullptr);
+        memset(large, 'a', 1024);
+        // the current block is still used for small allocations
+        REQUIRE((char *) arena.allocate(16) == (char *) small + 16);
+        arena.reset();
+        REQUIRE(arena.m_large == nullptr);
+    }
+
+    SECTION("Duplicating strings") {
+        Arena arena;
+        char *s = arena.strndup("hello world", 5);
+        REQUIRE(strcmp(s, "hello") == 0);
+    }
+}
+#endif
@@ -0,0 +1,89 @@
+//
+// Created by dc on 18/10/26.
+//
+
+#ifndef SUIL_ARENA_H
+#define SUIL_ARENA_H
+
+#include <cstddef>
+
+#include <suil/base.h>
+
+#ifndef SUIL_ARENA_BLOCK_SZ
+#define SUIL_ARENA_BLOCK_SZ 8192
+#endif
+
+namespace suil {
+
+    /**
+     * A bump allocator for memory that shares the same lifetime, e.g
+     * everything allocated while handling a request. Memory is carved out
+     * of chained blocks and released all at once with \see Arena::reset,
+     * blocks are kept for reuse so a long lived arena stops allocating
+     * once it has grown to its high-water mark.
+     *
+     * Destructors are never invoked on memory returned by the arena
+     */
+    struct Arena {
+        /**
+         * @param block the size of each block, allocations larger than a
+         * quarter of this size get a block of their own
+         */
+        explicit Arena(size_t block = SUIL_ARENA_BLOCK_SZ);
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        /**
+         * allocates memory from the arena
+         * @param size the number of bytes to allocate
+         * @param align the alignment of the returned pointer, must be a power of 2
+         * @return a pointer to the allocated memory, valid until the arena is reset
+         *
+         * @throws Exception::allocationFailure if the arena cannot grow
+         */
+        void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+        /**
+         * copies the given string into the arena
+         * @return a null terminated copy of \param str
+         */
+        char *strndup(const char *str, size_t len);
+
+        /**
+         * releases everything that was allocated from the arena, the pointers
+         * previously returned are no longer valid
+         */
+        void reset();
+
+        /**
+         * @return the number of bytes allocated since the last reset
+         */
+        inline size_t used() const {
+            return m_used;
+        }
+
+        ~Arena();
+
+    private suil_ut:
+        struct Block {
+            Block  *next;
+            size_t  size;
+            inline char *data() {
+                return (char *) (this + 1);
+            }
+        };
+
+        static Block *newblock(size_t size);
+
+        Block   *m_head{nullptr};
+        Block   *m_current{nullptr};
+        // allocations which didn't fit in a block, freed on reset
+        Block   *m_large{nullptr};
+        size_t   m_offset{0};
+        size_t   m_block;
+        size_t   m_used{0};
+    };
+}
+
+#endif //SUIL_ARENA_H
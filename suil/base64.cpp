@@ -4,60 +4,38 @@
 
 #include "buffer.h"
 #include "base64.h"
+#include "simd.h"
 
 namespace suil {
 
     namespace utils {
 
-        String base64::encode(const uint8_t *data, size_t sz) {
+        String base64::encode(const uint8_t *data, size_t sz, bool url) {
             OBuffer ob{};
-            encode(ob, data, sz);
+            encode(ob, data, sz, url);
             return String(ob);
         }
 
-        void base64::encode(OBuffer& ob, const uint8_t *data, size_t sz) {
-            static char b64table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        void base64::encode(OBuffer& ob, const uint8_t *data, size_t sz, bool url) {
             ob.reserve(2+((sz+2)/3*4));
 
             char *out = ob.data();
-            char *it = out;
-            while (sz >= 3) {
-                // |X|X|X|X|X|X|-|-|
-                *it++ = b64table[((*data & 0xFC) >> 2)];
-                // |-|-|-|-|-|-|X|X|
-                uint8_t h = (uint8_t) (*data++ & 0x03) << 4;
-                // |-|-|-|-|-|-|X|X|_|X|X|X|X|-|-|-|-|
-                *it++ = b64table[h | ((*data & 0xF0) >> 4)];
-                // |-|-|-|-|X|X|X|X|
-                h = (uint8_t) (*data++ & 0x0F) << 2;
-                // |-|-|-|-|X|X|X|X|_|X|X|-|-|-|-|-|-|
-                *it++ = b64table[h | ((*data & 0xC0) >> 6)];
-                // |-|-|X|X|X|X|X|X|
-                *it++ = b64table[(*data++ & 0x3F)];
-                sz -= 3;
-            }
-
-            if (sz == 1) {
-                // pad with ==
-                // |X|X|X|X|X|X|-|-|
-                *it++ = b64table[((*data & 0xFC) >> 2)];
-                // |-|-|-|-|-|-|X|X|
-                uint8_t h = (uint8_t) (*data++ & 0x03) << 4;
-                *it++ = b64table[h];
-                *it++ = '=';
-                *it++ = '=';
-            } else if (sz == 2) {
-                // pad with =
-                // |X|X|X|X|X|X|-|-|
-                *it++ = b64table[((*data & 0xFC) >> 2)];
-                // |-|-|-|-|-|-|X|X|
-                uint8_t h = (uint8_t) (*data++ & 0x03) << 4;
-                // |-|-|-|-|-|-|X|X|_|X|X|X|X|-|-|-|-|
-                *it++ = b64table[h | ((*data & 0xF0) >> 4)];
-                // |-|-|-|-|X|X|X|X|
-                h = (uint8_t) (*data++ & 0x0F) << 2;
-                *it++ = b64table[h];
-                *it++ = '=';
+            // whole groups of 3 bytes with the vectorized kernels
+            size_t bulk = sz - (sz % 3);
+            simd::b64encode(data, bulk, out, url);
+            char *it = out + (bulk/3*4);
+
+            if (sz > bulk) {
+                // the remaining 1 or 2 bytes, padded with 0's
+                uint8_t tail[3] = {0};
+                memcpy(tail, &data[bulk], sz - bulk);
+                simd::b64encode(simd::Scalar, tail, 3, it, url);
+                it += (sz - bulk) + 1;
+                if (!url) {
+                    // pad with = or ==
+                    while ((it - out) % 4)
+                        *it++ = '=';
+                }
             }
 
             *it = '\0';
@@ -65,72 +43,39 @@ namespace suil {
             ob.bseek(it-out);
         }
 
-        String base64::decode(const uint8_t *in, size_t size) {
+        String base64::decode(const uint8_t *in, size_t size, bool url) {
             OBuffer b((uint32_t) (size/4)*3);
-            decode(b, in, size);
+            decode(b, in, size, url);
             return String{b};
         }
 
-        void base64::decode(OBuffer& ob, const uint8_t *in, size_t size) {
+        void base64::decode(OBuffer& ob, const uint8_t *in, size_t size, bool url) {
             ob.reserve((uint32_t) (((size/4)*3)+4));
-            static const unsigned char ASCII_LOOKUP[256] =
-            {
-                /* ASCII table */
-                64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
-                64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
-                64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 62, 64, 64, 64, 63,
-                52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 64, 64, 64, 64, 64, 64,
-                64,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
-                15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 64, 64, 64, 64, 64,
-                64, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
-                41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 64, 64, 64, 64, 64,
-                64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
-                64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
-                64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
-                64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
-                64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
-                64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
-                64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
-                64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64
-            };
-            size_t sz = size, pos{0};
-            const uint8_t *it = in;
-            char *data = ob.data();
-
-            while (sz > 4) {
-                if (ASCII_LOOKUP[it[0]] == 64 ||
-                    ASCII_LOOKUP[it[1]] == 64 ||
-                    ASCII_LOOKUP[it[2]] == 64 ||
-                    ASCII_LOOKUP[it[3]] == 64)
-                {
-                    // invalid base64 character
-                    throw Exception::invalidArguments("utils::base64::decode - invalid base64 encoded string passed");
-                }
+            auto src = (const char *) in;
+            size_t sz{size};
+            // padding is optional
+            for (int i = 0; i < 2 && sz > 0 && src[sz-1] == '='; i++)
+                sz--;
+            if ((sz % 4) == 1)
+                throw Exception::invalidArguments("utils::base64::decode - invalid base64 encoded string passed");
 
-                data[pos++] = ((uint8_t)(ASCII_LOOKUP[it[0]] << 2 | ASCII_LOOKUP[it[1]] >> 4));
-                data[pos++] = ((uint8_t)(ASCII_LOOKUP[it[1]] << 4 | ASCII_LOOKUP[it[2]] >> 2));
-                data[pos++] = ((uint8_t)(ASCII_LOOKUP[it[2]] << 6 | ASCII_LOOKUP[it[3]]));
-                sz -= 4;
-                it += 4;
+            auto data = (uint8_t *) ob.data();
+            size_t bulk = sz - (sz % 4), pos = bulk/4*3;
+            bool ok = simd::b64decode(src, bulk, data, url);
+            if (ok && sz > bulk) {
+                // the last 2 or 3 characters, padded with 'A' (0)
+                char tail[4] = {'A', 'A', 'A', 'A'};
+                uint8_t bytes[3];
+                memcpy(tail, &src[bulk], sz - bulk);
+                ok = simd::b64decode(simd::Scalar, tail, 4, bytes, url);
+                memcpy(&data[pos], bytes, sz - bulk - 1);
+                pos += sz - bulk - 1;
             }
-            int i = 0;
-            while ((it[i] != '=') && (ASCII_LOOKUP[it[i]] != 64) && (i++ < 4));
-            if ((sz-i) && (it[i] != '=')) {
+
+            if (!ok) {
                 // invalid base64 character
                 throw Exception::invalidArguments("utils::base64::decode - invalid base64 encoded string passed");
             }
-            sz -= 4-i;
-
-            if (sz > 1) {
-                data[pos++] = ((uint8_t)(ASCII_LOOKUP[it[0]] << 2 | ASCII_LOOKUP[it[1]] >> 4));
-            }
-            if (sz > 2) {
-                data[pos++] = ((uint8_t)(ASCII_LOOKUP[it[1]] << 4 | ASCII_LOOKUP[it[2]] >> 2));
-            }
-            if (sz > 3) {
-                data[pos++] = ((uint8_t)(ASCII_LOOKUP[it[2]] << 6 | ASCII_LOOKUP[it[3]]));
-            }
-
             ob.seek(pos);
         }
     }
@@ -197,6 +142,37 @@ TEST_CASE("base64 encoding", "[common][utils][base64]")
         String db(utils::base64::decode(b64));
         REQUIRE(ob == db);
     }
+
+    SECTION("url safe alphabet") {
+        raw = "\xfb\xff\xbf?";  // +/+/Pw==
+        b64 = utils::base64::encode(raw);
+        CHECK(b64.compare("+/+/Pw==") == 0);
+        b64 = utils::base64::encode(raw, true);
+        CHECK(b64.compare("-_-_Pw") == 0);
+        REQUIRE(raw == utils::base64::decode(b64, true));
+        REQUIRE(raw == utils::base64::decode(String{"-_-_Pw=="}, true));
+        // each alphabet rejects the characters of the other
+        REQUIRE_THROWS(utils::base64::decode(b64));
+        REQUIRE_THROWS(utils::base64::decode(String{"+/+/Pw=="}, true));
+    }
+
+    SECTION("long and invalid data") {
+        std::string str;
+        for (int i = 0; i < 1000; i++) {
+            str += (char) (i * 7);
+            String enc = utils::base64::encode(str);
+            REQUIRE(enc.size() == (str.size()+2)/3*4);
+            REQUIRE(utils::base64::decode(enc) == String{str});
+            // padding is optional
+            strview sv{enc.data(), enc.size()};
+            while (!sv.empty() && sv.back() == '=')
+                sv.remove_suffix(1);
+            REQUIRE(utils::base64::decode(sv) == String{str});
+        }
+        REQUIRE_THROWS(utils::base64::decode("SGVsbG8gV29ybGQh!"));
+        REQUIRE_THROWS(utils::base64::decode("SGVsbG8gV2*ybGQhSGVsbG8gV29ybGQhSGVsbG8gV29ybGQh"));
+        REQUIRE_THROWS(utils::base64::decode("SGVsb"));
+    }
 }
 
 
@@ -11,32 +11,40 @@ namespace suil {
 
     namespace utils::base64 {
 
-        void encode(OBuffer& ob, const uint8_t *, size_t);
+        /**
+         * base64 encodes the given data, \param url selects the URL and filename
+         * safe alphabet (`-_` instead of `+/`), without padding
+         */
+        void encode(OBuffer& ob, const uint8_t *, size_t, bool url = false);
 
-        String encode(const uint8_t *, size_t);
+        String encode(const uint8_t *, size_t, bool url = false);
 
-        static String encode(const String &str) {
-            return encode((const uint8_t *) str.data(), str.size());
+        static String encode(const String &str, bool url = false) {
+            return encode((const uint8_t *) str.data(), str.size(), url);
         }
 
-        static String encode(const std::string &str) {
-            return encode((const uint8_t *) str.data(), str.size());
+        static String encode(const std::string &str, bool url = false) {
+            return encode((const uint8_t *) str.data(), str.size(), url);
         }
 
-        void decode(OBuffer& ob, const uint8_t *in, size_t len);
+        /**
+         * decodes base64 encoded data, the padding is optional and \param url
+         * selects the URL and filename safe alphabet
+         */
+        void decode(OBuffer& ob, const uint8_t *in, size_t len, bool url = false);
 
-        String decode(const uint8_t *in, size_t len);
+        String decode(const uint8_t *in, size_t len, bool url = false);
 
         static String decode(const char *in) {
             return decode((const uint8_t *) in, strlen(in));
         }
 
-        static String decode(strview &sv) {
-            return std::move(decode((const uint8_t *) sv.data(), sv.size()));
+        static String decode(strview &sv, bool url = false) {
+            return std::move(decode((const uint8_t *) sv.data(), sv.size(), url));
         }
 
-        static String decode(const String &zc) {
-            return std::move(decode((const uint8_t *) zc.data(), zc.size()));
+        static String decode(const String &zc, bool url = false) {
+            return std::move(decode((const uint8_t *) zc.data(), zc.size(), url));
         }
     }
 }
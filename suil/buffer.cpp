@@ -217,6 +217,28 @@ namespace suil {
 
         return m_offset - rc;
     }
+
+    OBufferSink::OBufferSink(OBuffer& ob, size_t threshold, Flusher flusher)
+        : ob(ob),
+          limit(threshold),
+          flusher(std::move(flusher))
+    {}
+
+    bool OBufferSink::flush(bool force) {
+        if (failed)
+            return false;
+        if (ob.empty() || (!force && (limit == 0 || ob.size() < limit)))
+            return true;
+
+        if (!flusher(ob.data(), ob.size())) {
+            failed = true;
+            return false;
+        }
+        total += ob.size();
+        // the memory is reused for the next chunk
+        ob.reset(limit, true);
+        return true;
+    }
 }
 
 #ifdef unit_test
@@ -580,6 +602,39 @@ TEST_CASE("OBuffer tests", "[common][obuffer]")
             std::string str = ob;
             REQUIRE(__Check(ob, 0, &str[0], str.size()));
         }
+
+        WHEN("Using an output buffer sink") {
+            OBuffer ob{0};
+            std::string out;
+            OBufferSink sink(ob, 8, [&](const char *data, size_t size) {
+                out.append(data, size);
+                return true;
+            });
+            ob << "Hello";
+            REQUIRE(sink.flush());
+            // below the threshold, nothing is flushed
+            REQUIRE(out.empty());
+            ob << " World";
+            REQUIRE(sink.flush());
+            REQUIRE(out == "Hello World");
+            REQUIRE(ob.empty());
+            ob << "!";
+            REQUIRE(sink.flush(true));
+            REQUIRE(out == "Hello World!");
+            REQUIRE(sink.flushed() == 12);
+
+            OBufferSink broken(ob, 0, [&](const char *data, size_t size) {
+                return false;
+            });
+            // an empty buffer is never flushed
+            REQUIRE(broken.flush(true));
+            ob << "Hello";
+            // without a threshold, only forced flushes drain the buffer
+            REQUIRE(broken.flush());
+            REQUIRE_FALSE(broken.flush(true));
+            // a failed sink stays failed
+            REQUIRE_FALSE(broken.flush());
+        }
     }
 }
 
@@ -6,14 +6,12 @@
 #define SUIL_BUFFER_H
 
 #include <type_traits>
+#include <functional>
 
 #include <suil/wire.h>
 
 namespace suil {
 
-    struct OBufferSink {
-
-    };
     /**
      * A lightweight ouput buffer
      */
@@ -738,6 +736,69 @@ namespace suil {
 
     static_assert(sizeof(OBuffer) <= 16, "Output buffer size must be <= 16");
 
+    /**
+     * An output buffer drained into a flusher whenever it holds at least
+     * a threshold of bytes, used to produce large outputs (e.g a response
+     * body) in bounded memory
+     *
+     * \example
+     *  OBufferSink sink(ob, 8192, [&](const char *data, size_t size) {
+     *      return sock.send(data, size, timeout) == size;
+     *  });
+     *  while (...) { sink.buffer() << ...; sink.flush(); }
+     *  sink.flush(true);
+     */
+    struct OBufferSink {
+        /**
+         * the callback draining the buffer, it must return false on failure
+         */
+        using Flusher = std::function<bool(const char *data, size_t size)>;
+
+        /**
+         * @param ob the buffer to write into, it's emptied on each flush
+         * @param threshold the number of bytes in the buffer which triggers a
+         * flush, 0 only flushes when forced
+         * @param flusher the callback draining the buffer
+         */
+        OBufferSink(OBuffer& ob, size_t threshold, Flusher flusher);
+
+        /**
+         * drains the buffer if it holds at least threshold bytes
+         * @param force drain any buffered data regardless of the threshold
+         * @return false if draining the buffer failed (the sink then fails
+         * all flushes that follow)
+         */
+        bool flush(bool force = false);
+
+        /**
+         * @return the buffer being written into
+         */
+        inline OBuffer& buffer() {
+            return ob;
+        }
+
+        /**
+         * @return the number of bytes drained so far
+         */
+        inline size_t flushed() const {
+            return total;
+        }
+
+        /**
+         * @return the number of bytes which triggers a flush
+         */
+        inline size_t threshold() const {
+            return limit;
+        }
+
+    private suil_ut:
+        OBuffer&  ob;
+        size_t    limit{0};
+        size_t    total{0};
+        bool      failed{false};
+        Flusher   flusher;
+    };
+
     namespace __internal {
 
         template<typename V>
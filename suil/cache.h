@@ -0,0 +1,465 @@
+//
+// Created by dc on 18/10/26.
+//
+
+#ifndef SUIL_CACHE_H
+#define SUIL_CACHE_H
+
+#include <suil/channel.h>
+#include <suil/logging.h>
+#include <suil/utils.h>
+
+#include <functional>
+#include <list>
+#include <memory>
+
+namespace suil {
+
+    define_log_tag(CACHE);
+
+    struct cache_config {
+        // the number of shards, each evicts its own least recently used entries. Only
+        // used when the cache is created
+        size_t   shards{8};
+        // the maximum number of bytes cached, split evenly among shards, 0 is unbounded
+        size_t   max_bytes{64*1024*1024};
+        // the maximum number of entries cached, split evenly among shards, 0 is unbounded
+        size_t   max_entries{0};
+        // how long (ms) an entry is fresh, < 0 never expires
+        int64_t  ttl{-1};
+        // how long (ms) an expired entry can still be served while it's being reloaded
+        int64_t  stale{0};
+        // how long (ms) to wait for a load started by another coroutine, < 0 waits forever
+        int64_t  wait{-1};
+    };
+
+    struct cache_stats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        // expired entries served while being reloaded
+        uint64_t stale{0};
+        uint64_t loads{0};
+        // lookups that waited for a load started by another coroutine
+        uint64_t coalesced{0};
+        uint64_t evictions{0};
+        uint64_t expired{0};
+        size_t   entries{0};
+        size_t   bytes{0};
+    };
+
+    /**
+     * the number of bytes accounted for a cached value, overload for
+     * values that own memory beyond their size
+     */
+    template <typename T>
+    inline size_t bytesof(const T&) {
+        return sizeof(T);
+    }
+
+    inline size_t bytesof(const String& s) {
+        return sizeof(String) + s.size();
+    }
+
+    inline size_t bytesof(const std::string& s) {
+        return sizeof(std::string) + s.capacity();
+    }
+
+    inline size_t bytesof(const OBuffer& b) {
+        return sizeof(OBuffer) + b.capacity();
+    }
+
+    /**
+     * A bounded in memory cache of values keyed by strings. The keys are
+     * spread over shards by their (cached) hash, each shard keeps its entries
+     * in least recently used order and evicts from the back when it holds more
+     * than its share of bytes or entries. Entries expire after a time to live
+     * and can be served stale for a while as they get reloaded, concurrent
+     * loads of the same key are coalesced into a single load which the other
+     * coroutines wait for
+     *
+     * @tparam V the cached value type, must be copyable
+     */
+    template <typename V>
+    struct Cache : LOGGER(CACHE) {
+        // the number of bytes taken by a value, \see bytesof by default
+        using Sizer  = std::function<size_t(const V&)>;
+        // loads the value of a key, throws on failure
+        using Loader = std::function<V()>;
+
+        Cache(cache_config cfg = {}, Sizer sizer = nullptr)
+            : config(cfg),
+              shards(std::max(cfg.shards, (size_t) 1)),
+              sizer(sizer? std::move(sizer) : [](const V& v) { return bytesof(v); })
+        {}
+
+        Cache(const Cache&) = delete;
+        Cache& operator=(const Cache&) = delete;
+
+        ~Cache() {
+            if (reloads > 0) {
+                // the reloads in flight still use the cache
+                idebug("waiting for %lu cache reloads to complete", reloads);
+                closing = true;
+                uint8_t token{0};
+                drained >> token;
+            }
+        }
+
+        /**
+         * looks up the value cached for the given key, marking it as the
+         * most recently used entry of its shard
+         *
+         * @param key the key to lookup
+         * @param stale if not null, set to true when the value has expired but
+         * can still be served, \see cache_config::stale. Otherwise expired values
+         * are never returned
+         * @return the cached value, which is only valid until the cache is modified,
+         * or nullptr if the key isn't cached
+         */
+        const V* find(const String& key, bool *stale = nullptr) {
+            auto& s = shard(key);
+            auto it = s.index.find(key);
+            if (it == s.index.end()) {
+                counters.misses++;
+                return nullptr;
+            }
+
+            auto e = it->second;
+            if (e->expires >= 0 && e->expires <= mnow()) {
+                if (stale == nullptr || e->expires + config.stale <= mnow()) {
+                    itrace("cache entry '%s' expired", e->key());
+                    counters.expired++;
+                    counters.misses++;
+                    drop(s, e);
+                    return nullptr;
+                }
+                *stale = true;
+                counters.stale++;
+            }
+            else {
+                counters.hits++;
+            }
+
+            s.lru.splice(s.lru.begin(), s.lru, e);
+            return &e->value;
+        }
+
+        /**
+         * @param key the key to lookup
+         * @param out the value cached for the key, if fresh
+         * @return true if a fresh value is cached for the key
+         */
+        bool get(const String& key, V& out) {
+            auto v = find(key);
+            if (v != nullptr) {
+                out = *v;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * caches a value, replacing the value already cached for the key and
+         * evicting the least recently used entries if the shard is full
+         *
+         * @param key the key to cache the value under
+         * @param value the value to cache
+         * @param ttl how long (ms) the value is fresh, \see cache_config::ttl
+         * is used when not given
+         * @return false if the value is larger than a shard
+         */
+        bool put(const String& key, V value, int64_t ttl = 0) {
+            auto& s = shard(key);
+            size_t bytes = sizeof(entry_t) + key.size() + sizer(value);
+            if (budget() && bytes > budget()) {
+                iwarn("not caching '%s', %lu bytes is larger than a shard", key(), bytes);
+                erase(key);
+                return false;
+            }
+
+            ttl = ttl? ttl : config.ttl;
+            int64_t expires = ttl < 0? -1 : mnow() + ttl;
+            auto it = s.index.find(key);
+            if (it != s.index.end()) {
+                auto e = it->second;
+                s.bytes -= e->bytes;
+                e->value   = std::move(value);
+                e->bytes   = bytes;
+                e->expires = expires;
+                s.lru.splice(s.lru.begin(), s.lru, e);
+            }
+            else {
+                s.lru.push_front(entry_t{key.dup(), std::move(value), bytes, expires});
+                // the index borrows the key from the entry
+                s.index.emplace(s.lru.front().key.peek(), s.lru.begin());
+            }
+            s.bytes += bytes;
+            evict(s);
+            return true;
+        }
+
+        /**
+         * @return true if the key was cached
+         */
+        bool erase(const String& key) {
+            auto& s = shard(key);
+            auto it = s.index.find(key);
+            if (it == s.index.end()) {
+                return false;
+            }
+            drop(s, it->second);
+            return true;
+        }
+
+        /**
+         * returns the fresh value cached for the key, or loads it. Only one
+         * coroutine loads a key at a time, the others wait for that load to
+         * complete. If stale values can be served, an expired value is returned
+         * while it gets reloaded on a separate coroutine
+         *
+         * @param key the key of the value
+         * @param load invoked to load the value if it's not cached. A stale value
+         * is reloaded on its own coroutine which can outlive the call, so the
+         * loader must own (capture by value) everything it uses
+         * @param ttl how long (ms) a loaded value is fresh, \see cache_config::ttl
+         * is used when not given
+         * @return the value of the key
+         *
+         * @throws the exception thrown by \param load, or an exception if the
+         * load being waited for fails or takes too long
+         */
+        V fetch(const String& key, Loader load, int64_t ttl = 0) {
+            while (true) {
+                bool stale{false};
+                auto v = find(key, &stale);
+                if (v != nullptr) {
+                    V tmp = *v;
+                    if (stale && claim(key)) {
+                        // the stale value is served while it gets reloaded, the
+                        // cache waits for the reload before being destroyed
+                        reloads++;
+                        go(revalidate(Ego, new reload_t{key.dup(), load, ttl}));
+                    }
+                    return std::move(tmp);
+                }
+
+                if (claim(key)) {
+                    try {
+                        V tmp = load();
+                        counters.loads++;
+                        put(key, tmp, ttl);
+                        settle(key);
+                        return std::move(tmp);
+                    }
+                    catch (...) {
+                        settle(key, Exception::fromCurrent().what());
+                        throw;
+                    }
+                }
+
+                if (!await(key)) {
+                    throw Exception::create("cache - timed out waiting for '", key(), "' to load");
+                }
+                // the value has been loaded, unless it was evicted
+            }
+        }
+
+        /**
+         * claims the loading of a key, coroutines that \see Cache::await the key
+         * wait until it is settled with \see Cache::settle
+         *
+         * @return false if another coroutine is loading the key
+         */
+        bool claim(const String& key) {
+            auto& s = shard(key);
+            if (s.loading.find(key) != s.loading.end()) {
+                return false;
+            }
+            s.loading.emplace(key.dup(), std::make_shared<flight_t>());
+            return true;
+        }
+
+        /**
+         * completes the loading of a key claimed with \see Cache::claim, waking up
+         * all the coroutines waiting for it
+         *
+         * @param error why loading failed, if it did
+         */
+        void settle(const String& key, const String& error = nullptr) {
+            auto& s = shard(key);
+            auto it = s.loading.find(key);
+            if (it == s.loading.end()) {
+                return;
+            }
+
+            auto f = it->second;
+            s.loading.erase(it);
+            f->settled = true;
+            f->error = error.dup();
+            !f->done;
+        }
+
+        /**
+         * waits until the loading of a key by another coroutine is settled
+         *
+         * @param timeout how long to wait, \see cache_config::wait is used
+         * when not given
+         * @return false if the load was not settled before the timeout, true
+         * otherwise or if the key isn't being loaded
+         *
+         * @throws an exception if loading failed
+         */
+        bool await(const String& key, int64_t timeout = 0) {
+            auto& s = shard(key);
+            auto it = s.loading.find(key);
+            if (it == s.loading.end()) {
+                return true;
+            }
+
+            // the load is kept alive until all waiters have been woken up
+            auto f = it->second;
+            counters.coalesced++;
+            timeout = timeout? timeout : config.wait;
+            uint8_t token{0};
+            if (timeout < 0) {
+                f->done >> token;
+            }
+            else {
+                f->done[timeout] >> token;
+            }
+
+            if (!f->settled) {
+                iwarn("timed out waiting for '%s' to load", key());
+                return false;
+            }
+            if (f->error) {
+                throw Exception::create("cache - loading '", key(), "' failed: ", f->error());
+            }
+            return true;
+        }
+
+        /**
+         * removes all cached entries, loads in progress are not affected
+         */
+        void clear() {
+            for (auto& s: shards) {
+                s.index.clear();
+                s.lru.clear();
+                s.bytes = 0;
+            }
+        }
+
+        /**
+         * @return the counters of the cache
+         */
+        cache_stats stats() const {
+            cache_stats st = counters;
+            for (auto& s: shards) {
+                st.entries += s.lru.size();
+                st.bytes   += s.bytes;
+            }
+            return st;
+        }
+
+        size_t size() const {
+            size_t n{0};
+            for (auto& s: shards) {
+                n += s.lru.size();
+            }
+            return n;
+        }
+
+        cache_config config{};
+
+    private suil_ut:
+        struct entry_t {
+            String   key;
+            V        value;
+            size_t   bytes;
+            int64_t  expires;
+        };
+
+        struct flight_t {
+            Channel<uint8_t> done{0};
+            String           error{};
+            bool             settled{false};
+        };
+
+        struct reload_t {
+            String   key;
+            Loader   load;
+            int64_t  ttl;
+        };
+
+        using Entries = std::list<entry_t>;
+
+        struct shard_t {
+            // the most recently used entry is at the front
+            Entries                  lru;
+            Map<typename Entries::iterator> index;
+            // keys being loaded
+            Map<std::shared_ptr<flight_t>>  loading;
+            size_t                   bytes{0};
+        };
+
+        inline shard_t& shard(const String& key) {
+            // the low bits of the hash pick the bucket within the shard
+            return shards[(key.hash() >> 32) % shards.size()];
+        }
+
+        inline size_t budget() const {
+            return config.max_bytes / shards.size();
+        }
+
+        inline size_t capacity() const {
+            return (config.max_entries + shards.size() - 1) / shards.size();
+        }
+
+        void drop(shard_t& s, typename Entries::iterator e) {
+            s.bytes -= e->bytes;
+            s.index.erase(e->key);
+            s.lru.erase(e);
+        }
+
+        void evict(shard_t& s) {
+            while (!s.lru.empty() &&
+                   ((budget() && s.bytes > budget()) || (capacity() && s.lru.size() > capacity())))
+            {
+                auto e = std::prev(s.lru.end());
+                itrace("evicting cache entry '%s'", e->key());
+                counters.evictions++;
+                drop(s, e);
+            }
+        }
+
+        static coroutine void revalidate(Cache<V>& c, reload_t *r) {
+            std::unique_ptr<reload_t> rl(r);
+            try {
+                V tmp = rl->load();
+                c.counters.loads++;
+                c.put(rl->key, std::move(tmp), rl->ttl);
+                c.settle(rl->key);
+            }
+            catch (...) {
+                auto ex = Exception::fromCurrent();
+                lwarn(&c, "reloading '%s' failed: %s", rl->key(), ex.what());
+                c.settle(rl->key, ex.what());
+            }
+
+            if (--c.reloads == 0 && c.closing) {
+                // wake up the destructor
+                !c.drained;
+            }
+        }
+
+        std::vector<shard_t> shards;
+        Sizer                sizer;
+        cache_stats          counters{};
+        // reloads in flight, \see Cache::~Cache
+        size_t               reloads{0};
+        bool                 closing{false};
+        Channel<uint8_t>     drained{0};
+    };
+}
+
+#endif //SUIL_CACHE_H
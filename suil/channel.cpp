@@ -46,4 +46,4 @@ TEST_CASE("Channel tests", "[common][Channel]") {
     }
 }
 
-#endif
\ No newline at end of file
+#endif
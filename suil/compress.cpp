@@ -3,6 +3,7 @@
 //
 
 #include <snappy/snappy.h>
+#include <zlib.h>
 
 #include "logging.h"
 #include "compression.h"
@@ -69,6 +70,37 @@ namespace suil {
             }
             return Data{buffer, needs, true};
         }
+
+        Data gzip(const uint8_t input[], size_t isz, int level) {
+            z_stream zs{};
+            // 16 + MAX_WBITS selects the gzip wrapper
+            if (deflateInit2(&zs, level, Z_DEFLATED, 16 + MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+                serror("initializing gzip stream failed: %s", zs.msg? zs.msg : "");
+                return Data{};
+            }
+
+            size_t osz = deflateBound(&zs, isz);
+            auto buffer = (uint8_t *) malloc(osz);
+            if (!buffer) {
+                deflateEnd(&zs);
+                throw Exception::create("allocating compression sink memory failed: ", errno_s);
+            }
+
+            zs.next_in   = (Bytef *) input;
+            zs.avail_in  = (uInt) isz;
+            zs.next_out  = buffer;
+            zs.avail_out = (uInt) osz;
+            int ret = deflate(&zs, Z_FINISH);
+            osz = zs.total_out;
+            deflateEnd(&zs);
+            if (ret != Z_STREAM_END) {
+                // deflateBound guarantees a single pass
+                serror("gzip compressing buffer failed: %d", ret);
+                free(buffer);
+                return Data{};
+            }
+            return Data{buffer, osz, true};
+        }
     }
 }
 
@@ -130,6 +162,22 @@ non proident, sunt in culpa qui officia deserunt mollit anim id est laborum.)";
         REQUIRE_NOTHROW((uncompressed = utils::uncompress(compressed)));
         String lstr2{(const char*)uncompressed.data(), uncompressed.size(), false};
         REQUIRE(lstr == lstr2);
+
+        // gzip output must be readable by a gzip decoder
+        Data gz = utils::gzip(lstr);
+        REQUIRE(gz.size());
+        REQUIRE(gz.size() < lstr.size());
+        REQUIRE((gz.data()[0] == 0x1f && gz.data()[1] == 0x8b));
+        std::vector<char> out(lstr.size() + 16);
+        z_stream zs{};
+        REQUIRE(inflateInit2(&zs, 16 + MAX_WBITS) == Z_OK);
+        zs.next_in   = (Bytef *) gz.data();
+        zs.avail_in  = (uInt) gz.size();
+        zs.next_out  = (Bytef *) out.data();
+        zs.avail_out = (uInt) out.size();
+        REQUIRE(inflate(&zs, Z_FINISH) == Z_STREAM_END);
+        inflateEnd(&zs);
+        REQUIRE(String(out.data(), zs.total_out, false) == lstr);
     };
 }
 #endif
\ No newline at end of file
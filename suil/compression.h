@@ -41,6 +41,17 @@ namespace suil {
         inline Data uncompress(const Data &in) {
             return uncompress(in.cdata(), in.size());
         }
+
+        /**
+         * Compresses the given input into the gzip format (RFC 1952)
+         * @param level the zlib compression level, 1 (fastest) to 9 (smallest)
+         * @return the compressed data, empty if compression failed
+         */
+        Data gzip(const uint8_t input[], size_t isz, int level = 9);
+
+        inline Data gzip(const String &in, int level = 9) {
+            return gzip((uint8_t *) in.data(), in.size(), level);
+        }
     }
 }
 #endif //SUIL_COMPRESSION_H
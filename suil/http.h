@@ -9,6 +9,7 @@
 
 #include <suil/http/common.h>
 #include <suil/net.h>
+#include <suil/arena.h>
 
 namespace suil {
 
@@ -200,6 +201,10 @@ namespace suil {
         uint64_t        hsts_enable{3600};
         std::string     server_name{SUIL_SOFTWARE_NAME};
         std::string     offload_path{"./.body"};
+        /* tokenize request heads with the vectorized parser backend */
+        bool            simd_parser{false};
+        /* size of the chunks streamed responses are sent in */
+        size_t          stream_chunk{16384};
     };
 
     namespace http {
@@ -448,7 +453,12 @@ namespace suil {
 
             QueryString();
 
-            QueryString(strview& sv);
+            /**
+             * @param sv the query string to parse
+             * @param arena if given the parsed query string is allocated from
+             * the arena and is only valid until the arena is reset
+             */
+            QueryString(strview& sv, Arena *arena = nullptr);
 
             QueryString(QueryString&& qs);
 
@@ -493,6 +503,7 @@ namespace suil {
             int nparams_{0};
             char *url_{nullptr};
             char **params_{nullptr};
+            bool pooled_{false};
         };
 
         namespace Error {
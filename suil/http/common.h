@@ -776,6 +776,7 @@ namespace suil {
                 double_params = std::move(params.double_params);
                 uint_params = std::move(params.uint_params);
                 string_params = std::move(params.string_params);
+                return *this;
             }
 
             routing_params()
@@ -881,6 +882,7 @@ namespace suil {
             router_params_t&operator=(router_params_t&& params) {
                 second = std::move(params.second);
                 first = params.first;
+                return *this;
             }
 
             router_params_t(const router_params_t&) = delete;
@@ -8,6 +8,10 @@
 #include <suil/http/parser.h>
 #include <suil/http/wsock.h>
 
+#ifndef HTTP_TX_BUFFER_SZ
+#define HTTP_TX_BUFFER_SZ 16384
+#endif
+
 namespace suil {
     namespace http {
 
@@ -207,9 +211,49 @@ namespace suil {
             }
         }
 
-#ifndef HTTP_RX_BUFFER_SZ
-#define HTTP_RX_BUFFER_SZ   2048
-#endif
+        /**
+         * The status line and the headers that only depend on the server
+         * configuration are the same for every response with the same status,
+         * they are serialized once per server and copied into each response
+         */
+        struct StaticHeaders {
+            enum : uint8_t {
+                KEEP_ALIVE = 0x01,
+                HSTS       = 0x02,
+                SERVER     = 0x04,
+                // the block ends with the Date field name, the value is appended
+                DATE       = 0x08
+            };
+
+            const String& get(const HttpConfig& config, Status status, uint8_t flags) {
+                uint32_t key = ((uint32_t) status << 8) | flags;
+                auto it = blocks.find(key);
+                if (it != blocks.end())
+                    return it->second;
+
+                OBuffer ob{256};
+                ob << status_text(status) << "\r\n";
+                if (flags & KEEP_ALIVE) {
+                    ob << "Connection: Keep-Alive\r\n"
+                       << "Keep-Alive: " << config.keep_alive_time << "\r\n";
+                }
+                if (flags & HSTS) {
+                    ob << "Strict-Transport-Security: max-age "
+                       << config.hsts_enable << "; includeSubdomains\r\n";
+                }
+                if (flags & SERVER) {
+                    ob << "Server: " << config.server_name << "\r\n";
+                }
+                if (flags & DATE) {
+                    ob << "Date: ";
+                }
+                return blocks.emplace(key, String(ob)).first->second;
+            }
+
+        private:
+            std::unordered_map<uint32_t, String> blocks;
+        };
+
         define_log_tag(HTTP_CONN);
         template <typename H, typename... Mws>
         struct Connection : LOGGER(HTTP_CONN) {
@@ -219,12 +263,14 @@ namespace suil {
                        HttpConfig& config,
                        H& handler,
                        middlewares_t* mws,
-                       ServerStats& stats)
+                       ServerStats& stats,
+                       StaticHeaders& statics)
                     : mws(mws),
                       config(config),
                       sock(sock),
                       handler(handler),
-                      stats(stats)
+                      stats(stats),
+                      statics(statics)
             {
                 stats.total_requests++;
                 stats.open_requests++;
@@ -235,6 +281,8 @@ namespace suil {
 
                 Status  status = Status::OK;
                 Request req(sock, config);
+                // request scoped allocations are released at once between requests
+                req.arena(&arena);
 
                 itrace("%s - starting Connection handler", sock.id());
                 do {
@@ -318,6 +366,7 @@ namespace suil {
                     send_response(req, res, err);
                     if (res.status == Status::SWITCHING_PROTOCOLS && res()) {
                         // easily switch protocols
+                        flush();
                         res()(req, res);
                         close_ = true;
                     }
@@ -328,8 +377,15 @@ namespace suil {
 
                     req.clear();
                     res.clear();
+                    arena.reset();
+                    if (!close_ && !req.pipelined()) {
+                        // no other complete request was received, responses
+                        // to pipelined requests go out in a single write
+                        flush();
+                    }
                 } while (!close_);
 
+                flush();
                 itrace("%p - done handling Connection, %d", this, close_);
             }
 
@@ -352,9 +408,16 @@ namespace suil {
                 obuf.reserve(req.headers.size()+res.chunks.size()+5);
                 hbuf.reset(1024, true);
 
-                const char *status = status_text(res.status);
-                hbuf.append(status);
-                hbuf.append("\r\n", 2);
+                if (err) {
+                    // the error message replaces whatever was to be streamed
+                    res.writer = nullptr;
+                }
+                // HTTP/1.0 clients read streamed bodies until the connection closes
+                bool chunked = res.writer && (req.http_major > 1 || req.http_minor > 0);
+                if (res.writer && !chunked)
+                    close_ = true;
+
+                uint8_t flags{0};
                 if (!err) {
                     const strview conn = req.header("Connection");
                     if (!conn.empty() && !strcasecmp(conn.data(), "Close")) {
@@ -364,16 +427,11 @@ namespace suil {
 
                     if (config.keep_alive_time && !close_) {
                         // set keep alive time
-                        hbuf.append("Connection: Keep-Alive\r\n",
-                                    (sizeof("Connection: Keep-Alive\r\n")-1));
-                        hbuf.appendnf(30, "Keep-Alive: %lu\r\n",
-                                      config.keep_alive_time);
+                        flags |= StaticHeaders::KEEP_ALIVE;
                     }
 
                     if (config.hsts_enable) {
-                        hbuf.reserve(48);
-                        hbuf << "Strict-Transport-Security: max-age "
-                             << config.hsts_enable << "; includeSubdomains\r\n";
+                        flags |= StaticHeaders::HSTS;
                     }
                 }
                 else {
@@ -381,40 +439,53 @@ namespace suil {
                     close_ = true;
                 }
 
-                if (res.status > Status::BAD_REQUEST && !res.body) {
-                    res.body.append((status+9));
+                if (res.status > Status::BAD_REQUEST && !res.body && !res.writer) {
+                    res.body.append((status_text(res.status)+9));
                 }
                 // flush cookies.
                 res.flush_cookies();
 
-                for (auto h : res.headers) {
-                    hbuf.append(h.first.data(), h.first.size());
-                    hbuf.append(" : ", sizeofcstr(" : "));
-                    hbuf.append(h.second.data(), h.second.size());
+                if (!res.headers.count("Server"))
+                    flags |= StaticHeaders::SERVER;
+                if (!res.headers.count("Date"))
+                    flags |= StaticHeaders::DATE;
+
+                // status line and headers which only depend on the configuration
+                const String& block = statics.get(config, res.status, flags);
+                hbuf.append(block.data(), block.size());
+                if (flags & StaticHeaders::DATE) {
+                    const strview date = get_cached_date();
+                    hbuf.append(date.data(), date.size());
                     hbuf.append("\r\n", 2);
                 }
 
-                if (!res.headers.count("Server")) {
-                    hbuf.append("Server: ", sizeofcstr("Server: "));
-                    hbuf.append(config.server_name.data(),
-                                config.server_name.size());
+                for (auto& h : res.headers) {
+                    hbuf.append(h.first.data(), h.first.size());
+                    hbuf.append(" : ", sizeofcstr(" : "));
+                    hbuf.append(h.second.data(), h.second.size());
                     hbuf.append("\r\n", 2);
                 }
 
-                if (!res.headers.count("Date")) {
-                    hbuf.append("Date: ", sizeofcstr("Date: "));
-                    hbuf.append(get_cached_date());
-                    hbuf.append("\r\n", 2);
+                if (chunked) {
+                    hbuf.append("Transfer-Encoding: chunked\r\n", sizeofcstr("Transfer-Encoding: chunked\r\n"));
                 }
-
-                if (!res.headers.count("Content-Length")) {
+                else if (!res.writer && !res.headers.count("Content-Length")) {
+                    hbuf.reserve(sizeofcstr("Content-Length: ") + 24);
                     hbuf.append("Content-Length: ", sizeofcstr("Content-Length: "));
-                    auto tmp = std::to_string(res.length());
-                    hbuf.append(tmp.data(), tmp.size());
+                    hbuf.seek(utils::uitoa(hbuf.data() + hbuf.size(), res.length()));
                     hbuf.append("\r\n", 2);
                 }
 
                 hbuf.append("\r\n", 2);
+                if (res.writer) {
+                    if (!stream_response(res, chunked)) {
+                        iwarn("(%p:%s) - streaming response failed: %s",
+                              this, sock.isopen(), errno_s);
+                        close_ = true;
+                        res.clear();
+                    }
+                    return;
+                }
                 obuf.emplace_back(hbuf.data(), hbuf.size());
 
                 if (res.body) {
@@ -425,7 +496,9 @@ namespace suil {
                     }
                 }
 
-                if (!write_response(obuf)) {
+                // responses to requests pipelined behind this one are written together
+                bool defer = !close_ && req.pending != 0;
+                if (!write_response(obuf, defer)) {
                     iwarn("(%p:%s) - sending data to socket failed: %s",
                           this, sock.isopen(), errno_s);
                     close_ = true;
@@ -436,60 +509,145 @@ namespace suil {
             }
 
 
-            bool write_response(sendbuf_t& buf) {
-                size_t rc{0};
-                for (auto b : buf) {
-                    if (b.use_fd) {
-                        // send file descriptor
-                        size_t nsent = 0;
-                        size_t chunk;
-                        do {
-                            chunk = std::min(config.send_chunk, b.len - nsent);
-                            rc = sock.sendfile(b.fd, (b.offset + nsent), chunk,
-                                               config.connection_timeout);
-                            if (rc == 0 || rc != chunk) {
-                                itrace("(%p) -  sending Response failed: %s", errno_s);
-                                return false;
-                            }
-
-                            nsent += chunk;
-                        } while (nsent < b.len);
+            /* invokes the writer of a streamed response, its output is sent (after the
+             * headers in hbuf) whenever HttpConfig::stream_chunk bytes are buffered */
+            bool stream_response(Response& res, bool chunked) {
+                static const char TRAILER[] = "0\r\n\r\n";
+                char head[24];
+
+                iov.push_back({hbuf.data(), hbuf.size()});
+                sbuf.reset(config.stream_chunk, true);
+                OBufferSink sink(sbuf, config.stream_chunk, [&](const char *data, size_t len) {
+                    if (chunked) {
+                        int n = snprintf(head, sizeof(head), "%zx\r\n", len);
+                        iov.push_back({head, (size_t) n});
                     }
-                    else {
-                        // for buffers we need to chunk the data
-                        size_t nsent = 0;
-                        size_t chunk;
-                        do {
-                            chunk = std::min(config.send_chunk, b.len-nsent);
-                            rc = sock.send(((char *)b.data + b.offset + nsent),
-                                           chunk,
-                                           config.connection_timeout);
-                            if (rc == 0) {
-                                itrace("(%p) sending Response failed: %s", errno_s);
-                                return false;
-                            }
+                    iov.push_back({(char *) data, len});
+                    if (chunked)
+                        iov.push_back({(char *) "\r\n", 2});
+                    return writev();
+                });
+
+                try {
+                    res.writer(sink);
+                    if (!sink.flush(true))
+                        return false;
+                }
+                catch (...) {
+                    // the client gets a truncated body as the headers might be gone
+                    ierror("(%p) - response writer failed: %s", this,
+                           Exception::fromCurrent().what());
+                    iov.clear();
+                    return false;
+                }
 
-                            nsent += chunk;
-                        } while (nsent < b.len);
+                if (chunked)
+                    iov.push_back({(char *) TRAILER, sizeofcstr(TRAILER)});
+                return writev();
+            }
+
+            bool write_response(sendbuf_t& buf, bool defer = false) {
+                if (defer) {
+                    size_t len{0};
+                    bool hasfd{false};
+                    for (auto& b : buf) {
+                        len += b.len;
+                        hasfd = hasfd || b.use_fd;
                     }
 
+                    if (!hasfd && (tx.size() + len) <= HTTP_TX_BUFFER_SZ) {
+                        // keep a copy, the buffers are released with the response
+                        for (auto& b : buf)
+                            tx.append((char *)b.data + b.offset, b.len);
+                        return true;
+                    }
+                }
+
+                for (auto& b : buf) {
+                    if (!b.use_fd) {
+                        // buffers are gathered and written at once
+                        iov.push_back({(char *)b.data + b.offset, b.len});
+                        continue;
+                    }
+
+                    // whatever comes before the file goes out first
+                    if (!writev())
+                        return false;
+
+                    // send file descriptor
+                    size_t nsent = 0;
+                    size_t chunk, rc;
+                    do {
+                        chunk = std::min(config.send_chunk, b.len - nsent);
+                        rc = sock.sendfile(b.fd, (b.offset + nsent), chunk,
+                                           config.connection_timeout);
+                        if (rc == 0 || rc != chunk) {
+                            itrace("(%p) -  sending Response failed: %s", this, errno_s);
+                            return false;
+                        }
+
+                        nsent += chunk;
+                    } while (nsent < b.len);
+
                     // update server statistics
                     stats.tx_bytes += b.len;
                 }
 
-                sock.flush(config.connection_timeout);
+                return writev();
+            }
+
+            bool writev() {
+                if (!tx.empty()) {
+                    // responses held back for pipelined requests go ahead
+                    iov.insert(iov.begin(), iovec{tx.data(), tx.size()});
+                }
+
+                if (iov.empty())
+                    return true;
+
+                size_t len{0};
+                for (auto& v : iov)
+                    len += v.iov_len;
+
+                size_t rc = sock.sendv(iov.data(), (int) iov.size(), config.connection_timeout);
+                tx.reset(0, true);
+                iov.clear();
+                if (rc != len) {
+                    itrace("(%p) sending Response failed: %s", this, errno_s);
+                    return false;
+                }
+
+                // update server statistics
+                stats.tx_bytes += len;
                 return true;
             }
 
-            static const char* get_cached_date() {
+            void flush() {
+                if (!sock.isopen()) {
+                    tx.reset(0, true);
+                    return;
+                }
+
+                if (!writev()) {
+                    iwarn("(%p:%s) - sending data to socket failed: %s",
+                          this, sock.isopen(), errno_s);
+                    close_ = true;
+                    return;
+                }
+                sock.flush(config.connection_timeout);
+            }
+
+            static strview get_cached_date() {
                 static int64_t rec = 0;
                 int64_t point = mnow();
                 static char buf[64];
+                static size_t len{0};
                 if ((point-rec) > 1000) {
                     rec = point;
                     Datetime()(buf, 64, Datetime::HTTP_FMT);
+                    len = strlen(buf);
                 }
-                return buf;
+                return strview(buf, len);
             }
 
             middlewares_t    *mws;
@@ -497,7 +655,14 @@ namespace suil {
             SocketAdaptor&   sock;
             H&               handler;
             ServerStats&     stats;
+            StaticHeaders&   statics;
             OBuffer          hbuf{1024};
+            // responses waiting to be written along with those of pipelined requests
+            OBuffer          tx{0};
+            // chunks of streamed responses
+            OBuffer          sbuf{0};
+            std::vector<struct iovec> iov;
+            Arena            arena;
             bool             close_{false};
         };
     }
@@ -29,7 +29,7 @@ namespace suil {
             struct socket_handler {
                 void operator()(SocketAdaptor &sock, server_t *s) {
                     Connection<H, Mws...> conn(
-                            sock, s->config, s->handler, &s->mws, s->stats);
+                            sock, s->config, s->handler, &s->mws, s->stats, s->statics);
 
                     conn.start();
                 }
@@ -84,6 +84,7 @@ namespace suil {
             H&                handler;
             middlewares_t       mws;
             ServerStats      stats;
+            StaticHeaders    statics;
         };
 
         #define eproute(app, url) \
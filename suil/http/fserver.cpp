@@ -6,19 +6,79 @@
 #include <sys/mman.h>
 
 #include <suil/http/fserver.h>
+#include <suil/compression.h>
 
 namespace suil {
     namespace http {
 
+        static const struct {
+            const char *name;
+            const char *ext;
+        } ENCODINGS[] = {
+            {"br",   ".br"},
+            {"zstd", ".zst"},
+            {"gzip", ".gz"}
+        };
+
+        static bool accepts(const strview& ae, const char *coding) {
+            // e.g "gzip, deflate;q=0.5, br;q=0, *;q=0.1"
+            const char *p = ae.data(), *e = ae.data() + ae.size();
+            size_t len = strlen(coding);
+            int star{-1};
+            while (p < e) {
+                while (p < e && (*p == ' ' || *p == ','))
+                    p++;
+                const char *tok = p;
+                while (p < e && *p != ',' && *p != ';' && *p != ' ')
+                    p++;
+                size_t tlen = p - tok;
+
+                bool zero{false};
+                while (p < e && *p != ',') {
+                    if (*p == ';') {
+                        while (++p < e && *p == ' ');
+                        if ((e - p) > 2 && (*p == 'q' || *p == 'Q') && p[1] == '=') {
+                            // q=0, q=0.0 ... disables the coding
+                            p += 2;
+                            zero = (*p++ == '0');
+                            if (p < e && *p == '.')
+                                p++;
+                            for (; p < e && isdigit(*p); p++)
+                                zero = zero && (*p == '0');
+                        }
+                        continue;
+                    }
+                    p++;
+                }
+
+                if (tlen == len && strncasecmp(tok, coding, len) == 0)
+                    return !zero;
+                if (tlen == 1 && *tok == '*')
+                    star = !zero;
+            }
+            return star == 1;
+        }
+
+        static bool matches(const strview& inm, const String& etag) {
+            // If-None-Match is either * or a list of entity tags
+            return !inm.empty() && (inm == "*" || inm.find(etag()) != strview::npos);
+        }
+
         void FileServer::init() {
             // add text mime types
             mime(".html", "text/html",
-                 opt(allow_caching, false));
-            mime(".css", "text/css");
-            mime(".csv", "text/csv");
-            mime(".txt", "text/plain");
-            mime(".sgml","text/sgml");
-            mime(".tsv", "text/tab-separated-values");
+                 opt(allow_caching, false),
+                 opt(allow_compress, true));
+            mime(".css", "text/css",
+                 opt(allow_compress, true));
+            mime(".csv", "text/csv",
+                 opt(allow_compress, true));
+            mime(".txt", "text/plain",
+                 opt(allow_compress, true));
+            mime(".sgml","text/sgml",
+                 opt(allow_compress, true));
+            mime(".tsv", "text/tab-separated-values",
+                 opt(allow_compress, true));
 
             // add compressed mime types
             mime(".bz", "application/x-bzip",
@@ -40,7 +100,8 @@ namespace suil {
             // add image mime types
             mime(".jpg", "image/jpeg");
             mime(".png", "image/png");
-            mime(".svg", "image/svg+xml");
+            mime(".svg", "image/svg+xml",
+                 opt(allow_compress, true));
             mime(".gif", "image/gif");
             mime(".bmp", "image/bmp");
             mime(".tiff","image/tiff");
@@ -63,12 +124,18 @@ namespace suil {
             mime(".wav", "audio/wav, audio/x-wav");
 
             // Other common mime types
-            mime(".json",  "application/json");
-            mime(".map",   "application/json");
-            mime(".js",    "application/javascript");
-            mime(".ttf",   "font/ttf");
-            mime(".xhtml", "application/xhtml+xml");
-            mime(".xml",   "application/xml");
+            mime(".json",  "application/json",
+                 opt(allow_compress, true));
+            mime(".map",   "application/json",
+                 opt(allow_compress, true));
+            mime(".js",    "application/javascript",
+                 opt(allow_compress, true));
+            mime(".ttf",   "font/ttf",
+                 opt(allow_compress, true));
+            mime(".xhtml", "application/xhtml+xml",
+                 opt(allow_compress, true));
+            mime(".xml",   "application/xml",
+                 opt(allow_compress, true));
 
             char base[PATH_MAX];
             realpath(config.root.data(), base);
@@ -136,7 +203,16 @@ namespace suil {
                 throw Error::notFound();
             }
 
-            cached_file_t& cf = sf->second;
+            cached_file_t& cf = negotiate(req, resp, sf->second);
+            if (!cf.etag.empty()) {
+                resp.header("ETag", cf.etag);
+                if (matches(req.header("If-None-Match"), cf.etag)) {
+                    // client already has this version of the file
+                    resp.end(Status::NOT_MODIFIED);
+                    return;
+                }
+            }
+
             if (mm.allow_caching) {
                 // if file supports cache headers employ cache headers
                 strview cc = req.header("If-Modified-Since");
@@ -174,7 +250,16 @@ namespace suil {
                 throw Error::notFound();
             }
 
-            cached_file_t& cf = sf->second;
+            cached_file_t& cf = negotiate(req, resp, sf->second);
+            if (!cf.etag.empty()) {
+                resp.header("ETag", cf.etag);
+                if (matches(req.header("If-None-Match"), cf.etag)) {
+                    // client already has this version of the file
+                    resp.end(Status::NOT_MODIFIED);
+                    return;
+                }
+            }
+
             if (mm.allow_caching) {
                 // if file supports cache headers employ cache headers
                 strview cc = req.header("If-Modified-Since");
@@ -339,6 +424,7 @@ namespace suil {
                     cf.last_access = (time_t) st.st_atim.tv_sec;
                     cf.len         = (size_t) st.st_size;
                     cf.path        = std::move(path);
+                    encode(cf, mm);
 
                     // file successfully loaded, add file to cache
                     it = cached_files_.emplace(
@@ -377,12 +463,129 @@ namespace suil {
                     cf.last_mod    = (time_t) st.st_mtim.tv_sec;
                     cf.last_access = (time_t) st.st_atim.tv_sec;
                     cf.len         = (size_t) st.st_size;
+                    encode(cf, mm);
                 }
             }
 
             return it;
         }
 
+        void FileServer::encode(cached_file_t &cf, const mime_type_t &mm)
+        {
+            // files served with sendfile are not loaded, map them temporarily
+            void *data = cf.data;
+            if (data == nullptr && cf.len) {
+                data = mmap(NULL, cf.len, PROT_READ, MAP_SHARED, cf.fd, 0);
+                if (data == MAP_FAILED) {
+                    iwarn("mapping static resource (%s) failed: %s", cf.path(), errno_s);
+                    return;
+                }
+            }
+
+            const uint8_t *content = data? (const uint8_t *) data : (const uint8_t *) "";
+            cf.etag = utils::catstr("\"", utils::md5(content, cf.len), "\"");
+
+            if (config.precompress && mm.allow_compress && cf.len >= config.compress_min) {
+                for (int enc = 0; enc < ENCODING_MAX; enc++) {
+                    load_encoded(cf, (encoding_t) enc, data);
+                }
+            }
+
+            if (data != cf.data) {
+                munmap(data, cf.len);
+            }
+        }
+
+        bool FileServer::load_encoded(cached_file_t &cf, encoding_t enc, const void *data)
+        {
+            auto ef = std::make_unique<cached_file_t>();
+            ef->path = utils::catstr(cf.path(), ENCODINGS[enc].ext);
+
+            struct stat st{};
+            if (stat(ef->path.data(), &st) == 0 && S_ISREG(st.st_mode) &&
+                (time_t) st.st_mtim.tv_sec >= cf.last_mod)
+            {
+                // use the precompressed file deployed along with the file
+                ef->fd = open(ef->path.data(), O_RDONLY);
+                if (ef->fd < 0) {
+                    iwarn("opening static resource(%s) failed: %s", ef->path(), errno_s);
+                    return false;
+                }
+            }
+            else if (enc == ENCODING_GZIP) {
+                Data gz = utils::gzip((const uint8_t *) data, cf.len);
+                if (gz.size() == 0 || gz.size() >= cf.len) {
+                    itrace("not keeping gzip variant of %s", cf.path());
+                    return false;
+                }
+
+                // the variant is kept in an anonymous file so that it can be sent with sendfile
+                ef->fd = memfd_create(ENCODINGS[enc].ext, MFD_CLOEXEC);
+                if (ef->fd < 0) {
+                    iwarn("creating gzip variant of %s failed: %s", cf.path(), errno_s);
+                    return false;
+                }
+
+                size_t nwr = 0;
+                while (nwr < gz.size()) {
+                    ssize_t ret = write(ef->fd, gz.cdata() + nwr, gz.size() - nwr);
+                    if (ret < 0) {
+                        iwarn("writing gzip variant of %s failed: %s", cf.path(), errno_s);
+                        return false;
+                    }
+                    nwr += ret;
+                }
+                lseek(ef->fd, 0, SEEK_SET);
+                fstat(ef->fd, &st);
+            }
+            else {
+                // only gzip variants are built
+                return false;
+            }
+
+            if (!read_file(*ef, st)) {
+                itrace("loading %s variant of %s failed", ENCODINGS[enc].name, cf.path());
+                return false;
+            }
+
+            ef->use_fd      = cf.use_fd;
+            ef->last_mod    = cf.last_mod;
+            ef->last_access = cf.last_access;
+            ef->len         = (size_t) st.st_size;
+            ef->etag = utils::catstr("\"", utils::md5((const uint8_t *) ef->data, ef->len), "\"");
+            itrace("loaded %s variant of %s, %lu/%lu bytes",
+                   ENCODINGS[enc].name, cf.path(), ef->len, cf.len);
+            cf.encoded[enc] = std::move(ef);
+            return true;
+        }
+
+        FileServer::cached_file_t& FileServer::negotiate(
+                const Request &req, Response &resp, cached_file_t &cf)
+        {
+            if (std::none_of(cf.encoded.begin(), cf.encoded.end(),
+                             [](const std::unique_ptr<cached_file_t>& ef) { return ef != nullptr; }))
+            {
+                return cf;
+            }
+
+            // the content served depends on the encodings accepted by the client
+            resp.header("Vary", "Accept-Encoding");
+            strview ae = req.header("Accept-Encoding");
+            if (ae.empty() || !req.header("Range").empty()) {
+                // ranges are always served from the original file
+                return cf;
+            }
+
+            for (int enc = 0; enc < ENCODING_MAX; enc++) {
+                if (cf.encoded[enc] && accepts(ae, ENCODINGS[enc].name)) {
+                    resp.header("Content-Encoding", ENCODINGS[enc].name);
+                    return *cf.encoded[enc];
+                }
+            }
+
+            return cf;
+        }
+
         bool FileServer::read_file(cached_file_t &cf, const struct stat &st)
         {
             if (cf.fd < 0) {
@@ -472,6 +675,44 @@ namespace suil {
             size = len = 0;
             fd = -1;
             last_mod = last_access = 0;
+            etag = String{};
+            for (auto& ef : encoded) {
+                ef.reset();
+            }
         }
     }
-}
\ No newline at end of file
+}
+#ifdef unit_test
+#include <catch/catch.hpp>
+
+using namespace suil;
+using namespace suil::http;
+
+TEST_CASE("suil::http::FileServer", "[http][fserver]")
+{
+    SECTION("Negotiating content encodings") {
+        REQUIRE(http::accepts("gzip", "gzip"));
+        REQUIRE(http::accepts("deflate, GZIP", "gzip"));
+        REQUIRE(http::accepts("gzip;q=0.5, br", "br"));
+        REQUIRE(http::accepts("gzip ; q=1.0", "gzip"));
+        REQUIRE_FALSE(http::accepts("gzip;q=0", "gzip"));
+        REQUIRE_FALSE(http::accepts("br, gzip;q=0.000", "gzip"));
+        REQUIRE_FALSE(http::accepts("deflate", "gzip"));
+        REQUIRE_FALSE(http::accepts("gzipx", "gzip"));
+        REQUIRE(http::accepts("*", "br"));
+        REQUIRE_FALSE(http::accepts("*;q=0", "br"));
+        // an explicit coding takes precedence over the wildcard
+        REQUIRE_FALSE(http::accepts("*, br;q=0", "br"));
+        REQUIRE(http::accepts("*;q=0, br", "br"));
+    }
+
+    SECTION("Matching entity tags") {
+        String etag{"\"5e1f-2a\""};
+        REQUIRE(http::matches("\"5e1f-2a\"", etag));
+        REQUIRE(http::matches("W/\"00-1\", \"5e1f-2a\"", etag));
+        REQUIRE(http::matches("*", etag));
+        REQUIRE_FALSE(http::matches("\"5e1f-2b\"", etag));
+        REQUIRE_FALSE(http::matches("", etag));
+    }
+}
+#endif
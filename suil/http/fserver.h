@@ -18,6 +18,8 @@ namespace suil {
                 bool            enable_send_file{false};
                 int64_t         cache_expires{86400};
                 size_t          mapped_min{2048};
+                // keep compressed variants of compressible files in memory
+                bool            precompress{true};
                 std::string     root{"./www/"};
                 std::string     route{"/" SUIL_FILE_SERVER_ROUTE};
             };
@@ -146,6 +148,18 @@ namespace suil {
             };
             typedef Map<mime_type_t> mime_types_t;
 
+            /*
+             * Supported content encodings in order of preference. Gzip variants are
+             * built when a file is loaded, the others are picked up from precompressed
+             * files next to the original (e.g app.js.br)
+             */
+            enum encoding_t : uint8_t {
+                ENCODING_BR,
+                ENCODING_ZSTD,
+                ENCODING_GZIP,
+                ENCODING_MAX
+            };
+
             struct cached_file_t {
                 int     fd{-1};
                 void    *data{nullptr};
@@ -159,6 +173,10 @@ namespace suil {
                 size_t   size{0};
                 time_t   last_mod{0};
                 time_t   last_access{0};
+                // strong entity tag, derived from the content hash
+                String   etag{};
+                // compressed variants of the file
+                std::array<std::unique_ptr<cached_file_t>, ENCODING_MAX> encoded{};
 
                 cached_file_t() = default;
 
@@ -172,7 +190,9 @@ namespace suil {
                       len(cf.len),
                       size(cf.size),
                       last_mod(cf.last_mod),
-                      last_access(cf.last_access)
+                      last_access(cf.last_access),
+                      etag(std::move(cf.etag)),
+                      encoded(std::move(cf.encoded))
                 {
                     cf.fd = -1;
                     cf.data = nullptr;
@@ -193,6 +213,8 @@ namespace suil {
                     size = cf.size;
                     last_mod = cf.last_mod;
                     last_access = cf.last_access;
+                    etag = std::move(cf.etag);
+                    encoded = std::move(cf.encoded);
 
                     cf.fd = -1;
                     cf.data = nullptr;
@@ -221,6 +243,12 @@ namespace suil {
 
             bool read_file(cached_file_t& cf, const struct stat& st);
 
+            void encode(cached_file_t& cf, const mime_type_t& mm);
+
+            bool load_encoded(cached_file_t& cf, encoding_t enc, const void *data);
+
+            cached_file_t& negotiate(const Request&, Response&, cached_file_t&);
+
             void cache_control(const Request&, Response&, cached_file_t&, mime_type_t&);
 
             void prepare_response(const Request&, Response&, cached_file_t&, mime_type_t&);
@@ -2257,6 +2257,8 @@ http_parser_version(void) {
 }
 #endif
 
+#include <suil/simd.h>
+
 namespace suil {
     namespace http {
 
@@ -2266,9 +2268,32 @@ namespace suil {
             return 0;
         }
 
+        /* fragments of the same token are contiguous when parsing in-place */
+        static inline void extend(String& v, const char *at, size_t len) {
+            if (v.data() == nullptr)
+                v = String(at, len, false);
+            else
+                v = String(v.data(), (size_t)((at + len) - v.data()), false);
+        }
+
+        /* the byte following a view has already been consumed by the parser
+         * (':' for fields, CR for values and SP for the url) */
+        static inline String terminate(String& v) {
+            if (v.empty()) {
+                // empty values are marked at the start of the next token
+                v = String();
+                return String();
+            }
+            ((char *) v.data())[v.size()] = '\0';
+            return std::move(v);
+        }
+
         int parser::on_url(http_parser *s, const char *at, size_t len) {
             parser *p = static_cast<parser*>(s);
-            p->raw_url.append(at, (uint32_t)len);
+            if (p->inplace)
+                extend(p->vurl, at, len);
+            else
+                p->raw_url.append(at, (uint32_t)len);
             return 0;
         }
 
@@ -2277,19 +2302,31 @@ namespace suil {
             switch (p->state)
             {
                 case STATE_FIELD:
-                    if (p->hv)
-                    {
-                        String hf(p->hf);
-                        String hv(p->hv);
-                        p->headers.emplace(
-                                std::move(hf),
-                                std::move(hv));
+                    if (p->inplace) {
+                        if (p->vf) {
+                            String hf = terminate(p->vf);
+                            p->headers.emplace(std::move(hf), terminate(p->vv));
+                        }
+                        extend(p->vf, at, len);
+                    }
+                    else {
+                        if (p->hf)
+                        {
+                            String hf(p->hf);
+                            String hv(p->hv);
+                            p->headers.emplace(
+                                    std::move(hf),
+                                    std::move(hv));
+                        }
+                        p->hf.append(at, (uint32_t) len);
                     }
-                    p->hf.append(at, (uint32_t) len);
                     p->state = STATE_VALUE;
                     break;
                 case STATE_VALUE:
-                    p->hf.append(at, (uint32_t) len);
+                    if (p->inplace)
+                        extend(p->vf, at, len);
+                    else
+                        p->hf.append(at, (uint32_t) len);
                     break;
                 default:
                     break;
@@ -2301,12 +2338,14 @@ namespace suil {
             parser *p = static_cast<parser*>(s);
             switch (p->state)
             {
-                case STATE_FIELD:
-                    p->hv.append(at, (uint32_t) len);
-                    break;
                 case STATE_VALUE:
                     p->state = 0;
-                    p->hv.append(at, (uint32_t) len);
+                    /* fall through */
+                case STATE_FIELD:
+                    if (p->inplace)
+                        extend(p->vv, at, len);
+                    else
+                        p->hv.append(at, (uint32_t) len);
                     break;
 
                 default:
@@ -2317,7 +2356,13 @@ namespace suil {
 
         int parser::on_headers_complete(http_parser *s) {
             parser *p = static_cast<parser*>(s);
-            if (p->hf)
+            if (p->inplace) {
+                if (p->vf) {
+                    String hf = terminate(p->vf);
+                    p->headers.emplace(std::move(hf), terminate(p->vv));
+                }
+            }
+            else if (p->hf)
             {
                 String hf(p->hf);
                 String hv(p->hv);
@@ -2337,19 +2382,30 @@ namespace suil {
         int parser::on_msg_complete(http_parser *s) {
             parser *p = static_cast<parser*>(s);
             // construct query string
-            strview sv = p->raw_url;
+            strview sv = p->inplace? (strview) p->vurl : (strview) p->raw_url;
             size_t pos = sv.find("?");
             auto url = sv.substr(0, pos);
             if (!url.empty()) {
-                p->url = strndup(url.data(), url.size());
-                if (pos != sv.size()) {
+                if (pos != sv.npos) {
                     strview tmp((sv.data() + pos), sv.length() - pos);
-                    p->qps = QueryString(tmp);
+                    p->qps = QueryString(tmp, p->pool);
+                    p->querystr = String(sv.data() + pos + 1, sv.length() - pos - 1, false);
+                }
+                if (p->inplace) {
+                    // the query string has been copied, terminate the path
+                    terminate(p->vurl);
+                    ((char *) url.data())[url.size()] = '\0';
+                    p->url = (char *) url.data();
+                }
+                else {
+                    p->url = strndup(url.data(), url.size());
                 }
             }
 
             p->body_complete = 1;
             p->msg_complete();
+            // don't run into the next message, it's parsed after this one is handled
+            http_parser_pause(s, 1);
             return 0;
         }
 
@@ -2361,6 +2417,17 @@ namespace suil {
               raw_url(32)
         {
             http_parser_init(this, type);
+            inplace = 0;
+        }
+
+        void parser::rebase(const char *from, size_t len, const char *to) {
+            headers.rebase(from, len, to);
+            Headers::rebase(vf, from, len, to);
+            Headers::rebase(vv, from, len, to);
+            Headers::rebase(vurl, from, len, to);
+            Headers::rebase(querystr, from, len, to);
+            if (url && url >= from && url < (from + len))
+                url = (char *) to + (url - from);
         }
 
         int parser::handle_body_part(const char *at, size_t len) {
@@ -2374,7 +2441,8 @@ namespace suil {
         }
 
         bool parser::feed(const char *buf, size_t len) {
-            return feed2(buf, len) == 0;
+            feed2(buf, len);
+            return HTTP_PARSER_ERRNO(this) == HPE_OK;
         }
 
         size_t parser::feed2(const char *buf, size_t len) {
@@ -2389,15 +2457,189 @@ namespace suil {
                     parser::on_msg_complete,
             };
 
-            size_t nparsed = http_parser_execute(this, &PARSER_SETTINGS, buf, len);
+            size_t nparsed{0};
+            if (simd && inplace && buf && http_parser::state == s_start_req) {
+                // tokenize the head, the state machine takes over from its last LF
+                nparsed = feed_head(buf, len);
+            }
+
+            nparsed += http_parser_execute(this, &PARSER_SETTINGS, buf + nparsed, len - nparsed);
+            if (HTTP_PARSER_ERRNO(this) == HPE_PAUSED) {
+                // paused at the end of a message, the next feed starts a new one
+                http_parser_pause(this, 0);
+            }
             return len - nparsed;
         }
 
+#ifndef HTTP_SIMD_MAX_HEADERS
+#define HTTP_SIMD_MAX_HEADERS 64
+#endif
+
+        /* bytes that are not allowed in a token (rfc 7230), i.e method and field names */
+        static const char SIMD_TOKEN_RANGES[] = "\x00 \"\"(),,//:@[]{\xff";
+        /* bytes terminating a request target */
+        static const char SIMD_URL_RANGES[]   = "\x00 \x7f\x7f";
+        /* control characters other than HTAB terminate a field value */
+        static const char SIMD_VALUE_RANGES[] = "\x00\x08\x0a\x1f\x7f\x7f";
+
+#define simd_find(p, e, r) simd::findranges((p), (e), (r), sizeof(r)-1)
+
+        static inline bool simd_iequals(const char *s, size_t len, const char *lit, size_t n) {
+            return len == n && strncasecmp(s, lit, n) == 0;
+        }
+
+        size_t parser::feed_head(const char *buf, size_t len) {
+            static const struct {
+                const char *name;
+                size_t      len;
+            } METHODS[] = {
+#define _XX(num, name, string) {#string, sizeof(#string)-1},
+                HTTP_METHOD_MAP(_XX)
+#undef _XX
+            };
+
+            struct {
+                const char *name;
+                uint32_t    nlen;
+                const char *value;
+                uint32_t    vlen;
+            } hdrs[HTTP_SIMD_MAX_HEADERS];
+            size_t nhdrs{0};
+
+            const char *p = buf, *end = buf + len;
+            if (len > HTTP_MAX_HEADER_SIZE) {
+                // let the state machine report the overflow
+                end = buf + HTTP_MAX_HEADER_SIZE;
+            }
+
+            // request method
+            const char *e = simd_find(p, end, SIMD_TOKEN_RANGES);
+            if (e == end || e == p || *e != ' ')
+                return 0;
+
+            int m = -1;
+            for (int i = 0; i < (int)(sizeof(METHODS)/sizeof(METHODS[0])); i++) {
+                if (METHODS[i].len == (size_t)(e - p) && memcmp(METHODS[i].name, p, METHODS[i].len) == 0) {
+                    m = i;
+                    break;
+                }
+            }
+            if (m < 0 || m == HTTP_CONNECT)
+                return 0;
+
+            // request target, absolute forms are left to the state machine
+            const char *url = p = e + 1;
+            e = simd_find(p, end, SIMD_URL_RANGES);
+            if (e == end || *url != '/' || *e != ' ')
+                return 0;
+            size_t urllen = e - url;
+
+            // protocol version
+            p = e + 1;
+            if ((end - p) < 10 || memcmp(p, "HTTP/", 5) != 0 ||
+                !isdigit(p[5]) || p[6] != '.' || !isdigit(p[7]) ||
+                p[8] != '\r' || p[9] != '\n')
+                return 0;
+            unsigned short major = (unsigned short)(p[5] - '0'), minor = (unsigned short)(p[7] - '0');
+            p += 10;
+
+            // header fields
+            while (true) {
+                if ((end - p) < 2)
+                    return 0;
+                if (p[0] == '\r') {
+                    if (p[1] != '\n')
+                        return 0;
+                    break;
+                }
+                if (nhdrs == HTTP_SIMD_MAX_HEADERS)
+                    return 0;
+
+                e = simd_find(p, end, SIMD_TOKEN_RANGES);
+                if (e == end || e == p || *e != ':')
+                    return 0;
+                hdrs[nhdrs].name = p;
+                hdrs[nhdrs].nlen = (uint32_t)(e - p);
+
+                p = e + 1;
+                while (p < end && (*p == ' ' || *p == '\t')) p++;
+                e = simd_find(p, end, SIMD_VALUE_RANGES);
+                if ((end - e) < 3 || e[0] != '\r' || e[1] != '\n' || e[2] == ' ' || e[2] == '\t')
+                    // incomplete, bare LF or obsolete line folding
+                    return 0;
+
+                // like the state machine, trailing whitespace is kept
+                hdrs[nhdrs].value = p;
+                hdrs[nhdrs].vlen  = (uint32_t)(e - p);
+                nhdrs++;
+                p = e + 2;
+            }
+
+            // headers the state machine interprets
+            unsigned flags{0};
+            uint64_t clen{_ULLONG_MAX};
+            for (size_t i = 0; i < nhdrs; i++) {
+                auto& h = hdrs[i];
+                if (simd_iequals(h.name, h.nlen, "Content-Length", 14)) {
+                    if (h.vlen == 0 || clen != _ULLONG_MAX)
+                        return 0;
+                    clen = 0;
+                    for (uint32_t j = 0; j < h.vlen; j++) {
+                        if (!isdigit(h.value[j]) || clen > ((_ULLONG_MAX - 10) / 10))
+                            return 0;
+                        clen = (clen * 10) + (h.value[j] - '0');
+                    }
+                }
+                else if (simd_iequals(h.name, h.nlen, "Transfer-Encoding", 17)) {
+                    if (simd_iequals(h.value, h.vlen, "chunked", 7))
+                        flags |= F_CHUNKED;
+                }
+                else if (simd_iequals(h.name, h.nlen, "Connection", 10) ||
+                         simd_iequals(h.name, h.nlen, "Proxy-Connection", 16)) {
+                    if (simd_iequals(h.value, h.vlen, "keep-alive", 10))
+                        flags |= F_CONNECTION_KEEP_ALIVE;
+                    else if (simd_iequals(h.value, h.vlen, "close", 5))
+                        flags |= F_CONNECTION_CLOSE;
+                }
+                else if (simd_iequals(h.name, h.nlen, "Upgrade", 7)) {
+                    if (h.vlen)
+                        flags |= F_UPGRADE;
+                }
+            }
+
+            // the head is valid, commit it
+            on_message_begin(this);
+            http_parser::flags = flags;
+            http_parser::content_length = clen;
+            http_parser::method = (unsigned) m;
+            http_parser::http_major = major;
+            http_parser::http_minor = minor;
+            http_parser::nread = 0;
+            vurl = String(url, urllen, false);
+            for (size_t i = 0; i < nhdrs; i++) {
+                auto& h = hdrs[i];
+                ((char *) h.name)[h.nlen] = '\0';
+                String hv;
+                if (h.vlen) {
+                    ((char *) h.value)[h.vlen] = '\0';
+                    hv = String(h.value, h.vlen, false);
+                }
+                headers.emplace(String(h.name, h.nlen, false), std::move(hv));
+            }
+
+            http_parser::state = s_headers_almost_done;
+            return (p + 1) - buf;
+        }
+
+#undef simd_find
+
         void parser::clear(bool internal) {
             if (url) {
-                free(url);
+                if (!inplace)
+                    free(url);
                 url = nullptr;
             }
+            vf = vv = vurl = String();
 
             raw_url.clear();
             state = 0;
@@ -2408,6 +2650,177 @@ namespace suil {
             hf.clear();
             headers.clear();
             qps.clear();
+            querystr = String();
         }
     }
-}
\ No newline at end of file
+}
+
+#ifdef unit_test
+#include <catch/catch.hpp>
+
+using namespace suil;
+using namespace suil::http;
+
+TEST_CASE("suil::http::parser", "[http][parser]")
+{
+    const char *REQ = "GET /hello/world?name=suil HTTP/1.1\r\n"
+                      "Host: localhost\r\n"
+                      "X-Empty:\r\n"
+                      "Connection: Keep-Alive\r\n"
+                      "\r\n";
+
+    SECTION("Parsing headers in-place") {
+        char buf[256];
+        size_t len = strlen(REQ);
+        memcpy(buf, REQ, len+1);
+
+        parser p;
+        p.viewmode(true);
+        // feed in fragments that split tokens
+        REQUIRE(p.feed(buf, 20));
+        REQUIRE(p.feed(&buf[20], 23));
+        REQUIRE(p.feed(&buf[43], len-43));
+        REQUIRE(p.headers_complete);
+        REQUIRE(p.headers.size() == 3);
+
+        auto it = p.headers.find("host");
+        REQUIRE(it != p.headers.end());
+        REQUIRE(it->first.data() >= buf);
+        REQUIRE(it->first.data() < &buf[len]);
+        REQUIRE(strcmp(it->second.data(), "localhost") == 0);
+        REQUIRE(p.headers.count("X-EMPTY") == 1);
+        REQUIRE(p.headers.find("X-Empty")->second.empty());
+        REQUIRE(strcmp(p.headers.find("connection")->second.data(), "Keep-Alive") == 0);
+
+        REQUIRE(p.url == &buf[4]);
+        REQUIRE(strcmp(p.url, "/hello/world") == 0);
+        REQUIRE(p.qps.get("name") == "suil");
+        REQUIRE(p.querystr == String("name=suil"));
+
+        // moving the buffer
+        char moved[256];
+        memcpy(moved, buf, len);
+        memset(buf, 0, sizeof(buf));
+        p.rebase(buf, len, moved);
+        REQUIRE(p.url == &moved[4]);
+        REQUIRE(p.querystr.data() == &moved[17]);
+        REQUIRE(strcmp(p.headers.find("Host")->second.data(), "localhost") == 0);
+        p.clear();
+        REQUIRE(p.url == nullptr);
+        REQUIRE(p.headers.empty());
+    }
+
+    SECTION("Parsing headers with copies") {
+        parser p;
+        REQUIRE(p.feed(REQ, strlen(REQ)));
+        REQUIRE(p.headers.size() == 3);
+        REQUIRE(p.headers.find("Host")->second == String("localhost"));
+        REQUIRE(strcmp(p.url, "/hello/world") == 0);
+        REQUIRE(p.querystr == String("name=suil"));
+    }
+
+    SECTION("Parsing heads with the simd backend") {
+        struct body_parser : parser {
+            int handle_headers_complete() override { nhc++; return 0; }
+            int msg_complete() override { nmc++; return parser::msg_complete(); }
+            int nhc{0}, nmc{0};
+        };
+
+        auto parse = [](parser& p, const char *req, char *buf, bool simd) {
+            size_t len = strlen(req);
+            memcpy(buf, req, len+1);
+            p.viewmode(true);
+            p.simdmode(simd);
+            return p.feed(buf, len);
+        };
+
+        const char *reqs[] = {
+            REQ,
+            "POST /form HTTP/1.0\r\nContent-Type:  text/plain  \r\nContent-Length: 5\r\n\r\nhello",
+            "PUT /chunked HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n",
+            "DELETE /x HTTP/1.1\r\nConnection: close\r\nX-Tab:\tvalue\r\n\r\n",
+            // these are handed over to the state machine
+            "GET http://localhost/x HTTP/1.1\r\nHost: localhost\r\n\r\n",
+            "GET /x HTTP/1.1\r\nX-Folded: one\r\n two\r\n\r\n",
+            "GET /x HTTP/1.1\nHost: localhost\n\n"
+        };
+
+        for (auto req: reqs) {
+            char b1[256], b2[256];
+            body_parser scalar, vectorized;
+            REQUIRE(parse(scalar, req, b1, false));
+            REQUIRE(parse(vectorized, req, b2, true));
+            REQUIRE(vectorized.nhc == 1);
+            REQUIRE(vectorized.nmc == 1);
+            REQUIRE(vectorized.method == scalar.method);
+            REQUIRE(vectorized.http_major == scalar.http_major);
+            REQUIRE(vectorized.http_minor == scalar.http_minor);
+            REQUIRE(http_should_keep_alive(&vectorized) == http_should_keep_alive(&scalar));
+            REQUIRE(strcmp(vectorized.url, scalar.url) == 0);
+            REQUIRE(vectorized.body.size() == scalar.body.size());
+            REQUIRE(vectorized.headers.size() == scalar.headers.size());
+            for (auto& h: scalar.headers) {
+                auto it = vectorized.headers.find(h.first);
+                REQUIRE(it != vectorized.headers.end());
+                REQUIRE(it->second == h.second);
+            }
+        }
+
+        // a partial head is left to the state machine
+        char buf[256];
+        parser p;
+        p.viewmode(true);
+        p.simdmode(true);
+        size_t len = strlen(REQ);
+        memcpy(buf, REQ, len+1);
+        REQUIRE(p.feed(buf, 30));
+        REQUIRE(p.feed(&buf[30], len-30));
+        REQUIRE(p.headers_complete);
+        REQUIRE(p.headers.size() == 3);
+    }
+
+    SECTION("Parsing stops at the end of a message") {
+        const char *NEXT = "POST /next HTTP/1.1\r\nContent-Length: 4\r\n\r\nbody";
+        char buf[512];
+        size_t len = strlen(REQ), nlen = strlen(NEXT);
+
+        for (int simd = 0; simd < 2; simd++) {
+            // both requests are received together and modified in place
+            memcpy(buf, REQ, len);
+            memcpy(&buf[len], NEXT, nlen+1);
+            parser p;
+            p.viewmode(true);
+            p.simdmode(simd);
+            // the pipelined request is left untouched
+            REQUIRE(p.feed2(buf, len+nlen) == nlen);
+            REQUIRE(p.body_complete);
+            REQUIRE(strcmp(p.url, "/hello/world") == 0);
+            REQUIRE(p.headers.size() == 3);
+
+            REQUIRE(p.feed2(&buf[len], nlen) == 0);
+            REQUIRE(p.body_complete);
+            REQUIRE(strcmp(p.url, "/next") == 0);
+            REQUIRE(p.headers.size() == 1);
+            REQUIRE(p.body.size() == 4);
+        }
+    }
+
+    SECTION("Header map spills to heap") {
+        HeaderMap<2> hm;
+        REQUIRE(hm.emplace(String("A"), String("1")).second);
+        REQUIRE(hm.emplace(String("B"), String("2")).second);
+        REQUIRE_FALSE(hm.emplace(String("a"), String("3")).second);
+        REQUIRE(hm.emplace(String("C"), String("3")).second);
+        REQUIRE(hm.size() == 3);
+        REQUIRE(hm.find("a")->second == String("1"));
+        REQUIRE(hm.find("c")->second == String("3"));
+        HeaderMap<2> other(std::move(hm));
+        REQUIRE(hm.empty());
+        REQUIRE(other.count("b") == 1);
+        other.clear();
+        REQUIRE(other.empty());
+        REQUIRE(other.emplace(String("D"), String("4")).second);
+        REQUIRE(other.find("d") == other.begin());
+    }
+}
+#endif
@@ -333,10 +333,159 @@ namespace suil {
 
     namespace http {
 
+#ifndef HTTP_INLINE_HEADERS
+#define HTTP_INLINE_HEADERS 24
+#endif
+
+        /**
+         * A case insensitive map of headers which keeps the first \tparam N
+         * headers in an inline array and only spills onto the heap when a
+         * message carries more headers than that. Lookups are linear scans,
+         * which for the handful of headers on a typical request is cheaper
+         * than hashing.
+         *
+         * @note keys and values can be views into a buffer owned by someone
+         * else, see \see parser::inplace
+         */
+        template <size_t N>
+        struct HeaderMap {
+            using value_type     = std::pair<String, String>;
+            using iterator       = value_type*;
+            using const_iterator = const value_type*;
+
+            HeaderMap() = default;
+
+            HeaderMap(HeaderMap&& other) noexcept {
+                Ego = std::move(other);
+            }
+
+            HeaderMap& operator=(HeaderMap&& other) noexcept {
+                if (this != &other) {
+                    clear();
+                    if (other.spill.empty()) {
+                        for (size_t i = 0; i < other.nheaders; i++)
+                            inlined[i] = std::move(other.inlined[i]);
+                    }
+                    else {
+                        spill = std::move(other.spill);
+                    }
+                    nheaders = other.nheaders;
+                    other.clear();
+                }
+                return Ego;
+            }
+
+            HeaderMap(const HeaderMap&) = delete;
+            HeaderMap& operator=(const HeaderMap&) = delete;
+
+            std::pair<iterator, bool> emplace(String&& key, String&& value) {
+                auto it = find(key);
+                if (it != end())
+                    return std::make_pair(it, false);
+
+                if (spill.empty() && nheaders < N) {
+                    inlined[nheaders].first  = std::move(key);
+                    inlined[nheaders].second = std::move(value);
+                }
+                else {
+                    if (spill.empty()) {
+                        // too many headers, move everything to the heap
+                        spill.reserve(N << 1);
+                        for (size_t i = 0; i < nheaders; i++)
+                            spill.emplace_back(std::move(inlined[i]));
+                    }
+                    spill.emplace_back(std::move(key), std::move(value));
+                }
+                return std::make_pair(begin() + nheaders++, true);
+            }
+
+            iterator find(const String& key) {
+                iterator it = begin(), e = end();
+                for (; it != e; it++) {
+                    if (it->first.size() == key.size() &&
+                        strncasecmp(it->first.data(), key.data(), key.size()) == 0)
+                        break;
+                }
+                return it;
+            }
+
+            const_iterator find(const String& key) const {
+                return ((HeaderMap *) this)->find(key);
+            }
+
+            inline size_t count(const String& key) const {
+                return find(key) == end()? 0 : 1;
+            }
+
+            inline iterator begin() {
+                return spill.empty()? &inlined[0] : spill.data();
+            }
+
+            inline iterator end() {
+                return begin() + nheaders;
+            }
+
+            inline const_iterator begin() const {
+                return spill.empty()? &inlined[0] : spill.data();
+            }
+
+            inline const_iterator end() const {
+                return begin() + nheaders;
+            }
+
+            inline size_t size() const {
+                return nheaders;
+            }
+
+            inline bool empty() const {
+                return nheaders == 0;
+            }
+
+            /**
+             * moves all the headers referencing the \param len bytes at \param from
+             * to the same offsets at \param to
+             */
+            void rebase(const char *from, size_t len, const char *to) {
+                for (auto it = begin(); it != end(); it++) {
+                    rebase(it->first, from, len, to);
+                    rebase(it->second, from, len, to);
+                }
+            }
+
+            static inline void rebase(String& s, const char *from, size_t len, const char *to) {
+                if (s.data() >= from && s.data() < (from + len))
+                    s = String(to + (s.data() - from), s.size(), false);
+            }
+
+            void clear() {
+                if (spill.empty()) {
+                    for (size_t i = 0; i < nheaders; i++) {
+                        // release anything owned
+                        inlined[i].first  = String();
+                        inlined[i].second = String();
+                    }
+                }
+                else {
+                    // retains capacity for the next message
+                    spill.clear();
+                }
+                nheaders = 0;
+            }
+
+        private suil_ut:
+            value_type              inlined[N];
+            std::vector<value_type> spill{};
+            size_t                  nheaders{0};
+        };
+
+        using Headers = HeaderMap<HTTP_INLINE_HEADERS>;
+
         struct parser : public http_parser {
             char *url;
-            CaseMap<String> headers;
+            Headers headers;
             QueryString qps;
+            // the raw query string without the '?', a view valid until the parser is cleared
+            String querystr{};
             OBuffer body;
 
         protected suil_ut:
@@ -345,6 +494,14 @@ namespace suil {
 
             // return false on error
             bool feed(const char *buffer, size_t length);
+            /**
+             * Parses at most one message from the given buffer, parsing stops
+             * once a message is complete so that the bytes of pipelined messages
+             * are left for the next message
+             *
+             * @return the number of bytes that were not consumed, non-zero after
+             * a message was completed with bytes to spare or on error
+             */
             size_t feed2(const char *buffer, size_t length);
 
             virtual void clear(bool internal = false);
@@ -370,10 +527,57 @@ namespace suil {
                 return 0;
             }
 
+            /**
+             * Switches the parser to in-place mode, where the buffers fed to
+             * the parser are owned by the caller and outlive the message. The
+             * url and headers are then views into the fed buffers (terminated
+             * in place), rather than copies. Consecutive feeds must therefore
+             * be contiguous in memory, if the buffer is moved
+             * \see parser::rebase must be invoked
+             *
+             * @param on true to enable in-place parsing
+             */
+            inline void viewmode(bool on) {
+                inplace = (uint8_t) (on? 1 : 0);
+            }
+
+            /**
+             * Selects the vectorized backend for request heads. When a new
+             * request's head is fully contained in a fed buffer, the request
+             * line and headers are tokenized with SIMD (\see simd::findranges)
+             * instead of the byte at a time state machine, which then only
+             * handles the body. Heads spanning several feeds, obsolete line
+             * folding and anything unusual fall back to the state machine.
+             *
+             * @param on true to enable the backend, only effective in view mode
+             */
+            inline void simdmode(bool on) {
+                simd = (uint8_t) (on? 1 : 0);
+            }
+
+            /**
+             * Allocates what is built while parsing a message (e.g the query
+             * string) from the given arena, which must outlive the message
+             *
+             * @param a the arena, nullptr to use the heap
+             */
+            inline void arena(Arena *a) {
+                pool = a;
+            }
+
+            /**
+             * re-points all views into the \param len bytes at \param from
+             * to the same offsets at \param to, used when the buffer
+             * being parsed in-place has been reallocated
+             */
+            void rebase(const char *from, size_t len, const char *to);
+
             struct {
                 uint8_t headers_complete : 1;
                 uint8_t body_complete    : 1;
-                uint8_t state : 6;
+                uint8_t inplace          : 1;
+                uint8_t simd             : 1;
+                uint8_t state : 4;
             };
 
             enum {
@@ -384,9 +588,16 @@ namespace suil {
             OBuffer hf;
             OBuffer hv;
             OBuffer raw_url;
+            Arena  *pool{nullptr};
+            // in-place views of the token currently being parsed
+            String  vf{};
+            String  vv{};
+            String  vurl{};
 
         private:
 
+            size_t feed_head(const char *buffer, size_t length);
+
             static int on_msg_complete(http_parser *);
 
             static int on_headers_complete(http_parser *);
@@ -3,6 +3,7 @@
 //
 
 #include <suil/http.h>
+#include <suil/simd.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,8 +24,9 @@ static int qs_strncmp(const char *s, const char *qs, size_t n);
 static int qs_parse(char *qs, char *qs_kv[], int qs_kv_size);
 
 
-/*  Used by qs_parse to decode the value portion of a k/v pair  */
-static int qs_decode(char *qs);
+/*  Used by qs_parse to decode the value portion of a k/v pair, \param end
+ *  bounds the scan (the value itself ends at the first '&', '#' or '=') */
+static int qs_decode(char *qs, const char *end);
 
 
 /*  Looks up the value according to the key on a pre-processed query string
@@ -95,6 +97,7 @@ inline int qs_strncmp(const char *s, const char *qs, size_t n) {
 inline int qs_parse(char *qs, char *qs_kv[], int qs_kv_size) {
     int i, j;
     char *substr_ptr;
+    const char *end = qs + strlen(qs);
 
     for (i = 0; i < qs_kv_size; i++) qs_kv[i] = NULL;
 
@@ -122,7 +125,7 @@ inline int qs_parse(char *qs, char *qs_kv[], int qs_kv_size) {
         if (substr_ptr[0] == '&' || substr_ptr[0] == '\0')  // blank value: skip decoding
             substr_ptr[0] = '\0';
         else
-            qs_decode(++substr_ptr);
+            qs_decode(++substr_ptr, end);
     }
 
 #ifdef _qsSORTING
@@ -133,28 +136,47 @@ inline int qs_parse(char *qs, char *qs_kv[], int qs_kv_size) {
 }
 
 
-inline int qs_decode(char *qs) {
-    int i = 0, j = 0;
+inline int qs_decode(char *qs, const char *end) {
+    // the bytes ending the value and those to decode: \0, #, %, &, +, =
+    static const char SPECIAL[] = "\0\0##%&++==";
+    // plain bytes after which the rest of the run is searched for
+    static const size_t SCAN_RUN = 8;
+    char *dst = qs;
+    const char *src = qs;
+    size_t plain = SCAN_RUN;
+
+    while (src != end) {
+        if (plain >= SCAN_RUN) {
+            // long runs of plain bytes are found with the vectorized kernels,
+            // escapes close together are cheaper to decode byte by byte
+            const char *at = suil::simd::findranges(src, end, SPECIAL, sizeof(SPECIAL) - 1);
+            if (dst != src)
+                memmove(dst, src, at - src);
+            dst += at - src;
+            src = at;
+            plain = 0;
+            if (src == end)
+                break;
+        }
+        if (!QS_ISQSCHR(*src))
+            break;
 
-    while (QS_ISQSCHR(qs[j])) {
-        if (qs[j] == '+') { qs[i] = ' '; }
-        else if (qs[j] == '%') // easier/safer than scanf
+        if (*src == '+') { *dst++ = ' '; src++; plain = 0; }
+        else if (*src == '%') // easier/safer than scanf
         {
-            if (!QS_ISHEX(qs[j + 1]) || !QS_ISHEX(qs[j + 2])) {
-                qs[i] = '\0';
-                return i;
+            if (!QS_ISHEX(src[1]) || !QS_ISHEX(src[2])) {
+                *dst = '\0';
+                return (int) (dst - qs);
             }
-            qs[i] = (QS_HEX2DEC(qs[j + 1]) * 16) + QS_HEX2DEC(qs[j + 2]);
-            j += 2;
-        } else {
-            qs[i] = qs[j];
+            *dst++ = (QS_HEX2DEC(src[1]) * 16) + QS_HEX2DEC(src[2]);
+            src += 3;
+            plain = 0;
         }
-        i++;
-        j++;
+        else { *dst++ = *src++; plain++; }
     }
-    qs[i] = '\0';
+    *dst = '\0';
 
-    return i;
+    return (int) (dst - qs);
 }
 
 
@@ -207,7 +229,7 @@ inline char *qs_scanvalue(const char *key, const char *qs, char *val, size_t val
         qs++;
         i = strcspn(qs, "&=#");
         strncpy(val, qs, (val_len - 1) < (i + 1) ? (val_len - 1) : (i + 1));
-        qs_decode(val);
+        qs_decode(val, val + strlen(val));
     } else {
         if (val_len > 0)
             val[0] = '\0';
@@ -225,17 +247,19 @@ namespace suil {
 
         QueryString::QueryString() {}
 
-        QueryString::QueryString(strview &sv)
-                : url_(sv.empty() ? nullptr : strndup(sv.data(), sv.size())) {
+        QueryString::QueryString(strview &sv, Arena *arena)
+                : pooled_(arena != nullptr) {
             if (sv.empty())
                 return;
 
+            url_ = pooled_? arena->strndup(sv.data(), sv.size()) : strndup(sv.data(), sv.size());
             char *params[MAX_KEY_VALUE_PAIRS_COUNT];
             int count = qs_parse(url_, params,
                                  MAX_KEY_VALUE_PAIRS_COUNT);
             if (count > 0) {
                 nparams_ = count;
-                params_ = (char **) malloc((sizeof(char *)) * (count + 1));
+                size_t size = (sizeof(char *)) * (count + 1);
+                params_ = (char **) (pooled_? arena->allocate(size, alignof(char *)) : malloc(size));
             }
             for (int i = 0; i < count; i++)
                 params_[i] = params[i];
@@ -249,6 +273,7 @@ namespace suil {
             qs.nparams_ = 0;
             url_ = qs.url_;
             qs.url_ = nullptr;
+            pooled_ = qs.pooled_;
             return *this;
         }
 
@@ -257,6 +282,12 @@ namespace suil {
         }
 
         void QueryString::clear() {
+            if (pooled_) {
+                // released along with the arena
+                params_ = nullptr;
+                url_ = nullptr;
+            }
+
             if (params_) {
 
                 free(params_);
@@ -268,6 +299,7 @@ namespace suil {
                 url_ = nullptr;
             }
             nparams_ = 0;
+            pooled_ = false;
         }
 
         strview QueryString::get(const char* name) const {
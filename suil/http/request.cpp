@@ -144,9 +144,22 @@ namespace suil {
             return true;
         }
 
+        char* Request::scratch(OBuffer& ob, size_t size) {
+            if (pool != nullptr) {
+                // released along with everything else the request allocated,
+                // the body is parsed as a string up to the padding
+                auto *buf = (char *) pool->allocate(size, 1);
+                memset(&buf[size-2], 0, 2);
+                return buf;
+            }
+            ob.reserve(size);
+            return ob.data();
+        }
+
         bool Request::parse_multipart_form(const String& boundary) {
-            OBuffer rb((uint32_t) content_length+2);
-            if (read_body(rb.data(), content_length) <= 0) {
+            OBuffer rb(0);
+            char *buf = scratch(rb, content_length+2);
+            if (read_body(buf, content_length) <= 0) {
                 itrace("error: reading body failed");
                 return false;
             }
@@ -158,8 +171,8 @@ namespace suil {
                 state_content, state_data,
                 state_error, state_end
             }  state = state_begin, next_state = state_begin;
-            rb.bseek(content_length);
-            char *p = rb.data(), *end = p + content_length;
+            rb.bseek(pool? 0 : content_length);
+            char *p = buf, *end = p + content_length;
 #if 1   // @TODO CURL/http_parser workaround
             p[0] = '-';
 #endif
@@ -314,8 +327,7 @@ namespace suil {
                                 form.size(), files.size(), mnow());
                         if (!form.empty() || !files.empty()) {
                             // cache the buffer for later references
-                            String tmp(rb);
-                            form_str = std::move(tmp);
+                            form_str = pool? String(buf, content_length, false) : String(rb);
                         }
                         return true;
 
@@ -333,10 +345,11 @@ namespace suil {
 #undef goto_chr
 
         bool Request::parse_url_encoded_form() {
-            OBuffer rb((uint32_t) content_length+2);
-            if (read_body(rb.data(), content_length) > 0) {
-                rb.bseek(content_length);
-                String tmp(rb);
+            OBuffer rb(0);
+            char *buf = scratch(rb, content_length+2);
+            if (read_body(buf, content_length) > 0) {
+                rb.bseek(pool? 0 : content_length);
+                String tmp = pool? String(buf, content_length, false) : String(rb);
                 auto parts = tmp.split("&");
                 for(auto& part : parts) {
                     /* save all parameters in part */
@@ -372,12 +385,52 @@ namespace suil {
             }
         }
 
+        char* Request::stage_reserve(size_t size) {
+            if (stage.capacity() < size) {
+                // headers are views into stage, follow the buffer if it moves
+                const char *from = stage.data();
+                stage.reserve(size);
+                if (from != nullptr && from != stage.data())
+                    rebase(from, stage.size(), stage.data());
+            }
+            return stage.data() + stage.size();
+        }
+
+        bool Request::parse(const char *ptr, size_t len) {
+            // whatever follows a complete request belongs to the next one
+            pending = feed2(ptr, len);
+            return HTTP_PARSER_ERRNO(this) == HPE_OK;
+        }
+
+        bool Request::pipelined() {
+            if (pending && !headers_complete) {
+                // parse the next request from the bytes received with the previous one,
+                // clear() moved them to the front of stage
+                if (!parse(stage.data(), pending)) {
+                    itrace("%s - parsing pipelined request failed: %s",
+                           sock.id(), http_errno_name((enum http_errno) http_errno));
+                    // the error is reported when receiving headers
+                    return true;
+                }
+            }
+            return body_complete;
+        }
+
         Status Request::receive_headers(ServerStats& stats) {
             Status  status = Status::OK;
-            stage.reserve(1023);
+            // requests pipelined behind the previous one are already in stage
+            pipelined();
 
-            char *ptr = (char *) &stage[0];
-            do {
+            while (status == Status::OK && !headers_complete) {
+                if (HTTP_PARSER_ERRNO(this) != HPE_OK) {
+                    itrace("%s - parsing headers failed: %s",
+                            sock.id(), http_errno_name((enum http_errno) http_errno));
+                    status = Status::BAD_REQUEST;
+                    break;
+                }
+
+                // headers accumulate in stage, the parser keeps views into it
+                char *ptr = stage_reserve(HTTP_RX_BUFFER_SZ >> 1);
                 size_t len = stage.capacity();
                 // receive a chunk of headers
                 if (!sock.read(ptr, len, config.connection_timeout)) {
@@ -388,22 +441,16 @@ namespace suil {
                     break;
                 }
                 stats.rx_bytes += len;
+                stage.seek(len);
                 // parse the chunk of received headers
-                if (!feed(ptr, len)) {
-                    itrace("%s - parsing headers failed: %s",
-                            sock.id(), http_errno_name((enum http_errno) http_errno));
-                    status = Status::BAD_REQUEST;
-                    break;
-                }
-
-            } while(!headers_complete);
+                parse(ptr, len);
+            }
 
             if (status == Status::OK) {
                 // process the completed headers
                 status = process_headers();
             }
 
-            stage.clear();
             return status;
         }
 
@@ -443,12 +490,12 @@ namespace suil {
                 return status;
             }
             size_t len  = 0, left = content_length;
-            // read body in chunks
-            stage.reserve(MIN(content_length, 2048));
+            // read body in chunks, past the headers which are still referenced
+            char *ptr = stage_reserve(MIN(content_length, HTTP_RX_BUFFER_SZ));
 
             do {
                 len = MIN(stage.capacity(), left);
-                if (!sock.receive(&stage[0], len, config.connection_timeout)) {
+                if (!sock.receive(ptr, len, config.connection_timeout)) {
                     itrace("%s - receive failed: %s", sock.id(), errno_s);
                     status = (errno == ETIMEDOUT)?
                              Status::REQUEST_TIMEOUT:
@@ -458,12 +505,16 @@ namespace suil {
                 stats.rx_bytes += len;
 
                 // parse header line
-                if (!feed(stage, len)) {
+                if (!parse(ptr, len)) {
                     itrace("%s - parsing failed: %s",
                           sock.id(), http_errno_name((enum http_errno )http_errno));
                     status = Status::BAD_REQUEST;
                     break;
                 }
+                if (pending) {
+                    // the next request came in with the end of the body, keep it
+                    stage.seek(len);
+                }
                 left -= len;
                 // no need to reset buffer
             } while (!body_complete && left > 0);
@@ -478,8 +529,6 @@ namespace suil {
                 body_read = 1;
             }
 
-            // clear the buffer after reading headers
-            stage.clear();
             return status;
         }
 
@@ -579,7 +628,13 @@ namespace suil {
             }
 
             if (!internal) {
-                stage.reset(0);
+                // reused by the next request on the connection, which
+                // might already be (partially) received
+                if (pending) {
+                    memmove(stage.data(), stage.data() + (stage.size() - pending), pending);
+                }
+                stage.reset(0, true);
+                stage.seek(pending);
             }
 
             has_body = 0;
@@ -16,6 +16,10 @@ namespace suil {
         template <typename H, typename... __Mws>
         struct Connection;
 
+#ifndef HTTP_RX_BUFFER_SZ
+#define HTTP_RX_BUFFER_SZ   2048
+#endif
+
         define_log_tag(HTTP_REQ);
 
         using form_data_it_t = std::function<bool(const String&, const String&)>;
@@ -56,7 +60,11 @@ namespace suil {
                 : stage(0),
                   sock(sock),
                   config(config)
-            {}
+            {
+                // headers and url are views into stage
+                viewmode(true);
+                simdmode(config.simd_parser);
+            }
 
             const char *ip() const {
                 return ipstr(sock.addr());
@@ -117,7 +125,7 @@ namespace suil {
 
             template <typename _F>
             void operator|(_F f) const {
-                for(auto h: headers) {
+                for(auto& h: headers) {
                     f(h.first.data(), h.second.data());
                 }
             }
@@ -182,6 +190,7 @@ namespace suil {
             bool parseForm();
             bool parse_url_encoded_form();
             bool parse_multipart_form(const String& boundary);
+            char *scratch(OBuffer& ob, size_t size);
 
             inline bool any_method() const {
                 return false;
@@ -197,6 +206,9 @@ namespace suil {
 
             Status receive_headers(ServerStats& stats);
             Status receive_body(ServerStats& stats);
+            char *stage_reserve(size_t size);
+            bool parse(const char *ptr, size_t len);
+            bool pipelined();
 
             CaseMap<String>    cookies;
             bool                     cookied{false};
@@ -225,6 +237,8 @@ namespace suil {
             uint32_t                body_offset{0};
             BodyOffload            *offload{nullptr};
             OBuffer                stage{0};
+            // bytes of pipelined requests, at the tail of stage
+            size_t                 pending{0};
 
             SocketAdaptor&       sock;
             HttpConfig&      config;
@@ -0,0 +1,333 @@
+//
+// Created by dc on 18/10/26.
+//
+
+#include "respcache.h"
+
+namespace suil {
+    namespace http {
+
+        static bool directive(strview cc, const char *name, strview *value = nullptr) {
+            // finds the given directive in a Cache-Control header
+            size_t len = strlen(name);
+            while (!cc.empty()) {
+                auto pos = cc.find(',');
+                auto tok = cc.substr(0, pos);
+                cc = (pos == strview::npos)? strview{} : cc.substr(pos+1);
+                while (!tok.empty() && tok.front() == ' ') tok.remove_prefix(1);
+
+                if (tok.size() >= len && strncasecmp(tok.data(), name, len) == 0 &&
+                    (tok.size() == len || tok[len] == '=' || tok[len] == ' '))
+                {
+                    if (value != nullptr && tok.size() > len && tok[len] == '=') {
+                        *value = tok.substr(len+1);
+                    }
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static bool uncovered(strview names, const std::vector<String>& vary) {
+            // checks if a Vary header names a header that is not part of the cache key
+            while (!names.empty()) {
+                auto pos = names.find(',');
+                auto tok = names.substr(0, pos);
+                names = (pos == strview::npos)? strview{} : names.substr(pos+1);
+                while (!tok.empty() && tok.front() == ' ') tok.remove_prefix(1);
+                while (!tok.empty() && tok.back() == ' ') tok.remove_suffix(1);
+                if (tok.empty()) {
+                    continue;
+                }
+
+                bool found{false};
+                for (auto& h: vary) {
+                    if (h.size() == tok.size() && strncasecmp(h.data(), tok.data(), tok.size()) == 0) {
+                        found = true;
+                        break;
+                    }
+                }
+                if (!found) {
+                    // includes `*`, which varies on everything
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        ResponseCache::Context::~Context() {
+            if (self != nullptr) {
+                // the route failed, wake up the requests waiting for the response
+                self->cache.settle(key);
+            }
+        }
+
+        void ResponseCache::before(Request &req, Response &resp, Context &ctx) {
+            if (req.method != (int) Method::Get && req.method != (int) Method::Head) {
+                return;
+            }
+
+            if (!req.header("Authorization").empty()) {
+                // responses to authorized requests are not shared
+                return;
+            }
+
+            ctx.key = Ego.key(req);
+            if (!directive(req.header("Cache-Control"), "no-cache")) {
+                bool stale{false};
+                auto e = cache.find(ctx.key, &stale);
+                if (e != nullptr) {
+                    if (!stale || !cache.claim(ctx.key)) {
+                        serve(resp, *e, stale? "STALE" : "HIT");
+                        return;
+                    }
+                    // this request refreshes the stale response
+                    ctx.self = this;
+                    return;
+                }
+
+                if (!cache.claim(ctx.key)) {
+                    // another request is producing the response
+                    if (cache.await(ctx.key) && (e = cache.find(ctx.key)) != nullptr) {
+                        serve(resp, *e, "HIT");
+                        return;
+                    }
+
+                    if (!cache.claim(ctx.key)) {
+                        // response not cached in time, don't wait any longer
+                        return;
+                    }
+                }
+                ctx.self = this;
+            }
+            else if (cache.claim(ctx.key)) {
+                // the client asked for a fresh response, which is still cached
+                ctx.self = this;
+            }
+        }
+
+        void ResponseCache::after(Request &req, Response &resp, Context &ctx) {
+            if (ctx.self == nullptr) {
+                // not produced for the cache, or already cached
+                return;
+            }
+
+            defer(settle, {
+                cache.settle(ctx.key);
+                ctx.self = nullptr;
+            });
+
+            if (resp.status != Status::OK || !resp.chunks.empty() || resp.writer || !resp.cookies.empty() ||
+                resp.body.size() > Ego.maxBody)
+            {
+                return;
+            }
+
+            int64_t ttl{0};
+            auto it = resp.headers.find("Cache-Control");
+            if (it != resp.headers.end()) {
+                strview cc{it->second.data(), it->second.size()}, age{};
+                if (directive(cc, "no-store") || directive(cc, "no-cache") || directive(cc, "private")) {
+                    return;
+                }
+
+                if (directive(cc, "max-age", &age)) {
+                    ttl = 0;
+                    for (auto c: age) {
+                        if (c < '0' || c > '9') break;
+                        ttl = (ttl * 10) + (c - '0');
+                    }
+                    if (ttl == 0) {
+                        return;
+                    }
+                    ttl *= 1000;
+                }
+            }
+
+            if (resp.headers.count("Set-Cookie")) {
+                return;
+            }
+
+            it = resp.headers.find("Vary");
+            if (it != resp.headers.end() &&
+                uncovered(strview{it->second.data(), it->second.size()}, Ego.vary))
+            {
+                // the response depends on headers the key does not include
+                return;
+            }
+
+            entry_t e;
+            e.status = resp.status;
+            e.headers.reserve(resp.headers.size());
+            for (auto& h: resp.headers) {
+                e.headers.emplace_back(h.first.dup(), h.second.dup());
+            }
+            e.body = String(resp.body.data(), resp.body.size(), false).dup();
+            itrace("caching response '%s', %lu bytes", ctx.key(), resp.body.size());
+            cache.put(ctx.key, std::move(e), ttl);
+
+            resp.header("X-Cache", "MISS");
+        }
+
+        String ResponseCache::key(const Request &req) const {
+            OBuffer b(127);
+            b << method_name((Method) req.method) << " " << req.url;
+            if (!req.querystr.empty()) {
+                b << "?" << req.querystr;
+            }
+            for (auto& h: vary) {
+                b << "\n" << req.header(h);
+            }
+            return String(b);
+        }
+
+        void ResponseCache::serve(Response &resp, const entry_t &e, const char *state) {
+            itrace("serving cached response (%s)", state);
+            for (auto& h: e.headers) {
+                resp.header(h.first.dup(), h.second.dup());
+            }
+            resp.header("X-Cache", state);
+            resp.body.append(e.body.data(), e.body.size());
+            resp.end(e.status);
+        }
+    }
+}
+
+#ifdef unit_test
+#include <catch/catch.hpp>
+
+using namespace suil;
+
+static coroutine void cacheFetcher(Cache<int>& c, Cache<int>::Loader& load, int& sum, Channel<int>& done) {
+    sum += c.fetch("key", load);
+    done << 1;
+}
+
+TEST_CASE("suil::Cache", "[common][Cache]") {
+    SECTION("Least recently used entries are evicted") {
+        cache_config cfg{};
+        cfg.shards = 1;
+        cfg.max_entries = 3;
+        Cache<int> cache{cfg};
+        cache.put("one", 1);
+        cache.put("two", 2);
+        cache.put("three", 3);
+        int v{0};
+        REQUIRE(cache.get("one", v));
+        REQUIRE(v == 1);
+        cache.put("four", 4);
+        REQUIRE(cache.size() == 3);
+        REQUIRE_FALSE(cache.get("two", v));
+        REQUIRE(cache.get("one", v));
+        REQUIRE(cache.get("four", v));
+        REQUIRE(cache.stats().evictions == 1);
+        REQUIRE(cache.erase("one"));
+        REQUIRE(cache.size() == 2);
+    }
+
+    SECTION("Cached bytes are bounded") {
+        cache_config cfg{};
+        cfg.shards = 2;
+        cfg.max_bytes = 4096;
+        Cache<String> cache{cfg};
+        for (int i = 0; i < 64; i++) {
+            cache.put(utils::catstr("key", i), String('x', 100));
+        }
+        auto st = cache.stats();
+        REQUIRE(st.bytes <= 4096);
+        REQUIRE(st.entries < 64);
+        REQUIRE(st.evictions == (64 - st.entries));
+        // a value larger than a shard is not cached
+        REQUIRE_FALSE(cache.put("large", String('x', 4096)));
+    }
+
+    SECTION("Entries expire") {
+        cache_config cfg{};
+        cfg.ttl = 50;
+        cfg.stale = 500;
+        Cache<int> cache{cfg};
+        cache.put("one", 1);
+        cache.put("two", 2, -1);
+        msleep(utils::after(100));
+        int v{0};
+        REQUIRE_FALSE(cache.get("one", v));
+        REQUIRE(cache.get("two", v));
+        REQUIRE(cache.stats().expired == 1);
+    }
+
+    SECTION("Loads are coalesced") {
+        Cache<int> cache{};
+        int loads{0};
+        Cache<int>::Loader loader = [&loads]() {
+            loads++;
+            msleep(utils::after(50));
+            return 10;
+        };
+        int sum{0};
+        Channel<int> done{-1};
+        for (int i = 0; i < 4; i++) {
+            go(cacheFetcher(cache, loader, sum, done));
+        }
+        bool ok = done[1000](4) | Void;
+        REQUIRE(ok);
+        REQUIRE(sum == 40);
+        REQUIRE(loads == 1);
+        REQUIRE(cache.stats().coalesced == 3);
+    }
+
+    SECTION("Stale entries are served while reloading") {
+        cache_config cfg{};
+        cfg.ttl = 200;
+        cfg.stale = 5000;
+        // outlives the cache, which waits for reloads in flight
+        auto loads = std::make_shared<int>(0);
+        Cache<int> cache{cfg};
+        auto loader = [loads]() {
+            msleep(utils::after(20));
+            return ++*loads;
+        };
+        REQUIRE(cache.fetch("key", loader) == 1);
+        msleep(utils::after(250));
+        // the stale value is returned and reloaded in the background
+        REQUIRE(cache.fetch("key", loader) == 1);
+        // the reloaded value is fresh
+        msleep(utils::after(60));
+        REQUIRE(cache.fetch("key", loader) == 2);
+        REQUIRE(*loads == 2);
+        REQUIRE(cache.stats().stale == 1);
+
+        // a reload still in flight when the cache goes away
+        auto other = std::make_unique<Cache<int>>(cfg);
+        other->put("key", 1, 1);
+        msleep(utils::after(10));
+        REQUIRE(other->fetch("key", loader) == 1);
+        other.reset();
+        REQUIRE(*loads == 3);
+    }
+
+    SECTION("Failed loads are reported to waiters") {
+        Cache<int> cache{};
+        REQUIRE_THROWS(cache.fetch("key", []() -> int {
+            throw Exception::create("unavailable");
+        }));
+        REQUIRE(cache.size() == 0);
+        REQUIRE(cache.fetch("key", []() { return 1; }) == 1);
+    }
+}
+
+TEST_CASE("suil::http::ResponseCache", "[http][ResponseCache]") {
+    SECTION("Responses varying on headers outside the key are not cached") {
+        std::vector<String> vary{"Accept", "Accept-Encoding"};
+        REQUIRE_FALSE(http::uncovered("", vary));
+        REQUIRE_FALSE(http::uncovered("Accept", vary));
+        REQUIRE_FALSE(http::uncovered("accept-encoding, Accept", vary));
+        REQUIRE_FALSE(http::uncovered(" Accept ,", vary));
+        REQUIRE(http::uncovered("*", vary));
+        REQUIRE(http::uncovered("Authorization", vary));
+        REQUIRE(http::uncovered("Accept, Cookie", vary));
+        REQUIRE(http::uncovered("Accept-Encodings", vary));
+        REQUIRE(http::uncovered("Accept", {}));
+    }
+}
+
+#endif
@@ -0,0 +1,110 @@
+//
+// Created by dc on 18/10/26.
+//
+
+#ifndef SUIL_RESPCACHE_H
+#define SUIL_RESPCACHE_H
+
+#include <suil/cache.h>
+#include <suil/http/routing.h>
+
+namespace suil {
+    namespace http {
+
+        define_log_tag(RESPONSE_CACHE);
+
+        /**
+         * A middleware caching the successful responses of GET and HEAD requests
+         * in memory. Responses are keyed on the method, the url (including the query)
+         * and the values of the configured vary headers. A cached response is served
+         * without invoking the route, concurrent requests for a response that is not
+         * cached yet wait for the first request to produce it.
+         *
+         * Responses are not cached if they set cookies, are sent from files, have a `Vary`
+         * header naming a header that is not one of the vary headers or have a
+         * `Cache-Control` header with `no-store`, `no-cache` or `private`, a `max-age`
+         * in the header overrides the configured time to live. Requests with an
+         * `Authorization` header bypass the cache
+         */
+        struct ResponseCache : LOGGER(RESPONSE_CACHE) {
+            struct Context {
+                Context() = default;
+
+                ~Context();
+
+            private:
+                friend struct ResponseCache;
+                ResponseCache *self{nullptr};
+                String         key{};
+            };
+
+            void before(Request& req, Response& resp, Context& ctx);
+
+            void after(Request& req, Response& resp, Context& ctx);
+
+            template<typename __T>
+            void configure(__T& opts) {
+                // times are given in seconds
+                cache.config.ttl   = opts.get(sym(expires), cache.config.ttl/1000) * 1000;
+                cache.config.stale = opts.get(sym(stale), cache.config.stale/1000) * 1000;
+                cache.config.max_bytes = opts.get(sym(max_size), cache.config.max_bytes);
+                Ego.maxBody = opts.get(sym(max_body), Ego.maxBody);
+
+                if (opts.has(sym(vary))) {
+                    // comma separated names of the headers the responses vary on
+                    Ego.vary.clear();
+                    String tmp = String(opts.get(sym(vary), "")).dup();
+                    for (auto part: tmp.split(",")) {
+                        String name = String(part).trim();
+                        if (!name.empty()) {
+                            Ego.vary.emplace_back(std::move(name));
+                        }
+                    }
+                }
+            }
+
+            template <typename E, typename...__Opts>
+            void setup(E& ep, __Opts... args) {
+                auto opts = iod::D(args...);
+                configure(opts);
+            }
+
+            /**
+             * @return the counters of the underlying cache
+             */
+            inline cache_stats stats() const {
+                return cache.stats();
+            }
+
+            /**
+             * drops all the cached responses
+             */
+            inline void clear() {
+                cache.clear();
+            }
+
+        private suil_ut:
+            struct entry_t {
+                Status  status{Status::OK};
+                std::vector<std::pair<String,String>> headers{};
+                String  body{};
+            };
+
+            String key(const Request& req) const;
+
+            void serve(Response& resp, const entry_t& e, const char *state);
+
+            Cache<entry_t> cache{cache_config{8, 32*1024*1024, 0, 60000, 0, 5000},
+                                 [](const entry_t& e) {
+                                     size_t bytes = sizeof(entry_t) + e.body.size();
+                                     for (auto& h: e.headers)
+                                         bytes += sizeof(h) + h.first.size() + h.second.size();
+                                     return bytes;
+                                 }};
+            std::vector<String> vary{"Accept", "Accept-Encoding"};
+            size_t              maxBody{1024*1024};
+        };
+    }
+}
+
+#endif //SUIL_RESPCACHE_H
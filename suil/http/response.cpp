@@ -14,6 +14,7 @@ namespace suil {
               status(other.status),
               completed(other.completed)
         {
+            writer = std::move(other.writer);
         }
 
         Response& Response::operator=(Response &&other) {
@@ -22,6 +23,7 @@ namespace suil {
             headers = std::move(other.headers);
             cookies = std::move(other.cookies);
             completed = other.completed;
+            writer = std::move(other.writer);
             return *this;
         }
 
@@ -31,6 +33,7 @@ namespace suil {
             body.clear();
             cookies.clear();
             chunks.clear();
+            writer = nullptr;
             status = Status::OK;
         }
 
@@ -107,7 +107,7 @@ namespace suil {
                   status(Status::OK)
             {
                 setContentType("application/json");
-                body << json::encode(data).c_str();
+                json::encode(data, body);
             }
 
             Response(Response&&);
@@ -154,10 +154,42 @@ namespace suil {
             }
 
             inline Response&operator<<(const json::Object& obj) {
-                body << json::encode(obj);
+                json::encode(obj, body);
                 return *this;
             }
 
+            /**
+             * the callback producing the body of a streamed response
+             */
+            using Writer = std::function<void(OBufferSink&)>;
+
+            /**
+             * streams the body of the response, the writer is invoked when the
+             * response is being sent and what it writes into the sink goes out in
+             * chunks of about HttpConfig::stream_chunk bytes (chunked transfer
+             * encoding on HTTP/1.1, until the connection closes on HTTP/1.0)
+             *
+             * @param w the writer producing the body
+             */
+            inline void stream(Writer w) {
+                writer = std::move(w);
+            }
+
+            /**
+             * streams the JSON encoding of the given object, large listings
+             * are sent without being encoded into memory as a whole
+             *
+             * @param data the object to encode, kept until the response is sent
+             */
+            template <typename _T>
+            void streamJson(_T data) {
+                setContentType("application/json");
+                auto obj = std::make_shared<_T>(std::move(data));
+                stream([obj](OBufferSink& sink) {
+                    json::encode(*obj, sink);
+                });
+            }
+
             inline void appendf(const char *fmt, ...) {
                 va_list  args;
                 va_start(args, fmt);
@@ -277,6 +309,7 @@ namespace suil {
             template <typename __H, typename ...Mws>
             friend struct Connection;
             friend struct FileServer;
+            friend struct ResponseCache;
 
 
             void chunk(Chunk chunk) {
@@ -287,6 +320,7 @@ namespace suil {
 
             std::vector<Chunk>  chunks;
             size_t                total_size_{0};
+            Writer                writer{nullptr};
 
 #ifdef SUIL_UT_ENABLED
         public:
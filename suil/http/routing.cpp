@@ -182,8 +182,223 @@ namespace suil {
             return {found, std::move(match_params)};
         }
 
+        static inline const char *parse_uint(const char *p, const char *e, uint64_t& value) {
+            const char *s = p;
+            value = 0;
+            for (; p < e && *p >= '0' && *p <= '9'; p++) {
+                if (__builtin_mul_overflow(value, 10, &value) ||
+                    __builtin_add_overflow(value, (uint64_t) (*p - '0'), &value))
+                    return nullptr;
+            }
+            return (p == s)? nullptr : p;
+        }
+
+        static inline const char *parse_int(const char *p, const char *e, int64_t& value) {
+            bool neg = (*p == '-');
+            if (neg || *p == '+')
+                p++;
+            uint64_t tmp;
+            if ((p = parse_uint(p, e, tmp)) == nullptr)
+                return nullptr;
+            if (tmp > (neg? (uint64_t) INT64_MAX + 1 : (uint64_t) INT64_MAX))
+                return nullptr;
+            value = neg? (int64_t) (0 - tmp) : (int64_t) tmp;
+            return p;
+        }
+
+        static inline const char *parse_double(const char *p, const char *e, double& value) {
+            // strtod needs a terminated string and the url is not necessarily terminated
+            char buf[64];
+            size_t len = std::min((size_t) (e - p), sizeof(buf) - 1);
+            const char *slash = (const char *) memchr(p, '/', len);
+            if (slash != nullptr)
+                len = slash - p;
+            memcpy(buf, p, len);
+            buf[len] = '\0';
+
+            char *eptr;
+            errno = 0;
+            value = strtod(buf, &eptr);
+            if (errno == ERANGE || eptr == buf)
+                return nullptr;
+            return p + (eptr - buf);
+        }
+
+        void Trie::compile() {
+            m_cnodes.clear();
+            m_firsts.clear();
+            m_labels.clear();
+            m_jumps.clear();
+
+            m_cnodes.emplace_back();
+            m_firsts.push_back('\0');
+            compile_node(0, head());
+        }
+
+        unsigned Trie::compile_node(unsigned idx, const node_t *node) {
+            unsigned min_rule = node->rule_index? node->rule_index : UINT32_MAX;
+            m_cnodes[idx].rule_index = node->rule_index;
+
+            for (int i = 0; i < (int) suil::detail::ParamType::MAX; i++) {
+                if (!node->param_childrens[i])
+                    continue;
+                unsigned pidx = m_cnodes.size();
+                m_cnodes.emplace_back();
+                m_firsts.push_back('\0');
+                m_cnodes[idx].param_childrens[i] = pidx;
+                min_rule = std::min(min_rule, compile_node(pidx, &m_nodes[node->param_childrens[i]]));
+            }
+
+            if (!node->children.empty()) {
+                // collapse chains of nodes with a single child into one edge
+                std::vector<std::pair<std::string, const node_t*>> edges;
+                for (auto& kv : node->children) {
+                    std::string label = kv.first;
+                    const node_t *child = &m_nodes[kv.second];
+                    while (child->issimple() && child->children.size() == 1) {
+                        label += child->children.begin()->first;
+                        child = &m_nodes[child->children.begin()->second];
+                    }
+                    edges.emplace_back(std::move(label), child);
+                }
+                std::sort(edges.begin(), edges.end(),
+                          [](const auto& a, const auto& b) { return a.first < b.first; });
+
+                unsigned first = m_cnodes.size();
+                m_cnodes.resize(first + edges.size());
+                m_cnodes[idx].children  = first;
+                m_cnodes[idx].nchildren = (uint16_t) edges.size();
+                for (unsigned i = 0; i < edges.size(); i++) {
+                    auto& cn = m_cnodes[first + i];
+                    cn.label = m_labels.size();
+                    cn.label_len = edges[i].first.size();
+                    m_labels += edges[i].first;
+                    m_firsts.push_back(edges[i].first[0]);
+                }
+
+                if (edges.size() >= SUIL_ROUTER_JUMP_MIN) {
+                    // wide nodes index their children by first byte
+                    m_jumps.emplace_back();
+                    auto& jump = m_jumps.back();
+                    jump.fill(0);
+                    for (unsigned i = 0; i < edges.size(); i++)
+                        jump[(uint8_t) edges[i].first[0]] = (uint16_t) (i + 1);
+                    m_cnodes[idx].jump = (uint16_t) m_jumps.size();
+                }
+
+                for (unsigned i = 0; i < edges.size(); i++)
+                    min_rule = std::min(min_rule, compile_node(first + i, edges[i].second));
+            }
+
+            m_cnodes[idx].min_rule = min_rule;
+            return min_rule;
+        }
+
+        void Trie::lookup(const strview &url, unsigned idx, size_t pos, match_t &m) const {
+            const cnode_t& node = m_cnodes[idx];
+            if (m.found && node.min_rule >= m.found) {
+                // nothing better can be found under this node
+                return;
+            }
+
+            if (pos == url.size()) {
+                if (node.rule_index && (!m.found || node.rule_index < m.found)) {
+                    m.found = node.rule_index;
+                    m.nbest = m.depth;
+                    memcpy(m.best, m.captures, sizeof(capture_t) * m.depth);
+                }
+                return;
+            }
+
+            const char *s = url.data() + pos, *e = url.data() + url.size();
+            auto capture = [&](suil::detail::ParamType type, const char *p, unsigned child) {
+                auto& cap = m.captures[m.depth++];
+                cap.type = type;
+                cap.pos = pos;
+                cap.len = p - s;
+                lookup(url, child, p - url.data(), m);
+                m.depth--;
+            };
+
+            unsigned child;
+            if ((child = node.param_childrens[(int)suil::detail::ParamType::INT])) {
+                const char *p = parse_int(s, e, m.captures[m.depth].i);
+                if (p != nullptr)
+                    capture(suil::detail::ParamType::INT, p, child);
+            }
+
+            if ((child = node.param_childrens[(int)suil::detail::ParamType::UINT]) && *s != '-') {
+                const char *p = parse_uint((*s == '+')? s+1 : s, e, m.captures[m.depth].u);
+                if (p != nullptr)
+                    capture(suil::detail::ParamType::UINT, p, child);
+            }
+
+            if ((child = node.param_childrens[(int)suil::detail::ParamType::DOUBLE]) &&
+                ((*s >= '0' && *s <= '9') || *s == '+' || *s == '-' || *s == '.'))
+            {
+                const char *p = parse_double(s, e, m.captures[m.depth].d);
+                if (p != nullptr)
+                    capture(suil::detail::ParamType::DOUBLE, p, child);
+            }
+
+            if ((child = node.param_childrens[(int)suil::detail::ParamType::STRING]) && *s != '/') {
+                const char *p = (const char *) memchr(s, '/', e - s);
+                capture(suil::detail::ParamType::STRING, p? p : e, child);
+            }
+
+            if ((child = node.param_childrens[(int)suil::detail::ParamType::PATH])) {
+                capture(suil::detail::ParamType::PATH, e, child);
+            }
+
+            if (node.nchildren) {
+                if (node.jump) {
+                    auto off = m_jumps[node.jump-1][(uint8_t) *s];
+                    if (off == 0)
+                        return;
+                    child = node.children + off - 1;
+                }
+                else {
+                    auto f = (const char *) memchr(&m_firsts[node.children], *s, node.nchildren);
+                    if (f == nullptr)
+                        return;
+                    child = f - m_firsts.data();
+                }
+
+                const cnode_t& cn = m_cnodes[child];
+                if ((size_t) (e - s) >= cn.label_len && memcmp(s, &m_labels[cn.label], cn.label_len) == 0)
+                    lookup(url, child, pos + cn.label_len, m);
+            }
+        }
+
+        suil::http::router_params_t Trie::match(const strview &url) const {
+            match_t m;
+            if (!m_cnodes.empty())
+                lookup(url, 0, 0, m);
+
+            suil::detail::routing_params params;
+            for (unsigned i = 0; i < m.nbest; i++) {
+                auto& cap = m.best[i];
+                switch (cap.type) {
+                    case suil::detail::ParamType::INT:
+                        params.push(cap.i);
+                        break;
+                    case suil::detail::ParamType::UINT:
+                        params.push(cap.u);
+                        break;
+                    case suil::detail::ParamType::DOUBLE:
+                        params.push(cap.d);
+                        break;
+                    default:
+                        params.push(url.substr(cap.pos, cap.len));
+                        break;
+                }
+            }
+
+            return {m.found, std::move(params)};
+        }
+
         void Trie::add(const std::string &url, unsigned rule_index) {
-            unsigned idx{0};
+            unsigned idx{0}, nparams{0};
 
             for(unsigned i = 0; i < url.size(); i ++)
             {
@@ -216,6 +431,8 @@ namespace suil {
                             }
                             idx = m_nodes[idx].param_childrens[(int)x.type];
                             ii += x.name.size();
+                            if (++nparams > SUIL_ROUTE_MAX_PARAMS)
+                                throw std::runtime_error(("too many parameters in " + url).c_str());
                             break;
                         }
                     }
@@ -328,7 +545,7 @@ namespace suil {
                 url = (char *) FS_URL;
             }
 
-            auto params = m_trie.find(url);
+            auto params = m_trie.match(url);
 
             if (params.first == 0) {
                 throw Error::notFound();
@@ -460,4 +677,140 @@ namespace suil {
             }
         }
     }
-}
\ No newline at end of file
+}
+#ifdef unit_test
+#include <catch/catch.hpp>
+#include <chrono>
+
+using namespace suil;
+using namespace suil::http;
+
+static unsigned build_routes(Trie& trie, unsigned nresources) {
+    unsigned idx{2};
+    for (unsigned i = 0; i < nresources; i++) {
+        std::string res = "/resource" + std::to_string(i);
+        trie.add(res, idx++);
+        trie.add(res + "/{int}", idx++);
+        trie.add(res + "/{int}/items", idx++);
+        trie.add(res + "/{int}/items/{str}", idx++);
+        trie.add(res + "/search/{str}", idx++);
+        trie.add(res + "/files/{path}", idx++);
+    }
+    return idx;
+}
+
+TEST_CASE("suil::http::Trie", "[http][router]")
+{
+    SECTION("Matching urls against compiled routes") {
+        Trie trie;
+        trie.add("/", 2);
+        trie.add("/users/{uint}", 3);
+        trie.add("/users/{int}/balance", 4);
+        trie.add("/users/me", 5);
+        trie.add("/users/{str}/profile", 6);
+        trie.add("/price/{float}", 7);
+        trie.add("/files/{path}", 8);
+        trie.add("/files/readme", 9);
+        REQUIRE_THROWS(trie.add("/users/me", 10));
+        trie.validate();
+
+        auto p = trie.match("/");
+        REQUIRE(p.first == 2);
+        p = trie.match("/users/12");
+        REQUIRE(p.first == 3);
+        REQUIRE(p.second.get<uint64_t>(0) == 12);
+        p = trie.match("/users/-12/balance");
+        REQUIRE(p.first == 4);
+        REQUIRE(p.second.get<int64_t>(0) == -12);
+        // uint does not accept signed values nor values that overflow
+        REQUIRE(trie.match("/users/-12").first == 0);
+        REQUIRE(trie.match("/users/18446744073709551616").first == 0);
+        REQUIRE(trie.match("/users/me").first == 5);
+        p = trie.match("/users/carter/profile");
+        REQUIRE(p.first == 6);
+        REQUIRE(p.second.get<std::string>(0) == "carter");
+        p = trie.match("/price/2.5");
+        REQUIRE(p.first == 7);
+        REQUIRE(p.second.get<double>(0) == 2.5);
+        p = trie.match("/files/docs/index.html");
+        REQUIRE(p.first == 8);
+        REQUIRE(p.second.get<std::string>(0) == "docs/index.html");
+        // lowest rule index wins when several rules match
+        REQUIRE(trie.match("/files/readme").first == 8);
+        REQUIRE(trie.match("/user").first == 0);
+        REQUIRE(trie.match("/users/").first == 0);
+        REQUIRE(trie.match("/users//profile").first == 0);
+        REQUIRE(trie.match("").first == 0);
+    }
+
+    SECTION("Compiled routes match like the trie they were built from") {
+        Trie trie;
+        build_routes(trie, 50);
+        trie.validate();
+
+        const char *urls[] = {
+            "/resource0", "/resource49", "/resource50", "/resource7/42",
+            "/resource7/-42", "/resource7/42/items", "/resource7/42/items/",
+            "/resource12/9/items/abc", "/resource12/search/", "/resource12/search/x/y",
+            "/resource3/files/a/b/c", "/resource3/files", "/resource", "/resource1/+5"
+        };
+        for (auto url : urls) {
+            auto expected = trie.find(url);
+            auto got = trie.match(url);
+            CAPTURE(url);
+            REQUIRE(got.first == expected.first);
+            REQUIRE(got.second.int_params.back == expected.second.int_params.back);
+            REQUIRE(got.second.string_params.back == expected.second.string_params.back);
+            for (unsigned i = 0; i < got.second.int_params.back; i++)
+                REQUIRE(got.second.get<int64_t>(i) == expected.second.get<int64_t>(i));
+            for (unsigned i = 0; i < got.second.string_params.back; i++)
+                REQUIRE(got.second.get<std::string>(i) == expected.second.get<std::string>(i));
+        }
+    }
+
+    SECTION("Routes with too many parameters are rejected") {
+        Trie trie;
+        std::string url;
+        for (int i = 0; i <= SUIL_ROUTE_MAX_PARAMS; i++)
+            url += "/{int}";
+        REQUIRE_THROWS(trie.add(url, 2));
+    }
+}
+
+TEST_CASE("suil::http::Trie lookup benchmark", "[.bench][router]")
+{
+    // ./sut "[.bench]"
+    Trie trie;
+    build_routes(trie, 60);
+    trie.validate();
+
+    std::vector<std::string> urls;
+    for (unsigned i = 0; i < 60; i += 7) {
+        std::string res = "/resource" + std::to_string(i);
+        urls.push_back(res);
+        urls.push_back(res + "/1234");
+        urls.push_back(res + "/1234/items/abcdef");
+        urls.push_back(res + "/search/hello");
+        urls.push_back(res + "/files/static/js/app.js");
+        urls.push_back(res + "/unknown");
+    }
+
+    const int ROUNDS = 20000;
+    auto bench = [&](const char *name, auto f) {
+        size_t found{0};
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ROUNDS; i++) {
+            for (auto& url : urls)
+                found += f(url).first;
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        WARN(name << ": " << (double) ns / (ROUNDS * urls.size()) << " ns/lookup (" << found << ")");
+        return found;
+    };
+
+    auto a = bench("Trie::find", [&](const std::string& url) { return trie.find(url); });
+    auto b = bench("Trie::match", [&](const std::string& url) { return trie.match(url); });
+    REQUIRE(a == b);
+}
+#endif
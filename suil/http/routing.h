@@ -446,6 +446,14 @@ namespace suil {
 
         const int RULE_SPECIAL_REDIRECT_SLASH = 1;
 
+#ifndef SUIL_ROUTE_MAX_PARAMS
+#define SUIL_ROUTE_MAX_PARAMS 16
+#endif
+
+#ifndef SUIL_ROUTER_JUMP_MIN
+#define SUIL_ROUTER_JUMP_MIN 8
+#endif
+
         using RouteEnumerator = std::function<bool(BaseRule&)>;
 
         class Trie
@@ -490,15 +498,29 @@ namespace suil {
             {
                 if (!head()->issimple())
                     throw std::runtime_error("Internal error: Trie header should be simple!");
+                compile();
                 optimize();
             }
 
+            /**
+             * Looks up a url by walking the nodes the trie was built with, this
+             * is the reference implementation of \see Trie::match
+             */
             suil::http::router_params_t find(
                     const strview& req_url,
                     const node_t* node = nullptr,
                     unsigned pos = 0,
                     suil::detail::routing_params* params = nullptr) const;
 
+            /**
+             * Looks up a url in the compiled form of the trie, which must have
+             * been built with \see Trie::validate
+             *
+             * @return the index of the matching rule (0 if none matched) and the
+             * parameters parsed from the url
+             */
+            suil::http::router_params_t match(const strview& url) const;
+
             void add(const std::string& url, unsigned rule_index);
 
         private:
@@ -533,6 +555,60 @@ namespace suil {
             }
 
             std::vector<node_t> m_nodes;
+
+        private suil_ut:
+            /*
+             * The compiled trie is a flat array of nodes where chains of single
+             * child nodes are collapsed into a single edge and the children of
+             * each node are stored next to each other
+             */
+            struct cnode_t
+            {
+                unsigned rule_index{};
+                // smallest rule index reachable from the node, used to prune lookups
+                unsigned min_rule{UINT32_MAX};
+                // the label of the edge leading to the node, stored in m_labels
+                uint32_t label{};
+                uint32_t label_len{};
+                uint32_t children{};
+                uint16_t nchildren{};
+                // 1 + index of the node's first byte jump table, 0 if there is none
+                uint16_t jump{};
+                std::array<unsigned, (int)suil::detail::ParamType::MAX> param_childrens{};
+            };
+
+            struct capture_t
+            {
+                suil::detail::ParamType type;
+                uint32_t pos;
+                uint32_t len;
+                union {
+                    int64_t  i;
+                    uint64_t u;
+                    double   d;
+                };
+            };
+
+            struct match_t
+            {
+                unsigned  found{0};
+                uint8_t   depth{0};
+                uint8_t   nbest{0};
+                capture_t captures[SUIL_ROUTE_MAX_PARAMS];
+                capture_t best[SUIL_ROUTE_MAX_PARAMS];
+            };
+
+            void compile();
+
+            unsigned compile_node(unsigned idx, const node_t* node);
+
+            void lookup(const strview& url, unsigned idx, size_t pos, match_t& m) const;
+
+            std::vector<cnode_t>  m_cnodes;
+            // the first byte of each compiled node's label
+            std::string           m_firsts;
+            std::string           m_labels;
+            std::vector<std::array<uint16_t, 256>> m_jumps;
         };
 
         define_log_tag(HTTP_ROUTER);
@@ -20,10 +20,35 @@ namespace suil {
         static uint8_t api_index{0};
         static std::unordered_map<uint8_t, WebSockApi&> apis{};
 
+        coroutine void WebSockApi::ipcBroadcast(void *data, size_t size) {
+            auto *msg = (WsockBcastMsg *) data;
+            auto it = apis.find(msg->api_id);
+            if (it != apis.end()) {
+                // forward message to web sockets connected to this worker
+                it->second.broadcast(nullptr, data, size);
+            }
+            free(data);
+        }
+
+        void WebSockApi::onIpcBroadcast(uint8_t src, const void *data, size_t size) {
+            strace("WebSock::onIpcBroadcast from worker/%hhu size %lu", src, size);
+            if (size < sizeof(WsockBcastMsg)) {
+                return;
+            }
+            // data is only valid within the handler
+            void *copy = malloc(size);
+            memcpy(copy, data, size);
+            go(ipcBroadcast(copy, size));
+        }
+
         WebSockApi::WebSockApi()
         {
             id = api_index++;
             apis.emplace(id, *this);
+            if (id == 0) {
+                // web socket messages from other workers
+                Worker::reg(IPC_WSOCK_BCAST, onIpcBroadcast);
+            }
         }
 
         Status WebSock::handshake(
@@ -373,6 +398,10 @@ namespace suil {
                 // the copied buffer now belongs to the go-routine
                 // being scheduled
                 size_t len = sizeof(WsockBcastMsg)+msg->len;
+                if (Worker::ipc()) {
+                    // forward to web sockets connected to other workers
+                    Worker::broadcast(IPC_WSOCK_BCAST, copy, len, api.timeout);
+                }
                 go(broadcast(*this, api, copy, len));
             }
         }
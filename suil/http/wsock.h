@@ -6,6 +6,7 @@
 #define SUIL_WSOCK_HPP
 
 #include <suil/channel.h>
+#include <suil/worker.h>
 #include <suil/http/request.h>
 #include <suil/http/response.h>
 
@@ -53,6 +54,10 @@ namespace suil {
 
             static coroutine void   bsend(Channel<int>&, WebSock& ws, const void *data, size_t len);
 
+            static coroutine void   ipcBroadcast(void *data, size_t size);
+
+            static void onIpcBroadcast(uint8_t src, const void *data, size_t size);
+
             Map<WebSock&>    websocks{};
             size_t           nsocks{0};
             uint8_t          id;
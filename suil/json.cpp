@@ -23,6 +23,8 @@
 
 #include "json.h"
 #include "file.h"
+#include "arena.h"
+#include "simd.h"
 
 #include <assert.h>
 #include <stdint.h>
@@ -31,64 +33,55 @@
 #include <string.h>
 #include <lua/lua.hpp>
 
-#define out_of_memory() do {                    \
-		fprintf(stderr, "Out of memory.\n");    \
-		exit(EXIT_FAILURE);                     \
-	} while (0)
-
-/* Sadly, strdup is not portable. */
-#define json_strdup(str) strdup(str)
+#ifndef SUIL_JSON_INDEX_MIN
+/* objects with at least this many members get an index on their keys */
+#define SUIL_JSON_INDEX_MIN 16
+#endif
 
-/* String buffer */
+#ifndef SUIL_JSON_STRUCTURALS_MIN
+/* documents with at least this many bytes are decoded from an index of
+ * their structural characters (see simd::jsonindex) */
+#define SUIL_JSON_STRUCTURALS_MIN 256
+#endif
 
-typedef struct
+/*
+ * The memory of a JSON document. All the nodes of the document are allocated
+ * from the arena and released together when the document is deleted
+ */
+struct JsonDoc
 {
-	char *cur;
-	char *end;
-	char *start;
-} SB;
+	explicit JsonDoc(size_t block)
+		: arena(block)
+	{}
 
-static void sb_init(SB *sb)
-{
-	sb->start = (char*) malloc(17);
-	if (sb->start == nullptr)
-		throw suil::Exception::allocationFailure("json::Object sb_init");
-	sb->cur = sb->start;
-	sb->end = sb->start + 16;
-}
+	suil::Arena arena;
+	/* the top level value of the document */
+	JsonNode    root{};
+};
 
-/* sb and need may be evaluated multiple times. */
-#define sb_need(sb, need) do {                  \
-		if ((sb)->end - (sb)->cur < (need))     \
-			sb_grow(sb, need);                  \
-	} while (0)
+/* the value of null objects, never modified */
+static JsonNode json_null{};
 
-static void sb_grow(SB *sb, int need)
-{
-	size_t length = sb->cur - sb->start;
-	size_t alloc = sb->end - sb->start;
-	
-	do {
-		alloc *= 2;
-	} while (alloc < length + need);
-	
-	sb->start = (char*) realloc(sb->start, alloc + 1);
-	if (sb->start == nullptr)
-		out_of_memory();
-	sb->cur = sb->start + length;
-	sb->end = sb->start + alloc;
-}
+/* typed decoding (iod::json_decode) uses the same structural index */
+static const bool json_indexer = (iod::json_internals::json_indexer() = suil::simd::jsonindex, true);
 
-static char *sb_finish(SB *sb)
+/* strings are escaped in runs, the bytes to escape are found with the widest
+ * instruction set available */
+static const char *json_find_escape(const char *p, const char *end)
 {
-	*sb->cur = 0;
-	assert(sb->start <= sb->cur && strlen(sb->start) == (size_t)(sb->cur - sb->start));
-	return sb->start;
+	static const char ESCAPED[] = {'\x00', '\x1f', '"', '"', '\\', '\\'};
+	return suil::simd::findranges(p, end, ESCAPED, sizeof(ESCAPED));
 }
 
-static void sb_free(SB *sb)
+static const bool json_escape_finder = (iod::json_internals::json_escape_finder() = json_find_escape, true);
+
+/* the block size of the arena of a document decoded from @size bytes */
+static size_t json_doc_block(size_t size)
 {
-	free(sb->start);
+	size_t block = 1024;
+	while (block < size && block < 65536)
+		block <<= 1;
+	return block;
 }
 
 /*
@@ -179,57 +172,29 @@ static int utf8_validate_cz(const char *s)
 	}
 }
 
-/* Validate a null-terminated UTF-8 string. */
-static bool utf8_validate(const char *s)
+/* Validate a null-terminated UTF-8 string of @len bytes. */
+static bool utf8_validate(const char *s, size_t len)
 {
-	int len;
-	
-	for (; *s != 0; s += len) {
-		len = utf8_validate_cz(s);
-		if (len == 0)
+	const char *end = s + len;
+	uint64_t w;
+
+	while (s < end) {
+		/* ASCII, 8 bytes at a time */
+		if ((end - s) >= 8) {
+			memcpy(&w, s, sizeof(w));
+			if ((w & 0x8080808080808080ULL) == 0) {
+				s += 8;
+				continue;
+			}
+		}
+
+		int n = utf8_validate_cz(s);
+		if (n == 0)
 			return false;
+		s += n;
 	}
-	
-	return true;
-}
-
-/*
- * Read a single UTF-8 character starting at @s,
- * returning the length, in bytes, of the character read.
- *
- * This function assumes input is valid UTF-8,
- * and that there are enough characters in front of @s.
- */
-static int utf8_read_char(const char *s, uchar_t *out)
-{
-	const auto *c = (const unsigned char*) s;
-	
-	if (!utf8_validate_cz(s))
-	    throw suil::Exception::create("string '", s, "' is not a valid utf8 string");
 
-	if (c[0] <= 0x7F) {
-		/* 00..7F */
-		*out = c[0];
-		return 1;
-	} else if (c[0] <= 0xDF) {
-		/* C2..DF (unless input is invalid) */
-		*out = ((uchar_t)c[0] & 0x1F) << 6 |
-		       ((uchar_t)c[1] & 0x3F);
-		return 2;
-	} else if (c[0] <= 0xEF) {
-		/* E0..EF */
-		*out = ((uchar_t)c[0] &  0xF) << 12 |
-		       ((uchar_t)c[1] & 0x3F) << 6  |
-		       ((uchar_t)c[2] & 0x3F);
-		return 3;
-	} else {
-		/* F0..F4 (unless input is invalid) */
-		*out = ((uchar_t)c[0] &  0x7) << 18 |
-		       ((uchar_t)c[1] & 0x3F) << 12 |
-		       ((uchar_t)c[2] & 0x3F) << 6  |
-		       ((uchar_t)c[3] & 0x3F);
-		return 4;
-	}
+	return true;
 }
 
 /*
@@ -288,319 +253,306 @@ static bool from_surrogate_pair(uint16_t uc, uint16_t lc, uchar_t *unicode)
 	}
 }
 
-/*
- * Construct a UTF-16 surrogate pair given a Unicode codepoint.
- *
- * @unicode must be U+10000..U+10FFFF.
- */
-static void to_surrogate_pair(uchar_t unicode, uint16_t *uc, uint16_t *lc)
-{
-	uchar_t n;
-	
-	if (!(unicode >= 0x10000 && unicode <= 0x10FFFF))
-        throw suil::Exception::create("'", unicode, "' is not a valid unicode character");
-	
-	n = unicode - 0x10000;
-	*uc = ((n >> 10) & 0x3FF) | 0xD800;
-	*lc = (n & 0x3FF) | 0xDC00;
-}
-
 #define is_space(c) ((c) == '\t' || (c) == '\n' || (c) == '\r' || (c) == ' ')
 #define is_digit(c) ((c) >= '0' && (c) <= '9')
 
-static bool parse_value     (const char **sp, JsonNode        **out);
-static bool parse_string    (const char **sp, char            **out);
+/* the state of a decoder */
+typedef struct
+{
+	suil::Arena *arena;
+	/* the children of the containers being decoded */
+	std::vector<JsonNode> *stack;
+	/* the offsets of the structural characters, null if not indexed */
+	const uint32_t *index;
+	size_t nindex;
+	/* the first structural not yet consumed */
+	size_t cur;
+	char *base;
+	char *end;
+} JsonCtx;
+
+static bool parse_value     (JsonCtx *ctx, char **sp, JsonNode *out);
+static bool parse_string    (JsonCtx *ctx, char **sp, const char **out, uint32_t *len);
 static bool parse_number    (const char **sp, double           *out);
-static bool parse_array     (const char **sp, JsonNode        **out);
-static bool parse_object    (const char **sp, JsonNode        **out);
-static bool parse_hex16     (const char **sp, uint16_t         *out);
+static bool parse_array     (JsonCtx *ctx, char **sp, JsonNode *out);
+static bool parse_object    (JsonCtx *ctx, char **sp, JsonNode *out);
+static bool parse_hex16     (char **sp, uint16_t         *out);
 
-static bool expect_literal  (const char **sp, const char *str);
-static void skip_space      (const char **sp);
+static bool expect_literal  (char **sp, const char *str);
+static void skip_space      (char **sp);
+static void skip_space      (JsonCtx *ctx, char **sp);
 
 static void emit_value              (iod::encode_stream& out, const JsonNode *node);
 static void emit_value_indented     (iod::encode_stream& out, const JsonNode *node, const char *space, int indent_level);
-static void emit_string             (iod::encode_stream& out, const char *str);
+static void emit_string             (iod::encode_stream& out, const char *str, size_t len);
 static void emit_number             (iod::encode_stream& out, double num);
 static void emit_array              (iod::encode_stream& out, const JsonNode *array);
 static void emit_array_indented     (iod::encode_stream& out, const JsonNode *array, const char *space, int indent_level);
 static void emit_object             (iod::encode_stream& out, const JsonNode *object);
 static void emit_object_indented    (iod::encode_stream& out, const JsonNode *object, const char *space, int indent_level);
-
-static int write_hex16(iod::encode_stream& out, uint16_t val);
-
-static JsonNode *mknode(JsonTag tag);
-static void append_node(JsonNode *parent, JsonNode *child);
-static void prepend_node(JsonNode *parent, JsonNode *child);
-static void append_member(JsonNode *object, char *key, JsonNode *value);
+static size_t estimate_value        (const JsonNode *node);
 
 /* Assertion-friendly validity checks */
 static bool tag_is_valid(unsigned int tag);
 static bool number_is_valid(const char *num);
 
-static void json_delete(JsonNode *node);
-
-static JsonNode *json_decode(const char *json)
-{
-	const char *s = json;
-	JsonNode *ret;
-
-	skip_space(&s);
-	if (!parse_value(&s, &ret))
-		return nullptr;
-
-	skip_space(&s);
-	if (*s != 0) {
-		json_delete(ret);
-		return nullptr;
-	}
-
-	return ret;
-}
-
-static void json_delete(JsonNode *node)
-{
-	if (node != nullptr) {
-		json_remove_from_parent(node);
-
-		switch (node->tag) {
-			case JSON_STRING:
-				free(node->string_);
-				break;
-			case JSON_ARRAY:
-			case JSON_OBJECT:
-			{
-				JsonNode *child, *next;
-				for (child = node->children.head; child != nullptr; child = next) {
-					next = child->next;
-					json_delete(child);
-				}
-				break;
-			}
-			default:;
-		}
-		free(node);
-	}
-}
-
-bool json_validate(const char *json)
+static bool is_container(const JsonNode *node)
 {
-	const char *s = json;
-
-	skip_space(&s);
-	if (!parse_value(&s, nullptr))
-		return false;
-
-	skip_space(&s);
-	if (*s != 0)
-		return false;
-
-	return true;
+	return node != nullptr && (node->tag == JSON_ARRAY || node->tag == JSON_OBJECT);
 }
 
-JsonNode *json_find_element(JsonNode *array, int index)
+static JsonNode *mknode(suil::Arena& arena, JsonTag tag)
 {
-	JsonNode *element;
-	int i = 0;
-
-	if (array == nullptr || array->tag != JSON_ARRAY)
-		return nullptr;
-
-	json_foreach(element, array) {
-		if (i == index)
-			return element;
-		i++;
-	}
-
-	return nullptr;
-}
-
-JsonNode *json_find_member(JsonNode *object, const char *name)
-{
-	JsonNode *member;
-
-	if (object == nullptr || object->tag != JSON_OBJECT)
-		return nullptr;
-
-	json_foreach(member, object)
-		if (strcmp(member->key, name) == 0)
-			return member;
-
-	return nullptr;
+	auto *node = (JsonNode *) arena.allocate(sizeof(JsonNode), alignof(JsonNode));
+	memset(node, 0, sizeof(JsonNode));
+	node->tag = tag;
+	return node;
 }
 
-JsonNode *json_find_member(JsonNode *object, const char *key, size_t keyLen)
+static void mkstring(suil::Arena& arena, JsonNode *node, const char *s, size_t len)
 {
-	JsonNode *member;
-
-	if (object == nullptr || object->tag != JSON_OBJECT)
-		return nullptr;
-
-	json_foreach(member, object)
-		if (strncmp(member->key, key, keyLen) == 0)
-			return member;
-
-	return nullptr;
+	node->tag = JSON_STRING;
+	node->string_ = arena.strndup(s, len);
+	node->len = (uint32_t) len;
 }
 
-JsonNode *json_first_child(const JsonNode *node)
+/*
+ * Moves the children on top of the decoder stack, from @mark, to
+ * a single allocation of contiguous nodes.
+ */
+static void mkchildren(JsonCtx *ctx, JsonNode *parent, size_t mark)
 {
-	if (node != nullptr && (node->tag == JSON_ARRAY || node->tag == JSON_OBJECT))
-		return node->children.head;
-	return nullptr;
-}
+	auto& stack = *ctx->stack;
+	size_t n = stack.size() - mark;
+
+	parent->len = (uint32_t) n;
+	parent->children.cap = (uint32_t) n;
+	parent->children.icap = 0;
+	parent->children.index = nullptr;
+	parent->children.items = nullptr;
+	if (n == 0)
+		return;
 
-static JsonNode *mknode(JsonTag tag)
-{
-	JsonNode *ret = (JsonNode*) calloc(1, sizeof(JsonNode));
-	if (ret == nullptr)
-		out_of_memory();
-	ret->tag = tag;
-	return ret;
+	auto *nodes = (JsonNode *) ctx->arena->allocate(n * (sizeof(JsonNode) + sizeof(JsonNode *)), alignof(JsonNode));
+	auto **items = (JsonNode **) (nodes + n);
+	memcpy(nodes, &stack[mark], n * sizeof(JsonNode));
+	for (size_t i = 0; i < n; i++)
+		items[i] = &nodes[i];
+	parent->children.items = items;
+	stack.resize(mark);
 }
 
-JsonNode *json_mknull(void)
+/* Copies @src, and its descendants, into @dst allocating from @arena. */
+static void copy_node(suil::Arena& arena, JsonNode *dst, const JsonNode *src)
 {
-	return mknode(JSON_NULL);
-}
+	dst->tag = src->tag;
+	dst->key = nullptr;
+	switch (src->tag) {
+		case JSON_STRING:
+			mkstring(arena, dst, src->string_, src->len);
+			break;
+		case JSON_ARRAY:
+		case JSON_OBJECT: {
+			uint32_t n = src->len;
+			dst->len = n;
+			dst->children.cap = n;
+			dst->children.icap = 0;
+			dst->children.index = nullptr;
+			dst->children.items = nullptr;
+			if (n == 0)
+				break;
 
-JsonNode *json_mkbool(bool b)
-{
-	JsonNode *ret = mknode(JSON_BOOL);
-	ret->bool_ = b;
-	return ret;
+			auto *nodes = (JsonNode *) arena.allocate(n * (sizeof(JsonNode) + sizeof(JsonNode *)), alignof(JsonNode));
+			auto **items = (JsonNode **) (nodes + n);
+			for (uint32_t i = 0; i < n; i++) {
+				const JsonNode *child = src->children.items[i];
+				copy_node(arena, &nodes[i], child);
+				if (child->key != nullptr)
+					nodes[i].key = arena.strndup(child->key, strlen(child->key));
+				items[i] = &nodes[i];
+			}
+			dst->children.items = items;
+			break;
+		}
+		default:
+			dst->len = 0;
+			dst->number_ = src->number_;
+			if (src->tag == JSON_BOOL)
+				dst->bool_ = src->bool_;
+			break;
+	}
 }
 
-static JsonNode *mkstring(char *s)
+static inline size_t key_hash(const char *key, size_t len)
 {
-	JsonNode *ret = mknode(JSON_STRING);
-	ret->string_ = s;
-	return ret;
+	/* same as suil::String::hash so cached hashes can be used for lookups */
+	return std::hash<suil::strview>()(suil::strview(key, len));
 }
 
-JsonNode *json_mkstring(const char *s)
+static inline bool key_equals(const char *key, const char *other, size_t len)
 {
-	return mkstring(json_strdup(s));
+	return strncmp(key, other, len) == 0 && key[len] == '\0';
 }
 
-JsonNode *json_mknstring(const char *s, size_t size)
+/* Adds member @i of @object to its index, the first of duplicate keys is kept. */
+static void index_member(JsonNode *object, uint32_t i)
 {
-    return mkstring(strndup(s, size));
+	const char *key = object->children.items[i]->key;
+	uint32_t mask = object->children.icap - 1;
+	size_t len = strlen(key);
+	uint32_t h = (uint32_t) (key_hash(key, len) & mask);
+
+	while (object->children.index[h] != 0) {
+		if (key_equals(object->children.items[object->children.index[h]-1]->key, key, len))
+			return;
+		h = (h + 1) & mask;
+	}
+	object->children.index[h] = i + 1;
 }
 
-JsonNode *json_mknumber(double n)
+static void build_index(suil::Arena& arena, JsonNode *object)
 {
-	JsonNode *node = mknode(JSON_NUMBER);
-	node->number_ = n;
-	return node;
+	uint32_t icap = 32;
+	while (icap < (object->len << 1))
+		icap <<= 1;
+
+	object->children.index = (uint32_t *) arena.allocate(icap * sizeof(uint32_t), alignof(uint32_t));
+	memset(object->children.index, 0, icap * sizeof(uint32_t));
+	object->children.icap = icap;
+	for (uint32_t i = 0; i < object->len; i++)
+		index_member(object, i);
 }
 
-JsonNode *json_mkarray(void)
+static void append_child(suil::Arena& arena, JsonNode *parent, JsonNode *child)
 {
-	return mknode(JSON_ARRAY);
-}
+	if (parent->len == parent->children.cap) {
+		uint32_t cap = parent->children.cap? parent->children.cap << 1 : 4;
+		auto **items = (JsonNode **) arena.allocate(cap * sizeof(JsonNode *), alignof(JsonNode *));
+		if (parent->len)
+			memcpy(items, parent->children.items, parent->len * sizeof(JsonNode *));
+		/* the free slots are looked at by \see child_node */
+		memset(items + parent->len, 0, (cap - parent->len) * sizeof(JsonNode *));
+		parent->children.items = items;
+		parent->children.cap = cap;
+	}
+	parent->children.items[parent->len++] = child;
 
-JsonNode *json_mkobject(void)
-{
-	return mknode(JSON_OBJECT);
+	if (parent->children.index != nullptr) {
+		if ((parent->len << 1) > parent->children.icap)
+			build_index(arena, parent);
+		else
+			index_member(parent, parent->len - 1);
+	}
 }
 
-static void append_node(JsonNode *parent, JsonNode *child)
+static JsonNode *find_member(suil::Arena& arena, JsonNode *object, const char *key, size_t len, size_t hash)
 {
-	child->parent = parent;
-	child->prev = parent->children.tail;
-	child->next = nullptr;
+	if (object == nullptr || object->tag != JSON_OBJECT)
+		return nullptr;
 
-	if (parent->children.tail != nullptr)
-		parent->children.tail->next = child;
-	else
-		parent->children.head = child;
-	parent->children.tail = child;
-}
+	if (object->len < SUIL_JSON_INDEX_MIN) {
+		for (uint32_t i = 0; i < object->len; i++)
+			if (key_equals(object->children.items[i]->key, key, len))
+				return object->children.items[i];
+		return nullptr;
+	}
 
-static void prepend_node(JsonNode *parent, JsonNode *child)
-{
-	child->parent = parent;
-	child->prev = nullptr;
-	child->next = parent->children.head;
+	if (object->children.index == nullptr)
+		build_index(arena, object);
 
-	if (parent->children.head != nullptr)
-		parent->children.head->prev = child;
-	else
-		parent->children.tail = child;
-	parent->children.head = child;
-}
+	uint32_t mask = object->children.icap - 1;
+	uint32_t h = (uint32_t) (hash & mask);
+	while (object->children.index[h] != 0) {
+		JsonNode *member = object->children.items[object->children.index[h]-1];
+		if (key_equals(member->key, key, len))
+			return member;
+		h = (h + 1) & mask;
+	}
 
-static void append_member(JsonNode *object, char *key, JsonNode *value)
-{
-	value->key = key;
-	append_node(object, value);
+	return nullptr;
 }
 
-void json_append_element(JsonNode *array, JsonNode *element)
+/*
+ * Overwrites @dst, a member or element of a document, with a copy of @src. The
+ * storage of a previous string value is reused when the new string fits in it
+ */
+static void assign_node(suil::Arena& arena, JsonNode *dst, const JsonNode *src)
 {
-	assert(array->tag == JSON_ARRAY);
-	assert(element->parent == nullptr);
+	if (dst == src)
+		return;
 
-	append_node(array, element);
+	const char *key = dst->key;
+	if (src->tag == JSON_STRING && dst->tag == JSON_STRING && dst->len >= src->len) {
+		auto *str = (char *) dst->string_;
+		memmove(str, src->string_, src->len);
+		str[src->len] = '\0';
+		dst->len = src->len;
+	}
+	else {
+		copy_node(arena, dst, src);
+	}
+	dst->key = key;
 }
 
-void json_prepend_element(JsonNode *array, JsonNode *element)
+/* Empties @node into a container of type @tag, keeping its child array and index if it had one */
+static void reset_container(JsonNode *node, JsonTag tag)
 {
-	assert(array->tag == JSON_ARRAY);
-	assert(element->parent == nullptr);
-
-	prepend_node(array, element);
+	if (is_container(node)) {
+		if (node->children.index != nullptr)
+			memset(node->children.index, 0, node->children.icap * sizeof(uint32_t));
+	}
+	else {
+		node->children.items = nullptr;
+		node->children.cap = 0;
+		node->children.icap = 0;
+		node->children.index = nullptr;
+	}
+	node->tag = tag;
+	node->len = 0;
 }
 
-void json_append_member(JsonNode *object, const char *key, JsonNode *value)
+/*
+ * Appends a child, with the given @key, to @parent for the caller to assign. The
+ * children of an emptied container are left in its child array (\see reset_container),
+ * they are recycled along with the storage of their values
+ */
+static JsonNode *child_node(suil::Arena& arena, JsonNode *parent, const char *key, size_t len)
 {
-	assert(object->tag == JSON_OBJECT);
-	assert(value->parent == nullptr);
-
-	append_member(object, json_strdup(key), value);
-}
+	JsonNode *node{nullptr};
+	if (parent->len < parent->children.cap)
+		node = parent->children.items[parent->len];
 
-void json_prepend_member(JsonNode *object, const char *key, JsonNode *value)
-{
-	assert(object->tag == JSON_OBJECT);
-	assert(value->parent == nullptr);
+	if (node == nullptr)
+		node = mknode(arena, JSON_NULL);
+	else if (key == nullptr || node->key == nullptr || !key_equals(node->key, key, len))
+		node->key = nullptr;
 
-	value->key = json_strdup(key);
-	prepend_node(object, value);
+	if (key != nullptr && node->key == nullptr)
+		node->key = arena.strndup(key, len);
+	append_child(arena, parent, node);
+	return node;
 }
 
-void json_remove_from_parent(JsonNode *node)
+/* The member @key of @object, which is appended if the object has no such member */
+static JsonNode *member_node(suil::Arena& arena, JsonNode *object, const char *key)
 {
-	JsonNode *parent = node->parent;
-
-	if (parent != nullptr) {
-		if (node->prev != nullptr)
-			node->prev->next = node->next;
-		else
-			parent->children.head = node->next;
-		if (node->next != nullptr)
-			node->next->prev = node->prev;
-		else
-			parent->children.tail = node->prev;
-
-		free(node->key);
-
-		node->parent = nullptr;
-		node->prev = node->next = nullptr;
-		node->key = nullptr;
-	}
+	size_t len = strlen(key);
+	JsonNode *node = find_member(arena, object, key, len, key_hash(key, len));
+	if (node == nullptr)
+		node = child_node(arena, object, key, len);
+	return node;
 }
 
-static bool parse_value(const char **sp, JsonNode **out)
+static bool parse_value(JsonCtx *ctx, char **sp, JsonNode *out)
 {
-	const char *s = *sp;
+	char *s = *sp;
 
+	out->key = nullptr;
 	switch (*s) {
 		case 'n':
 			if (expect_literal(&s, "null")) {
-				if (out)
-					*out = json_mknull();
+				out->tag = JSON_NULL;
+				out->len = 0;
 				*sp = s;
 				return true;
 			}
@@ -608,8 +560,9 @@ static bool parse_value(const char **sp, JsonNode **out)
 
 		case 'f':
 			if (expect_literal(&s, "false")) {
-				if (out)
-					*out = json_mkbool(false);
+				out->tag = JSON_BOOL;
+				out->len = 0;
+				out->bool_ = false;
 				*sp = s;
 				return true;
 			}
@@ -617,18 +570,17 @@ static bool parse_value(const char **sp, JsonNode **out)
 
 		case 't':
 			if (expect_literal(&s, "true")) {
-				if (out)
-					*out = json_mkbool(true);
+				out->tag = JSON_BOOL;
+				out->len = 0;
+				out->bool_ = true;
 				*sp = s;
 				return true;
 			}
 			return false;
 
 		case '"': {
-			char *str;
-			if (parse_string(&s, out ? &str : nullptr)) {
-				if (out)
-					*out = mkstring(str);
+			if (parse_string(ctx, &s, &out->string_, &out->len)) {
+				out->tag = JSON_STRING;
 				*sp = s;
 				return true;
 			}
@@ -636,25 +588,25 @@ static bool parse_value(const char **sp, JsonNode **out)
 		}
 
 		case '[':
-			if (parse_array(&s, out)) {
+			if (parse_array(ctx, &s, out)) {
 				*sp = s;
 				return true;
 			}
 			return false;
 
 		case '{':
-			if (parse_object(&s, out)) {
+			if (parse_object(ctx, &s, out)) {
 				*sp = s;
 				return true;
 			}
 			return false;
 
 		default: {
-			double num;
-			if (parse_number(&s, out ? &num : nullptr)) {
-				if (out)
-					*out = json_mknumber(num);
-				*sp = s;
+			const char *cs = s;
+			if (parse_number(&cs, &out->number_)) {
+				out->tag = JSON_NUMBER;
+				out->len = 0;
+				*sp = (char *) cs;
 				return true;
 			}
 			return false;
@@ -662,15 +614,15 @@ static bool parse_value(const char **sp, JsonNode **out)
 	}
 }
 
-static bool parse_array(const char **sp, JsonNode **out)
+static bool parse_array(JsonCtx *ctx, char **sp, JsonNode *out)
 {
-	const char *s = *sp;
-	JsonNode *ret = out ? json_mkarray() : nullptr;
-	JsonNode *element;
+	char *s = *sp;
+	size_t mark = ctx->stack->size();
+	JsonNode element;
 
 	if (*s++ != '[')
 		goto failure;
-	skip_space(&s);
+	skip_space(ctx, &s);
 
 	if (*s == ']') {
 		s++;
@@ -678,12 +630,11 @@ static bool parse_array(const char **sp, JsonNode **out)
 	}
 
 	for (;;) {
-		if (!parse_value(&s, out ? &element : nullptr))
+		if (!parse_value(ctx, &s, &element))
 			goto failure;
-		skip_space(&s);
+		skip_space(ctx, &s);
 
-		if (out)
-			json_append_element(ret, element);
+		ctx->stack->push_back(element);
 
 		if (*s == ']') {
 			s++;
@@ -692,30 +643,31 @@ static bool parse_array(const char **sp, JsonNode **out)
 
 		if (*s++ != ',')
 			goto failure;
-		skip_space(&s);
+		skip_space(ctx, &s);
 	}
 
 success:
 	*sp = s;
-	if (out)
-		*out = ret;
+	out->tag = JSON_ARRAY;
+	mkchildren(ctx, out, mark);
 	return true;
 
 failure:
-	json_delete(ret);
+	ctx->stack->resize(mark);
 	return false;
 }
 
-static bool parse_object(const char **sp, JsonNode **out)
+static bool parse_object(JsonCtx *ctx, char **sp, JsonNode *out)
 {
-	const char *s = *sp;
-	JsonNode *ret = out ? json_mkobject() : nullptr;
-	char *key;
-	JsonNode *value;
+	char *s = *sp;
+	size_t mark = ctx->stack->size();
+	const char *key;
+	uint32_t len;
+	JsonNode value;
 
 	if (*s++ != '{')
 		goto failure;
-	skip_space(&s);
+	skip_space(ctx, &s);
 
 	if (*s == '}') {
 		s++;
@@ -723,20 +675,20 @@ static bool parse_object(const char **sp, JsonNode **out)
 	}
 
 	for (;;) {
-		if (!parse_string(&s, out ? &key : nullptr))
+		if (!parse_string(ctx, &s, &key, &len))
 			goto failure;
-		skip_space(&s);
+		skip_space(ctx, &s);
 
 		if (*s++ != ':')
-			goto failure_free_key;
-		skip_space(&s);
+			goto failure;
+		skip_space(ctx, &s);
 
-		if (!parse_value(&s, out ? &value : nullptr))
-			goto failure_free_key;
-		skip_space(&s);
+		if (!parse_value(ctx, &s, &value))
+			goto failure;
+		skip_space(ctx, &s);
 
-		if (out)
-			append_member(ret, key, value);
+		value.key = key;
+		ctx->stack->push_back(value);
 
 		if (*s == '}') {
 			s++;
@@ -745,47 +697,60 @@ static bool parse_object(const char **sp, JsonNode **out)
 
 		if (*s++ != ',')
 			goto failure;
-		skip_space(&s);
+		skip_space(ctx, &s);
 	}
 
 success:
 	*sp = s;
-	if (out)
-		*out = ret;
+	out->tag = JSON_OBJECT;
+	mkchildren(ctx, out, mark);
 	return true;
 
-failure_free_key:
-	if (out)
-		free(key);
 failure:
-	json_delete(ret);
+	ctx->stack->resize(mark);
 	return false;
 }
 
-bool parse_string(const char **sp, char **out)
+/*
+ * Parses a string in place, the unescaped string is never longer than
+ * its escaped form and is written over it, null terminated.
+ */
+static bool parse_string(JsonCtx *ctx, char **sp, const char **out, uint32_t *len)
 {
-	const char *s = *sp;
-	SB sb;
-	char throwaway_buffer[4];
-		/* enough space for a UTF-8 character */
+	char *s = *sp;
 	char *b;
+	const char *start;
 
-	if (*s++ != '"')
+	if (*s != '"')
 		return false;
 
-	if (out) {
-		sb_init(&sb);
-		sb_need(&sb, 4);
-		b = sb.cur;
-	} else {
-		b = throwaway_buffer;
+	if (ctx->index != nullptr) {
+		/* the closing quote is the structural following the opening one, and
+		 * the content was validated while indexing, only escapes need work */
+		size_t off = s - ctx->base;
+		while (ctx->cur < ctx->nindex && ctx->index[ctx->cur] < off)
+			ctx->cur++;
+		if (ctx->cur + 1 < ctx->nindex && ctx->index[ctx->cur] == off) {
+			char *q = ctx->base + ctx->index[ctx->cur + 1];
+			if (memchr(s + 1, '\\', q - s - 1) == nullptr) {
+				*q = '\0';
+				*out = s + 1;
+				*len = (uint32_t) (q - s - 1);
+				*sp = q + 1;
+				ctx->cur += 2;
+				return true;
+			}
+		}
 	}
+	s++;
 
+	start = b = s;
 	while (*s != '"') {
-		unsigned char c = *s++;
+		unsigned char c = *s;
 
 		/* Parse next character, and write it to b. */
 		if (c == '\\') {
+			s++;
 			c = *s++;
 			switch (c) {
 				case '"':
@@ -814,67 +779,51 @@ bool parse_string(const char **sp, char **out)
 					uchar_t unicode;
 
 					if (!parse_hex16(&s, &uc))
-						goto failed;
+						return false;
 
 					if (uc >= 0xD800 && uc <= 0xDFFF) {
 						/* Handle UTF-16 surrogate pair. */
 						if (*s++ != '\\' || *s++ != 'u' || !parse_hex16(&s, &lc))
-							goto failed; /* Incomplete surrogate pair. */
+							return false; /* Incomplete surrogate pair. */
 						if (!from_surrogate_pair(uc, lc, &unicode))
-							goto failed; /* Invalid surrogate pair. */
+							return false; /* Invalid surrogate pair. */
 					} else if (uc == 0) {
 						/* Disallow "\u0000". */
-						goto failed;
+						return false;
 					} else {
 						unicode = uc;
 					}
 
+					/* at most 4 bytes written for the 6 or 12 read */
 					b += utf8_write_char(unicode, b);
 					break;
 				}
 				default:
 					/* Invalid escape */
-					goto failed;
+					return false;
 			}
 		} else if (c <= 0x1F) {
 			/* Control characters are not allowed in string literals. */
-			goto failed;
+			return false;
+		} else if (c < 0x80) {
+			*b++ = *s++;
 		} else {
 			/* Validate and echo a UTF-8 character. */
-			int len;
-
-			s--;
-			len = utf8_validate_cz(s);
-			if (len == 0)
-				goto failed; /* Invalid UTF-8 character. */
+			int n = utf8_validate_cz(s);
+			if (n == 0)
+				return false; /* Invalid UTF-8 character. */
 
-			while (len--)
+			while (n--)
 				*b++ =  *s++;
 		}
-
-		/*
-		 * Update sb to know about the new bytes,
-		 * and set up b to write another character.
-		 */
-		if (out) {
-			sb.cur = b;
-			sb_need(&sb, 4);
-			b = sb.cur;
-		} else {
-			b = throwaway_buffer;
-		}
 	}
 	s++;
 
-	if (out)
-		*out = sb_finish(&sb);
+	*b = '\0';
+	*out = start;
+	*len = (uint32_t) (b - start);
 	*sp = s;
 	return true;
-
-failed:
-	if (out)
-		sb_free(&sb);
-	return false;
 }
 
 /*
@@ -935,14 +884,28 @@ bool parse_number(const char **sp, double *out)
 	return true;
 }
 
-static void skip_space(const char **sp)
+static void skip_space(char **sp)
 {
-	const char *s = *sp;
+	char *s = *sp;
 	while (is_space(*s))
 		s++;
 	*sp = s;
 }
 
+/* Skips whitespace, jumping straight to the next structural if indexed. */
+static void skip_space(JsonCtx *ctx, char **sp)
+{
+	char *s = *sp;
+	if (ctx->index != nullptr && is_space(*s)) {
+		size_t off = s - ctx->base;
+		while (ctx->cur < ctx->nindex && ctx->index[ctx->cur] < off)
+			ctx->cur++;
+		s = ctx->cur < ctx->nindex? ctx->base + ctx->index[ctx->cur] : ctx->end;
+	}
+	skip_space(&s);
+	*sp = s;
+}
+
 static void emit_value(iod::encode_stream& out, const JsonNode *node)
 {
 	assert(tag_is_valid(node->tag));
@@ -954,7 +917,7 @@ static void emit_value(iod::encode_stream& out, const JsonNode *node)
 			out << (node->bool_ ? "true" : "false");
 			break;
 		case JSON_STRING:
-			emit_string(out, node->string_);
+			emit_string(out, node->string_, node->len);
 			break;
 		case JSON_NUMBER:
 			emit_number(out, node->number_);
@@ -984,7 +947,7 @@ void emit_value_indented(iod::encode_stream& out, const JsonNode *node, const ch
 			out << (node->bool_ ? "true" : "false");
 			break;
 		case JSON_STRING:
-			emit_string(out, node->string_);
+			emit_string(out, node->string_, node->len);
 			break;
 		case JSON_NUMBER:
 			emit_number(out, node->number_);
@@ -1002,182 +965,114 @@ void emit_value_indented(iod::encode_stream& out, const JsonNode *node, const ch
 
 static void emit_array(iod::encode_stream& out, const JsonNode *array)
 {
-	const JsonNode *element;
-
 	out << '[';
-	json_foreach(element, array) {
-		emit_value(out, element);
-		if (element->next != nullptr)
+	for (uint32_t i = 0; i < array->len; i++) {
+		if (i != 0)
 			out << ',';
+		emit_value(out, array->children.items[i]);
 	}
 	out << ']';
 }
 
 static void emit_array_indented(iod::encode_stream& out, const JsonNode *array, const char *space, int indent_level)
 {
-	const JsonNode *element = array->children.head;
 	int i;
 
-	if (element == nullptr) {
+	if (array->len == 0) {
 		out << "[]";
 		return;
 	}
 
 	out << "[\n";
-	while (element != nullptr) {
+	for (uint32_t e = 0; e < array->len; e++) {
 		for (i = 0; i < indent_level + 1; i++)
 			out << space;
-		emit_value_indented(out, element, space, indent_level + 1);
+		emit_value_indented(out, array->children.items[e], space, indent_level + 1);
 
-		element = element->next;
-		out << (element != nullptr ? ",\n" : "\n");
+		out << ((e + 1) < array->len ? ",\n" : "\n");
 	}
 	for (i = 0; i < indent_level; i++)
 		out << space;
 	out << ']';
 }
 
-static void emit_object(iod::encode_stream& out, const JsonNode *object)
+/* the size of the encoding of @node assuming numbers take 8 bytes and
+ * strings need no escaping */
+static size_t estimate_value(const JsonNode *node)
 {
-	const JsonNode *member;
+	size_t n;
+
+	switch (node->tag) {
+		case JSON_NULL:
+			return 4;
+		case JSON_BOOL:
+			return 5;
+		case JSON_STRING:
+			return node->len + 2;
+		case JSON_NUMBER:
+			return 8;
+		case JSON_ARRAY:
+		case JSON_OBJECT:
+			n = 2 + node->len;
+			for (uint32_t i = 0; i < node->len; i++) {
+				const JsonNode *child = node->children.items[i];
+				if (node->tag == JSON_OBJECT)
+					n += strlen(child->key) + 3;
+				n += estimate_value(child);
+			}
+			return n;
+		default:
+			return 0;
+	}
+}
 
+static void emit_object(iod::encode_stream& out, const JsonNode *object)
+{
 	out << '{';
-	json_foreach(member, object) {
-		emit_string(out, member->key);
+	for (uint32_t i = 0; i < object->len; i++) {
+		const JsonNode *member = object->children.items[i];
+		if (i != 0)
+			out << ',';
+		emit_string(out, member->key, strlen(member->key));
 		out << ':';
 		emit_value(out, member);
-		if (member->next != nullptr)
-			out << ',';
 	}
 	out << '}';
 }
 
 static void emit_object_indented(iod::encode_stream& out, const JsonNode *object, const char *space, int indent_level)
 {
-	const JsonNode *member = object->children.head;
 	int i;
 
-	if (member == nullptr) {
+	if (object->len == 0) {
 		out << "{}";
 		return;
 	}
 
 	out << "{\n";
-	while (member != nullptr) {
+	for (uint32_t m = 0; m < object->len; m++) {
+		const JsonNode *member = object->children.items[m];
 		for (i = 0; i < indent_level + 1; i++)
 			out << space;
-		emit_string(out, member->key);
+		emit_string(out, member->key, strlen(member->key));
 		out << ": ";
 		emit_value_indented(out, member, space, indent_level + 1);
 
-		member = member->next;
-		out << (member != nullptr ? ",\n" : "\n");
+		out << ((m + 1) < object->len ? ",\n" : "\n");
 	}
 	for (i = 0; i < indent_level; i++)
 		out << space;
 	out << '}';
 }
 
-void emit_string(iod::encode_stream& out, const char *str)
+void emit_string(iod::encode_stream& out, const char *str, size_t len)
 {
-	bool escape_unicode = false;
-	const char *s = str;
-
-	if (!utf8_validate(str))
+	if (!utf8_validate(str, len))
 		throw suil::Exception::create("'", str, "' is not a valid utf8 string");
 
-	out << '"';
-	while (*s != 0) {
-		unsigned char c = *s++;
-
-		/* Encode the next character, and write it to b. */
-		switch (c) {
-			case '"':
-				out <<  '\\';
-				out <<  '"';
-				break;
-			case '\\':
-				out <<  '\\';
-				out <<  '\\';
-				break;
-			case '\b':
-				out <<  '\\';
-				out <<  'b';
-				break;
-			case '\f':
-				out <<  '\\';
-				out <<  'f';
-				break;
-			case '\n':
-				out <<  '\\';
-				out <<  'n';
-				break;
-			case '\r':
-				out <<  '\\';
-				out <<  'r';
-				break;
-			case '\t':
-				out <<  '\\';
-				out <<  't';
-				break;
-			default: {
-				int len;
-
-				s--;
-				len = utf8_validate_cz(s);
-
-				if (len == 0) {
-					/*
-					 * Handle invalid UTF-8 character gracefully in production
-					 * by writing a replacement character (U+FFFD)
-					 * and skipping a single byte.
-					 *
-					 * This should never happen when assertions are enabled
-					 * due to the assertion at the beginning of this function.
-					 */
-					assert(false);
-					if (escape_unicode) {
-						out << "\\uFFFD";
-					} else {
-						out <<  0xEF;
-						out <<  0xBF;
-						out <<  0xBD;
-					}
-					s++;
-				} else if (c < 0x1F || (c >= 0x80 && escape_unicode)) {
-					/* Encode using \u.... */
-					uint32_t unicode;
-
-					s += utf8_read_char(s, &unicode);
-
-					if (unicode <= 0xFFFF) {
-						out <<  '\\';
-						out <<  'u';
-						write_hex16(out, unicode);
-					} else {
-						/* Produce a surrogate pair. */
-						uint16_t uc, lc;
-						if (unicode > 0x10FFFF)
-						    throw suil::Exception::create("'...", s, "' is not a valid unicode string");
-						to_surrogate_pair(unicode, &uc, &lc);
-						out <<  '\\';
-						out <<  'u';
-						write_hex16(out, uc);
-						out <<  '\\';
-						out <<  'u';
-						write_hex16(out, lc);
-					}
-				} else {
-					/* Write the character directly. */
-					while (len--)
-						out << *s++;
-				}
-
-				break;
-			}
-		}
-	}
-	out <<  '"';
+	/* UTF-8 is written as is, only quotes, backslashes and control characters
+	 * are escaped, runs of other bytes are copied at once */
+	iod::json_internals::json_escape_(str, len, out);
 }
 
 static void emit_number(iod::encode_stream& out, double num)
@@ -1189,10 +1084,11 @@ static void emit_number(iod::encode_stream& out, double num)
 	 * like 0.3 -> 0.299999999999999988898 .
 	 */
 	char buf[64];
-	sprintf(buf, "%.16g", num);
-	
-	if (number_is_valid(buf))
-		out << num;
+	int n = snprintf(buf, sizeof(buf), "%.16g", num);
+
+	/* the validated text is what gets written, the number is not formatted twice */
+	if (n > 0 && number_is_valid(buf))
+		out << iod::stringview(buf, n);
 	else
 		out << "null";
 }
@@ -1207,9 +1103,9 @@ static bool number_is_valid(const char *num)
 	return (parse_number(&num, nullptr) && *num == '\0');
 }
 
-static bool expect_literal(const char **sp, const char *str)
+static bool expect_literal(char **sp, const char *str)
 {
-	const char *s = *sp;
+	char *s = *sp;
 	
 	while (*str != '\0')
 		if (*s++ != *str++)
@@ -1223,9 +1119,9 @@ static bool expect_literal(const char **sp, const char *str)
  * Parses exactly 4 hex characters (capital or lowercase).
  * Fails if any input chars are not [0-9A-Fa-f].
  */
-static bool parse_hex16(const char **sp, uint16_t *out)
+static bool parse_hex16(char **sp, uint16_t *out)
 {
-	const char *s = *sp;
+	char *s = *sp;
 	uint16_t ret = 0;
 	uint16_t i;
 	uint16_t tmp;
@@ -1256,88 +1152,6 @@ static bool parse_hex16(const char **sp, uint16_t *out)
  * Encodes a 16-bit number into hexadecimal,
  * writing exactly 4 hex chars.
  */
-static int write_hex16(iod::encode_stream& out, uint16_t val)
-{
-	const char *hex = "0123456789ABCDEF";
-	
-	out.append(hex[(val >> 12) & 0xF]);
-	out.append(hex[(val >> 8)  & 0xF]);
-	out.append(hex[(val >> 4)  & 0xF]);
-	out.append(hex[ val        & 0xF]);
-	
-	return 4;
-}
-
-bool json_check(const JsonNode *node, char errmsg[256])
-{
-	#define problem(...) do { \
-			if (errmsg != nullptr) \
-				snprintf(errmsg, 256, __VA_ARGS__); \
-			return false; \
-		} while (0)
-	
-	if (node->key != nullptr && !utf8_validate(node->key))
-		problem("key contains invalid UTF-8");
-	
-	if (!tag_is_valid(node->tag))
-		problem("tag is invalid (%u)", node->tag);
-	
-	if (node->tag == JSON_BOOL) {
-		if (node->bool_ != false && node->bool_ != true)
-			problem("bool_ is neither false (%d) nor true (%d)", (int)false, (int)true);
-	} else if (node->tag == JSON_STRING) {
-		if (node->string_ == nullptr)
-			problem("string_ is nullptr");
-		if (!utf8_validate(node->string_))
-			problem("string_ contains invalid UTF-8");
-	} else if (node->tag == JSON_ARRAY || node->tag == JSON_OBJECT) {
-		JsonNode *head = node->children.head;
-		JsonNode *tail = node->children.tail;
-		
-		if (head == nullptr || tail == nullptr) {
-			if (head != nullptr)
-				problem("tail is nullptr, but head is not");
-			if (tail != nullptr)
-				problem("head is nullptr, but tail is not");
-		} else {
-			JsonNode *child;
-			JsonNode *last = nullptr;
-			
-			if (head->prev != nullptr)
-				problem("First child's prev pointer is not nullptr");
-			
-			for (child = head; child != nullptr; last = child, child = child->next) {
-				if (child == node)
-					problem("node is its own child");
-				if (child->next == child)
-					problem("child->next == child (cycle)");
-				if (child->next == head)
-					problem("child->next == head (cycle)");
-				
-				if (child->parent != node)
-					problem("child does not point back to parent");
-				if (child->next != nullptr && child->next->prev != child)
-					problem("child->next does not point back to child");
-				
-				if (node->tag == JSON_ARRAY && child->key != nullptr)
-					problem("Array element's key is not nullptr");
-				if (node->tag == JSON_OBJECT && child->key == nullptr)
-					problem("Object member's key is nullptr");
-				
-				if (!json_check(child, errmsg))
-					return false;
-			}
-			
-			if (last != tail)
-				problem("tail does not match pointer found by starting at head and following next links");
-		}
-	}
-	
-	return true;
-	
-	#undef problem
-}
-
 namespace {
 
     int luaEnv(lua_State *L) {
@@ -1369,62 +1183,100 @@ namespace {
 
 namespace suil::json {
 
+    /* documents of standalone scalars are never extended */
+    static JsonDoc *mkdoc(size_t block = 64) {
+        return new JsonDoc(block);
+    }
+
+    static JsonDoc *mkcontainer(JsonTag tag) {
+        auto *doc = mkdoc(1024);
+        doc->root.tag = tag;
+        return doc;
+    }
+
     Object::Object()
-        : mNode(mknode(JsonTag::JSON_NULL))
+        : mNode(&json_null)
     {}
 
     Object::Object(bool b)
-        : mNode(json_mkbool(b))
-    {}
+        : mDoc(mkdoc())
+    {
+        mNode = &mDoc->root;
+        mNode->tag = JSON_BOOL;
+        mNode->bool_ = b;
+    }
 
     Object::Object(double d)
-        : mNode(json_mknumber(d))
-    {}
+        : mDoc(mkdoc())
+    {
+        mNode = &mDoc->root;
+        mNode->tag = JSON_NUMBER;
+        mNode->number_ = d;
+    }
 
     Object::Object(const char *str)
-        : mNode(json_mkstring(str))
-    {}
+        : mDoc(mkdoc())
+    {
+        mNode = &mDoc->root;
+        mkstring(mDoc->arena, mNode, str, strlen(str));
+    }
 
     Object::Object(const suil::String &str)
-        : mNode(json_mknstring(str.data(), str.size()))
-    {}
+        : mDoc(mkdoc())
+    {
+        mNode = &mDoc->root;
+        mkstring(mDoc->arena, mNode, str.data(), str.size());
+    }
 
     Object::Object(const std::string &str)
-        : mNode(json_mknstring(str.data(), str.size()))
-    {}
+        : mDoc(mkdoc())
+    {
+        mNode = &mDoc->root;
+        mkstring(mDoc->arena, mNode, str.data(), str.size());
+    }
 
     Object::Object(suil::json::Array_t)
-        : mNode(json_mkarray())
-    {}
+        : mDoc(mkcontainer(JSON_ARRAY))
+    {
+        mNode = &mDoc->root;
+    }
 
     Object::Object(suil::json::Object_t)
-        : mNode(json_mkobject())
-    {}
+        : mDoc(mkcontainer(JSON_OBJECT))
+    {
+        mNode = &mDoc->root;
+    }
 
     void Object::push(suil::json::Object &&o) {
         if (mNode == nullptr || mNode->tag != JsonTag::JSON_ARRAY)
             throw Exception::create("json::Object::push - object is not a JSON array");
-        json_append_element(mNode, o.mNode);
-        o.ref = true;
+        // the value is copied into this document, the moved object
+        // becomes a reference to the copy
+        JsonNode *node = child_node(mDoc->arena, mNode, nullptr, 0);
+        assign_node(mDoc->arena, node, o.mNode? o.mNode : &json_null);
+        o = Object(node, mDoc, true);
     }
 
     void Object::set(const char *key, suil::json::Object &&o) {
         if (mNode == nullptr || mNode->tag != JsonTag::JSON_OBJECT)
             throw Exception::create("json::Object::set - object is not a JSON object");
-        json_append_member(mNode, key, o.mNode);
-        o.ref = true;
+        // an existing member is overwritten in place
+        JsonNode *node = member_node(mDoc->arena, mNode, key);
+        assign_node(mDoc->arena, node, o.mNode? o.mNode : &json_null);
+        o = Object(node, mDoc, true);
     }
 
     Object Object::operator[](int index) const {
         if (mNode == nullptr || mNode->tag != JsonTag::JSON_ARRAY)
             throw Exception::create("json::Object::[index] - object is not a JSON array");
-        Object obj(json_find_element(mNode, index));
-        return obj;
+        if (index < 0 || (uint32_t) index >= mNode->len)
+            return Object(nullptr, mDoc);
+        return Object(mNode->children.items[index], mDoc);
     }
 
     Object Object::operator()(const char *key, bool throwNotFound) const {
         const char *s = key, *p = key;
-        Object obj{mNode};
+        Object obj{mNode, mDoc};
         while ((p = strchr(s, '.')) != nullptr) {
             String part{s, (size_t)(p-s), false};
             obj = obj.get(part, throwNotFound);
@@ -1456,8 +1308,9 @@ namespace suil::json {
                 return Object{nullptr};
         }
 
-        Object obj(json_find_member(mNode, key.data(), key.size()));
-        return obj;
+        // large objects are indexed on the key's hash, which is cached in the key
+        size_t hash = mNode->len < SUIL_JSON_INDEX_MIN? 0 : key.hash();
+        return Object(find_member(mDoc->arena, mNode, key.data(), key.size(), hash), mDoc);
     }
 
     Object::operator bool()   const {
@@ -1479,11 +1332,11 @@ namespace suil::json {
     bool Object::empty() const {
         if (mNode == nullptr || mNode->tag == JsonTag::JSON_NULL) return true;
         if (mNode->tag == JsonTag::JSON_STRING)
-            return mNode->string_? strlen(mNode->string_) == 0 : true;
+            return mNode->len == 0;
         if (mNode->tag == JsonTag::JSON_BOOL)
 			return !mNode->bool_;
         if (mNode->tag == JsonTag::JSON_OBJECT || mNode->tag == JsonTag::JSON_ARRAY)
-            return mNode->children.head == nullptr;
+            return mNode->len == 0;
 
         return false;
     }
@@ -1518,11 +1371,10 @@ namespace suil::json {
         if (mNode == nullptr || mNode->tag != JsonTag::JSON_ARRAY)
             /* valid node */
             throw Exception::create("json::Object::push - object is not a JSON array");
-        /* create array node and append it */
-        Object o(json::Arr);
-        json_append_element(mNode, o.mNode);
-        o.ref = true;
-        return o;
+        /* append an empty array, a recycled node keeps its child array */
+        JsonNode *node = child_node(mDoc->arena, mNode, nullptr, 0);
+        reset_container(node, JSON_ARRAY);
+        return Object(node, mDoc, true);
     }
 
     Object Object::push(const suil::json::Object_t&) {
@@ -1530,61 +1382,90 @@ namespace suil::json {
             /* valid node */
             throw Exception::create("json::Object::push - object is not a JSON array");
 
-        /* create array node and append it */
-        Object o(json::Obj);
-        json_append_element(mNode, o.mNode);
-        o.ref = true;
-        return o;
+        /* append an empty object, a recycled node keeps its child array */
+        JsonNode *node = child_node(mDoc->arena, mNode, nullptr, 0);
+        reset_container(node, JSON_OBJECT);
+        return Object(node, mDoc, true);
     }
 
     Object Object::set(const char *key, const suil::json::Object_t &) {
         if (mNode == nullptr || mNode->tag != JsonTag::JSON_OBJECT)
             /* valid node */
             throw Exception::create("json::Object::set - object is not a JSON object");
-        /* create array node and append it */
-        Object o(json::Obj);
-        json_append_member(mNode, key, o.mNode);
-        o.ref = true;
-        return o;
+        /* an existing member is emptied, reusing its child array */
+        JsonNode *node = member_node(mDoc->arena, mNode, key);
+        reset_container(node, JSON_OBJECT);
+        return Object(node, mDoc, true);
     }
 
     Object Object::set(const char *key, const suil::json::Array_t &) {
         if (mNode == nullptr || mNode->tag != JsonTag::JSON_OBJECT)
             /* valid node */
             throw Exception::create("json::Object::set - object is not a JSON object");
-        /* create array node and append it */
-        Object o(json::Arr);
-        json_append_member(mNode, key, o.mNode);
-        o.ref = true;
-        return o;
+        /* an existing member is emptied, reusing its child array */
+        JsonNode *node = member_node(mDoc->arena, mNode, key);
+        reset_container(node, JSON_ARRAY);
+        return Object(node, mDoc, true);
     }
 
     void Object::encode(iod::encode_stream &ss) const {
         /* encode json object */
-        emit_value(ss, mNode);
+        emit_value(ss, mNode? mNode : &json_null);
     }
 
-    Object Object::decode(const char *str, size_t& sz) {
-        JsonNode *ret;
-        const char *s = str;
-        skip_space(&s);
-        if (!parse_value(&s, &ret)) {
+    size_t Object::estimate() const {
+        return estimate_value(mNode? mNode : &json_null);
+    }
+
+    /* decodes @str, of @sz bytes, in place into @doc, returns the number of bytes consumed */
+    static size_t decode_doc(JsonDoc *doc, char *str, size_t sz) {
+        static thread_local std::vector<JsonNode> stack{};
+        static thread_local std::vector<uint32_t> structurals{};
+        JsonCtx ctx{&doc->arena, &stack, nullptr, 0, 0, str, str + sz};
+        char *s = str;
+
+        stack.clear();
+        if (sz >= SUIL_JSON_STRUCTURALS_MIN && simd::jsonindex(str, sz, structurals)) {
+            // documents which fail to index (invalid UTF-8, unterminated strings...)
+            // are decoded byte by byte, to report where they are invalid
+            ctx.index = structurals.data();
+            ctx.nindex = structurals.size();
+        }
+
+        skip_space(&ctx, &s);
+        if (!parse_value(&ctx, &s, &doc->root)) {
             /* parsing json string failed */
             throw Exception::create("json::Object::decode invalid json string at ", (s-str));
         }
 
-        skip_space(&s);
-        sz = s-str;
-        return Object(ret, false);
+        skip_space(&ctx, &s);
+        return s-str;
+    }
+
+    Object Object::decode(const char *str, size_t& sz) {
+        std::unique_ptr<JsonDoc> doc(mkdoc(json_doc_block(sz)));
+        // the input is copied into the document and decoded in place
+        sz = decode_doc(doc.get(), doc->arena.strndup(str, sz), sz);
+        auto *d = doc.release();
+        return Object(&d->root, d, false);
+    }
+
+    Object Object::decode(char *str, size_t& sz, bool insitu) {
+        if (!insitu)
+            return Object::decode((const char *) str, sz);
+
+        std::unique_ptr<JsonDoc> doc(mkdoc(json_doc_block(sz)));
+        sz = decode_doc(doc.get(), str, sz);
+        auto *d = doc.release();
+        return Object(&d->root, d, false);
     }
 
     void Object::operator|(suil::json::Object::ArrayEnumerator f) const {
         if (mNode == nullptr || mNode->tag != JsonTag::JSON_ARRAY)
             /* valid node */
             throw Exception::create("json::Object::enumerate - object is not a JSON array");
-        JsonNode *node{nullptr};
-        json_foreach(node, mNode) {
-            if (f(Object(node, true)))
+        for (uint32_t i = 0; i < mNode->len; i++) {
+            if (f(Object(mNode->children.items[i], mDoc, true)))
                 break;
         }
     }
@@ -1594,9 +1475,9 @@ namespace suil::json {
             /* valid node */
             throw Exception::create("json::Object::enumerate - object is not a JSON object");
 
-        JsonNode *node{nullptr};
-        json_foreach(node, mNode) {
-            if (f(node->key, Object(node, true)))
+        for (uint32_t i = 0; i < mNode->len; i++) {
+            JsonNode *node = mNode->children.items[i];
+            if (f(node->key, Object(node, mDoc, true)))
                 break;
         }
     }
@@ -1613,7 +1494,7 @@ namespace suil::json {
                 return String{other.mNode->string_} == String{Ego.mNode->string_};
             case JSON_ARRAY: {
                 auto ai = Ego.begin();
-                auto bi = other.end();
+                auto bi = other.begin();
                 while (ai != Ego.end()) {
                     if (bi == other.end()) return  false;
                     if (!((*ai).second == (*bi).second)) return false;
@@ -1639,34 +1520,48 @@ namespace suil::json {
     }
 
     Object::iterator Object::iterator::operator++() {
-    	if (mNode)
-    		mNode = mNode->next;
+    	if (mPos)
+    		mPos++;
     	return Ego;
     }
 
     const std::pair<const char*,Object> Object::iterator::operator*() const {
-    	return std::make_pair(mNode? mNode->key:nullptr, Object(mNode));
+    	return std::make_pair((*mPos)->key, Object(*mPos, mDoc));
     }
 
     Object::iterator Object::begin() {
     	if (Ego.isArray() || Ego.isObject())
-    		return iterator(mNode->children.head);
+    		return iterator(mNode->children.items, mDoc);
     	return end();
     }
 
+    Object::iterator Object::end() {
+    	if (Ego.isArray() || Ego.isObject())
+    		return iterator(mNode->children.items + mNode->len, mDoc);
+    	return iterator(nullptr, mDoc);
+    }
+
     Object::const_iterator Object::begin() const {
 		if (Ego.isArray() || Ego.isObject())
-			return const_iterator(mNode->children.head);
+			return const_iterator(mNode->children.items, mDoc);
 		return end();
     }
 
+    Object::const_iterator Object::end() const {
+		if (Ego.isArray() || Ego.isObject())
+			return const_iterator(mNode->children.items + mNode->len, mDoc);
+		return const_iterator(nullptr, mDoc);
+    }
+
     Object& Object::operator=(suil::json::Object &&o) noexcept {
 		if (this != &o) {
-			if (mNode && !ref)
-				json_delete(mNode);
+			if (mDoc && !ref)
+				delete mDoc;
 			mNode = o.mNode;
+			mDoc = o.mDoc;
 			ref = o.ref;
 			o.mNode = nullptr;
+			o.mDoc = nullptr;
 		}
 		return Ego;
 	}
@@ -1794,14 +1689,16 @@ namespace suil::json {
     }
 
     Object::~Object() {
-        if (mNode && !ref)
-            json_delete(mNode);
+        if (mDoc && !ref)
+            delete mDoc;
         mNode = nullptr;
+        mDoc = nullptr;
     }
 }
 
 #ifdef unit_test
 #include <catch/catch.hpp>
+#include <chrono>
 #include "tests/test_symbols.h"
 
 using namespace suil;
@@ -1842,13 +1739,70 @@ struct Mt : iod::MetaType
     static Mt fromJson(iod::json::parser& p)
 	{
     	Mt tmp;
+    	p >> p.spaces >> '{';
     	iod::json::iod_attr_from_json(&Mt::Meta, tmp, p);
+    	p >> p.spaces >> '}';
     	return std::move(tmp);
 	}
 };
 
 Mt::Schema Mt::Meta{};
 
+/* the type scc generates, and tests/scc_account.inc its JSON codec, for
+ *
+ *  meta Account {
+ *      int64_t id;
+ *      String name;
+ *      String email;
+ *      [[optional, ignore]]
+ *      String phone;
+ *      [[json_skip]]
+ *      String token;
+ *      bool active;
+ *      double balance;
+ *      std::vector<String> roles;
+ *      [[optional]]
+ *      std::vector<int> scores;
+ *  };
+ */
+struct Account : iod::MetaType
+{
+    typedef decltype(iod::D(
+        tprop(id,                                 int64_t),
+        tprop(name,                               String),
+        tprop(email,                              String),
+        tprop(phone(var(optional), var(ignore)),  String),
+        tprop(token(var(json_skip)),              String),
+        tprop(active,                             bool),
+        tprop(balance,                            double),
+        tprop(roles,                              std::vector<String>),
+        tprop(scores(var(optional)),              std::vector<int>)
+    )) Schema;
+    static Schema Meta;
+
+    static Account fromJson(iod::json::parser&);
+
+    void toJson(iod::json::jstream&) const;
+
+    int64_t             id;
+    String              name;
+    String              email;
+    String              phone;
+    String              token;
+    bool                active;
+    double              balance;
+    std::vector<String> roles;
+    std::vector<int>    scores;
+};
+
+Account::Schema Account::Meta{};
+
+#include "tests/scc_account.inc"
+
+static JsonNode *jsonChild(const JsonNode *parent, uint32_t i) {
+    return i < parent->len? parent->children.items[i] : nullptr;
+}
+
 TEST_CASE("suil::json::Object", "[json][Object]")
 {
     SECTION("Constructing a JSON Object") {
@@ -1890,27 +1844,27 @@ TEST_CASE("suil::json::Object", "[json][Object]")
         json::Object arr(json::Arr);
         REQUIRE(arr.mNode->tag == JsonTag::JSON_ARRAY);
         REQUIRE_FALSE(arr.ref);
-        REQUIRE(arr.mNode->children.head == nullptr);
+        REQUIRE(arr.mNode->len == 0);
 
         json::Object arr2(json::Arr, 1, 2, "Carter", true, json::Object(json::Arr, "Hello", 4, "Worlds"));
         REQUIRE(arr2.mNode->tag == JsonTag::JSON_ARRAY);
         REQUIRE_FALSE(arr2.ref);
-        REQUIRE_FALSE(arr2.mNode->children.head == nullptr);
+        REQUIRE_FALSE(arr2.mNode->len == 0);
 
         json::Object arr3(json::Arr, std::vector<int>{1, 2, 4});
         REQUIRE(arr3.mNode->tag == JsonTag::JSON_ARRAY);
         REQUIRE_FALSE(arr3.ref);
-        REQUIRE_FALSE(arr3.mNode->children.head == nullptr);
+        REQUIRE_FALSE(arr3.mNode->len == 0);
 
         json::Object obj(json::Obj);
         REQUIRE(obj.mNode->tag == JsonTag::JSON_OBJECT);
         REQUIRE_FALSE(obj.ref);
-        REQUIRE(obj.mNode->children.head == nullptr);
+        REQUIRE(obj.mNode->len == 0);
 
         json::Object obj2(json::Obj, "name", "Carter", "age", 29);
         REQUIRE(obj2.mNode->tag == JsonTag::JSON_OBJECT);
         REQUIRE_FALSE(obj2.ref);
-        REQUIRE_FALSE(obj2.mNode->children.head == nullptr);
+        REQUIRE_FALSE(obj2.mNode->len == 0);
     }
 
     SECTION("assigning/moving json objects") {
@@ -1953,21 +1907,21 @@ TEST_CASE("suil::json::Object", "[json][Object]")
             REQUIRE_FALSE(j1.mNode == nullptr);
             REQUIRE_FALSE(j1.mNode == node);
             REQUIRE(j1.mNode->tag == JsonTag::JSON_ARRAY);
-            REQUIRE_FALSE(j1.mNode->children.head == nullptr);
+            REQUIRE_FALSE(j1.mNode->len == 0);
             node = j1.mNode;
 
             j1 = json::Object(json::Arr);
             REQUIRE_FALSE(j1.mNode == nullptr);
             REQUIRE_FALSE(j1.mNode == node);
             REQUIRE(j1.mNode->tag == JsonTag::JSON_ARRAY);
-            REQUIRE(j1.mNode->children.head == nullptr);
+            REQUIRE(j1.mNode->len == 0);
             node = j1.mNode;
 
             j1 = json::Object(json::Obj, "One", 1);
             REQUIRE_FALSE(j1.mNode == nullptr);
             REQUIRE_FALSE(j1.mNode == node);
             REQUIRE(j1.mNode->tag == JsonTag::JSON_OBJECT);
-            REQUIRE_FALSE(j1.mNode->children.head == nullptr);
+            REQUIRE_FALSE(j1.mNode->len == 0);
         }
 
         WHEN("copying or moving JSON object") {
@@ -2030,47 +1984,51 @@ TEST_CASE("suil::json::Object", "[json][Object]")
         /* test adding values to arrays or objects */
         WHEN("adding values to an array") {
             /* initializing and adding values to arrays */
-            JsonNode *node{nullptr};
+            JsonNode *node{nullptr}, *parent{nullptr};
+            uint32_t idx{0};
             json::Object arr(json::Arr);
             arr.push(1);
-            node = json_first_child(arr.mNode);
+            parent = arr.mNode; idx = 0;
+            node = jsonChild(parent, idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_NUMBER);
             REQUIRE(node->number_ == 1);
 
             arr.push(true, 67.9, "Cali", json::Object(json::Arr), json::Object(json::Obj));
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_BOOL);
             REQUIRE(node->bool_);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_NUMBER);
             REQUIRE(node->number_ == 67.9);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_STRING);
             REQUIRE(strcmp(node->string_, "Cali") == 0);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_ARRAY);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_OBJECT);
-            REQUIRE(node->next == nullptr);
+            REQUIRE(jsonChild(parent, idx+1) == nullptr);
             arr = json::Object(json::Arr, 1, json::Object(json::Arr, 10, true));
-            node = json_first_child(arr.mNode);
+            parent = arr.mNode; idx = 0;
+            node = jsonChild(parent, idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_NUMBER);
             REQUIRE(node->number_ == 1);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_ARRAY);
-            node = json_first_child(node);
+            parent = node; idx = 0;
+            node = jsonChild(parent, idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_NUMBER);
             REQUIRE(node->number_ == 10);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_BOOL);
             REQUIRE(node->bool_);
@@ -2088,65 +2046,69 @@ TEST_CASE("suil::json::Object", "[json][Object]")
 
         WHEN("adding values to an object") {
             /* test adding values to an object */
-            JsonNode *node{nullptr};
+            JsonNode *node{nullptr}, *parent{nullptr};
+            uint32_t idx{0};
             json::Object obj(json::Obj);
             obj.set("one", 1);
-            node = json_first_child(obj.mNode);
+            parent = obj.mNode; idx = 0;
+            node = jsonChild(parent, idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_NUMBER);
             REQUIRE(strcmp(node->key, "one") == 0);
             REQUIRE(node->number_ == 1);
             obj.set("two", 2, "bool", true, "str", "Cali", "arr", json::Object(json::Arr), "obj", json::Object(json::Obj));
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_NUMBER);
             REQUIRE(strcmp(node->key, "two") == 0);
             REQUIRE(node->number_ == 2);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_BOOL);
             REQUIRE(strcmp(node->key, "bool") == 0);
             REQUIRE(node->bool_);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_STRING);
             REQUIRE(strcmp(node->key, "str") == 0);
             REQUIRE(strcmp(node->string_, "Cali") == 0);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_ARRAY);
             REQUIRE(strcmp(node->key, "arr") == 0);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_OBJECT);
             REQUIRE(strcmp(node->key, "obj") == 0);
-            REQUIRE(node->next == nullptr);
+            REQUIRE(jsonChild(parent, idx+1) == nullptr);
             obj = json::Object(json::Obj, "one", 1, "bool", true, "obj", json::Object(json::Obj, "two", 2, "str", "Cali"));
-            node = json_first_child(obj.mNode);
+            parent = obj.mNode; idx = 0;
+            node = jsonChild(parent, idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_NUMBER);
             REQUIRE(strcmp(node->key, "one") == 0);
             REQUIRE(node->number_ == 1);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_BOOL);
             REQUIRE(strcmp(node->key, "bool") == 0);
             REQUIRE(node->bool_);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_OBJECT);
             REQUIRE(strcmp(node->key, "obj") == 0);
-            node = json_first_child(node);
+            parent = node; idx = 0;
+            node = jsonChild(parent, idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_NUMBER);
             REQUIRE(strcmp(node->key, "two") == 0);
             REQUIRE(node->number_ == 2);
-            node = node->next;
+            node = jsonChild(parent, ++idx);
             REQUIRE_FALSE(node == nullptr);
             REQUIRE(node->tag == JsonTag::JSON_STRING);
             REQUIRE(strcmp(node->key, "str") == 0);
             REQUIRE(strcmp(node->string_, "Cali") == 0);
-            REQUIRE(node->next == nullptr);
+            REQUIRE(jsonChild(parent, idx+1) == nullptr);
 
             obj = json::Object();
             REQUIRE_THROWS(obj.push(5)); // cannot insert into a json object
@@ -2157,6 +2119,42 @@ TEST_CASE("suil::json::Object", "[json][Object]")
             obj = json::Object("Cali");
             REQUIRE_THROWS(obj.set("five", 5));
         }
+
+        WHEN("replacing the members of an object") {
+            json::Object obj(json::Obj);
+            obj.set("n", 1, "s", "Nairobi", "o", json::Object(json::Obj, "a", 1));
+            obj.set("n", 2, "s", "Kampala", "o", "Kigali");
+            REQUIRE(obj.mNode->len == 3);
+            REQUIRE((int) obj["n"] == 2);
+            REQUIRE(strcmp((const char *) obj["s"], "Kampala") == 0);
+            REQUIRE(strcmp((const char *) obj["o"], "Kigali") == 0);
+            obj.set("o", json::Arr).push(1, 2);
+            REQUIRE(obj["o"].isArray());
+            REQUIRE(obj.mNode->len == 3);
+
+            // a long lived document updating the same keys stops growing
+            size_t used{0};
+            for (int i = 0; i < 1000; i++) {
+                obj.set("n", i, "s", "Dodoma", "b", (i % 2) == 0);
+                obj.set("o", json::Arr).push(i, "x");
+                if (i == 10)
+                    used = obj.mDoc->arena.used();
+            }
+            REQUIRE(obj.mDoc->arena.used() == used);
+            REQUIRE(obj.mNode->len == 4);
+            REQUIRE((int) obj["n"] == 999);
+            REQUIRE(strcmp((const char *) obj["s"], "Dodoma") == 0);
+            REQUIRE(obj["o"].mNode->len == 2);
+
+            // indexed objects find the member to replace as well
+            json::Object big(json::Obj);
+            for (int i = 0; i < 64; i++)
+                big.set(utils::catstr("k", i)(), i);
+            for (int i = 0; i < 64; i++)
+                big.set(utils::catstr("k", i)(), i * 2);
+            REQUIRE(big.mNode->len == 64);
+            REQUIRE((int) big["k63"] == 126);
+        }
     }
 
     SECTION("index access operators on arrays/objects") {
@@ -2450,6 +2448,165 @@ TEST_CASE("suil::json::Object", "[json][Object]")
             auto s1 = json::encode(obj);
             REQUIRE(String(s1) == str);
     	}
+
+        WHEN("decoding json strings in-situ") {
+            OBuffer ob{};
+            ob << R"({"esc":"a\"b\u00e9c","arr":[1,{"k":"v"}],"s":"Cali"})";
+            auto size{ob.size()};
+            char *raw = (char *) ob;
+            auto obj = json::Object::decode(raw, size, true);
+            REQUIRE(size == ob.size());
+            // strings are unescaped in place and reference the buffer
+            auto tmp = obj["s"];
+            REQUIRE(tmp.mNode->string_ >= raw);
+            REQUIRE(tmp.mNode->string_ < (raw + ob.size()));
+            REQUIRE(tmp.mNode->len == 4);
+            REQUIRE(String("a\"b\xc3\xa9" "c") == (String) obj["esc"]);
+            REQUIRE(String("v") == (String) obj["arr"][1]["k"]);
+            // the children of a decoded container are contiguous
+            auto arr = obj["arr"];
+            REQUIRE((arr.mNode->children.items[0] + 1) == arr.mNode->children.items[1]);
+            REQUIRE(json::encode(obj) == "{\"esc\":\"a\\\"b\xc3\xa9" "c\",\"arr\":[1,{\"k\":\"v\"}],\"s\":\"Cali\"}");
+        }
+
+        WHEN("looking up members of large objects") {
+            json::Object obj(json::Obj);
+            for (int i = 0; i < 100; i++) {
+                auto key = utils::catstr("key", i);
+                obj.set(key(), i);
+            }
+            // setting an existing key replaces its value
+            obj.set("key10", 1000);
+            REQUIRE((int) obj["key99"] == 99);
+            REQUIRE(obj.mNode->children.index != nullptr);
+            REQUIRE((int) obj["key10"] == 1000);
+            REQUIRE(obj.mNode->len == 100);
+            REQUIRE(obj["key100"].isNull());
+            // appending after the index is built
+            for (int i = 100; i < 200; i++) {
+                auto key = utils::catstr("key", i);
+                obj.set(key(), i);
+            }
+            REQUIRE((int) obj["key100"] == 100);
+            REQUIRE((int) obj["key199"] == 199);
+
+            auto s1 = json::encode(obj);
+            auto size{s1.size()};
+            auto decoded = json::Object::decode(s1.data(), size);
+            REQUIRE(json::encode(decoded) == s1);
+            REQUIRE((int) decoded["key150"] == 150);
+            REQUIRE(decoded.mNode->children.index != nullptr);
+        }
+
+        WHEN("decoding large documents from their structural index") {
+            // pretty printed, escapes spanning 64 byte blocks
+            String pad(' ', 70);
+            auto str = utils::catstr("{\n", pad, "\"esc\" : \"", String('\\', 66), "\\\"x\",\n",
+                                     "  \"text\": \"h\xc3\xa9llo, [w:o{r}l]d\",", pad, "\n",
+                                     "  \"arr\" : [ 1 , -2.5e1,true,\tfalse, null , {\"k\" :\"v\"}, [] ]\n}");
+            REQUIRE(str.size() >= SUIL_JSON_STRUCTURALS_MIN);
+            auto size{str.size()};
+            auto obj = json::Object::decode(str.data(), size);
+            REQUIRE(size == str.size());
+            REQUIRE(((String) obj["esc"]).size() == 35);
+            REQUIRE(String("h\xc3\xa9llo, [w:o{r}l]d") == (String) obj["text"]);
+            REQUIRE(obj["arr"].mNode->len == 7);
+            REQUIRE(-25 == (int) obj["arr"][1]);
+            REQUIRE_FALSE((bool) obj["arr"][3]);
+            REQUIRE(String("v") == (String) obj["arr"][5]["k"]);
+            REQUIRE(json::encode(json::Object::decode(json::encode(obj))) == json::encode(obj));
+
+            // documents which can't be indexed are still decoded, or rejected, byte by byte
+            auto tail = utils::catstr(",\"", pad, "\"");
+            auto check = [&](const String& head, bool valid) {
+                auto doc = utils::catstr("[", head, tail, tail, tail, "]");
+                auto sz{doc.size()};
+                if (valid) {
+                    REQUIRE_NOTHROW(json::Object::decode(doc.data(), sz));
+                }
+                else {
+                    REQUIRE_THROWS(json::Object::decode(doc.data(), sz));
+                }
+            };
+            check("12", true);
+            check("12abc", false);
+            check("\"\xc3\x28\"", false);
+            check("\"a\tb\"", false);
+            check("\"\\\"", false);
+            // only the first value is decoded, trailing data is not validated
+            check("1], \"", true);
+
+            // the typed decoder uses the index too
+            typedef decltype(iod::D(
+                tprop(a,        std::string),
+                tprop(b,        String),
+                tprop(c,        json::Object),
+                tprop(d,        std::vector<int>)
+            )) Type;
+            auto s1 = utils::catstr("{ \"a\" : \"", pad, "\\\"q\\\"\",", pad, "\"b\":\"", pad, "\", \"c\" : { \"k\": [1, \"2\"] }  ,\n",
+                                    "\"d\":[1, 2,  3]}");
+            Type t;
+            json::decode(s1, t);
+            REQUIRE(t.a == utils::catstr(pad, "\"q\"")());
+            REQUIRE(t.b == pad);
+            REQUIRE(json::encode(t.c) == R"({"k":[1,"2"]})");
+            REQUIRE((t.d == std::vector<int>{1, 2, 3}));
+        }
+
+        WHEN("encoding straight into output buffers and sinks") {
+            typedef decltype(iod::D(
+                tprop(a,        std::string),
+                tprop(b,        double),
+                tprop(c,        int64_t),
+                tprop(d,        std::vector<int>)
+            )) Type;
+            Type t;
+            t.a = "say \"hi\"\t\x01";
+            t.b = 0.1;
+            t.c = -9007199254740993;
+            t.d = {1, 2, 3};
+            // strings are escaped, numbers read back to the same value
+            auto s1 = json::encode(t);
+            REQUIRE(s1 == R"({"a":"say \"hi\"\t\u0001","b":0.1,"c":-9007199254740993,"d":[1,2,3]})");
+            REQUIRE(json::encode(json::Object(json::Arr, 0.1, 1e21, "\\\n")) == R"([0.1,1e+21,"\\\n"])");
+            auto est = iod::json_estimate(t);
+            REQUIRE(est >= s1.size()/2);
+            REQUIRE(est <= s1.size()*2);
+
+            // the encoding is appended to the buffer
+            OBuffer ob{0};
+            ob << "x:";
+            json::encode(t, ob);
+            REQUIRE(std::string(ob) == ("x:" + s1));
+            json::Object obj(json::Obj, "s", "a\"b", "n", 2);
+            REQUIRE(obj.estimate() >= 10);
+            ob.reset(0, true);
+            json::encode(obj, ob);
+            REQUIRE(std::string(ob) == R"({"s":"a\"b","n":2})");
+
+            // large listings go out in chunks of about the threshold
+            std::vector<Type> rows(1000, t);
+            auto whole = json::encode(rows);
+            OBuffer sb{0};
+            std::string out;
+            size_t nflushes{0}, largest{0};
+            OBufferSink sink(sb, 1024, [&](const char *data, size_t len) {
+                out.append(data, len);
+                largest = std::max(largest, len);
+                nflushes++;
+                return true;
+            });
+            json::encode(rows, sink);
+            REQUIRE(out == whole);
+            REQUIRE(sink.flushed() == whole.size());
+            REQUIRE(nflushes > 1);
+            REQUIRE(largest < 2048);
+            REQUIRE(sb.empty());
+
+            // failing to flush aborts encoding
+            OBufferSink broken(sb, 1024, [&](const char *, size_t) { return false; });
+            REQUIRE_THROWS(json::encode(rows, broken));
+        }
     }
 
     SECTION("converting IOD serializable and JSON object") {
@@ -2654,5 +2811,142 @@ TEST_CASE("suil::json::Object", "[json][Object]")
     }
 }
 
+static Account mkaccount(int i)
+{
+    Account a{};
+    a.id      = 1000000 + i;
+    a.name    = utils::catstr("User ", i);
+    a.email   = utils::catstr("user", i, "@example.com");
+    a.phone   = (i % 2)? utils::catstr("+1 555 01", i % 100) : String{};
+    a.token   = utils::catstr("secret", i);
+    a.active  = (i % 3) != 0;
+    a.balance = i * 12.25;
+    a.roles   = {"reader", (i % 5)? "writer" : "admin"};
+    a.scores  = {i, i * 2, i * 3};
+    return a;
+}
+
+/* the codecs generated before scc emitted its own, reflecting over the schema */
+static std::string iodEncode(const Account& a)
+{
+    iod::json::jstream ss;
+    json::metaToJson(a, ss);
+    return ss.move_str();
+}
+
+static Account iodDecode(const std::string& str)
+{
+    iod::json::parser p(str);
+    Account tmp{};
+    p >> p.spaces >> '{';
+    iod::json::iod_attr_from_json(&Account::Meta, tmp, p);
+    p >> p.spaces >> '}';
+    return tmp;
+}
+
+TEST_CASE("scc generated JSON codecs", "[json][scc]")
+{
+    SECTION("encoding generated codecs") {
+        // the output is that of the reflected codec
+        for (int i = 0; i < 4; i++) {
+            auto a = mkaccount(i);
+            REQUIRE(json::encode(a) == iodEncode(a));
+        }
+        auto a = mkaccount(1);
+        REQUIRE(json::encode(a) == R"({"id":1000001,"name":"User 1","email":"user1@example.com","phone":"+1 555 011",)"
+                                   R"("active":true,"balance":12.25,"roles":["reader","writer"],"scores":[1,2,3]})");
+        // ignored fields are omitted when empty
+        a.phone = String{};
+        REQUIRE(json::encode(a).find("phone") == std::string::npos);
+        // skipped fields are never encoded
+        REQUIRE(json::encode(a).find("token") == std::string::npos);
+    }
+
+    SECTION("decoding with generated codecs") {
+        auto a = mkaccount(3);
+        Account b{};
+        json::decode(json::encode(a), b);
+        REQUIRE(b.id == a.id);
+        REQUIRE(b.name == a.name);
+        REQUIRE(b.email == a.email);
+        REQUIRE(b.phone == a.phone);
+        REQUIRE(b.active == a.active);
+        REQUIRE(b.balance == a.balance);
+        REQUIRE(b.roles == a.roles);
+        REQUIRE(b.scores == a.scores);
+
+        // keys in any order, optional fields and null values
+        std::string str = R"( { "scores" : null, "roles":[], "balance": 1.5, "active":false,)"
+                          R"( "email":"a@b.c", "name":"A", "id":7 } )";
+        json::decode(str, b);
+        REQUIRE(b.id == 7);
+        REQUIRE(b.name == "A");
+        REQUIRE(b.email == "a@b.c");
+        REQUIRE(b.phone.empty());
+        REQUIRE_FALSE(b.active);
+        REQUIRE(b.balance == 1.5);
+        REQUIRE(b.roles.empty());
+        REQUIRE(b.scores.empty());
+        auto c = iodDecode(str);
+        REQUIRE(c.name == b.name);
+        REQUIRE(c.balance == b.balance);
+
+        // unknown keys, missing required fields and bad values fail as with reflection
+        REQUIRE_THROWS(json::decode(std::string(R"({"id":1,"nickname":"x"})"), b));
+        REQUIRE_THROWS(json::decode(std::string(R"({"id":1,"name":"x"})"), b));
+        REQUIRE_THROWS(json::decode(std::string(R"({"id":"one","name":"x"})"), b));
+        REQUIRE_THROWS(json::decode(std::string(R"({"id":1,"name":"x")"), b));
+
+        // skipped fields are accepted but not decoded
+        json::decode(std::string(R"({"id":1,"token":{"v":["a","b"]},"name":"x","email":"",)"
+                                 R"("active":true,"balance":0,"roles":[]})"), b);
+        REQUIRE(b.id == 1);
+        REQUIRE(b.name == "x");
+        REQUIRE(b.token.empty());
+
+        // trailing commas are rejected
+        REQUIRE_THROWS(json::decode(std::string(R"({"id":1,"name":"x","email":"","active":true,)"
+                                                R"("balance":0,"roles":[],})"), b));
+        REQUIRE_THROWS(json::decode(std::string(R"({"id":1,"name":"x","email":"","active":true,)"
+                                                R"("balance":0,"roles":[] , })"), b));
+    }
+}
+
+TEST_CASE("scc generated JSON codecs benchmark", "[.bench][json]")
+{
+    // ./sut "[.bench]"
+    std::vector<Account> accounts;
+    std::vector<std::string> encoded;
+    for (int i = 0; i < 1000; i++) {
+        accounts.push_back(mkaccount(i));
+        encoded.push_back(json::encode(accounts.back()));
+    }
+
+    const int ROUNDS = 200;
+    auto bench = [&](const char *name, auto f) {
+        size_t total{0};
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ROUNDS; i++) {
+            for (size_t j = 0; j < accounts.size(); j++)
+                total += f(j);
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        WARN(name << ": " << (double) ns / (ROUNDS * accounts.size()) << " ns/object (" << total << ")");
+        return total;
+    };
+
+    auto a = bench("generated encode", [&](size_t j) { return json::encode(accounts[j]).size(); });
+    auto b = bench("reflected encode", [&](size_t j) { return iodEncode(accounts[j]).size(); });
+    REQUIRE(a == b);
+
+    auto c = bench("generated decode", [&](size_t j) {
+        iod::json::parser p(encoded[j]);
+        return (size_t) Account::fromJson(p).id;
+    });
+    auto d = bench("reflected decode", [&](size_t j) { return (size_t) iodDecode(encoded[j]).id; });
+    REQUIRE(c == d);
+}
+
 #endif
 
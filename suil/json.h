@@ -44,23 +44,29 @@ typedef enum {
 } JsonTag;
 
 typedef struct JsonNode JsonNode;
+typedef struct JsonDoc  JsonDoc;
 
+/*
+ * A node of a JSON document. Nodes, their keys, strings and child arrays
+ * are allocated from the arena of the document they belong to (\see JsonDoc),
+ * when decoding in-situ keys and strings point into the decoded buffer
+ */
 struct JsonNode
 {
-    /* only if parent is an object or array (NULL otherwise) */
-    JsonNode *parent;
-    JsonNode *prev, *next;
+    JsonTag tag;
+
+    /* JSON_STRING: the length of the string, JSON_ARRAY/JSON_OBJECT: the number of children */
+    uint32_t len;
 
     /* only if parent is an object (NULL otherwise) */
-    char *key; /* Must be valid UTF-8. */
+    const char *key; /* Must be valid UTF-8, null terminated. */
 
-    JsonTag tag;
     union {
         /* JSON_BOOL */
         bool bool_;
 
         /* JSON_STRING */
-        char *string_; /* Must be valid UTF-8. */
+        const char *string_; /* Must be valid UTF-8, null terminated. */
 
         /* JSON_NUMBER */
         double number_;
@@ -68,60 +74,17 @@ struct JsonNode
         /* JSON_ARRAY */
         /* JSON_OBJECT */
         struct {
-            JsonNode *head, *tail;
+            /* contiguous array of the children, the children decoded
+             * together are also contiguous in memory */
+            JsonNode **items;
+            uint32_t   cap;
+            /* open addressing index of member keys, only built on large objects */
+            uint32_t   icap;
+            uint32_t  *index;
         } children;
     };
 };
 
-/*** Encoding, decoding, and validation ***/
-
-//JsonNode   *json_decode         (const char *json);
-//char       *json_encode         (const JsonNode *node);
-//char       *json_encode_string  (const char *str);
-//char       *json_stringify      (const JsonNode *node, const char *space);
-//void        json_delete         (JsonNode *node);
-//bool        json_validate       (const char *json);
-
-/*** Lookup and traversal ***/
-
-JsonNode   *json_find_element   (JsonNode *array, int index);
-JsonNode   *json_find_member    (JsonNode *object, const char *key);
-JsonNode   *json_find_member    (JsonNode *object, const char *key, size_t keyLen);
-
-JsonNode   *json_first_child    (const JsonNode *node);
-
-#define json_foreach(i, object_or_array)            \
-	for ((i) = json_first_child(object_or_array);   \
-		 (i) != NULL;                               \
-		 (i) = (i)->next)
-
-/*** Construction and manipulation ***/
-
-JsonNode *json_mknull(void);
-JsonNode *json_mkbool(bool b);
-JsonNode *json_mkstring(const char *s);
-JsonNode *json_mknstring(const char *s, size_t size);
-JsonNode *json_mknumber(double n);
-JsonNode *json_mkarray(void);
-JsonNode *json_mkobject(void);
-
-void json_append_element(JsonNode *array, JsonNode *element);
-void json_prepend_element(JsonNode *array, JsonNode *element);
-void json_append_member(JsonNode *object, const char *key, JsonNode *value);
-void json_prepend_member(JsonNode *object, const char *key, JsonNode *value);
-
-void json_remove_from_parent(JsonNode *node);
-
-/*** Debugging ***/
-
-/*
- * Look for structure and encoding problems in a JsonNode or its descendents.
- *
- * If a problem is detected, return false, writing a description of the problem
- * to errmsg (unless errmsg is NULL).
- */
-bool json_check(const JsonNode *node, char errmsg[256]);
-
 struct lua_State;
 
 namespace suil {
@@ -148,16 +111,17 @@ namespace suil {
 
             class iterator {
             public:
-                iterator(JsonNode *node) : mNode(node) {}
+                iterator(JsonNode **pos, JsonDoc *doc) : mPos(pos), mDoc(doc) {}
 
                 iterator operator++();
 
-                bool operator!=(const iterator &other) { return mNode != other.mNode; }
-                bool operator==(const iterator &other) { return mNode == other.mNode; }
+                bool operator!=(const iterator &other) { return mPos != other.mPos; }
+                bool operator==(const iterator &other) { return mPos == other.mPos; }
                 const std::pair<const char *, Object> operator*() const;
 
             private:
-                JsonNode *mNode;
+                JsonNode **mPos;
+                JsonDoc   *mDoc;
             };
 
             using const_iterator = iterator;
@@ -231,13 +195,18 @@ namespace suil {
 
             Object(const Object &o) noexcept
                 : mNode(o.mNode),
+                  mDoc(o.mDoc),
                   ref(true)
             { }
 
             Object(Object &&o) noexcept
                 : mNode(o.mNode),
+                  mDoc(o.mDoc),
                   ref(o.ref)
-            { o.mNode = nullptr; }
+            {
+                o.mNode = nullptr;
+                o.mDoc = nullptr;
+            }
 
             Object &operator=(Object &&o) noexcept;
 
@@ -312,6 +281,12 @@ namespace suil {
                     Ego.set(key, *a);
             }
 
+            /**
+             * sets the member \param key of this object, an existing member is
+             * overwritten in place. The document's arena only grows by the copy
+             * of the new value, strings that fit in the previous value's storage
+             * and containers set with \see Obj or \see Arr reuse it
+             */
             void set(const char *key, Object &&);
 
             Object set(const char *key, const Object_t &);
@@ -352,8 +327,30 @@ namespace suil {
 
             operator double() const;
 
+            /**
+             * decodes the JSON value at the start of the given string, the
+             * string is copied into the decoded document
+             *
+             * @param str the string to decode
+             * @param sz the size of \param str, updated with the number of
+             * bytes consumed
+             * @return the decoded value
+             */
             static Object decode(const char *str, size_t &sz);
 
+            /**
+             * decodes the JSON value at the start of the given string
+             *
+             * @param str the string to decode, must be null terminated at \param sz
+             * e.g (char *) OBuffer
+             * @param sz the size of \param str, updated with the number of bytes consumed
+             * @param insitu if true, the string is not copied. Strings are unescaped in place
+             * and the returned object references \param str which must outlive it. The
+             * contents of \param str are undefined after decoding
+             * @return the decoded value
+             */
+            static Object decode(char *str, size_t &sz, bool insitu);
+
             template <typename T>
             static Object decode(const T& data) {
                 size_t sz{data.size()};
@@ -366,6 +363,12 @@ namespace suil {
 
             void encode(iod::encode_stream &ss) const;
 
+            /**
+             * @return an estimate of the size of the encoding of this object,
+             * used to size output buffers before encoding
+             */
+            size_t estimate() const;
+
             template<typename T, typename std::enable_if<std::is_arithmetic<T>::value>::type* = nullptr>
             inline operator T() const {
                 return (T) ((double) Ego);
@@ -510,14 +513,14 @@ namespace suil {
 
             iterator begin();
 
-            iterator end() { return iterator(nullptr); }
+            iterator end();
 
             const_iterator begin() const;
 
-            const_iterator end() const { return const_iterator(nullptr); }
+            const_iterator end() const;
 
             Object weak() {
-                return Object(mNode, true);
+                return Object(mNode, mDoc, true);
             }
 
             static Object fromLuaTable(lua_State* L, int index = 0);
@@ -526,10 +529,14 @@ namespace suil {
 
         private suil_ut:
 
-            Object(JsonNode *node, bool ref = true)
+            Object(JsonNode *node, JsonDoc *doc, bool ref = true)
                     : mNode(node),
+                      mDoc(doc),
                       ref(ref) {};
+
             JsonNode *mNode{nullptr};
+            // the document which owns the node, freed with the object unless it is a reference
+            JsonDoc  *mDoc{nullptr};
             bool ref{false};
         };
     }
@@ -561,20 +568,23 @@ namespace iod {
         Ego >> '"';
 
         int start = pos;
-        int end = pos;
+        int end = string_end(pos);
 
-        while (true) {
-            while (!eof() and str[end] != '"')
-                end++;
+        if (end < 0) {
+            end = pos;
+            while (true) {
+                while (!eof() and str[end] != '"')
+                    end++;
 
-            // Count the prev backslashes.
-            int sb = end - 1;
-            while (sb >= 0 and str[sb] == '\\')
-                sb--;
+                // Count the prev backslashes.
+                int sb = end - 1;
+                while (sb >= 0 and str[sb] == '\\')
+                    sb--;
 
-            if ((end - sb) % 2) break;
-            else
-                end++;
+                if ((end - sb) % 2) break;
+                else
+                    end++;
+            }
         }
         s = suil::String(str.data() + start, (size_t)(end-start), false).dup();
         pos = end+1;
@@ -586,20 +596,23 @@ namespace iod {
         Ego >> '"';
 
         int start = pos;
-        int end = pos;
+        int end = string_end(pos);
 
-        while (true) {
-            while (!eof() and str[end] != '"')
-                end++;
+        if (end < 0) {
+            end = pos;
+            while (true) {
+                while (!eof() and str[end] != '"')
+                    end++;
 
-            // Count the prev backslashes.
-            int sb = end - 1;
-            while (sb >= 0 and str[sb] == '\\')
-                sb--;
+                // Count the prev backslashes.
+                int sb = end - 1;
+                while (sb >= 0 and str[sb] == '\\')
+                    sb--;
 
-            if ((end - sb) % 2) break;
-            else
-                end++;
+                if ((end - sb) % 2) break;
+                else
+                    end++;
+            }
         }
         suil::String tmp{};
         Ego.fill(tmp);
@@ -613,10 +626,12 @@ namespace iod {
 
     template<>
     inline json_internals::json_parser& json_internals::json_parser::fill<suil::json::Object>(suil::json::Object& o) {
-        // just parse into a json object
-        size_t tmp = str.size();
+        // just parse into a json object, only the value itself if its extent is indexed
+        int end = value_end(pos);
+        size_t tmp = (end < 0)? str.size() - pos : end - pos;
         o = suil::json::Object::decode(&str[pos], tmp);
         pos += tmp;
+        return *this;
     }
 
     // Decode \o from a json string \b.
@@ -646,7 +661,11 @@ namespace iod {
 
     template<typename T, typename = typename std::enable_if<std::is_base_of<iod::MetaType,T>::value>::type>
     inline void json_decode(T& o, const stringview& s) {
-        json_decode<typename T::Schema, T>(o, s);
+        // meta types carry their own (possibly generated) decoder
+        if (s.size() == 0)
+            throw std::runtime_error("Empty string.");
+        json_internals::json_parser p(s);
+        o = T::fromJson(p);
     }
 
     template<typename S>
@@ -686,6 +705,18 @@ namespace iod {
         inline void json_encode_(const suil::json::Object& o, S &ss) {
             o.encode(ss);
         }
+
+        inline void json_estimate_(const suil::String& s, json_size &sz) {
+            sz.n += s.size() + 2;
+        }
+
+        inline void json_estimate_(const suil::Data& d, json_size &sz) {
+            sz.n += (d.size() << 1) + 2;
+        }
+
+        inline void json_estimate_(const suil::json::Object& o, json_size &sz) {
+            sz.n += o.estimate();
+        }
     }
 
     inline std::string json_encode(const suil::json::Object& o) {
@@ -728,6 +759,76 @@ namespace suil {
             return iod::json_encode(o);
         }
 
+        /**
+         * Lets the JSON encoder write straight into an output buffer, when
+         * the buffer belongs to a sink it is flushed as it fills up
+         */
+        struct BufferEncoder : iod::json_internals::json_sink {
+            BufferEncoder(OBuffer& ob, OBufferSink *sink = nullptr)
+                : ob(ob),
+                  sink(sink)
+            {}
+
+            char *reserve(size_t n, size_t &avail) override {
+                if (sink != nullptr && !sink->flush())
+                    throw Exception::create("json::encode - flushing encoded data failed");
+
+                ob.reserve(n);
+                avail = ob.capacity();
+                if (sink != nullptr && sink->threshold() != 0) {
+                    // never buffer much more than a chunk
+                    avail = std::min(avail, std::max(n, sink->threshold()));
+                }
+                return ob.data() + ob.size();
+            }
+
+            void commit(size_t n) override {
+                ob.seek(n);
+            }
+
+        private suil_ut:
+            OBuffer&     ob;
+            OBufferSink *sink{nullptr};
+        };
+
+        /**
+         * encodes the given object appending the encoding to the given buffer,
+         * the buffer is grown once to the estimated size of the encoding
+         * @param o the object to encode
+         * @param ob the buffer to append to
+         */
+        template<typename O>
+        inline void encode(const O &o, OBuffer& ob) {
+            ob.reserve(iod::json_estimate(o));
+            BufferEncoder enc(ob);
+            iod::encode_stream ss(&enc);
+            iod::json_internals::json_encode_(o, ss);
+            ss.sync();
+        }
+
+        /**
+         * encodes the given object into the given sink, the encoding is flushed
+         * in chunks of about the threshold of the sink (large listings are
+         * never held in memory as a whole)
+         * @param o the object to encode
+         * @param sink the sink to encode into, it's flushed when done
+         * @throws Exception if flushing the sink fails
+         */
+        template<typename O>
+        inline void encode(const O &o, OBufferSink& sink) {
+            size_t hint = iod::json_estimate(o);
+            if (sink.threshold() != 0)
+                hint = std::min(hint, sink.threshold());
+            sink.buffer().reserve(hint);
+
+            BufferEncoder enc(sink.buffer(), &sink);
+            iod::encode_stream ss(&enc);
+            iod::json_internals::json_encode_(o, ss);
+            ss.sync();
+            if (!sink.flush(true))
+                throw Exception::create("json::encode - flushing encoded data failed");
+        }
+
         template<typename S, typename O>
         static bool trydecode(const S &s, O &o) {
             iod::stringview sv(s.data(), s.size());
@@ -747,6 +848,24 @@ namespace suil {
             iod::json_decode(o, sv);
         }
 
+        /**
+         * The hash codecs generated by scc dispatch object keys on, scc picks a
+         * seed for which the (masked) hashes of the fields of a type are distinct
+         * @param key the key to hash
+         * @param len the size of \param key
+         * @param seed the seed picked for the type
+         * @return the hash of the key
+         */
+        constexpr uint32_t fieldhash(const char *key, size_t len, uint32_t seed) {
+            uint32_t h = seed ^ 2166136261u;
+            for (size_t i = 0; i < len; i++) {
+                h ^= (uint8_t) key[i];
+                h *= 16777619u;
+            }
+            // the low bits select the slot, fold the high bits into them
+            return h ^ (h >> 15);
+        }
+
         template <typename Mt>
         inline void metaToJson(const Mt& o, iod::json::jstream& ss)
         {
@@ -756,8 +875,8 @@ namespace suil {
             foreach(Mt::Meta) | [&](auto m) {
                 if (!m.attributes().has(iod::_json_skip)) {
                     /* ignore empty entry */
-                    auto val = m.value();
-                    if (m.attributes().has(iod::_ignore) && iod::json::json_ignore<decltype(val)>(val)) return;
+                    const auto& val = m.symbol().member_access(o);
+                    if (m.attributes().has(iod::_ignore) && iod::json::json_ignore(val)) return;
 
                     if (!first) { ss << ','; }
                     first = false;
@@ -773,7 +892,8 @@ namespace suil {
 
     template <typename... T>
     OBuffer& OBuffer::operator<<(const iod::sio<T...>& o) {
-        return (Ego << json::encode(o));
+        json::encode(o, Ego);
+        return Ego;
     }
 }
 
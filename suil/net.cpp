@@ -2,11 +2,39 @@
 // Created by dc on 12/11/18.
 //
 
+#include <linux/filter.h>
+#include <sys/socket.h>
+
 #include "init.h"
 #include "net.h"
 
 namespace suil {
 
+    bool reuseport_cpu_steering(int fd, uint32_t nsocks) {
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+        if (fd < 0 || nsocks == 0) {
+            errno = EINVAL;
+            return false;
+        }
+
+        // A = cpu; A = A % nsocks; return A
+        struct sock_filter code[] = {
+            { BPF_LD  | BPF_W | BPF_ABS, 0, 0, (uint32_t) (SKF_AD_OFF + SKF_AD_CPU) },
+            { BPF_ALU | BPF_MOD | BPF_K, 0, 0, nsocks },
+            { BPF_RET | BPF_A,           0, 0, 0 }
+        };
+        struct sock_fprog prog = {
+            .len = sizeof(code)/sizeof(code[0]),
+            .filter = code
+        };
+
+        return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+#else
+        errno = ENOTSUP;
+        return false;
+#endif
+    }
+
     void server_handler::operator()(suil::SocketAdaptor &sock, void *) {
         //sinfo("received Connection from: %s", sock.id());
         sock.send(version::SWNAME);
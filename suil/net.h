@@ -6,6 +6,7 @@
 #define SUIL_NET_HPP
 
 #include <suil/sock.h>
+#include <suil/worker.h>
 
 namespace suil {
 
@@ -13,6 +14,16 @@ namespace suil {
         void operator()(SocketAdaptor& sock, void *);
     };
 
+    /**
+     * attaches a classic BPF program to a SO_REUSEPORT listening socket which
+     * steers new connections to the socket at index (cpu % \param nsocks)
+     * in the reuseport group
+     * @param fd the listening socket
+     * @param nsocks the number of sockets in the reuseport group
+     * @return true if the program was attached, false otherwise
+     */
+    bool reuseport_cpu_steering(int fd, uint32_t nsocks);
+
     define_log_tag(SERVER);
     struct ServerConfig : public  SslSsConfig , public TcpSsConfig {
         std::string     name{"127.0.0.1"};
@@ -20,6 +31,11 @@ namespace suil {
         int             accept_backlog{127};
         int64_t         accept_timeout{-1};
         uint64_t        request_limit{40};
+        /* each worker listens on it's own SO_REUSEPORT socket, requires
+         * the server to listen after Worker::launch */
+        bool            reuse_port{false};
+        /* steer connections to the worker pinned on the CPU receiving them */
+        bool            cpu_steering{false};
     };
 
     template <class __H = server_handler, class __A = TcpSs, class __C = void>
@@ -40,7 +56,31 @@ namespace suil {
 
             ipaddr addr = iplocal(config.name.c_str(), config.port, 0);
 
-            if (!adaptor.listen(addr, config.accept_backlog)) {
+            if (config.reuse_port) {
+                // workers join the reuseport group in worker order, the CPU steering
+                // program relies on the group index matching the worker's CPU
+                int ret = Worker::ordered([&]() -> int {
+                    if (!adaptor.listen(addr, config.accept_backlog, true)) {
+                        ierror("listening on reuseport adaptor failed: %s", errno_s);
+                        return errno;
+                    }
+                    return 0;
+                });
+                if (ret) {
+                    return ret < 0? -ret : ret;
+                }
+
+                if (config.cpu_steering) {
+                    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+                    if (Worker::count() > ncpus) {
+                        iwarn("cpu steering disabled, %hhu workers on %ld cpu's", Worker::count(), ncpus);
+                    }
+                    else if (!reuseport_cpu_steering(adaptor.fd(), Worker::count())) {
+                        iwarn("attaching cpu steering program failed: %s", errno_s);
+                    }
+                }
+            }
+            else if (!adaptor.listen(addr, config.accept_backlog)) {
                 ierror("listening on adaptor failed: %s", errno_s);
                 return errno;
             }
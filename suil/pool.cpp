@@ -0,0 +1,107 @@
+//
+// Created by dc on 18/10/26.
+//
+
+#include "pool.h"
+
+#ifdef unit_test
+#include <catch/catch.hpp>
+#include <suil/utils.h>
+
+using namespace suil;
+
+static coroutine void poolWaiter(Pool<int>& pool, Channel<int>& got) {
+    int h{0};
+    got << (pool.acquire(h, 1000)? h : 0);
+}
+
+TEST_CASE("Pool tests", "[common][Pool]") {
+    // tests the bounded pool of handles
+    int next{0}, closed{0};
+    bool healthy{true};
+    Pool<int> pool([&]() { return ++next; },
+                   [&](int&) { closed++; },
+                   [&](int&) { return healthy; });
+
+    SECTION("Reuse is last in first out") {
+        int a{0}, b{0}, c{0};
+        REQUIRE(pool.acquire(a));
+        REQUIRE(pool.acquire(b));
+        REQUIRE(a == 1);
+        REQUIRE(b == 2);
+        pool.release(std::move(a));
+        pool.release(std::move(b));
+        REQUIRE(pool.acquire(c));
+        REQUIRE(c == 2);
+        auto stats = pool.stats();
+        REQUIRE(stats.opened == 2);
+        REQUIRE(stats.reused == 1);
+        REQUIRE(stats.idle == 1);
+        REQUIRE(stats.inuse == 1);
+    }
+
+    SECTION("Unhealthy and unkept handles are closed") {
+        int a{0};
+        REQUIRE(pool.acquire(a));
+        pool.release(std::move(a));
+        healthy = false;
+        REQUIRE(pool.acquire(a));
+        REQUIRE(a == 2);
+        REQUIRE(closed == 1);
+        REQUIRE(pool.stats().unhealthy == 1);
+        pool.config.keep_alive = 0;
+        pool.release(std::move(a));
+        REQUIRE(closed == 2);
+        REQUIRE(pool.size() == 0);
+    }
+
+    SECTION("Exhausted pool hands released handles to waiters") {
+        pool.config.max = 1;
+        int a{0}, b{0};
+        REQUIRE(pool.acquire(a));
+        REQUIRE_FALSE(pool.acquire(b, 10));
+        REQUIRE(pool.stats().timeouts == 1);
+
+        Channel<int> got{-1};
+        go(poolWaiter(pool, got));
+        yield();
+        pool.release(std::move(a));
+        int h{0};
+        REQUIRE((got[1000] >> h));
+        REQUIRE(h == 1);
+        REQUIRE(pool.stats().waited == 2);
+        REQUIRE(pool.stats().peak == 1);
+    }
+
+    SECTION("Only handles idle for long enough are checked") {
+        int checks{0};
+        Pool<int> checked([&]() { return ++next; },
+                          [&](int&) { closed++; },
+                          [&](int&) { checks++; return healthy; });
+        checked.config.check_idle = 50;
+        int a{0};
+        REQUIRE(checked.acquire(a));
+        checked.release(std::move(a));
+        REQUIRE(checked.acquire(a));
+        REQUIRE(checks == 0);
+        checked.release(std::move(a));
+        msleep(utils::after(60));
+        healthy = false;
+        REQUIRE(checked.acquire(a));
+        REQUIRE(checks == 1);
+        REQUIRE(a == 2);
+        REQUIRE(checked.stats().unhealthy == 1);
+    }
+
+    SECTION("Warmup opens the minimum idle handles") {
+        pool.config.min_idle = 3;
+        pool.config.max = 2;
+        REQUIRE(pool.warmup() == 2);
+        REQUIRE(pool.stats().idle == 2);
+        pool.clear();
+        REQUIRE(closed == 2);
+        REQUIRE(pool.size() == 0);
+    }
+}
+
+#endif
@@ -0,0 +1,338 @@
+//
+// Created by dc on 18/10/26.
+//
+
+#ifndef SUIL_POOL_H
+#define SUIL_POOL_H
+
+#include <suil/channel.h>
+#include <suil/logging.h>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+
+namespace suil {
+
+    define_log_tag(POOL);
+
+    struct pool_config {
+        // the maximum number of handles open at a time, 0 is unbounded
+        size_t   max{0};
+        // the number of idle handles that are never expired
+        size_t   min_idle{0};
+        // how long (ms) an idle handle is kept, 0 closes it on release and < 0 keeps it forever
+        int64_t  keep_alive{-1};
+        // how long (ms) to wait for a handle when the pool is exhausted, < 0 waits forever
+        int64_t  wait{-1};
+        // how long (ms) a handle must have been idle to be checked before it's reused, 0 checks every reuse
+        int64_t  check_idle{0};
+    };
+
+    struct pool_stats {
+        uint64_t opened{0};
+        uint64_t closed{0};
+        uint64_t acquired{0};
+        // acquisitions served from the idle handles
+        uint64_t reused{0};
+        // acquisitions that had to wait for a handle
+        uint64_t waited{0};
+        uint64_t timeouts{0};
+        // idle handles which failed the health check
+        uint64_t unhealthy{0};
+        size_t   idle{0};
+        size_t   inuse{0};
+        // the largest number of handles open at a time
+        size_t   peak{0};
+    };
+
+    /**
+     * A bounded pool of handles to a backend, e.g database connections. Idle
+     * handles are reused last in first out so that the handle that was used most
+     * recently (and whose caches are warmest) is handed out first while the rest
+     * age and get expired. When \see pool_config::max handles are open, acquiring
+     * coroutines queue up and each waits on its own channel for a handle to be
+     * released
+     *
+     * @tparam Handle a movable handle to the pooled resource
+     */
+    template <typename Handle>
+    struct Pool : LOGGER(POOL) {
+        // opens a new handle, throws on failure
+        using Opener  = std::function<Handle()>;
+        using Closer  = std::function<void(Handle&)>;
+        // checks that an idle handle can still be used
+        using Checker = std::function<bool(Handle&)>;
+
+        Pool(Opener open, Closer close, Checker check = nullptr)
+            : opener(std::move(open)),
+              closer(std::move(close)),
+              checker(std::move(check))
+        {}
+
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+
+        /**
+         * gets a handle from the pool, reusing the most recently released idle handle
+         * or opening a new one if the pool isn't full
+         *
+         * @param h the acquired handle
+         * @param timeout how long to wait for a handle when the pool is exhausted,
+         * \see pool_config::wait is used when not given
+         * @return false if no handle was released before the timeout
+         *
+         * @throws the exception thrown when opening a new handle fails
+         */
+        bool acquire(Handle& h, int64_t timeout = 0) {
+            timeout = timeout? timeout : config.wait;
+            int64_t dd = timeout < 0? -1 : mnow() + timeout;
+            bool waited{false};
+
+            while (true) {
+                while (!idle.empty()) {
+                    entry_t e = std::move(idle.back());
+                    idle.pop_back();
+                    if (checker && (mnow() - e.since) >= config.check_idle && !checker(e.h)) {
+                        itrace("discarding unhealthy pooled handle");
+                        counters.unhealthy++;
+                        shut(e.h);
+                        continue;
+                    }
+                    counters.acquired++;
+                    counters.reused++;
+                    h = std::move(e.h);
+                    return true;
+                }
+
+                if (config.max == 0 || total < config.max) {
+                    // the slot is reserved while the handle is being opened
+                    total++;
+                    counters.peak = std::max(counters.peak, total);
+                    try {
+                        h = opener();
+                    }
+                    catch (...) {
+                        total--;
+                        handover();
+                        throw;
+                    }
+                    counters.opened++;
+                    counters.acquired++;
+                    return true;
+                }
+
+                if (!waited) {
+                    counters.waited++;
+                    waited = true;
+                }
+
+                waiter_t w;
+                waiters.push_back(&w);
+                uint8_t token{0};
+                if (dd < 0) {
+                    w.ch >> token;
+                }
+                else {
+                    int64_t left = dd - mnow();
+                    if (left > 0) w.ch[left] >> token;
+                }
+
+                if (w.state == waiter_t::Handed) {
+                    counters.acquired++;
+                    h = std::move(w.h);
+                    return true;
+                }
+                if (w.state == waiter_t::Waiting) {
+                    // timed out before a handle was released
+                    waiters.erase(std::find(waiters.begin(), waiters.end(), &w));
+                    counters.timeouts++;
+                    iwarn("timed out waiting for a pooled handle, %lu open", total);
+                    return false;
+                }
+                // a slot was freed, try again
+            }
+        }
+
+        /**
+         * returns a handle to the pool, handing it over to the coroutine that
+         * has waited the longest if any
+         *
+         * @param h the handle to return
+         * @param reuse false if the handle is broken and should be closed
+         */
+        void release(Handle&& h, bool reuse = true) {
+            if (!reuse || config.keep_alive == 0) {
+                shut(h);
+                handover();
+                return;
+            }
+
+            if (!waiters.empty()) {
+                auto w = waiters.front();
+                waiters.pop_front();
+                w->h = std::move(h);
+                w->state = waiter_t::Handed;
+                w->ch << (uint8_t) 1;
+                return;
+            }
+
+            int64_t now = mnow();
+            int64_t alive = config.keep_alive < 0? -1 : now + config.keep_alive;
+            idle.push_back(entry_t{std::move(h), alive, now});
+            if (!cleaning && config.keep_alive > 0) {
+                // schedule cleanup routine
+                go(cleanup(Ego));
+            }
+        }
+
+        /**
+         * opens handles until there are at least \see pool_config::min_idle idle
+         * handles, or the pool is full
+         *
+         * @return the number of handles opened
+         */
+        size_t warmup() {
+            size_t opened{0};
+            while (idle.size() < config.min_idle && (config.max == 0 || total < config.max)) {
+                total++;
+                try {
+                    Handle h = opener();
+                    counters.opened++;
+                    counters.peak = std::max(counters.peak, total);
+                    int64_t now = mnow();
+                    int64_t alive = config.keep_alive > 0? now + config.keep_alive : -1;
+                    idle.push_back(entry_t{std::move(h), alive, now});
+                    opened++;
+                }
+                catch (...) {
+                    total--;
+                    iwarn("warming up pool failed: %s", Exception::fromCurrent().what());
+                    break;
+                }
+            }
+            return opened;
+        }
+
+        /**
+         * closes all the idle handles, handles in use are not affected
+         */
+        void clear() {
+            if (cleaning) {
+                /* unschedule the cleaning coroutine */
+                itrace("notifying cleanup routine to exit");
+                !notify;
+                cleaning = false;
+            }
+
+            itrace("cleaning up %lu idle handles", idle.size());
+            while (!idle.empty()) {
+                entry_t e = std::move(idle.front());
+                idle.pop_front();
+                shut(e.h);
+            }
+        }
+
+        /**
+         * @return the counters of the pool
+         */
+        pool_stats stats() const {
+            pool_stats s = counters;
+            s.idle  = idle.size();
+            s.inuse = total - idle.size();
+            return s;
+        }
+
+        inline size_t size() const {
+            return total;
+        }
+
+        ~Pool() {
+            clear();
+        }
+
+        pool_config config{};
+
+    private suil_ut:
+        struct entry_t {
+            Handle   h;
+            int64_t  alive;
+            // when the handle became idle
+            int64_t  since;
+        };
+
+        struct waiter_t {
+            enum : uint8_t { Waiting, Handed, Retry };
+            Channel<uint8_t, 1> ch{0};
+            Handle              h{};
+            uint8_t             state{Waiting};
+        };
+
+        void shut(Handle& h) {
+            total--;
+            counters.closed++;
+            closer(h);
+        }
+
+        void handover() {
+            // wake up a waiting coroutine to take up the freed slot
+            if (!waiters.empty()) {
+                auto w = waiters.front();
+                waiters.pop_front();
+                w->state = waiter_t::Retry;
+                w->ch << (uint8_t) 1;
+            }
+        }
+
+        static coroutine void cleanup(Pool<Handle>& p) {
+            int64_t expires = p.config.keep_alive + 5;
+            if (p.idle.size() <= p.config.min_idle)
+                return;
+
+            p.cleaning = true;
+            do {
+                /* if notified to exit, exit immediately*/
+                uint8_t status{0};
+                if (p.notify[expires] >> status) {
+                    if (status == 1) return;
+                }
+
+                /* un-register all expired handles and all that will expire in the
+                 * next 500 ms, the least recently used are at the front */
+                int64_t t = mnow() + 500;
+                int pruned = 0;
+                ltrace(&p, "starting prune with %ld handles", p.idle.size());
+                while (p.idle.size() > p.config.min_idle && p.idle.front().alive <= t) {
+                    entry_t e = std::move(p.idle.front());
+                    p.idle.pop_front();
+                    p.shut(e.h);
+                    if ((++pruned % 100) == 0) {
+                        /* avoid hogging the CPU */
+                        yield();
+                    }
+                }
+                ltrace(&p, "pruned %ld handles", pruned);
+
+                if (p.idle.size() > p.config.min_idle) {
+                    /*ensure that this will run after at least 3 second*/
+                    expires = std::max(p.idle.front().alive - t, (int64_t)3000);
+                }
+            } while (p.idle.size() > p.config.min_idle);
+
+            p.cleaning = false;
+        }
+
+        Opener               opener;
+        Closer               closer;
+        Checker              checker;
+        std::deque<entry_t>  idle;
+        std::deque<waiter_t*> waiters;
+        pool_stats           counters{};
+        // handles open, including those being opened
+        size_t               total{0};
+        Channel<uint8_t>     notify{1};
+        bool                 cleaning{false};
+    };
+}
+
+#endif //SUIL_POOL_H
@@ -5,6 +5,11 @@
 
 namespace suil::redis {
 
+    enum : uint8_t {
+        MUX_DONE = 1,
+        MUX_READ = 2
+    };
+
     Transaction::Transaction(BaseClient &client)
             : client(client) {}
 
@@ -49,6 +54,11 @@ namespace suil::redis {
             return false;
         }
 
+        if (client.multiplexed()) {
+            iwarn("MULTI not supported on a shared connection");
+            return false;
+        }
+
         // send EXEC command
         cachedresp = client.send("MULTI");
         if (!cachedresp) {
@@ -66,6 +76,11 @@ namespace suil::redis {
     }
 
     Response BaseClient::dosend(Commmand &cmd, size_t nrps) {
+        if (mux) {
+            // connection shared with other coroutines
+            return muxsend(cmd, nrps);
+        }
+
         // send the command to the server
         String data = cmd.prepared();
         size_t size = adaptor().send(data.data(), data.size(), config().timeout);
@@ -76,16 +91,12 @@ namespace suil::redis {
         adaptor().flush(config().timeout);
 
         Response resp;
-        std::vector<Reply> stage;
-        do {
-            if (!recvresp(resp.buffer, stage)) {
-                // receiving data failed
-                return Response{Reply('-',
-                                      utils::catstr("receiving Response failed: ", errno_s))};
-            }
-        } while (--nrps > 0);
+        if (!recvresp(resp, nrps)) {
+            // receiving data failed
+            return Response{Reply('-',
+                                  utils::catstr("receiving Response failed: ", errno_s))};
+        }
 
-        resp.entries = std::move(stage);
         return std::move(resp);
     }
 
@@ -96,6 +107,11 @@ namespace suil::redis {
 
         for (auto &cmd: batched) {
             String data = cmd->prepared();
+            if (mux) {
+                // queued along with the last command
+                mux->txq << data;
+                continue;
+            }
             size_t size = adaptor().send(data.data(), data.size(), config().timeout);
             if (size != data.size()) {
                 // sending command failure
@@ -111,114 +127,406 @@ namespace suil::redis {
         return String{nullptr};
     }
 
-    bool BaseClient::recvresp(OBuffer &out, std::vector<Reply> &stagging) {
-        size_t rxd{1}, offset{out.size()};
-        char prefix;
-        if (!adaptor().read(&prefix, rxd, config().timeout)) {
-            return false;
+    void BaseClient::multiplex() {
+        if (!mux) {
+            mux = std::make_unique<mux_t>();
         }
+    }
 
-        switch (prefix) {
-            case SUIL_REDIS_PREFIX_ERROR:
-            case SUIL_REDIS_PREFIX_INTEGER:
-            case SUIL_REDIS_PREFIX_VALUE: {
-                if (!readline(out)) {
-                    return false;
-                }
-                String tmp{(char *) &out[offset], out.size() - offset, false};
-                out << '\0';
-                stagging.emplace_back(Reply(prefix, std::move(tmp)));
-                return true;
-            }
-            case SUIL_REDIS_PREFIX_STRING: {
-                int64_t len{0};
-                if (!readlen(len)) {
-                    return false;
-                }
+    void BaseClient::retire(std::function<void()> fn) {
+        if (idle()) {
+            fn();
+            return;
+        }
+        mux->retired = std::move(fn);
+    }
 
-                String tmp = String{nullptr};
-                if (len >= 0) {
-                    size_t size = (size_t) len + 2;
-                    out.reserve((size_t) size + 2);
-                    if (!adaptor().read(&out[offset], size, config().timeout)) {
-                        idebug("receiving string '%lu' failed: %s", errno_s);
-                        return false;
-                    }
-                    // only interested in actual string
-                    if (len) {
-                        out.seek(len);
-                        tmp = String{(char *) &out[offset], (size_t) len, false};
-                        // terminate string
-                        out << '\0';
-                    }
-                }
-                stagging.emplace_back(Reply(SUIL_REDIS_PREFIX_STRING, std::move(tmp)));
-                return true;
+    Response BaseClient::muxsend(Commmand &cmd, size_t nrps) {
+        if (mux->broken) {
+            return Response{Reply('-', "shared connection is broken")};
+        }
+
+        mux->users++;
+        defer(users, {
+            if (--mux->users == 0 && mux->retired && idle()) {
+                // the client is not used after this, the handler can destroy it
+                auto fn = std::move(mux->retired);
+                fn();
             }
+        });
 
-            case SUIL_REDIS_PREFIX_ARRAY: {
-                int64_t len{0};
-                if (!readlen(len)) {
-                    return false;
-                }
-                stagging.emplace_back(Reply(SUIL_REDIS_PREFIX_ARRAY, ""));
-                if (len > 0) {
-                    int i = 0;
-                    for (i; i < len; i++) {
-                        if (!recvresp(out, stagging)) {
-                            return false;
-                        }
-                    }
+        Response resp;
+        waiter_t w(resp, nrps);
+        mux->txq << cmd.prepared();
+        mux->inflight.push_back(&w);
+
+        if (!mux->flushing) {
+            // let the other ready coroutines queue their commands before writing
+            mux->flushing = true;
+            yield();
+            bool ok = muxflush();
+            mux->flushing = false;
+            if (!ok) {
+                iwarn("writing to shared connection failed: %s", errno_s);
+                mux->broken = true;
+                if (!mux->reading) {
+                    // otherwise the reader will fail when reading from the connection
+                    muxabort(&w);
                 }
+            }
+        }
 
-                return true;
+        if (!w.done) {
+            uint8_t status{MUX_READ};
+            if (mux->reading) {
+                // wait for the replies or for our turn to read
+                w.ready >> status;
+            }
+            if (status == MUX_READ) {
+                muxread(w);
             }
+        }
 
-            default: {
-                ierror("received Response with unsupported type: %c", out[0]);
+        if (w.failed) {
+            return Response{Reply('-', "receiving Response on shared connection failed")};
+        }
+        return std::move(resp);
+    }
+
+    bool BaseClient::muxflush() {
+        // commands queued while writing are written in the next round
+        OBuffer tx(0);
+        while (!mux->txq.empty()) {
+            std::swap(tx, mux->txq);
+            size_t size = adaptor().send(tx.data(), tx.size(), config().timeout);
+            if (size != tx.size()) {
                 return false;
             }
+            if (!adaptor().flush(config().timeout)) {
+                return false;
+            }
+            tx.bseek(0);
+        }
+        return true;
+    }
+
+    void BaseClient::muxread(waiter_t &w) {
+        mux->reading = true;
+        while (!w.done) {
+            waiter_t *front = mux->inflight.front();
+            if (!recvresp(front->resp, front->nreply)) {
+                iwarn("reading from shared connection failed: %s", errno_s);
+                mux->reading = false;
+                mux->broken = true;
+                muxabort(&w);
+                return;
+            }
+
+            front->done = true;
+            mux->inflight.pop_front();
+            if (front != &w) {
+                front->ready << MUX_DONE;
+            }
+        }
+
+        mux->reading = false;
+        if (!mux->inflight.empty()) {
+            // hand over reading to the next coroutine in line
+            mux->reading = true;
+            mux->inflight.front()->ready << MUX_READ;
         }
     }
 
-    bool BaseClient::readlen(int64_t &len) {
-        OBuffer out{16};
-        if (!readline(out)) {
+    void BaseClient::muxabort(waiter_t *self) {
+        while (!mux->inflight.empty()) {
+            waiter_t *w = mux->inflight.front();
+            mux->inflight.pop_front();
+            w->failed = w->done = true;
+            if (w != self) {
+                w->ready << MUX_DONE;
+            }
+        }
+    }
+
+    static bool parselen(const char *p, const char *e, int64_t& len) {
+        bool neg{false};
+        if (p < e && *p == '-') {
+            neg = true;
+            p++;
+        }
+        if (p == e) {
             return false;
         }
-        String tmp{(char *) &out[0], out.size(), false};
-        tmp.data()[tmp.size()] = '\0';
-        utils::cast(tmp, len);
+
+        len = 0;
+        for (; p < e; p++) {
+            if (*p < '0' || *p > '9') {
+                return false;
+            }
+            len = (len * 10) + (*p - '0');
+        }
+        if (neg) len = -len;
         return true;
     }
 
-    bool BaseClient::readline(OBuffer &out) {
-        out.reserve(255);
-        size_t cap{out.capacity()};
-        do {
-            if (!adaptor().receiveuntil(&out[out.size()], cap, "\r", 1, config().timeout)) {
-                if (errno == ENOBUFS) {
-                    // reserve buffers
-                    out.seek(cap);
-                    out.reserve(512);
-                    continue;
+    static char *materialize(char *p, std::vector<Reply>& out) {
+        // only called on framed replies, the line is terminated
+        char *cr = (char *) rawmemchr(p, '\r');
+        char *next = cr + 2;
+        char prefix = *p;
+        int64_t len{0};
+        *cr = '\0';
+        String line{p + 1, (size_t) (cr - p - 1), false};
+
+        switch (prefix) {
+            case SUIL_REDIS_PREFIX_STRING:
+            case SUIL_REDIS_PREFIX_VERBATIM:
+            case SUIL_REDIS_PREFIX_BLOBERROR: {
+                parselen(p + 1, cr, len);
+                String tmp{nullptr};
+                if (len >= 0) {
+                    char *data = next;
+                    next += len + 2;
+                    // terminate string over the trailing CRLF
+                    data[len] = '\0';
+                    if (prefix == SUIL_REDIS_PREFIX_VERBATIM && len >= 4) {
+                        // skip the format, e.g 'txt:'
+                        data += 4;
+                        len  -= 4;
+                    }
+                    if (len) {
+                        tmp = String{data, (size_t) len, false};
+                    }
                 }
-                return false;
+                out.emplace_back(Reply(prefix == SUIL_REDIS_PREFIX_BLOBERROR?
+                                       SUIL_REDIS_PREFIX_ERROR : SUIL_REDIS_PREFIX_STRING, std::move(tmp)));
+                return next;
+            }
+            case SUIL_REDIS_PREFIX_BOOL: {
+                // booleans are handed out as integers
+                p[1] = (p[1] == 't')? '1' : '0';
+                out.emplace_back(Reply(SUIL_REDIS_PREFIX_INTEGER, std::move(line)));
+                return next;
+            }
+            case SUIL_REDIS_PREFIX_NULL: {
+                out.emplace_back(Reply(SUIL_REDIS_PREFIX_STRING, String{nullptr}));
+                return next;
+            }
+            case SUIL_REDIS_PREFIX_ATTRIBUTE: {
+                // attributes are not exposed, only the reply that follows them
+                std::vector<Reply> attrs;
+                parselen(p + 1, cr, len);
+                for (int64_t i = 0; i < (len << 1); i++) {
+                    next = materialize(next, attrs);
+                }
+                return materialize(next, out);
+            }
+            case SUIL_REDIS_PREFIX_ARRAY:
+            case SUIL_REDIS_PREFIX_SET:
+            case SUIL_REDIS_PREFIX_PUSH:
+            case SUIL_REDIS_PREFIX_MAP: {
+                parselen(p + 1, cr, len);
+                out.emplace_back(Reply(prefix, ""));
+                if (prefix == SUIL_REDIS_PREFIX_MAP) {
+                    len <<= 1;
+                }
+                for (int64_t i = 0; i < len; i++) {
+                    next = materialize(next, out);
+                }
+                return next;
             }
+            default: {
+                out.emplace_back(Reply(prefix, std::move(line)));
+                return next;
+            }
+        }
+    }
+
+    bool BaseClient::recvresp(Response &resp, size_t nreply) {
+        return recvresp(resp, nreply, config().timeout);
+    }
 
-            out.seek(cap - 1);
-            uint8_t tmp[2];
-            cap = sizeof(tmp);
-            if (!adaptor().receiveuntil(tmp, cap, "\n", 1, config().timeout)) {
-                // this should be impossible
+    bool BaseClient::recvresp(Response &resp, size_t nreply, int64_t timeout) {
+        // offsets are relative to rxoff as fill() can move the unconsumed data
+        std::vector<int64_t> pending;
+        std::vector<std::pair<size_t, size_t>> pushes;
+        size_t scan{0}, start{0};
+
+        while (nreply > 0) {
+            int rc = frame(scan, pending);
+            if (rc < 0) {
+                ierror("received malformed Response at '%c'",
+                       rxb.data()[rxoff + scan]);
+                rxb.bseek(0);
+                rxoff = 0;
+                errno = EPROTO;
                 return false;
             }
-            break;
-        } while (true);
+            if (rc == 0) {
+                if (!fill(timeout)) {
+                    // whatever was received is kept, framing resumes on the next call
+                    return false;
+                }
+                continue;
+            }
+
+            if (rxb.data()[rxoff + start] == SUIL_REDIS_PREFIX_PUSH) {
+                pushes.emplace_back(start, scan);
+            }
+            else {
+                nreply--;
+            }
+            start = scan;
+        }
+
+        size_t tail = rxb.size() - rxoff - scan;
+        char *base;
+        if (scan >= SUIL_REDIS_RX_HANDOVER && tail < scan && resp.buffer.empty()) {
+            // hand the receive buffer over to the response, only the bytes
+            // following the replies are copied
+            OBuffer rest(MAX(SUIL_REDIS_RX_CHUNK, tail));
+            rest.append(&rxb.data()[rxoff + scan], tail);
+            resp.buffer = std::move(rxb);
+            rxb = std::move(rest);
+            base = &resp.buffer.data()[rxoff];
+            rxoff = 0;
+        }
+        else {
+            resp.buffer.reserve(scan);
+            base = &resp.buffer.data()[resp.buffer.size()];
+            resp.buffer.append(&rxb.data()[rxoff], scan);
+            rxoff += scan;
+        }
+
+        char *p = base, *end = base + scan;
+        auto push = pushes.begin();
+        while (p < end) {
+            if (push != pushes.end() && p == (base + push->first)) {
+                Response msg;
+                msg.buffer.append(p, push->second - push->first);
+                materialize(msg.buffer.data(), msg.entries);
+                pushed(msg);
+                p = base + push->second;
+                push++;
+                continue;
+            }
+            p = materialize(p, resp.entries);
+        }
 
         return true;
     }
 
+    int BaseClient::frame(size_t &scan, std::vector<int64_t> &pending) {
+        const char *buf = &rxb.data()[rxoff];
+        size_t size = rxb.size() - rxoff;
+
+        while (scan < size) {
+            const char *p = &buf[scan];
+            auto cr = (const char *) memchr(p, '\r', size - scan);
+            if (cr == nullptr || (cr + 1) == &buf[size]) {
+                // line not completely received
+                return 0;
+            }
+
+            size_t next = (cr - buf) + 2;
+            int64_t len{0};
+            switch (*p) {
+                case SUIL_REDIS_PREFIX_VALUE:
+                case SUIL_REDIS_PREFIX_ERROR:
+                case SUIL_REDIS_PREFIX_INTEGER:
+                case SUIL_REDIS_PREFIX_NULL:
+                case SUIL_REDIS_PREFIX_BOOL:
+                case SUIL_REDIS_PREFIX_DOUBLE:
+                case SUIL_REDIS_PREFIX_BIGNUM:
+                    break;
+                case SUIL_REDIS_PREFIX_STRING:
+                case SUIL_REDIS_PREFIX_VERBATIM:
+                case SUIL_REDIS_PREFIX_BLOBERROR:
+                    if (!parselen(p + 1, cr, len)) {
+                        return -1;
+                    }
+                    if (len >= 0) {
+                        next += len + 2;
+                        if (next > size) {
+                            // string not completely received
+                            return 0;
+                        }
+                    }
+                    len = 0;
+                    break;
+                case SUIL_REDIS_PREFIX_ARRAY:
+                case SUIL_REDIS_PREFIX_SET:
+                case SUIL_REDIS_PREFIX_PUSH:
+                    if (!parselen(p + 1, cr, len)) {
+                        return -1;
+                    }
+                    break;
+                case SUIL_REDIS_PREFIX_MAP:
+                    if (!parselen(p + 1, cr, len)) {
+                        return -1;
+                    }
+                    len <<= 1;
+                    break;
+                case SUIL_REDIS_PREFIX_ATTRIBUTE:
+                    if (!parselen(p + 1, cr, len)) {
+                        return -1;
+                    }
+                    // the attributes and the reply they are attached to
+                    len = (len << 1) + 1;
+                    break;
+                default:
+                    return -1;
+            }
+
+            scan = next;
+            if (len > 0) {
+                // elements of the aggregate follow
+                pending.push_back(len);
+                continue;
+            }
+
+            // element complete, close the aggregates it completes
+            while (!pending.empty()) {
+                if (--pending.back() > 0) break;
+                pending.pop_back();
+            }
+            if (pending.empty()) {
+                return 1;
+            }
+        }
+
+        return 0;
+    }
+
+    bool BaseClient::fill(int64_t timeout) {
+        size_t unread = rxb.size() - rxoff;
+        if (unread == 0) {
+            rxb.bseek(0);
+            rxoff = 0;
+        }
+        else if (rxoff && rxb.capacity() < SUIL_REDIS_RX_CHUNK) {
+            // move the data that hasn't been consumed to the front
+            memmove(rxb.data(), &rxb.data()[rxoff], unread);
+            rxb.bseek(unread);
+            rxoff = 0;
+        }
+
+        rxb.reserve(SUIL_REDIS_RX_CHUNK);
+        size_t len = rxb.capacity();
+        bool ok = adaptor().read(&rxb.data()[rxb.size()], len, timeout);
+        if (ok || adaptor().isopen()) {
+            // keep whatever was received before a timeout
+            rxb.seek(len);
+        }
+        return ok;
+    }
+
+    void BaseClient::pushed(Response &msg) {
+        if (msg.entries.size() > 1) {
+            idebug("dropping push message '%s'", msg.entries[1].data.c_str());
+        }
+    }
+
     bool BaseClient::info(ServerInfo &out) {
         Commmand cmd("INFO");
         Response resp = send(cmd);
@@ -248,6 +556,8 @@ namespace suil::redis {
                         std::move(key), std::move(val)));
             }
         }
+        // keys and values are views into the reply
+        out.buffer = std::move(resp.buffer);
 
         return true;
     }
@@ -402,6 +712,79 @@ namespace suil::redis {
         }
     }
 
+    const String* NearCache::find(const String &key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            counters.misses++;
+            return nullptr;
+        }
+
+        counters.hits++;
+        // most recently used entries are kept at the front
+        lru.splice(lru.begin(), lru, it->second);
+        return &it->second->value;
+    }
+
+    uint64_t NearCache::pending(const String &key) {
+        uint64_t ticket = ++tickets;
+        auto it = reading.find(key);
+        if (it != reading.end()) {
+            // only the most recent read of the key is cached
+            it->second = ticket;
+        }
+        else {
+            reading.emplace(key.dup(), ticket);
+        }
+        return ticket;
+    }
+
+    void NearCache::insert(const String &key, const String &value, uint64_t ticket) {
+        auto rd = reading.find(key);
+        if (rd == reading.end() || rd->second != ticket) {
+            // the key was invalidated or is being read again
+            return;
+        }
+        reading.erase(rd);
+        if (value.empty() || capacity == 0) {
+            return;
+        }
+
+        String copy{'\0', value.size()};
+        memcpy(copy.data(), value.data(), value.size());
+        auto it = index.find(key);
+        if (it != index.end()) {
+            it->second->value = std::move(copy);
+            lru.splice(lru.begin(), lru, it->second);
+            return;
+        }
+
+        if (index.size() >= capacity) {
+            auto& last = lru.back();
+            index.erase(last.key);
+            lru.pop_back();
+            counters.evictions++;
+        }
+        lru.push_front(entry_t{key.dup(), std::move(copy)});
+        index.emplace(lru.front().key.peek(), lru.begin());
+    }
+
+    void NearCache::invalidate(const String &key) {
+        reading.erase(key);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            lru.erase(it->second);
+            index.erase(it);
+            counters.invalidations++;
+        }
+    }
+
+    void NearCache::clear() {
+        counters.invalidations += index.size();
+        index.clear();
+        lru.clear();
+        reading.clear();
+    }
+
     ServerInfo::ServerInfo(ServerInfo &&o)
         : version(std::move(o.version)),
           buffer(std::move(o.buffer)),
@@ -422,4 +805,301 @@ namespace suil::redis {
         }
         throw Exception::create("parameter '", key, "' does not exist");
     }
-}
\ No newline at end of file
+}
+#ifdef unit_test
+#include <catch/catch.hpp>
+
+using namespace suil;
+using namespace suil::redis;
+
+namespace {
+
+    // replays canned server output, at most chunk bytes per read
+    struct ReplaySock : SocketAdaptor {
+        bool connect(ipaddr, int64_t) override { return true; }
+        int port() const override { return 0; }
+        const ipaddr addr() const override { return ipaddr{}; }
+        size_t send(const void *buf, size_t len, int64_t) override {
+            if (broken) {
+                errno = EPIPE;
+                return 0;
+            }
+            sent.append((const char *) buf, len);
+            return len;
+        }
+        size_t sendfile(int, off_t, size_t, int64_t) override { return 0; }
+        bool flush(int64_t) override { return true; }
+        bool receive(void *buf, size_t& len, int64_t timeout) override {
+            return read(buf, len, timeout);
+        }
+        bool read(void *buf, size_t& len, int64_t) override {
+            if (pos == data.size()) {
+                errno = ECONNRESET;
+                len = 0;
+                return false;
+            }
+            len = MIN(len, MIN(chunk, data.size() - pos));
+            memcpy(buf, &data[pos], len);
+            pos += len;
+            reads++;
+            errno = 0;
+            return true;
+        }
+        bool receiveuntil(void*, size_t& len, const char*, size_t, int64_t) override {
+            len = 0;
+            return false;
+        }
+        bool isopen() const override { return true; }
+        void close() override {}
+
+        std::string data;
+        size_t      pos{0};
+        size_t      chunk{SUIL_REDIS_RX_CHUNK};
+        size_t      reads{0};
+        // the commands written by the client
+        std::string sent;
+        bool        broken{false};
+    };
+
+    struct ReplayClient : BaseClient {
+        ReplayClient(const std::string& data, size_t chunk) {
+            sock.data  = data;
+            sock.chunk = chunk;
+        }
+
+        Response next(size_t nreply = 1) {
+            Response resp;
+            if (!recvresp(resp, nreply))
+                return Response{Reply('-', "receiving failed")};
+            return std::move(resp);
+        }
+
+        SocketAdaptor& adaptor() override { return sock; }
+        redisdb_config& config() override { return cfg; }
+        void pushed(Response& msg) override {
+            std::vector<String> tmp = msg;
+            for (auto& s: tmp)
+                pushes.emplace_back(s.dup());
+        }
+
+        ReplaySock          sock;
+        redisdb_config      cfg;
+        std::vector<String> pushes;
+    };
+}
+
+static coroutine void muxSender(ReplayClient& client, const char *key, String& out, Channel<int>& done) {
+    auto resp = client("GET", key);
+    out = resp? resp.get<String>().dup() : String{"failed"}.dup();
+    done << 1;
+}
+
+TEST_CASE("suil::redis::BaseClient", "[redis][resp]") {
+
+    SECTION("Parsing RESP2 replies") {
+        std::string data{"+OK\r\n"
+                         "-ERR unknown command\r\n"
+                         ":42\r\n"
+                         "$5\r\nhello\r\n"
+                         "$-1\r\n"
+                         "*3\r\n$3\r\none\r\n*2\r\n:1\r\n:2\r\n$5\r\nth\r\ne\r\n"
+                         "*0\r\n"
+                         "+PONG\r\n"};
+        for (size_t chunk: {1, 3, 7, 4096}) {
+            CAPTURE(chunk);
+            ReplayClient client(data, chunk);
+            auto r1 = client.next();
+            REQUIRE(r1.status());
+            auto r2 = client.next();
+            REQUIRE_FALSE(r2);
+            REQUIRE(strcmp(r2.error(), "ERR unknown command") == 0);
+            REQUIRE((int) client.next() == 42);
+            REQUIRE(client.next().get<String>() == "hello");
+            REQUIRE_FALSE(client.next());
+            auto r6 = client.next();
+            REQUIRE(r6.entries.size() == 6);
+            REQUIRE(r6.get<String>(1) == "one");
+            REQUIRE(r6.get<int>(4) == 2);
+            REQUIRE(r6.get<String>(5) == "th\r\ne");
+            REQUIRE(client.next().entries.size() == 1);
+            // the last two replies in one go
+            ReplayClient batch(data, chunk);
+            auto all = batch.next(8);
+            REQUIRE(all.entries.size() == 13);
+            REQUIRE(all.status());
+            REQUIRE(all.entries[12].status("PONG"));
+        }
+    }
+
+    SECTION("Parsing RESP3 replies") {
+        std::string data{"%2\r\n+first\r\n:1\r\n$6\r\nsecond\r\n#t\r\n"
+                         ">2\r\n$10\r\ninvalidate\r\n*1\r\n$3\r\nkey\r\n"
+                         "~2\r\n,3.5\r\n(12345678901234567890\r\n"
+                         "|1\r\n+ttl\r\n:3600\r\n=8\r\ntxt:vrbt\r\n"
+                         "_\r\n"
+                         "#f\r\n"
+                         "!9\r\nERR blobs\r\n"};
+        for (size_t chunk: {1, 5, 4096}) {
+            CAPTURE(chunk);
+            ReplayClient client(data, chunk);
+            auto map = client.next();
+            REQUIRE(map.entries.size() == 5);
+            REQUIRE(map.get<String>(1) == "first");
+            REQUIRE(map.get<String>(3) == "second");
+            REQUIRE(map.get<int>(4) == 1);
+            auto set = client.next();
+            // the push message was delivered separately
+            REQUIRE(client.pushes.size() == 3);
+            REQUIRE(client.pushes[0] == "invalidate");
+            REQUIRE(client.pushes[2] == "key");
+            REQUIRE(set.entries.size() == 3);
+            REQUIRE(set.get<double>(1) == 3.5);
+            REQUIRE(set.get<String>(2) == "12345678901234567890");
+            auto verbatim = client.next();
+            REQUIRE(verbatim.entries.size() == 1);
+            REQUIRE(verbatim.get<String>() == "vrbt");
+            REQUIRE_FALSE(client.next());
+            REQUIRE(client.next().get<int>() == 0);
+            auto err = client.next();
+            REQUIRE_FALSE(err);
+            REQUIRE(strcmp(err.error(), "ERR blobs") == 0);
+        }
+    }
+
+    SECTION("Client side cache") {
+        NearCache cache(2);
+        cache.tracking = true;
+        cache.epoch = 1;
+        ReplayClient client("$5\r\nhello\r\n:10\r\n+OK\r\n$3\r\nbye\r\n", 4096);
+        client.near = &cache;
+        client.nearEpoch = 1;
+
+        REQUIRE(client.get<String>("a") == "hello");
+        REQUIRE(client.get<String>("a") == "hello");
+        REQUIRE(client.get<int>("b") == 10);
+        REQUIRE(client.get<int>("b") == 10);
+        REQUIRE(cache.stats().hits == 2);
+        REQUIRE(cache.stats().misses == 2);
+        // writes drop the local copy
+        REQUIRE(client.set("a", "x"));
+        REQUIRE(client.get<String>("a") == "bye");
+        REQUIRE(cache.size() == 2);
+        // nothing more to read, served from the cache
+        REQUIRE(client.get<String>("a") == "bye");
+
+        // not used once tracking was restarted
+        cache.epoch = 2;
+        REQUIRE_THROWS(client.get<String>("a"));
+    }
+
+    SECTION("Client side cache eviction and invalidation") {
+        NearCache cache(2);
+        auto t1 = cache.pending("a");
+        cache.insert("a", "1", t1);
+        auto t2 = cache.pending("b");
+        cache.insert("b", "2", t2);
+        REQUIRE(cache.find("a") != nullptr);
+        // b is the least recently used
+        cache.insert("c", "3", cache.pending("c"));
+        REQUIRE(cache.stats().evictions == 1);
+        REQUIRE(cache.find("b") == nullptr);
+        REQUIRE(*cache.find("c") == "3");
+
+        // a value read before its key was invalidated is never cached
+        auto t3 = cache.pending("d");
+        cache.invalidate("d");
+        cache.insert("d", "4", t3);
+        REQUIRE(cache.find("d") == nullptr);
+        // only the last of concurrent reads is cached
+        auto t4 = cache.pending("e");
+        auto t5 = cache.pending("e");
+        cache.insert("e", "old", t4);
+        REQUIRE(cache.find("e") == nullptr);
+        cache.insert("e", "new", t5);
+        REQUIRE(*cache.find("e") == "new");
+
+        cache.invalidate("e");
+        REQUIRE(cache.find("e") == nullptr);
+        cache.clear();
+        REQUIRE(cache.size() == 0);
+        REQUIRE(cache.stats().invalidations == 2);
+    }
+
+    SECTION("Large and malformed replies") {
+        std::string large(100000, 'x');
+        std::string data = "$" + std::to_string(large.size()) + "\r\n" + large + "\r\n:7\r\n";
+        ReplayClient client(data, 4096);
+        auto big = client.next();
+        REQUIRE((big.get<String>() == String{large.data(), large.size(), false}));
+        REQUIRE((int) client.next() == 7);
+        // reads are not byte by byte
+        REQUIRE(client.sock.reads < 30);
+
+        ReplayClient bad("+OK\r\n?oops\r\n", 4096);
+        REQUIRE(bad.next().status());
+        REQUIRE_FALSE(bad.next());
+    }
+
+    SECTION("Shared connections") {
+        String out[3];
+        const char *keys[] = {"k1", "k2", "k3"};
+        Channel<int> done{-1};
+        int retired{0};
+
+        SECTION("Replies are matched to concurrent senders in order") {
+            ReplayClient client("$1\r\na\r\n$1\r\nb\r\n$1\r\nc\r\n", 3);
+            client.multiplex();
+            for (int i = 0; i < 3; i++) {
+                go(muxSender(client, keys[i], out[i], done));
+            }
+            REQUIRE((done[1000](3) | Void));
+            REQUIRE(out[0] == "a");
+            REQUIRE(out[1] == "b");
+            REQUIRE(out[2] == "c");
+            // commands are written in the order they were sent
+            auto& sent = client.sock.sent;
+            REQUIRE(sent.find("k1") < sent.find("k2"));
+            REQUIRE(sent.find("k2") < sent.find("k3"));
+            REQUIRE(client.idle());
+            REQUIRE_FALSE(client.broken());
+        }
+
+        SECTION("Connection failures fail the requests in flight") {
+            ReplayClient client("$1\r\na\r\n", 4096);
+            client.multiplex();
+            for (int i = 0; i < 3; i++) {
+                go(muxSender(client, keys[i], out[i], done));
+            }
+            client.retire([&]() { retired++; });
+            REQUIRE(retired == 0);
+            REQUIRE((done[1000](3) | Void));
+            REQUIRE(out[0] == "a");
+            REQUIRE(out[1] == "failed");
+            REQUIRE(out[2] == "failed");
+            REQUIRE(client.broken());
+            REQUIRE(client.idle());
+            // retired once the last request failed
+            REQUIRE(retired == 1);
+            REQUIRE_FALSE(client("GET", "k4"));
+        }
+
+        SECTION("Write failures abort the requests in flight") {
+            ReplayClient client("", 4096);
+            client.sock.broken = true;
+            client.multiplex();
+            for (int i = 0; i < 3; i++) {
+                go(muxSender(client, keys[i], out[i], done));
+            }
+            REQUIRE((done[1000](3) | Void));
+            for (auto& o: out) {
+                REQUIRE(o == "failed");
+            }
+            REQUIRE(client.broken());
+            REQUIRE(client.idle());
+            REQUIRE(client.sock.sent.empty());
+            client.retire([&]() { retired++; });
+            REQUIRE(retired == 1);
+        }
+    }
+}
+#endif
@@ -8,7 +8,9 @@
 
 #include <deque>
 #include <list>
+#include <unordered_set>
 #include <suil/channel.h>
+#include <suil/pool.h>
 #include <suil/net.h>
 #include <suil/blob.h>
 
@@ -21,6 +23,26 @@ namespace suil {
 #define SUIL_REDIS_PREFIX_STRING        '$'
 #define SUIL_REDIS_PREFIX_ARRAY         '*'
 #define SUIL_REDIS_PREFIX_INTEGER       ':'
+#define SUIL_REDIS_PREFIX_NULL          '_'
+#define SUIL_REDIS_PREFIX_BOOL          '#'
+#define SUIL_REDIS_PREFIX_DOUBLE        ','
+#define SUIL_REDIS_PREFIX_BIGNUM        '('
+#define SUIL_REDIS_PREFIX_BLOBERROR     '!'
+#define SUIL_REDIS_PREFIX_VERBATIM      '='
+#define SUIL_REDIS_PREFIX_MAP           '%'
+#define SUIL_REDIS_PREFIX_SET           '~'
+#define SUIL_REDIS_PREFIX_PUSH          '>'
+#define SUIL_REDIS_PREFIX_ATTRIBUTE     '|'
+
+#ifndef SUIL_REDIS_RX_CHUNK
+// minimum number of bytes requested from the socket on each read
+#define SUIL_REDIS_RX_CHUNK             16384
+#endif
+
+#ifndef SUIL_REDIS_RX_HANDOVER
+// replies larger than this take over the receive buffer instead of being copied
+#define SUIL_REDIS_RX_HANDOVER          4096
+#endif
 
     namespace redis {
         define_log_tag(REDIS);
@@ -119,18 +141,20 @@ namespace suil {
                   data(data)
             {}
 
-            Reply(OBuffer&& rxb)
-                : recvd(std::move(rxb)),
-                  prefix(rxb.data()[0]),
-                  data(&rxb.data()[1], rxb.size()-3, false)
-            {
-                // null terminate
-                data.data()[data.size()] = '\0';
-            }
-
             operator bool() const {
                 if (prefix == SUIL_REDIS_PREFIX_ERROR) return false;
-                return (prefix == SUIL_REDIS_PREFIX_ARRAY || !data.empty());
+                return (aggregate() || !data.empty());
+            }
+
+            /**
+             * @return true if the reply is the header of an array, map, set
+             * or push reply, the elements of which follow it in the response
+             */
+            inline bool aggregate() const {
+                return prefix == SUIL_REDIS_PREFIX_ARRAY ||
+                       prefix == SUIL_REDIS_PREFIX_MAP   ||
+                       prefix == SUIL_REDIS_PREFIX_SET   ||
+                       prefix == SUIL_REDIS_PREFIX_PUSH;
             }
 
             inline bool status(const char *expect = SUIL_REDIS_STATUS_OK) const {
@@ -146,11 +170,11 @@ namespace suil {
                 return prefix == '[' || prefix == ']';
             }
 
-        private:
+        private suil_ut:
             friend struct Response;
             friend struct BaseClient;
+            // view into the buffer of the response holding the reply
             String data{nullptr};
-            OBuffer recvd;
             char     prefix{'-'};
         };
 
@@ -199,7 +223,7 @@ namespace suil {
             operator std::vector<T>() const {
                 std::vector<T> tmp;
                 int i = 0;
-                if (!entries.empty() && entries[0].prefix == SUIL_REDIS_PREFIX_ARRAY)
+                if (!entries.empty() && entries[0].aggregate())
                     i = 1;
                 for (i; i < entries.size(); i++) {
                     tmp.push_back(get<T>(i));
@@ -211,7 +235,7 @@ namespace suil {
             operator std::vector<T>() const {
                 std::vector<String> tmp;
                 int i = 0;
-                if (!entries.empty() && entries[0].prefix == SUIL_REDIS_PREFIX_ARRAY)
+                if (!entries.empty() && entries[0].aggregate())
                     i = 1;
                 for (i; i < entries.size(); i++) {
                     tmp.emplace_back(get<String>(i));
@@ -237,7 +261,7 @@ namespace suil {
                 }
             }
 
-        private:
+        private suil_ut:
 
             template <typename T, typename std::enable_if<std::is_arithmetic<T>::value>::type* = nullptr>
             void castreply(int idx, T& d) const {
@@ -254,13 +278,112 @@ namespace suil {
             friend struct Transaction;
 
             std::vector<Reply> entries;
-            OBuffer           buffer{128};
+            // the raw replies, entries are views into this buffer
+            OBuffer           buffer{0};
         };
 
         struct redisdb_config {
             int64_t     timeout{-1};
             std::string passwd{""};
             uint64_t    keep_alive{30000};
+            // number of values kept in the client side cache, 0 disables the cache
+            size_t      near_cache{0};
+            // maximum number of pooled connections, 0 is unbounded
+            size_t      pool_size{0};
+            // number of idle connections opened upfront and never expired
+            size_t      min_idle{0};
+            // how long to wait for a connection when the pool is exhausted
+            int64_t     pool_wait{-1};
+            // how long (ms) a pooled connection must have been idle to be pinged before it's reused
+            int64_t     check_idle{1000};
+        };
+
+        /**
+         * A bounded least recently used cache of the values read with GET,
+         * kept coherent with the server by the invalidation messages of
+         * redis client side caching (CLIENT TRACKING, redis >= 6). The cache
+         * is fed by clients whose connections are tracked, \see RedisDb
+         */
+        struct NearCache {
+            struct stats_t {
+                uint64_t hits{0};
+                uint64_t misses{0};
+                uint64_t evictions{0};
+                uint64_t invalidations{0};
+            };
+
+            explicit NearCache(size_t capacity)
+                : capacity(capacity)
+            {}
+
+            NearCache(const NearCache&) = delete;
+            NearCache&operator=(const NearCache&) = delete;
+
+            /**
+             * @return the cached value of \param key or nullptr if not cached,
+             * the value is valid until the caller yields
+             */
+            const String* find(const String& key);
+
+            /**
+             * Records that \param key is about to be read from the server
+             * @return a ticket to pass to \see NearCache::insert along with the
+             * value that was read
+             */
+            uint64_t pending(const String& key);
+
+            /**
+             * Caches \param value as the value of \param key unless the key was
+             * invalidated since \param ticket was issued
+             */
+            void insert(const String& key, const String& value, uint64_t ticket);
+
+            /**
+             * Drops the cached value of \param key and voids reads in flight
+             */
+            void invalidate(const String& key);
+
+            /**
+             * Drops all the cached values and voids reads in flight
+             */
+            void clear();
+
+            /**
+             * @return true if the invalidation messages for a connection which
+             * started tracking in \param epoch are still being received
+             */
+            inline bool valid(uint32_t epoch) const {
+                return tracking && (epoch == Ego.epoch);
+            }
+
+            inline const stats_t& stats() const {
+                return counters;
+            }
+
+            inline size_t size() const {
+                return index.size();
+            }
+
+        private suil_ut:
+            template <typename Proto>
+            friend struct RedisDb;
+
+            struct entry_t {
+                String  key;
+                String  value;
+            };
+
+            std::list<entry_t>  lru;
+            // keys refer to the entries in the lru list
+            Map<std::list<entry_t>::iterator> index;
+            // keys being read from the server
+            Map<uint64_t>       reading;
+            size_t              capacity;
+            uint64_t            tickets{0};
+            stats_t             counters;
+            // incremented whenever the invalidation connection is (re)opened
+            uint32_t            epoch{0};
+            bool                tracking{false};
         };
 
         struct ServerInfo {
@@ -323,7 +446,23 @@ namespace suil {
 
             template <typename T>
             auto get(const String& key) -> T {
+                uint64_t ticket{0};
+                bool cached = (near != nullptr) && near->valid(nearEpoch);
+                if (cached) {
+                    auto val = near->find(key);
+                    if (val != nullptr) {
+                        Response resp{Reply(SUIL_REDIS_PREFIX_STRING,
+                                            String{val->data(), val->size(), false})};
+                        return (T) resp;
+                    }
+                    ticket = near->pending(key);
+                }
+
                 Response resp = send("GET", key);
+                if (cached) {
+                    // failed reads only release the ticket
+                    near->insert(key, resp? resp.entries[0].data : String{}, ticket);
+                }
                 if (!resp) {
                     throw Exception::create("redis GET '", key,
                                              "' failed: ", resp.error());
@@ -333,7 +472,16 @@ namespace suil {
 
             template <typename T>
             inline bool set(const String& key, const T val) {
-                return send("SET", key, val).status();
+                if (near != nullptr) {
+                    // voids reads of the old value that are still in flight
+                    near->invalidate(key);
+                }
+                bool ok = send("SET", key, val).status();
+                if (near != nullptr) {
+                    // the server's invalidation message could still be on its way
+                    near->invalidate(key);
+                }
+                return ok;
             }
 
             int64_t incr(const String& key, int by = 0);
@@ -496,6 +644,45 @@ namespace suil {
 
             bool info(ServerInfo&);
 
+            /**
+             * Shares the client's connection between the coroutines of the current
+             * worker. Commands sent by different coroutines are queued, written
+             * together once per scheduler tick and each coroutine is handed back its
+             * replies in the order the commands were sent.
+             *
+             * Transactions and commands that change the connection state (e.g SELECT)
+             * must not be used on a shared connection
+             */
+            void multiplex();
+
+            /**
+             * @return true if the client's connection is shared, \see BaseClient::multiplex
+             */
+            inline bool multiplexed() const {
+                return mux != nullptr;
+            }
+
+            /**
+             * @return true if the shared connection failed and can no longer be used
+             */
+            inline bool broken() const {
+                return mux != nullptr && mux->broken;
+            }
+
+            /**
+             * @return true if no coroutine is currently using the shared connection
+             */
+            inline bool idle() const {
+                return mux == nullptr ||
+                       (mux->users == 0 && mux->inflight.empty() && !mux->flushing && !mux->reading);
+            }
+
+            /**
+             * Invokes \param fn once no coroutine is using the shared connection anymore,
+             * immediately if it's idle. \param fn can destroy the client
+             */
+            void retire(std::function<void()> fn);
+
             virtual void close() {};
 
         protected:
@@ -526,15 +713,91 @@ namespace suil {
                 }
             }
 
-            bool recvresp(OBuffer& out, std::vector<Reply>& stagging);
+            /**
+             * Receives the next \param nreply replies from the connection into
+             * \param resp. Data is read from the socket in large chunks into the
+             * client's receive buffer and framed in place, whatever is received
+             * past the requested replies is kept for the next call. Push frames
+             * received in between are passed to \see BaseClient::pushed
+             *
+             * @return false if receiving failed or the server sent a malformed reply
+             */
+            bool recvresp(Response& resp, size_t nreply);
 
-            bool readline(OBuffer& out);
+            bool recvresp(Response& resp, size_t nreply, int64_t timeout);
 
-            bool readlen(int64_t& len);
+            /**
+             * Invoked with out of band (RESP3 push) messages received on the
+             * connection, these are logged and dropped by default
+             */
+            virtual void pushed(Response& msg);
 
             String commit(Response& resp);
 
             std::vector<Commmand*> batched;
+
+        private suil_ut:
+            template <typename Proto>
+            friend struct RedisDb;
+
+            // the client side cache used by get<T>/set, \see RedisDb::track
+            NearCache  *near{nullptr};
+            uint32_t    nearEpoch{0};
+
+            /**
+             * Advances \param scan, an offset from the first unconsumed byte of the
+             * receive buffer, over the elements that have been completely received
+             * @param pending the number of elements still expected by each of the
+             * aggregates enclosing the scan position
+             * @return 1 if a reply ends at \param scan, 0 if more data is needed
+             * and -1 if the data is not a valid reply
+             */
+            int frame(size_t& scan, std::vector<int64_t>& pending);
+
+            bool fill(int64_t timeout);
+
+            OBuffer rxb{0};
+            // offset of the first byte in rxb that hasn't been consumed
+            size_t  rxoff{0};
+
+        private:
+            struct waiter_t {
+                waiter_t(Response& resp, size_t nreply)
+                    : resp(resp),
+                      nreply(nreply)
+                {}
+
+                Response&   resp;
+                size_t      nreply;
+                bool        done{false};
+                bool        failed{false};
+                // signalled when the replies are received or when it is the waiter's turn to read
+                Channel<uint8_t, 1> ready{(uint8_t) 0};
+            };
+
+            struct mux_t {
+                // commands waiting to be written
+                OBuffer                 txq{1024};
+                // waiters in the order their commands were queued
+                std::deque<waiter_t*>   inflight;
+                bool                    flushing{false};
+                bool                    reading{false};
+                bool                    broken{false};
+                // coroutines sending commands on the connection
+                size_t                  users{0};
+                // invoked when the last user is done, \see BaseClient::retire
+                std::function<void()>   retired{nullptr};
+            };
+
+            Response muxsend(Commmand& cmd, size_t nreply);
+
+            bool muxflush();
+
+            void muxread(waiter_t& w);
+
+            void muxabort(waiter_t *self);
+
+            std::unique_ptr<mux_t> mux{nullptr};
         };
 
         template <typename Sock>
@@ -615,11 +878,7 @@ namespace suil {
         struct RedisDb : LOGGER(REDIS) {
         private:
             using ConnectedClients = std::list<Client<Proto>>;
-            struct cache_handle_t final {
-                typename ConnectedClients::iterator it;
-                int64_t           alive{0};
-            };
-            using ClientCache = std::deque<cache_handle_t>;
+            using ClientId = typename ConnectedClients::iterator;
 
         public:
 
@@ -628,6 +887,7 @@ namespace suil {
                 : addr(ipremote(host, port, 0, utils::after(3000)))
             {
                 utils::apply_config(config, args...);
+                setup();
             }
 
             RedisDb()
@@ -637,34 +897,109 @@ namespace suil {
             void configure(const char *host, int port, Opts& opts) {
                 addr = ipremote(host, port, 0, utils::after(3000));
                 utils::apply_options(Ego.config, opts);
+                setup();
             }
 
+            /**
+             * Gets a client from the connection pool, waiting up to \see redisdb_config::pool_wait
+             * for a connection when \see redisdb_config::pool_size connections are in use. The
+             * client is returned to the pool when it's closed
+             *
+             * @param db the database to select on the connection
+             */
             Client<Proto>& connect(int db = 0) {
-                Proto proto;
-                auto it = fromCache();
-                if (it == Ego.clients.end()) {
-                    it = newConnection();
+                ClientId it;
+                if (!Ego.pool.acquire(it)) {
+                    throw Exception::create("redis - connection pool exhausted, ",
+                                            Ego.pool.size(), " connections in use");
                 }
 
                 Client<Proto>& cli = *it;
-                // ensure that the server is accepting commands
-                if (!cli.ping()) {
-                    throw Exception::create("redis - ping Request failed");
-                }
 
                 if (db != 0) {
                     itrace("changing database to %d", db);
                     auto resp = cli("SELECT", 1);
                     if (!resp) {
+                        Ego.pool.release(std::move(it), false);
                         throw Exception::create(
                                 "redis - changing to selected database '",
                                 db, "' failed: ", resp.error());
                     }
                 }
 
+                track(cli, db);
                 return cli;
             }
 
+            /**
+             * Gets a client whose connection is shared by all the coroutines of the
+             * worker, \see BaseClient::multiplex. The client must not be closed
+             * by the caller.
+             *
+             * @param db the database the shared connection uses
+             */
+            Client<Proto>& shared(int db = 0) {
+                while (Ego.muxing.count(db)) {
+                    // another coroutine is opening the shared connection
+                    msleep(utils::after(1));
+                }
+
+                auto it = Ego.muxed.find(db);
+                if (it != Ego.muxed.end()) {
+                    if (!it->second->broken()) {
+                        track(*it->second, db);
+                        return *it->second;
+                    }
+
+                    // coroutines still waiting on a broken connection keep a reference to it
+                    ClientId broken = it->second;
+                    Ego.muxed.erase(it);
+                    broken->retire([this, broken]() { Ego.clients.erase(broken); });
+                }
+
+                Ego.muxing.insert(db);
+                ClientId cit;
+                try {
+                    cit = newConnection();
+                    // shared connections are never returned to the cache
+                    cit->closeHandler = nullptr;
+                    if (db != 0) {
+                        auto resp = (*cit)("SELECT", db);
+                        if (!resp) {
+                            Ego.clients.erase(cit);
+                            throw Exception::create(
+                                    "redis - changing to selected database '",
+                                    db, "' failed: ", resp.error());
+                        }
+                    }
+                }
+                catch (...) {
+                    Ego.muxing.erase(db);
+                    throw;
+                }
+
+                cit->multiplex();
+                Ego.muxed.emplace(db, cit);
+                Ego.muxing.erase(db);
+                itrace("opened shared redis connection to database %d", db);
+                track(*cit, db);
+                return *cit;
+            }
+
+            /**
+             * @return the counters of the client side cache, \see redisdb_config::near_cache
+             */
+            NearCache::stats_t cachestats() const {
+                return Ego.tracker? Ego.tracker->cache.stats() : NearCache::stats_t{};
+            }
+
+            /**
+             * @return the counters of the connection pool
+             */
+            pool_stats poolstats() const {
+                return Ego.pool.stats();
+            }
+
             const ServerInfo& getinfo(Client<Proto>& cli, bool refresh = true) {
                 if (refresh || !srvinfo.version) {
                     if (!cli.info(srvinfo)) {
@@ -675,34 +1010,155 @@ namespace suil {
             }
 
             ~RedisDb() {
-                if (cleaning) {
-                    /* unschedule the cleaning coroutine */
-                    itrace("notifying cleanup routine to exit");
-                    !notify;
+                if (Ego.tracker) {
+                    // the invalidations coroutine exits on its next wake up
+                    Ego.tracker->stop = true;
                 }
 
-                itrace("cleaning up %lu connections", Ego.cache.size());
-                auto it = Ego.cache.begin();
-
-                while (it != Ego.cache.end()) {
-                    Ego.clients.erase(it->it);
-                    Ego.cache.erase(it);
-                    it = Ego.cache.begin();
+                Ego.pool.clear();
+                itrace("cleaning up %lu connections", Ego.clients.size());
+                for (auto& cli: Ego.clients) {
+                    // the clients would otherwise remove themselves from the list being cleared
+                    cli.closeHandler = nullptr;
                 }
                 Ego.clients.clear();
             }
 
         private:
-            typename ConnectedClients::iterator fromCache() {
-                if (!Ego.cache.empty()) {
-                    auto handle = Ego.cache.front();
-                    Ego.cache.pop_front();
-                    return handle.it;
+            struct tracker_t : std::enable_shared_from_this<tracker_t> {
+                tracker_t(const redisdb_config& config)
+                    : cache(config.near_cache),
+                      config(config)
+                {}
+
+                NearCache       cache;
+                // the connection receiving the invalidation messages
+                std::unique_ptr<Client<Proto>> conn{nullptr};
+                redisdb_config  config;
+                int64_t         id{-1};
+                bool            opening{false};
+                bool            unsupported{false};
+                bool            stop{false};
+            };
+
+            /**
+             * Attaches the client side cache to \param cli, enabling tracking on
+             * its connection if it hasn't been enabled since the invalidation
+             * connection was last (re)opened
+             */
+            void track(Client<Proto>& cli, int db) {
+                cli.near = nullptr;
+                if (Ego.config.near_cache == 0 || db != 0) {
+                    // invalidation messages do not name the database
+                    return;
+                }
+
+                if (!Ego.tracker) {
+                    Ego.tracker = std::make_shared<tracker_t>(Ego.config);
+                }
+                auto tr = Ego.tracker;
+                while (tr->opening) {
+                    // another coroutine is opening the invalidation connection
+                    msleep(utils::after(1));
                 }
-                return Ego.clients.end();
+                if (tr->unsupported || (!tr->cache.tracking && !listen(tr))) {
+                    return;
+                }
+
+                if (cli.nearEpoch != tr->cache.epoch) {
+                    auto resp = cli("CLIENT", "TRACKING", "on", "REDIRECT", tr->id);
+                    if (!resp) {
+                        iwarn("enabling client side caching failed: %s", resp.error());
+                        // server errors are permanent, e.g redis < 6
+                        tr->unsupported = strncmp(resp.error(), "ERR", 3) == 0;
+                        return;
+                    }
+                    cli.nearEpoch = tr->cache.epoch;
+                }
+                cli.near = &tr->cache;
             }
 
-            typename ConnectedClients::iterator newConnection() {
+            bool listen(std::shared_ptr<tracker_t>& tr) {
+                tr->opening = true;
+                defer(opening, { tr->opening = false; });
+
+                Proto proto;
+                if (!proto.connect(addr, Ego.config.timeout)) {
+                    iwarn("opening redis invalidation connection failed: %s", errno_s);
+                    return false;
+                }
+                auto conn = std::make_unique<Client<Proto>>(std::move(proto), tr->config, nullptr);
+                if (!Ego.config.passwd.empty() && !conn->auth(Ego.config.passwd.c_str())) {
+                    iwarn("redis - authorizing invalidation connection failed");
+                    return false;
+                }
+
+                auto id = conn->send("CLIENT", "ID");
+                if (!id) {
+                    iwarn("redis - CLIENT ID failed: %s", id.error());
+                    tr->unsupported = true;
+                    return false;
+                }
+                auto sub = conn->send("SUBSCRIBE", "__redis__:invalidate");
+                if (!sub) {
+                    iwarn("redis - subscribing to invalidations failed: %s", sub.error());
+                    return false;
+                }
+
+                tr->id = (int64_t) id;
+                tr->conn = std::move(conn);
+                tr->cache.clear();
+                tr->cache.epoch++;
+                tr->cache.tracking = true;
+                itrace("receiving redis invalidations on connection %ld", tr->id);
+                go(invalidations(tr.get()));
+                return true;
+            }
+
+            static coroutine void invalidations(tracker_t *self) {
+                // keeps the cache alive if the database is destroyed before the coroutine exits
+                auto tr = self->shared_from_this();
+                while (!tr->stop) {
+                    Response msg;
+                    if (!tr->conn->recvresp(msg, 1, 1000)) {
+                        if (errno == ETIMEDOUT && tr->conn->adaptor().isopen()) {
+                            continue;
+                        }
+                        // invalidations could have been missed, nothing cached can be trusted
+                        lwarn(tr->conn.get(), "redis invalidation connection failed: %s", errno_s);
+                        break;
+                    }
+
+                    // ["message", "__redis__:invalidate", [keys...]], the keys are null on FLUSHALL
+                    std::vector<String> parts = msg;
+                    if (parts.size() < 3 || parts[0].compare("message") != 0) {
+                        continue;
+                    }
+                    if (parts.size() == 3) {
+                        tr->cache.clear();
+                    }
+                    for (size_t i = 3; i < parts.size(); i++) {
+                        if (!parts[i].empty()) {
+                            tr->cache.invalidate(parts[i]);
+                        }
+                    }
+                }
+
+                tr->cache.clear();
+                tr->cache.tracking = false;
+                tr->conn = nullptr;
+            }
+
+            void setup() {
+                Ego.pool.config.max        = Ego.config.pool_size;
+                Ego.pool.config.min_idle   = Ego.config.min_idle;
+                Ego.pool.config.keep_alive = (int64_t) Ego.config.keep_alive;
+                Ego.pool.config.wait       = Ego.config.pool_wait;
+                Ego.pool.config.check_idle = Ego.config.check_idle;
+                Ego.pool.warmup();
+            }
+
+            ClientId newConnection() {
                 Proto proto;
                 itrace("opening redis Connection");
                 if (!proto.connect(addr, Ego.config.timeout)) {
@@ -720,6 +1176,7 @@ namespace suil {
                 if (!config.passwd.empty()) {
                     // authenticate
                     if (!it->auth(config.passwd.c_str())) {
+                        closeConnection(it);
                         throw Exception::create("redis - authorizing client failed");
                     }
                 }
@@ -728,83 +1185,29 @@ namespace suil {
                 return it;
             }
 
-            void returnConnection(typename ConnectedClients::iterator it, bool dctor) {
-                cache_handle_t entry{it, -1};
-                if (!dctor && (config.keep_alive != 0)) {
-                    entry.alive = mnow() + Ego.config.keep_alive;
-                    cache.push_back(std::move(entry));
-                    if (!Ego.cleaning) {
-                        // schedule cleanup routine
-                        go(cleanup(Ego));
-                    }
-                }
-                else if (it != clients.end()){
-                    // caching not supported, delete client
-                    it->closeHandler = nullptr;
-                    clients.erase(it);
-                }
+            void returnConnection(ClientId it, bool dctor) {
+                Ego.pool.release(std::move(it), !dctor);
             }
 
-            static coroutine void cleanup(RedisDb<Proto>& db) {
-                bool status;
-                int64_t expires = db.config.keep_alive + 5;
-                if (db.cache.empty())
-                    return;
-
-                db.cleaning = true;
-                do {
-                    uint8_t status{0};
-                    if (db.notify[expires] >> status) {
-                        if (status == 1) break;
-                    }
-
-                    /* was not forced to exit */
-                    auto it = db.cache.begin();
-                    /* un-register all expired connections and all that will expire in the
-                     * next 500 ms */
-                    int64_t t = mnow() + 500;
-                    int pruned = 0;
-                    ltrace(&db, "starting prune with %ld connections", db.cache.size());
-                    while (it != db.cache.end()) {
-                        if ((*it).alive <= t) {
-                            if (db.isValid(it->it)) {
-                                it->it->closeHandler = nullptr;
-                                db.clients.erase(it->it);
-                            }
-                            db.cache.erase(it);
-                            it = db.cache.begin();
-                        } else {
-                            /* there is no point in going forward */
-                            break;
-                        }
-
-                        if ((++pruned % 100) == 0) {
-                            /* avoid hogging the CPU */
-                            yield();
-                        }
-                    }
-                    ltrace(&db, "pruned %ld connections", pruned);
-
-                    if (it != db.cache.end()) {
-                        /*ensure that this will run after at least 3 second*/
-                        expires = std::max((*it).alive - t, (int64_t)3000);
-                    }
-                } while (!db.cache.empty());
-
-                db.cleaning = false;
-            }
-
-            inline bool isValid(typename ConnectedClients::iterator& it) {
-                return (it != typename ConnectedClients::iterator{nullptr}) && it != clients.end();
+            void closeConnection(ClientId& it) {
+                if (it != ClientId{nullptr} && it != Ego.clients.end()) {
+                    it->closeHandler = nullptr;
+                    Ego.clients.erase(it);
+                }
             }
 
             ConnectedClients     clients;
-            ClientCache          cache;
+            Pool<ClientId>       pool{
+                    [this]() { return Ego.newConnection(); },
+                    [this](ClientId& it) { Ego.closeConnection(it); },
+                    // ensure that the server is still accepting commands, \see redisdb_config::check_idle
+                    [this](ClientId& it) { return it->ping(); }};
+            std::unordered_map<int, ClientId> muxed;
+            std::unordered_set<int> muxing;
             ipaddr         addr;
             redisdb_config config{1500, ""};
             ServerInfo    srvinfo;
-            Channel<uint8_t>  notify{1};
-            bool           cleaning{false};
+            std::shared_ptr<tracker_t> tracker{nullptr};
         };
 
         struct Transaction : LOGGER(REDIS) {
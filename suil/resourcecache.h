@@ -5,144 +5,122 @@
 #ifndef SUIL_RESOURCECACHE_H
 #define SUIL_RESOURCECACHE_H
 
-#include <suil/channel.h>
-#include <suil/logging.h>
+#include <suil/pool.h>
 
 #include <list>
-#include <deque>
 
 namespace suil {
 
     template <typename Resource>
+    struct ResourceCache;
+
+    /**
+     * Base of resources managed by a \see ResourceCache, closing the
+     * resource returns it to the cache
+     */
+    template <typename Resource>
     struct Cacheable {
-        using CacheId = typename std::list<Resource>;
+        using CacheId = typename std::list<Resource>::iterator;
         using CloseHandler = std::function<void(CacheId, bool)>;
 
-        Cacheable(CacheId id, CloseHandler closeHandler = nullptr)
-            : id(id),
-              closeHandler(closeHandler)
+        Cacheable(CloseHandler closeHandler = nullptr)
+            : closeHandler(closeHandler)
         {}
 
+        void onClose(CloseHandler handler) {
+            closeHandler = handler;
+        }
+
         void close() {
             if (closeHandler != nullptr && id != CacheId{nullptr}) {
+                closeHandler(id, false);
             }
         }
 
     private:
+        template <typename R>
+        friend struct ResourceCache;
         CloseHandler  closeHandler;
         CacheId       id{nullptr};
     };
 
+    /**
+     * Keeps resources deriving \see Cacheable in a bounded \see Pool, the
+     * cache opens resources with \see ResourceCache::open when the pool
+     * has no idle resource
+     */
     template <typename Resource>
     struct ResourceCache {
         virtual ~ResourceCache() {
-            if (cleaning) {
-                /* unschedule the cleaning coroutine */
-                strace("notifying cleanup routine to exit");
-                !notify;
-            }
-
-            strace("cleaning up %lu connections", Ego.cache.size());
-            auto it = Ego.cache.begin();
-
-            while (it != Ego.cache.end()) {
-                Ego.inflight.erase(it->it);
-                Ego.cache.erase(it);
-                it = Ego.cache.begin();
+            strace("cleaning up %lu cached resources", Ego.inflight.size());
+            Ego.pool.clear();
+            for (auto& res: Ego.inflight) {
+                // resources in use can no longer be returned
+                res.closeHandler = nullptr;
             }
             Ego.inflight.clear();
         }
 
+        /**
+         * @return the counters of the underlying pool
+         */
+        pool_stats stats() const {
+            return Ego.pool.stats();
+        }
+
     protected:
         using InflightResources = std::list<Resource>;
         using CacheId = typename InflightResources::iterator;
-        struct cache_handle_t final {
-            CacheId         id;
-            int64_t         alive;
-        };
-        using CacheEntries = std::deque<cache_handle_t>;
 
-    protected:
-        CacheId fromCache() {
-            if (!Ego.cache.empty()) {
-                auto handle = cache.front();
-                cache.pop_front();
-                return handle.id;
+        ResourceCache()
+            : pool([this]() { return Ego.addResource(Ego.open()); },
+                   [this](CacheId& id) { Ego.removeResource(id); },
+                   [this](CacheId& id) { return Ego.healthy(*id); })
+        {}
+
+        /**
+         * opens a new resource, invoked when the pool has no idle resource
+         * @throws an exception if the resource cannot be opened
+         */
+        virtual Resource open() = 0;
+
+        /**
+         * @return false if the idle resource \param res should be discarded
+         */
+        virtual bool healthy(Resource& res) {
+            return true;
+        }
+
+        /**
+         * @param timeout how long to wait if the pool is exhausted
+         * @return a resource from the cache, or `inflight.end()` if none
+         * was returned to the cache before \param timeout
+         */
+        CacheId fromCache(int64_t timeout = 0) {
+            CacheId id;
+            if (Ego.pool.acquire(id, timeout)) {
+                return id;
             }
             return Ego.inflight.end();
         }
 
         CacheId addResource(Resource&& resource) {
-            resource.onClose(std::bind(&ResourceCache::returnResource,
+            auto id = Ego.inflight.insert(Ego.inflight.end(), std::move(resource));
+            id->id = id;
+            id->onClose(std::bind(&ResourceCache::returnResource,
                     this, std::placeholders::_1, std::placeholders::_2));
-            auto id = Ego.inflight.insert(Ego.inflight.back(), std::move(resource));
             return id;
         }
 
-        void returnResource(CacheId  id, bool dctor) {
-            cache_handle_t entry{id, -1};
-            if (!dctor && (keepAlive != 0)) {
-                entry.alive = mnow() + keepAlive;
-                cache.push_back(std::move(entry));
-                if (!Ego.cleaning) {
-                    // schedule cleanup routine
-                    go(cleanup(Ego));
-                }
-            }
-            else if (id != Ego.inflight.end()){
-                // caching not supported, delete client
+        void removeResource(CacheId& id) {
+            if (isValid(id)) {
                 id->closeHandler = nullptr;
                 Ego.inflight.erase(id);
             }
         }
 
-        static coroutine void cleanup(ResourceCache<Resource>& rc) {
-            bool status;
-            int64_t expires = rc.keepAlive + 5;
-            if (rc.cache.empty())
-                return;
-
-            rc.cleaning = true;
-            do {
-                uint8_t status{0};
-                if (rc.notify[expires] >> status) {
-                    if (status == 1) break;
-                }
-
-                /* was not forced to exit */
-                auto it = rc.cache.begin();
-                /* un-register all expired connections and all that will expire in the
-                 * next 500 ms */
-                int64_t t = mnow() + 500;
-                int pruned = 0;
-                strace("starting prune with %ld connections", rc.cache.size());
-                while (it != rc.cache.end()) {
-                    if ((*it).alive <= t) {
-                        if (rc.isValid(it->id)) {
-                            it->id->onClose(nullptr);
-                            rc.inflight.erase(it->it);
-                        }
-                        rc.cache.erase(it);
-                        it = rc.cache.begin();
-                    } else {
-                        /* there is no point in going forward */
-                        break;
-                    }
-
-                    if ((++pruned % 100) == 0) {
-                        /* avoid hogging the CPU */
-                        yield();
-                    }
-                }
-                strace("pruned %ld connections", pruned);
-
-                if (it != rc.cache.end()) {
-                    /*ensure that this will run after at least 3 second*/
-                    expires = std::max((*it).alive - t, (int64_t)3000);
-                }
-            } while (!rc.cache.empty());
-
-            rc.cleaning = false;
+        void returnResource(CacheId id, bool dctor) {
+            Ego.pool.release(std::move(id), !dctor);
         }
 
         inline bool isValid(CacheId& it) {
@@ -150,10 +128,7 @@ namespace suil {
         }
 
         InflightResources   inflight;
-        CacheEntries        cache;
-        Channel<uint8_t>    notify{1};
-        bool                cleaning{false};
-        int64_t             keepAlive{0};
+        Pool<CacheId>       pool;
     };
 
 }
@@ -0,0 +1,1030 @@
+//
+// Created by dc on 18/10/26.
+//
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SUIL_SIMD_X86
+#endif
+
+#include <cassert>
+
+#include "simd.h"
+
+namespace suil::simd {
+
+    static inline bool inranges(uint8_t c, const char *ranges, size_t nranges) {
+        for (size_t i = 0; i+1 < nranges; i += 2) {
+            if (c >= (uint8_t) ranges[i] && c <= (uint8_t) ranges[i+1])
+                return true;
+        }
+        return false;
+    }
+
+    static const char *scalar_findranges(const char *p, const char *end, const char *ranges, size_t nranges) {
+        for (; p < end; p++) {
+            if (inranges((uint8_t) *p, ranges, nranges))
+                break;
+        }
+        return p;
+    }
+
+#ifdef SUIL_SIMD_X86
+    __attribute__((target("sse4.2")))
+    static const char *sse42_findranges(const char *p, const char *end, const char *ranges, size_t nranges) {
+        uint8_t tmp[16] = {0};
+        memcpy(tmp, ranges, nranges);
+        __m128i rr = _mm_loadu_si128((const __m128i *) tmp);
+        while ((end - p) >= 16) {
+            __m128i b = _mm_loadu_si128((const __m128i *) p);
+            int idx = _mm_cmpestri(rr, (int) nranges, b, 16,
+                    _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
+            if (idx != 16)
+                return p + idx;
+            p += 16;
+        }
+        return scalar_findranges(p, end, ranges, nranges);
+    }
+
+    __attribute__((target("avx2")))
+    static const char *avx2_findranges(const char *p, const char *end, const char *ranges, size_t nranges) {
+        // x is within [lo, hi] iff (x - lo) <= (hi - lo), unsigned
+        __m256i lo[8], span[8];
+        size_t n = nranges >> 1;
+        for (size_t i = 0; i < n; i++) {
+            lo[i]   = _mm256_set1_epi8(ranges[i<<1]);
+            span[i] = _mm256_set1_epi8((char) ((uint8_t) ranges[(i<<1)+1] - (uint8_t) ranges[i<<1]));
+        }
+
+        while ((end - p) >= 32) {
+            __m256i b = _mm256_loadu_si256((const __m256i *) p);
+            __m256i m = _mm256_setzero_si256();
+            for (size_t i = 0; i < n; i++) {
+                __m256i d = _mm256_sub_epi8(b, lo[i]);
+                m = _mm256_or_si256(m, _mm256_cmpeq_epi8(_mm256_min_epu8(d, span[i]), d));
+            }
+            uint32_t mask = (uint32_t) _mm256_movemask_epi8(m);
+            if (mask)
+                return p + __builtin_ctz(mask);
+            p += 32;
+        }
+        return sse42_findranges(p, end, ranges, nranges);
+    }
+#endif
+
+    /* Stage 1 of the JSON decoder: 64 byte blocks are classified into bitmaps
+     * (one bit per byte) by an instruction set specific kernel, the bitmaps
+     * are then reduced to the structural positions with scalar bit arithmetic
+     * shared by all the kernels (https://arxiv.org/abs/1902.08318) */
+    struct jsonblock_t {
+        uint64_t bs;      // backslashes
+        uint64_t quote;   // double quotes
+        uint64_t op;      // {}[]:,
+        uint64_t ws;      // space, \t, \n, \r
+        uint64_t ctrl;    // bytes < 0x20
+        uint64_t high;    // bytes >= 0x80
+    };
+
+    typedef void (*jsonclassify_t)(const uint8_t *, jsonblock_t&);
+
+    enum : uint8_t { JBS = 1, JQUOTE = 2, JOP = 4, JWS = 8, JCTRL = 16, JHIGH = 32 };
+
+    static const struct jsonclasses_t {
+        uint8_t tab[256];
+        jsonclasses_t() : tab{} {
+            for (int c = 0; c < 0x20; c++) tab[c] = JCTRL;
+            for (int c = 0x80; c < 0x100; c++) tab[c] = JHIGH;
+            for (const char *c = "{}[]:,"; *c != '\0'; c++) tab[(uint8_t) *c] = JOP;
+            tab['\\'] = JBS; tab['"'] = JQUOTE;
+            tab[' '] = JWS; tab['\t'] |= JWS; tab['\n'] |= JWS; tab['\r'] |= JWS;
+        }
+    } JSON_CLASSES;
+
+    static void scalar_jsonclassify(const uint8_t *p, jsonblock_t& b) {
+        uint64_t m[6] = {0};
+        for (int i = 0; i < 64; i++) {
+            uint8_t c = JSON_CLASSES.tab[p[i]];
+            for (int k = 0; k < 6; k++)
+                m[k] |= (uint64_t) ((c >> k) & 1) << i;
+        }
+        b = {m[0], m[1], m[2], m[3], m[4], m[5]};
+    }
+
+#ifdef SUIL_SIMD_X86
+    __attribute__((target("sse4.2")))
+    static void sse42_jsonclassify(const uint8_t *p, jsonblock_t& b) {
+        const __m128i bs = _mm_set1_epi8('\\'), quote = _mm_set1_epi8('"'),
+                      ctrl = _mm_set1_epi8(0x1f);
+        b = {};
+        for (int i = 0; i < 64; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *) &p[i]);
+            __m128i op = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('{')), _mm_cmpeq_epi8(v, _mm_set1_epi8('}'))),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+            op = _mm_or_si128(op, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('[')), _mm_cmpeq_epi8(v, _mm_set1_epi8(']'))));
+            __m128i ws = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+            b.bs    |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, bs)) << i;
+            b.quote |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << i;
+            b.op    |= (uint64_t) (uint16_t) _mm_movemask_epi8(op) << i;
+            b.ws    |= (uint64_t) (uint16_t) _mm_movemask_epi8(ws) << i;
+            b.ctrl  |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v)) << i;
+            b.high  |= (uint64_t) (uint16_t) _mm_movemask_epi8(v) << i;
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static void avx2_jsonclassify(const uint8_t *p, jsonblock_t& b) {
+        const __m256i bs = _mm256_set1_epi8('\\'), quote = _mm256_set1_epi8('"'),
+                      ctrl = _mm256_set1_epi8(0x1f);
+        b = {};
+        for (int i = 0; i < 64; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *) &p[i]);
+            __m256i op = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('}'))),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+            op = _mm256_or_si256(op, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('[')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(']'))));
+            __m256i ws = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+            b.bs    |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, bs)) << i;
+            b.quote |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)) << i;
+            b.op    |= (uint64_t) (uint32_t) _mm256_movemask_epi8(op) << i;
+            b.ws    |= (uint64_t) (uint32_t) _mm256_movemask_epi8(ws) << i;
+            b.ctrl  |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(v, ctrl), v)) << i;
+            b.high  |= (uint64_t) (uint32_t) _mm256_movemask_epi8(v) << i;
+        }
+    }
+#endif
+
+    static inline uint64_t prefix_xor(uint64_t x) {
+        // bit i becomes the parity of bits [0, i]
+        x ^= x << 1; x ^= x << 2; x ^= x << 4;
+        x ^= x << 8; x ^= x << 16; x ^= x << 32;
+        return x;
+    }
+
+    static bool utf8valid(const uint8_t *p, const uint8_t *end) {
+        while (p < end) {
+            if ((end - p) >= 8) {
+                uint64_t w;
+                memcpy(&w, p, 8);
+                if ((w & 0x8080808080808080ULL) == 0) {
+                    p += 8;
+                    continue;
+                }
+            }
+            uint8_t c = *p;
+            if (c < 0x80) { p++; continue; }
+            size_t n;
+            uint32_t cp, min;
+            if ((c & 0xe0) == 0xc0)      { n = 1; cp = c & 0x1f; min = 0x80; }
+            else if ((c & 0xf0) == 0xe0) { n = 2; cp = c & 0x0f; min = 0x800; }
+            else if ((c & 0xf8) == 0xf0) { n = 3; cp = c & 0x07; min = 0x10000; }
+            else return false;
+            if ((size_t) (end - p) <= n)
+                return false;
+            for (size_t i = 1; i <= n; i++) {
+                if ((p[i] & 0xc0) != 0x80)
+                    return false;
+                cp = (cp << 6) | (p[i] & 0x3f);
+            }
+            // overlong encodings, surrogates and code points past U+10FFFF
+            if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+                return false;
+            p += n+1;
+        }
+        return true;
+    }
+
+    static bool jsonindex(jsonclassify_t classify, const char *p, size_t len, std::vector<uint32_t>& idx) {
+        // a document has at most one structural per byte
+        idx.resize(len + 64);
+        uint32_t *out = idx.data();
+        uint64_t prevEscaped{0}, prevInString{0}, prevScalar{0}, ctrlInString{0};
+        const uint8_t *high{nullptr};
+        const auto *s = (const uint8_t *) p;
+        jsonblock_t b{};
+        uint8_t tail[64];
+
+        for (size_t off = 0; off < len; off += 64) {
+            const uint8_t *blk = &s[off];
+            if ((len - off) < 64) {
+                // pad the last block with spaces, they are never structural
+                memset(tail, ' ', sizeof(tail));
+                memcpy(tail, blk, len - off);
+                blk = tail;
+            }
+            classify(blk, b);
+            if (b.high && high == nullptr)
+                high = &s[off];
+
+            // characters preceded by an odd sequence of backslashes are escaped
+            uint64_t bs = b.bs & ~prevEscaped;
+            uint64_t followsEscape = (bs << 1) | prevEscaped;
+            const uint64_t even = 0x5555555555555555ULL;
+            uint64_t oddStarts = bs & ~even & ~followsEscape, evenSeqs;
+            prevEscaped = __builtin_add_overflow(oddStarts, bs, &evenSeqs);
+            uint64_t escaped = (even ^ (evenSeqs << 1)) & followsEscape;
+
+            // strings span from their opening quote up to (excluding) their closing quote
+            uint64_t quote = b.quote & ~escaped;
+            uint64_t inString = prefix_xor(quote) ^ prevInString;
+            prevInString = (uint64_t) ((int64_t) inString >> 63);
+            ctrlInString |= b.ctrl & inString & ~quote;
+
+            // every other token starts where a run of non-structural bytes starts
+            uint64_t op = b.op & ~inString;
+            uint64_t scalar = ~(op | b.ws | quote | inString);
+            uint64_t starts = scalar & ~((scalar << 1) | prevScalar);
+            prevScalar = scalar >> 63;
+
+            uint64_t bits = op | quote | starts;
+            auto base = (uint32_t) off;
+            while (bits) {
+                *out++ = base + __builtin_ctzll(bits);
+                bits &= bits - 1;
+            }
+        }
+
+        idx.resize(out - idx.data());
+        if (prevInString || ctrlInString)
+            return false;
+        return (high == nullptr) || utf8valid(high, &s[len]);
+    }
+
+    /* Base64 and hex codecs. The vector kernels follow W. Muła and D. Lemire,
+     * "Faster Base64 Encoding and Decoding Using AVX2 Instructions"
+     * (https://arxiv.org/abs/1704.00605), each one handing its tail to the
+     * next narrower kernel */
+    static const char B64_CHARS[2][65] = {
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+    };
+
+    static const struct b64values_t {
+        // 0x40 flags characters outside the alphabet
+        uint8_t tab[2][256];
+        b64values_t() {
+            memset(tab, 0x40, sizeof(tab));
+            for (uint8_t i = 0; i < 64; i++) {
+                tab[0][(uint8_t) B64_CHARS[0][i]] = i;
+                tab[1][(uint8_t) B64_CHARS[1][i]] = i;
+            }
+        }
+    } B64_VALUES;
+
+    static const char HEX_CHARS[2][17] = {"0123456789abcdef", "0123456789ABCDEF"};
+
+    static const struct hexvalues_t {
+        // 0xff flags non hex digits
+        uint8_t tab[256];
+        hexvalues_t() {
+            memset(tab, 0xff, sizeof(tab));
+            for (uint8_t i = 0; i < 16; i++) {
+                tab[(uint8_t) HEX_CHARS[0][i]] = i;
+                tab[(uint8_t) HEX_CHARS[1][i]] = i;
+            }
+        }
+    } HEX_VALUES;
+
+    static void scalar_b64encode(const uint8_t *in, size_t len, char *out, bool url) {
+        const char *chars = B64_CHARS[url];
+        for (const uint8_t *end = in + len; in < end; in += 3) {
+            uint32_t v = (uint32_t) in[0] << 16 | (uint32_t) in[1] << 8 | in[2];
+            *out++ = chars[v >> 18];
+            *out++ = chars[(v >> 12) & 0x3F];
+            *out++ = chars[(v >> 6) & 0x3F];
+            *out++ = chars[v & 0x3F];
+        }
+    }
+
+    static bool scalar_b64decode(const char *in, size_t len, uint8_t *out, bool url) {
+        const uint8_t *values = B64_VALUES.tab[url];
+        for (const char *end = in + len; in < end; in += 4) {
+            uint8_t a = values[(uint8_t) in[0]], b = values[(uint8_t) in[1]],
+                    c = values[(uint8_t) in[2]], d = values[(uint8_t) in[3]];
+            if ((a | b | c | d) & 0x40)
+                return false;
+            *out++ = (uint8_t) (a << 2 | b >> 4);
+            *out++ = (uint8_t) (b << 4 | c >> 2);
+            *out++ = (uint8_t) (c << 6 | d);
+        }
+        return true;
+    }
+
+    static void scalar_hexencode(const uint8_t *in, size_t len, char *out, bool caps) {
+        const char *chars = HEX_CHARS[caps];
+        for (const uint8_t *end = in + len; in < end; in++) {
+            *out++ = chars[*in >> 4];
+            *out++ = chars[*in & 0x0F];
+        }
+    }
+
+    static bool scalar_hexdecode(const char *in, size_t len, uint8_t *out) {
+        for (uint8_t *end = out + len; out < end; in += 2) {
+            uint8_t hi = HEX_VALUES.tab[(uint8_t) in[0]], lo = HEX_VALUES.tab[(uint8_t) in[1]];
+            if ((hi | lo) == 0xff)
+                return false;
+            *out++ = (uint8_t) (hi << 4 | lo);
+        }
+        return true;
+    }
+
+    // decodes the byte, '+' or escape at \param p
+    static inline const char *urldecode1(const char *p, const char *end, char *& out) {
+        if (*p == '+') {
+            *out++ = ' ';
+            return p + 1;
+        }
+        if (*p == '%' && (end - p) > 2) {
+            uint8_t hi = HEX_VALUES.tab[(uint8_t) p[1]], lo = HEX_VALUES.tab[(uint8_t) p[2]];
+            if ((hi | lo) != 0xff) {
+                *out++ = (char) (hi << 4 | lo);
+                return p + 3;
+            }
+        }
+        *out++ = *p;
+        return p + 1;
+    }
+
+    static size_t scalar_urldecode(const char *in, size_t len, char *out) {
+        char *start = out;
+        for (const char *end = in + len; in < end;)
+            in = urldecode1(in, end, out);
+        return out - start;
+    }
+
+#ifdef SUIL_SIMD_X86
+    // 12 bytes (at offset 0 of each 128 bit lane) to their 16 base64 characters
+    __attribute__((target("sse4.2")))
+    static inline __m128i sse42_b64chars(__m128i in, bool url) {
+        in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i idx = _mm_or_si128(t0, t1);
+        // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+        __m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+        r = _mm_or_si128(r, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+        const __m128i shift = url?
+            _mm_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+                          '0'-52, '0'-52, '0'-52, '-'-62, '_'-63, 'A', 0, 0) :
+            _mm_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+                          '0'-52, '0'-52, '0'-52, '+'-62, '/'-63, 'A', 0, 0);
+        return _mm_add_epi8(_mm_shuffle_epi8(shift, r), idx);
+    }
+
+    __attribute__((target("sse4.2")))
+    static void sse42_b64encode(const uint8_t *in, size_t len, char *out, bool url) {
+        // the loads read 16 bytes to use 12
+        for (; len >= 16; len -= 12, in += 12, out += 16)
+            _mm_storeu_si128((__m128i *) out, sse42_b64chars(_mm_loadu_si128((const __m128i *) in), url));
+        scalar_b64encode(in, len, out, url);
+    }
+
+    __attribute__((target("avx2")))
+    static void avx2_b64encode(const uint8_t *in, size_t len, char *out, bool url) {
+        const __m256i shift = url?
+            _mm256_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+                             '0'-52, '0'-52, '0'-52, '-'-62, '_'-63, 'A', 0, 0,
+                             'a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+                             '0'-52, '0'-52, '0'-52, '-'-62, '_'-63, 'A', 0, 0) :
+            _mm256_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+                             '0'-52, '0'-52, '0'-52, '+'-62, '/'-63, 'A', 0, 0,
+                             'a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+                             '0'-52, '0'-52, '0'-52, '+'-62, '/'-63, 'A', 0, 0);
+        const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                                1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+        // two loads of 16 bytes, 12 of each used
+        for (; len >= 28; len -= 24, in += 24, out += 32) {
+            __m256i v = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) in)),
+                    _mm_loadu_si128((const __m128i *) &in[12]), 1);
+            v = _mm256_shuffle_epi8(v, spread);
+            __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)),
+                                            _mm256_set1_epi32(0x04000040));
+            __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)),
+                                            _mm256_set1_epi32(0x01000010));
+            __m256i idx = _mm256_or_si256(t0, t1);
+            __m256i r = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+            r = _mm256_or_si256(r, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx),
+                                                    _mm256_set1_epi8(13)));
+            _mm256_storeu_si256((__m256i *) out, _mm256_add_epi8(_mm256_shuffle_epi8(shift, r), idx));
+        }
+        sse42_b64encode(in, len, out, url);
+    }
+
+    /* 16 base64 characters to their 6 bit values, the lookups flag
+     * characters outside the alphabet and give the offset to add to
+     * the others, both indexed by nibble */
+    __attribute__((target("sse4.2")))
+    static inline __m128i sse42_b64values(__m128i v, bool url, __m128i& bad) {
+        if (url) {
+            // check for +/ then decode -_ as +/
+            bad = _mm_or_si128(bad, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('+')),
+                                                 _mm_cmpeq_epi8(v, _mm_set1_epi8('/'))));
+            v = _mm_add_epi8(v, _mm_and_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('-')), _mm_set1_epi8('+'-'-')));
+            v = _mm_add_epi8(v, _mm_and_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')), _mm_set1_epi8('/'-'_')));
+        }
+        const __m128i lo_bits = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                              0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m128i hi_bits = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                              0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m128i roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        __m128i hi = _mm_and_si128(_mm_srli_epi32(v, 4), _mm_set1_epi8(0x0F));
+        __m128i lo = _mm_and_si128(v, _mm_set1_epi8(0x0F));
+        bad = _mm_or_si128(bad, _mm_and_si128(_mm_shuffle_epi8(lo_bits, lo), _mm_shuffle_epi8(hi_bits, hi)));
+        // '/' shares its high nibble with '+' but not the offset
+        __m128i slash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+        return _mm_add_epi8(v, _mm_shuffle_epi8(roll, _mm_add_epi8(slash, hi)));
+    }
+
+    __attribute__((target("sse4.2")))
+    static bool sse42_b64decode(const char *in, size_t len, uint8_t *out, bool url) {
+        __m128i bad = _mm_setzero_si128();
+        // the stores write 16 bytes of which 12 are used, keep room for the other 4
+        for (; len >= 24; len -= 16, in += 16, out += 12) {
+            __m128i v = sse42_b64values(_mm_loadu_si128((const __m128i *) in), url, bad);
+            v = _mm_madd_epi16(_mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+            v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+            _mm_storeu_si128((__m128i *) out, v);
+        }
+        if (!_mm_testz_si128(bad, bad))
+            return false;
+        return scalar_b64decode(in, len, out, url);
+    }
+
+    __attribute__((target("avx2")))
+    static bool avx2_b64decode(const char *in, size_t len, uint8_t *out, bool url) {
+        const __m256i lo_bits = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                                 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                                 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                                 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m256i hi_bits = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                                 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                                 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                                 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m256i roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                              2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        __m256i bad = _mm256_setzero_si256();
+        // the stores write 32 bytes of which 24 are used, keep room for the other 8
+        for (; len >= 44; len -= 32, in += 32, out += 24) {
+            __m256i v = _mm256_loadu_si256((const __m256i *) in);
+            if (url) {
+                bad = _mm256_or_si256(bad, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('+')),
+                                                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'))));
+                v = _mm256_add_epi8(v, _mm256_and_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('-')),
+                                                        _mm256_set1_epi8('+'-'-')));
+                v = _mm256_add_epi8(v, _mm256_and_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')),
+                                                        _mm256_set1_epi8('/'-'_')));
+            }
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi32(v, 4), _mm256_set1_epi8(0x0F));
+            __m256i lo = _mm256_and_si256(v, _mm256_set1_epi8(0x0F));
+            bad = _mm256_or_si256(bad, _mm256_and_si256(_mm256_shuffle_epi8(lo_bits, lo),
+                                                        _mm256_shuffle_epi8(hi_bits, hi)));
+            __m256i slash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'));
+            v = _mm256_add_epi8(v, _mm256_shuffle_epi8(roll, _mm256_add_epi8(slash, hi)));
+            v = _mm256_madd_epi16(_mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140)),
+                                  _mm256_set1_epi32(0x00011000));
+            v = _mm256_shuffle_epi8(v, pack);
+            // bring the 12 bytes of the high lane next to those of the low one
+            v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+            _mm256_storeu_si256((__m256i *) out, v);
+        }
+        if (!_mm256_testz_si256(bad, bad))
+            return false;
+        return sse42_b64decode(in, len, out, url);
+    }
+
+    __attribute__((target("sse4.2")))
+    static void sse42_hexencode(const uint8_t *in, size_t len, char *out, bool caps) {
+        const __m128i chars = _mm_loadu_si128((const __m128i *) HEX_CHARS[caps]);
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        for (; len >= 16; len -= 16, in += 16, out += 32) {
+            __m128i v = _mm_loadu_si128((const __m128i *) in);
+            __m128i hi = _mm_shuffle_epi8(chars, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+            __m128i lo = _mm_shuffle_epi8(chars, _mm_and_si128(v, nibble));
+            _mm_storeu_si128((__m128i *) out, _mm_unpacklo_epi8(hi, lo));
+            _mm_storeu_si128((__m128i *) &out[16], _mm_unpackhi_epi8(hi, lo));
+        }
+        scalar_hexencode(in, len, out, caps);
+    }
+
+    __attribute__((target("avx2")))
+    static void avx2_hexencode(const uint8_t *in, size_t len, char *out, bool caps) {
+        const __m256i chars = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) HEX_CHARS[caps]));
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        for (; len >= 32; len -= 32, in += 32, out += 64) {
+            __m256i v = _mm256_loadu_si256((const __m256i *) in);
+            __m256i hi = _mm256_shuffle_epi8(chars, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+            __m256i lo = _mm256_shuffle_epi8(chars, _mm256_and_si256(v, nibble));
+            // the unpacks work within lanes, put the halves back in order
+            __m256i a = _mm256_unpacklo_epi8(hi, lo), b = _mm256_unpackhi_epi8(hi, lo);
+            _mm256_storeu_si256((__m256i *) out, _mm256_permute2x128_si256(a, b, 0x20));
+            _mm256_storeu_si256((__m256i *) &out[32], _mm256_permute2x128_si256(a, b, 0x31));
+        }
+        sse42_hexencode(in, len, out, caps);
+    }
+
+    // 16 hex digits to their values, flagging non digits in \param bad
+    __attribute__((target("sse4.2")))
+    static inline __m128i sse42_hexvalues(__m128i v, __m128i& bad) {
+        // digit iff c - '0' <= 9, letter iff (c | 0x20) - 'a' <= 5 (unsigned)
+        __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+        __m128i l = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        __m128i isd = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+        __m128i isl = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+        bad = _mm_or_si128(bad, _mm_andnot_si128(_mm_or_si128(isd, isl), _mm_set1_epi8(-1)));
+        v = _mm_blendv_epi8(_mm_add_epi8(l, _mm_set1_epi8(10)), d, isd);
+        // pairs of digits to bytes, in 16 bit lanes
+        return _mm_maddubs_epi16(v, _mm_set1_epi16(0x0110));
+    }
+
+    __attribute__((target("sse4.2")))
+    static bool sse42_hexdecode(const char *in, size_t len, uint8_t *out) {
+        __m128i bad = _mm_setzero_si128();
+        for (; len >= 16; len -= 16, in += 32, out += 16) {
+            __m128i a = sse42_hexvalues(_mm_loadu_si128((const __m128i *) in), bad);
+            __m128i b = sse42_hexvalues(_mm_loadu_si128((const __m128i *) &in[16]), bad);
+            _mm_storeu_si128((__m128i *) out, _mm_packus_epi16(a, b));
+        }
+        if (!_mm_testz_si128(bad, bad))
+            return false;
+        return scalar_hexdecode(in, len, out);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i avx2_hexvalues(__m256i v, __m256i& bad) {
+        __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+        __m256i l = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+        __m256i isd = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+        __m256i isl = _mm256_cmpeq_epi8(_mm256_min_epu8(l, _mm256_set1_epi8(5)), l);
+        bad = _mm256_or_si256(bad, _mm256_andnot_si256(_mm256_or_si256(isd, isl), _mm256_set1_epi8(-1)));
+        v = _mm256_blendv_epi8(_mm256_add_epi8(l, _mm256_set1_epi8(10)), d, isd);
+        return _mm256_maddubs_epi16(v, _mm256_set1_epi16(0x0110));
+    }
+
+    __attribute__((target("avx2")))
+    static bool avx2_hexdecode(const char *in, size_t len, uint8_t *out) {
+        __m256i bad = _mm256_setzero_si256();
+        for (; len >= 32; len -= 32, in += 64, out += 32) {
+            __m256i a = avx2_hexvalues(_mm256_loadu_si256((const __m256i *) in), bad);
+            __m256i b = avx2_hexvalues(_mm256_loadu_si256((const __m256i *) &in[32]), bad);
+            // the pack interleaves the lanes of a and b
+            __m256i v = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+            _mm256_storeu_si256((__m256i *) out, v);
+        }
+        if (!_mm256_testz_si256(bad, bad))
+            return false;
+        return sse42_hexdecode(in, len, out);
+    }
+
+    __attribute__((target("sse4.2")))
+    static size_t sse42_urldecode(const char *in, size_t len, char *out) {
+        const char *end = in + len;
+        char *start = out;
+        while ((end - in) >= 16) {
+            __m128i b = _mm_loadu_si128((const __m128i *) in);
+            int m = _mm_movemask_epi8(_mm_or_si128(
+                    _mm_cmpeq_epi8(b, _mm_set1_epi8('%')), _mm_cmpeq_epi8(b, _mm_set1_epi8('+'))));
+            // the whole block is stored (out never runs ahead of in), only
+            // the bytes before the first '%' or '+' are kept
+            _mm_storeu_si128((__m128i *) out, b);
+            if (m == 0) {
+                in += 16, out += 16;
+                continue;
+            }
+            const char *block = in + 16;
+            int n = __builtin_ctz((unsigned) m);
+            in += n, out += n;
+            in = urldecode1(in, end, out);
+            // escapes close together are cheaper to decode byte by byte
+            // than with a reload per escape
+            if (m & (m - 1)) {
+                while (in < block)
+                    in = urldecode1(in, end, out);
+            }
+        }
+        return (out - start) + scalar_urldecode(in, end - in, out);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t avx2_urldecode(const char *in, size_t len, char *out) {
+        const char *end = in + len;
+        char *start = out;
+        while ((end - in) >= 32) {
+            __m256i b = _mm256_loadu_si256((const __m256i *) in);
+            uint32_t m = (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(
+                    _mm256_cmpeq_epi8(b, _mm256_set1_epi8('%')), _mm256_cmpeq_epi8(b, _mm256_set1_epi8('+'))));
+            _mm256_storeu_si256((__m256i *) out, b);
+            if (m == 0) {
+                in += 32, out += 32;
+                continue;
+            }
+            const char *block = in + 32;
+            int n = __builtin_ctz(m);
+            in += n, out += n;
+            in = urldecode1(in, end, out);
+            if (m & (m - 1)) {
+                while (in < block)
+                    in = urldecode1(in, end, out);
+            }
+        }
+        return (out - start) + sse42_urldecode(in, end - in, out);
+    }
+#endif
+
+    static Isa detect() {
+#ifdef SUIL_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return Avx2;
+        if (__builtin_cpu_supports("sse4.2"))
+            return Sse42;
+#endif
+        return Scalar;
+    }
+
+    Isa isa() {
+        static Isa detected = detect();
+        return detected;
+    }
+
+    const char *name(Isa isa) {
+        switch (isa) {
+            case Avx2:  return "avx2";
+            case Sse42: return "sse4.2";
+            default:    return "scalar";
+        }
+    }
+
+    const char *findranges(Isa isa, const char *p, const char *end, const char *ranges, size_t nranges) {
+        assert(nranges <= 16 && (nranges & 1) == 0);
+        switch (isa) {
+#ifdef SUIL_SIMD_X86
+            case Avx2:
+                return avx2_findranges(p, end, ranges, nranges);
+            case Sse42:
+                return sse42_findranges(p, end, ranges, nranges);
+#endif
+            default:
+                return scalar_findranges(p, end, ranges, nranges);
+        }
+    }
+
+    const char *findranges(const char *p, const char *end, const char *ranges, size_t nranges) {
+        static const Isa ISA = isa();
+        return findranges(ISA, p, end, ranges, nranges);
+    }
+
+    bool jsonindex(Isa isa, const char *p, size_t len, std::vector<uint32_t>& idx) {
+        if (len > UINT32_MAX)
+            return false;
+        switch (isa) {
+#ifdef SUIL_SIMD_X86
+            case Avx2:
+                return jsonindex(avx2_jsonclassify, p, len, idx);
+            case Sse42:
+                return jsonindex(sse42_jsonclassify, p, len, idx);
+#endif
+            default:
+                return jsonindex(scalar_jsonclassify, p, len, idx);
+        }
+    }
+
+    bool jsonindex(const char *p, size_t len, std::vector<uint32_t>& idx) {
+        static const Isa ISA = isa();
+        return jsonindex(ISA, p, len, idx);
+    }
+
+    void b64encode(Isa isa, const uint8_t *in, size_t len, char *out, bool url) {
+        assert((len % 3) == 0);
+        switch (isa) {
+#ifdef SUIL_SIMD_X86
+            case Avx2:
+                return avx2_b64encode(in, len, out, url);
+            case Sse42:
+                return sse42_b64encode(in, len, out, url);
+#endif
+            default:
+                return scalar_b64encode(in, len, out, url);
+        }
+    }
+
+    void b64encode(const uint8_t *in, size_t len, char *out, bool url) {
+        static const Isa ISA = isa();
+        b64encode(ISA, in, len, out, url);
+    }
+
+    bool b64decode(Isa isa, const char *in, size_t len, uint8_t *out, bool url) {
+        assert((len % 4) == 0);
+        switch (isa) {
+#ifdef SUIL_SIMD_X86
+            case Avx2:
+                return avx2_b64decode(in, len, out, url);
+            case Sse42:
+                return sse42_b64decode(in, len, out, url);
+#endif
+            default:
+                return scalar_b64decode(in, len, out, url);
+        }
+    }
+
+    bool b64decode(const char *in, size_t len, uint8_t *out, bool url) {
+        static const Isa ISA = isa();
+        return b64decode(ISA, in, len, out, url);
+    }
+
+    void hexencode(Isa isa, const uint8_t *in, size_t len, char *out, bool caps) {
+        switch (isa) {
+#ifdef SUIL_SIMD_X86
+            case Avx2:
+                return avx2_hexencode(in, len, out, caps);
+            case Sse42:
+                return sse42_hexencode(in, len, out, caps);
+#endif
+            default:
+                return scalar_hexencode(in, len, out, caps);
+        }
+    }
+
+    void hexencode(const uint8_t *in, size_t len, char *out, bool caps) {
+        static const Isa ISA = isa();
+        hexencode(ISA, in, len, out, caps);
+    }
+
+    bool hexdecode(Isa isa, const char *in, size_t len, uint8_t *out) {
+        switch (isa) {
+#ifdef SUIL_SIMD_X86
+            case Avx2:
+                return avx2_hexdecode(in, len, out);
+            case Sse42:
+                return sse42_hexdecode(in, len, out);
+#endif
+            default:
+                return scalar_hexdecode(in, len, out);
+        }
+    }
+
+    bool hexdecode(const char *in, size_t len, uint8_t *out) {
+        static const Isa ISA = isa();
+        return hexdecode(ISA, in, len, out);
+    }
+
+    size_t urldecode(Isa isa, const char *in, size_t len, char *out) {
+        switch (isa) {
+#ifdef SUIL_SIMD_X86
+            case Avx2:
+                return avx2_urldecode(in, len, out);
+            case Sse42:
+                return sse42_urldecode(in, len, out);
+#endif
+            default:
+                return scalar_urldecode(in, len, out);
+        }
+    }
+
+    size_t urldecode(const char *in, size_t len, char *out) {
+        static const Isa ISA = isa();
+        return urldecode(ISA, in, len, out);
+    }
+}
+
+#ifdef unit_test
+#include <catch/catch.hpp>
+#include <chrono>
+
+#include <suil/utils.h>
+
+using namespace suil;
+
+TEST_CASE("suil::simd", "[simd]")
+{
+    static const char RANGES[] = "\x00 \"\"(),,//:@[]{\xff";
+    const size_t NRANGES = sizeof(RANGES)-1;
+
+    SECTION("Finding bytes in ranges") {
+        char buf[128];
+        memset(buf, 'a', sizeof(buf));
+        for (int isa = simd::Scalar; isa <= simd::isa(); isa++) {
+            for (size_t at = 0; at < sizeof(buf); at++) {
+                // every special byte at every position, with tails of every length
+                for (const char *c = ":\"{\x01\xfe"; *c != '\0'; c++) {
+                    buf[at] = *c;
+                    REQUIRE(simd::findranges((simd::Isa) isa, buf, &buf[sizeof(buf)], RANGES, NRANGES) == &buf[at]);
+                    REQUIRE(simd::findranges((simd::Isa) isa, buf, &buf[at], RANGES, NRANGES) == &buf[at]);
+                    buf[at] = 'a';
+                }
+            }
+            REQUIRE(simd::findranges((simd::Isa) isa, buf, &buf[sizeof(buf)], RANGES, NRANGES) == &buf[sizeof(buf)]);
+            buf[sizeof(buf)-1] = '\0';
+            REQUIRE(simd::findranges((simd::Isa) isa, buf, &buf[sizeof(buf)], RANGES, NRANGES) == &buf[sizeof(buf)-1]);
+            buf[sizeof(buf)-1] = 'a';
+        }
+    }
+
+    SECTION("Indexing JSON structurals") {
+        // reference, one byte at a time; like the kernels, a backslash escapes
+        // the following byte even outside strings (where it is invalid anyway)
+        auto reference = [](const std::string& doc, bool& valid) {
+            std::vector<uint32_t> idx;
+            bool instr{false}, prevScalar{false}, escaped{false};
+            valid = true;
+            for (size_t i = 0; i < doc.size(); i++) {
+                char c = doc[i];
+                bool esc = escaped;
+                escaped = (c == '\\') && !esc;
+                if (instr) {
+                    valid = valid && ((uint8_t) c >= 0x20);
+                    if (c == '"' && !esc) { idx.push_back(i); instr = false; }
+                    continue;
+                }
+                bool scalar{false};
+                if (c == '"' && !esc) { idx.push_back(i); instr = true; }
+                else if (strchr("{}[]:,", c) != nullptr) idx.push_back(i);
+                else if (strchr(" \t\r\n", c) == nullptr) {
+                    if (!prevScalar) idx.push_back(i);
+                    scalar = true;
+                }
+                prevScalar = scalar;
+            }
+            valid = valid && !instr;
+            return idx;
+        };
+
+        std::vector<uint32_t> idx;
+        bool valid;
+        const char *doc = R"({"a" : [1, true,null], "b\"c\\": "x:{y}", "d":-1.5e3})";
+        REQUIRE(simd::jsonindex(simd::Scalar, doc, strlen(doc), idx));
+        REQUIRE(idx == reference(doc, valid));
+        REQUIRE((idx == std::vector<uint32_t>{0,1,3,5,7,8,9,11,15,16,20,21,23,30,31,33,39,40,42,44,45,46,52}));
+
+        srand(0x5011);
+        const char *alphabet[] = {"{", "}", "[", "]", ":", ",", " ", "\n", "\"", "\\", "\\\\",
+                                  "a", "123", "null", "\xc3\xa9", "\xe2\x82\xac"};
+        for (int round = 0; round < 200; round++) {
+            std::string str;
+            size_t len = rand() % 300;
+            while (str.size() < len)
+                str += alphabet[rand() % (sizeof(alphabet)/sizeof(alphabet[0]))];
+            auto expected = reference(str, valid);
+            for (int isa = simd::Scalar; isa <= simd::isa(); isa++) {
+                bool ok = simd::jsonindex((simd::Isa) isa, str.data(), str.size(), idx);
+                REQUIRE(ok == valid);
+                if (ok) {
+                    REQUIRE(idx == expected);
+                }
+            }
+        }
+
+        for (int isa = simd::Scalar; isa <= simd::isa(); isa++) {
+            auto index = [&](const char *str) {
+                return simd::jsonindex((simd::Isa) isa, str, strlen(str), idx);
+            };
+            // unterminated strings, control characters within strings
+            REQUIRE_FALSE(index(R"({"a": "b})"));
+            REQUIRE_FALSE(index("{\"a\tb\": 1}"));
+            REQUIRE(index("{\"a\\tb\": 1}\t"));
+            // invalid UTF-8: a stray continuation byte, overlong, surrogate, truncated
+            REQUIRE(index("[\"\xc3\xa9\xf0\x9f\x98\x80\"]"));
+            REQUIRE_FALSE(index("[\"\xa9\"]"));
+            REQUIRE_FALSE(index("[\"\xc0\xaf\"]"));
+            REQUIRE_FALSE(index("[\"\xed\xa0\x80\"]"));
+            REQUIRE_FALSE(index("[\"\xe2\x82"));
+            // blocks with an escape sequence spanning them
+            std::string str(63, ' ');
+            str[0] = '"'; str[62] = '\\';
+            str += "\"\"";
+            REQUIRE(simd::jsonindex((simd::Isa) isa, str.data(), str.size(), idx));
+            REQUIRE((idx == std::vector<uint32_t>{0, 64}));
+        }
+    }
+
+    SECTION("Base64 and hex codecs") {
+        srand(0xb64);
+        uint8_t raw[300], dec[300];
+        char enc[600], ref[600];
+        for (size_t i = 0; i < sizeof(raw); i++)
+            raw[i] = (uint8_t) rand();
+
+        for (size_t len = 0; len <= sizeof(raw); len += 3) {
+            for (bool url: {false, true}) {
+                simd::b64encode(simd::Scalar, raw, len, ref, url);
+                for (int isa = simd::Scalar; isa <= simd::isa(); isa++) {
+                    simd::b64encode((simd::Isa) isa, raw, len, enc, url);
+                    REQUIRE(memcmp(enc, ref, len/3*4) == 0);
+                    REQUIRE(simd::b64decode((simd::Isa) isa, enc, len/3*4, dec, url));
+                    REQUIRE(memcmp(dec, raw, len) == 0);
+                }
+            }
+        }
+        simd::b64encode(simd::Scalar, (const uint8_t *) "\xfb\xff\xbf", 3, enc, false);
+        REQUIRE(strncmp(enc, "+/+/", 4) == 0);
+        simd::b64encode(simd::Scalar, (const uint8_t *) "\xfb\xff\xbf", 3, enc, true);
+        REQUIRE(strncmp(enc, "-_-_", 4) == 0);
+
+        for (size_t len = 0; len <= sizeof(raw); len++) {
+            for (bool caps: {false, true}) {
+                simd::hexencode(simd::Scalar, raw, len, ref, caps);
+                for (int isa = simd::Scalar; isa <= simd::isa(); isa++) {
+                    simd::hexencode((simd::Isa) isa, raw, len, enc, caps);
+                    REQUIRE(memcmp(enc, ref, len*2) == 0);
+                    REQUIRE(simd::hexdecode((simd::Isa) isa, enc, len, dec));
+                    REQUIRE(memcmp(dec, raw, len) == 0);
+                }
+            }
+        }
+        REQUIRE(strncmp(utils::hexstr((const uint8_t *) "\x01\xab\xff", 3)(), "01abff", 6) == 0);
+
+        // every byte value at every position of a block, only the alphabets decode
+        for (int isa = simd::Scalar; isa <= simd::isa(); isa++) {
+            char buf[96];
+            for (int c = 0; c < 256; c++) {
+                for (size_t at = 0; at < sizeof(buf); at += 5) {
+                    memset(buf, 'A', sizeof(buf));
+                    buf[at] = (char) c;
+                    REQUIRE(simd::b64decode((simd::Isa) isa, buf, sizeof(buf), dec, false) ==
+                            (isalnum(c) || c == '+' || c == '/'));
+                    REQUIRE(simd::b64decode((simd::Isa) isa, buf, sizeof(buf), dec, true) ==
+                            (isalnum(c) || c == '-' || c == '_'));
+                    memset(buf, '0', sizeof(buf));
+                    buf[at] = (char) c;
+                    REQUIRE(simd::hexdecode((simd::Isa) isa, buf, sizeof(buf)/2, dec) == (isxdigit(c) != 0));
+                }
+            }
+        }
+    }
+
+    SECTION("URL decoding") {
+        char in[100], ref[100], out[100];
+        REQUIRE(simd::urldecode(simd::Scalar, "a+b%2Cc%2g%4", 12, out) == 10);
+        REQUIRE(strncmp(out, "a b,c%2g%4", 10) == 0);
+
+        // escapes, valid or not, at every offset of and across the blocks
+        const char ALPHABET[] = "%+aF0g";
+        for (int round = 0; round < 2000; round++) {
+            size_t len = (size_t) rand() % sizeof(in);
+            for (size_t i = 0; i < len; i++)
+                in[i] = (round & 1)? ALPHABET[rand() % 6] : (rand() % 8)? 'x' : ALPHABET[rand() % 6];
+            size_t n = simd::urldecode(simd::Scalar, in, len, ref);
+            for (int isa = simd::Scalar; isa <= simd::isa(); isa++) {
+                REQUIRE(simd::urldecode((simd::Isa) isa, in, len, out) == n);
+                REQUIRE(memcmp(out, ref, n) == 0);
+            }
+        }
+        REQUIRE(utils::urldecode("some+text%2C+and%20more", 23) == "some text, and more");
+    }
+}
+
+TEST_CASE("suil::simd codecs benchmark", "[.bench][simd]")
+{
+    // ./sut "[.bench]"
+    const size_t SIZE = 1 << 20, ROUNDS = 50;
+    std::vector<uint8_t> raw(SIZE), dec(SIZE);
+    std::vector<char> b64(SIZE/3*4 + 4), hex(SIZE*2);
+    for (auto& b: raw)
+        b = (uint8_t) rand();
+
+    auto bench = [&](const char *name, simd::Isa isa, auto f) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < ROUNDS; i++)
+            f(isa);
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        WARN(name << " (" << simd::name(isa) << "): " << (SIZE * ROUNDS * 1000.0) / ns << " MB/s");
+    };
+
+    const size_t len = SIZE/3*3;
+    for (int isa = simd::Scalar; isa <= simd::isa(); isa++) {
+        bench("base64 encode", (simd::Isa) isa, [&](simd::Isa i) {
+            simd::b64encode(i, raw.data(), len, b64.data());
+        });
+        bench("base64 decode", (simd::Isa) isa, [&](simd::Isa i) {
+            REQUIRE(simd::b64decode(i, b64.data(), len/3*4, dec.data()));
+        });
+        bench("hex encode", (simd::Isa) isa, [&](simd::Isa i) {
+            simd::hexencode(i, raw.data(), SIZE, hex.data());
+        });
+        bench("hex decode", (simd::Isa) isa, [&](simd::Isa i) {
+            REQUIRE(simd::hexdecode(i, hex.data(), SIZE, dec.data()));
+        });
+    }
+
+    // query string values dense and sparse with escapes
+    for (auto chunk: {"some+text%2C+and%20more", "some-longer-text-between-the-escapes%2C-"}) {
+        std::string url;
+        while (url.size() < SIZE)
+            url += chunk;
+        std::vector<char> out(url.size());
+        WARN("url decode input: " << chunk);
+        for (int isa = simd::Scalar; isa <= simd::isa(); isa++) {
+            bench("url decode", (simd::Isa) isa, [&](simd::Isa i) {
+                REQUIRE(simd::urldecode(i, url.data(), url.size(), out.data()) != 0);
+            });
+        }
+    }
+}
+#endif
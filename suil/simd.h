@@ -0,0 +1,159 @@
+//
+// Created by dc on 18/10/26.
+//
+
+#ifndef SUIL_SIMD_H
+#define SUIL_SIMD_H
+
+#include <vector>
+
+#include <suil/base.h>
+
+namespace suil::simd {
+
+    /**
+     * The instruction sets with vectorized implementations, the best
+     * one supported by the running CPU is detected once at startup
+     */
+    enum Isa : uint8_t {
+        Scalar = 0,
+        Sse42,
+        Avx2
+    };
+
+    /**
+     * @return the best instruction set supported by the running CPU
+     */
+    Isa isa();
+
+    /**
+     * @return the name of the given instruction set
+     */
+    const char *name(Isa isa);
+
+    /**
+     * Finds the first byte in [\param p, \param end) which falls within any
+     * of the given inclusive ranges.
+     *
+     * @param ranges pairs of bytes, each pair being an inclusive range
+     * e.g "\x00\x1f\x7f\x7f" matches control characters
+     * @param nranges the number of bytes in \param ranges, at most 16
+     *
+     * @return a pointer to the matching byte or \param end if none matched
+     */
+    const char *findranges(const char *p, const char *end, const char *ranges, size_t nranges);
+
+    /**
+     * \see simd::findranges, uses the given instruction set regardless
+     * of what was detected (the CPU must support it)
+     */
+    const char *findranges(Isa isa, const char *p, const char *end, const char *ranges, size_t nranges);
+
+    /**
+     * Indexes the structural characters of a JSON document: the offsets of
+     * `{}[]:,` outside strings, of both quotes of every string and of the
+     * first byte of every other token (numbers, true, false, null). Bytes
+     * between two consecutive offsets outside a string are whitespace.
+     *
+     * The whole input is also validated as UTF-8, and strings are checked
+     * for unescaped control characters
+     *
+     * @param p the JSON document
+     * @param len the size of \param p
+     * @param idx receives the offsets, in increasing order
+     *
+     * @return false if the input is not valid UTF-8, has control characters
+     * in strings or ends within a string, \param idx is then unusable
+     */
+    bool jsonindex(const char *p, size_t len, std::vector<uint32_t>& idx);
+
+    /**
+     * \see simd::jsonindex, uses the given instruction set regardless
+     * of what was detected (the CPU must support it)
+     */
+    bool jsonindex(Isa isa, const char *p, size_t len, std::vector<uint32_t>& idx);
+
+    /**
+     * Base64 encodes whole groups of 3 bytes, padding is left to the caller
+     *
+     * @param in the bytes to encode
+     * @param len the number of bytes in \param in, a multiple of 3
+     * @param out receives the (len/3)*4 encoded characters
+     * @param url true to use the URL and filename safe alphabet (`-_`
+     * instead of `+/`)
+     */
+    void b64encode(const uint8_t *in, size_t len, char *out, bool url = false);
+
+    /**
+     * \see simd::b64encode, uses the given instruction set regardless
+     * of what was detected (the CPU must support it)
+     */
+    void b64encode(Isa isa, const uint8_t *in, size_t len, char *out, bool url = false);
+
+    /**
+     * Decodes whole groups of 4 base64 characters, padding must have
+     * been stripped by the caller
+     *
+     * @param in the characters to decode
+     * @param len the number of characters in \param in, a multiple of 4
+     * @param out receives the (len/4)*3 decoded bytes
+     * @param url true to decode the URL and filename safe alphabet
+     *
+     * @return false if \param in has characters outside the alphabet,
+     * \param out is then unusable
+     */
+    bool b64decode(const char *in, size_t len, uint8_t *out, bool url = false);
+
+    /**
+     * \see simd::b64decode, uses the given instruction set regardless
+     * of what was detected (the CPU must support it)
+     */
+    bool b64decode(Isa isa, const char *in, size_t len, uint8_t *out, bool url = false);
+
+    /**
+     * Writes the 2*\param len hex digits of the given bytes to \param out
+     *
+     * @param caps true for upper case digits
+     */
+    void hexencode(const uint8_t *in, size_t len, char *out, bool caps = false);
+
+    /**
+     * \see simd::hexencode, uses the given instruction set regardless
+     * of what was detected (the CPU must support it)
+     */
+    void hexencode(Isa isa, const uint8_t *in, size_t len, char *out, bool caps = false);
+
+    /**
+     * Decodes the 2*\param len hex digits (in any case) at \param in
+     * into \param len bytes
+     *
+     * @return false if \param in has non hex digits, \param out is
+     * then unusable
+     */
+    bool hexdecode(const char *in, size_t len, uint8_t *out);
+
+    /**
+     * \see simd::hexdecode, uses the given instruction set regardless
+     * of what was detected (the CPU must support it)
+     */
+    bool hexdecode(Isa isa, const char *in, size_t len, uint8_t *out);
+
+    /**
+     * URL decodes \param in, `+` to a space and `%XX` escapes to their
+     * byte, `%` not followed by two hex digits is copied as is
+     *
+     * @param out receives the decoded bytes, at most \param len, it
+     * must not overlap \param in
+     *
+     * @return the number of bytes written to \param out
+     */
+    size_t urldecode(const char *in, size_t len, char *out);
+
+    /**
+     * \see simd::urldecode, uses the given instruction set regardless
+     * of what was detected (the CPU must support it)
+     */
+    size_t urldecode(Isa isa, const char *in, size_t len, char *out);
+}
+
+#endif //SUIL_SIMD_H
@@ -63,6 +63,25 @@ namespace suil {
         return ns;
     }
 
+    size_t SslSock::sendv(const struct iovec *iov, int iovcnt, int64_t timeout) {
+        if (!isopen()) {
+            iwarn("writing to a closed socket not supported");
+            errno = ENOTSUP;
+            return 0;
+        }
+
+        ssize_t ns = sslsendv(raw, iov, iovcnt, utils::after(timeout));
+        if (errno != 0) {
+            itrace("send error: %s", errno_s);
+            if (errno == ECONNRESET) {
+                close();
+            }
+            return 0;
+        }
+
+        return (size_t) ns;
+    }
+
     size_t SslSock::sendfile(int fd, off_t offset, size_t len, int64_t timeout) {
         assert(!"Unsupported operation");
         return 0;
@@ -221,6 +240,25 @@ namespace suil {
         }
     }
 
+    size_t TcpSock::sendv(const struct iovec *iov, int iovcnt, int64_t timeout) {
+        if (!isopen()) {
+            itrace("writing to a closed socket not supported");
+            errno = ENOTSUP;
+            return 0;
+        } else {
+            size_t ns = tcpsendv(raw, iov, iovcnt, utils::after(timeout));
+            if (errno != 0) {
+                itrace("sending failed: %s", errno_s);
+                if (errno == ECONNRESET) {
+                    Ego.close();
+                }
+                return 0;
+            }
+
+            return ns;
+        }
+    }
+
     size_t TcpSock::sendfile(int fd, off_t offset, size_t len, int64_t timeout) {
         if (!isopen()) {
             itrace("writing to a closed socket not supported");
@@ -332,15 +370,15 @@ namespace suil {
             close();
     }
 
-    bool SslSs::listen(ipaddr addr, int backlog) {
+    bool SslSs::listen(ipaddr addr, int backlog, bool reuseport) {
         if (raw != nullptr) {
             iwarn("server socket already listening");
             errno = EINPROGRESS;
             return false;
         }
 
-        raw = ssllisten(addr, config.key.c_str(),
-                        config.cert.c_str(), backlog);
+        raw = ssllisten2(addr, config.key.c_str(),
+                         config.cert.c_str(), backlog, (reuseport? 1: 0));
 
         if (raw == nullptr) {
             iwarn("listening failed: %s", errno_s);
@@ -349,6 +387,11 @@ namespace suil {
         return true;
     }
 
+    int SslSs::fd() const {
+        if (raw) return sslfd(raw);
+        return -1;
+    }
+
     bool SslSs::accept(sock_t& s, int64_t timeout) {
         sslsock tsock;
         tsock = sslaccept(raw, utils::after(timeout));
@@ -369,14 +412,14 @@ namespace suil {
         }
     }
 
-    bool TcpSs::listen(ipaddr addr, int backlog) {
+    bool TcpSs::listen(ipaddr addr, int backlog, bool reuseport) {
         if (raw != nullptr) {
             iwarn("server socket already listening");
             errno = EINPROGRESS;
             return false;
         }
 
-        raw = tcplisten(addr, backlog);
+        raw = tcplisten2(addr, backlog, (reuseport? 1: 0));
         if (raw == nullptr) {
             iwarn("listening failed: %s", errno_s);
             return false;
@@ -384,6 +427,11 @@ namespace suil {
         return true;
     }
 
+    int TcpSs::fd() const {
+        if (raw) return tcpfd(raw);
+        return -1;
+    }
+
     bool TcpSs::accept(sock_t& s, int64_t timeout) {
         tcpsock tsock;
         tsock = tcpaccept(raw, utils::after(timeout));
@@ -410,3 +458,72 @@ namespace suil {
         }
     }
 }
+
+#ifdef unit_test
+#include <sys/socket.h>
+#include <catch/catch.hpp>
+#include <suil/channel.h>
+
+using namespace suil;
+
+static coroutine void tcpSlowReader(tcpsock s, size_t total, std::string& out, Channel<int>& done) {
+    char buf[512];
+    while (out.size() < total) {
+        // a slow peer, the sender's buffer keeps filling up
+        msleep(mnow() + 1);
+        size_t n = tcprecv(s, buf, std::min(sizeof(buf), total - out.size()), mnow() + 5);
+        out.append(buf, n);
+        if (errno != 0 && errno != ETIMEDOUT)
+            break;
+    }
+    done << (int) out.size();
+}
+
+TEST_CASE("suil::TcpSock gather writes", "[sock]")
+{
+    tcpsock ls = tcplisten(iplocal("127.0.0.1", 0, 0), 10);
+    REQUIRE(ls != nullptr);
+    tcpsock cs = tcpconnect(iplocal("127.0.0.1", tcpport(ls), 0), mnow() + 1000);
+    REQUIRE(cs != nullptr);
+    tcpsock as = tcpaccept(ls, mnow() + 1000);
+    REQUIRE(as != nullptr);
+    int bufsz{4096};
+    setsockopt(tcpfd(cs), SOL_SOCKET, SO_SNDBUF, &bufsz, sizeof(bufsz));
+    setsockopt(tcpfd(as), SOL_SOCKET, SO_RCVBUF, &bufsz, sizeof(bufsz));
+
+    SECTION("buffered bytes left by a timed out write are sent once") {
+        // each round buffers a head and gathers it with a body written with a
+        // deadline too short for the slow reader, the unsent parts are retried
+        std::string expected, received;
+        for (int i = 0; i < 100; i++) {
+            expected += std::string(1400, (char) ('a' + (i % 26)));
+            expected += std::string(3000, (char) ('A' + (i % 26)));
+        }
+        Channel<int> done{-1};
+        go(tcpSlowReader(as, expected.size(), received, done));
+
+        size_t timeouts{0};
+        for (int i = 0; i < 100; i++) {
+            const char *head = &expected[i * 4400], *body = head + 1400;
+            REQUIRE(tcpsend(cs, head, 1400, mnow() + 5000) == 1400);
+            size_t sent{0};
+            while (sent < 3000) {
+                struct iovec iov{(void *) (body + sent), 3000 - sent};
+                sent += tcpsendv(cs, &iov, 1, mnow() + 1);
+                REQUIRE((errno == 0 || errno == ETIMEDOUT));
+                timeouts += (errno == ETIMEDOUT);
+            }
+        }
+        tcpflush(cs, mnow() + 5000);
+        REQUIRE(errno == 0);
+        REQUIRE((done[10000](1) | Void));
+        REQUIRE(timeouts > 0);
+        REQUIRE(received.size() == expected.size());
+        REQUIRE(received == expected);
+    }
+
+    tcpclose(as);
+    tcpclose(cs);
+    tcpclose(ls);
+}
+#endif
@@ -47,6 +47,22 @@ namespace suil {
             return send(buf, sz, timeout);
         }
 
+        /**
+         * Sends the given buffers in order, as a single gather write where the
+         * socket supports it
+         * @return the total number of bytes sent
+         */
+        virtual size_t sendv(const struct iovec *iov, int iovcnt, int64_t timeout = -1) {
+            size_t total{0};
+            for (int i = 0; i < iovcnt; i++) {
+                size_t ns = send(iov[i].iov_base, iov[i].iov_len, timeout);
+                total += ns;
+                if (ns != iov[i].iov_len)
+                    break;
+            }
+            return total;
+        }
+
         virtual size_t sendfile(int, off_t, size_t, int64_t timeout = -1) = 0;
         virtual bool flush(int64_t timeout = -1) = 0;
         virtual bool receive(void*,
@@ -109,6 +125,8 @@ namespace suil {
 
         virtual size_t send(const void *buf, size_t len, int64_t timeout = -1);
 
+        virtual size_t sendv(const struct iovec *iov, int iovcnt, int64_t timeout = -1);
+
         virtual size_t sendfile(int fd, off_t offset, size_t len, int64_t timeout = -1);
 
         virtual bool flush(int64_t timeout = -1);
@@ -152,6 +170,8 @@ namespace suil {
 
         virtual size_t send(const void *buf, size_t len, int64_t timeout = -1);
 
+        virtual size_t sendv(const struct iovec *iov, int iovcnt, int64_t timeout = -1);
+
         virtual size_t sendfile(int fd, off_t offset, size_t len, int64_t timeout = -1);
 
         virtual bool flush(int64_t timeout = -1);
@@ -180,7 +200,8 @@ namespace suil {
 
     template <class __S>
     struct ServerSock {
-        virtual bool listen(ipaddr, int) = 0;
+        virtual bool listen(ipaddr, int, bool reuseport = false) = 0;
+        virtual int  fd() const = 0;
         virtual bool accept(__S&, int64_t timeout = -1) = 0;
         virtual void close() = 0;
         virtual void shutdown() = 0;
@@ -199,7 +220,9 @@ namespace suil {
             :config(cfg)
         {}
 
-        virtual bool listen(ipaddr addr, int backlog);
+        virtual bool listen(ipaddr addr, int backlog, bool reuseport = false);
+
+        virtual int  fd() const;
 
         virtual bool accept(sock_t& s, int64_t timeout = -1);
 
@@ -224,7 +247,9 @@ namespace suil {
             : raw(nullptr)
         {}
 
-        virtual bool listen(ipaddr addr, int backlog);
+        virtual bool listen(ipaddr addr, int backlog, bool reuseport = false);
+
+        virtual int  fd() const;
 
         virtual bool accept(sock_t& s, int64_t timeout = -1);
 
@@ -29,6 +29,12 @@ namespace suil {
             template <typename T>
             using remove_primary_keys_t =
             decltype(suil::__internal::remove_members_with_attribute(std::declval<T>(), sym(PRIMARY_KEY)));
+
+            // connections which can pipeline statements, \see PgSqlConnection::pipeline
+            template <typename C, typename = void>
+            struct has_pipeline : std::false_type {};
+            template <typename C>
+            struct has_pipeline<C, std::void_t<decltype(std::declval<C&>().pipeline())>> : std::true_type {};
         }
 
         template<typename Connection, typename Type, typename Schema = Type>
@@ -93,35 +99,47 @@ namespace suil {
             template<typename T>
             bool insert(const T& o)
             {
-                OBuffer qb(32), vb(32);
-
-                qb << "insert into " << table << "(";
-
-                bool first = true;
-                int i = 1;
-                typedef decltype(WithoutAutoIncrement()) __tmp;
-                auto values = iod::foreach2(WithoutIgnore2<__tmp>()) |
-                [&](auto& m) {
-                    if (!first) {
-                        qb << ", ";
-                        vb << ", ";
-                    }
-                    first = false;
-                    qb << m.symbol().name();
-                    Connection::params(vb, i++);
-
-                    return m.symbol() = m.symbol().member_access(o);
-                };
-
-                qb << ") values (" << vb << ")";
+                OBuffer qb(32);
+                insertq(qb);
 
                 // execute query
                 auto req = conn(qb);
-                iod::apply(values, req);
+                iod::apply(insertv(o), req);
 
                 return req.status();
             }
 
+            /**
+             * inserts all the given objects, connections that support it send
+             * all the inserts before waiting for their results
+             * @return true if all the objects were inserted
+             */
+            template<typename T>
+            bool insert(const std::vector<T>& objs)
+            {
+                OBuffer qb(32);
+                insertq(qb);
+                // the connection takes over the buffer of a statement it hasn't seen
+                String query(qb);
+
+                if constexpr (__internal::has_pipeline<Connection>::value) {
+                    auto pl = conn.pipeline();
+                    for (auto& o: objs) {
+                        iod::apply(insertv(o), pl(query()));
+                    }
+                    return pl.exec();
+                }
+                else {
+                    bool ok{true};
+                    for (auto& o: objs) {
+                        auto req = conn(query());
+                        iod::apply(insertv(o), req);
+                        ok = req.status() && ok;
+                    }
+                    return ok;
+                }
+            }
+
             // initialize a table for this table
             bool cifne(bool trunc = false) {
                 // pass the request to respective connection
@@ -249,6 +267,36 @@ namespace suil {
 
 
         private:
+            void insertq(OBuffer& qb) {
+                OBuffer vb(32);
+                qb << "insert into " << table << "(";
+
+                bool first = true;
+                int i = 1;
+                typedef decltype(WithoutAutoIncrement()) __tmp;
+                iod::foreach2(WithoutIgnore2<__tmp>()) |
+                [&](auto& m) {
+                    if (!first) {
+                        qb << ", ";
+                        vb << ", ";
+                    }
+                    first = false;
+                    qb << m.symbol().name();
+                    Connection::params(vb, i++);
+                };
+
+                qb << ") values (" << vb << ")";
+            }
+
+            template<typename T>
+            auto insertv(const T& o) {
+                typedef decltype(WithoutAutoIncrement()) __tmp;
+                return iod::foreach2(WithoutIgnore2<__tmp>()) |
+                [&](auto& m) {
+                    return m.symbol() = m.symbol().member_access(o);
+                };
+            }
+
             Connection& conn;
             suil::String table{nullptr};
         };
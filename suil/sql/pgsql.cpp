@@ -11,19 +11,23 @@ namespace suil::sql {
         String tmp(req, false);
         itrace("%s", tmp());
 
-        auto it = stmt_cache.find(tmp);
-        if (it != stmt_cache.end()) {
+        auto it = stmt_cache->find(tmp);
+        if (it != stmt_cache->end()) {
             return it->second;
         }
 
         /* statement not cached, create new */
         String key(req);
         tmp = key.peek();
+        /* statements are never removed from the cache, its size gives
+         * each prepared statement a unique name on the connection */
+        String name = preparable(tmp)?
+                      utils::catstr("suil_", stmt_cache->size()) : String{nullptr};
         /* the key will be copied to statement so it won't be delete
          * when the statement is deleted */
-        auto ret = stmt_cache.insert(it,
+        auto ret = stmt_cache->insert(it,
                                      std::make_pair(std::move(key),
-                                                    PGSQLStatement(conn, std::move(tmp), async, timeout)));
+                                                    PGSQLStatement(conn, std::move(tmp), async, timeout, std::move(name))));
 
         return ret->second;
     }
@@ -33,8 +37,8 @@ namespace suil::sql {
         String tmp(req);
         itrace("%s", tmp());
 
-        auto it = stmt_cache.find(tmp);
-        if (it != stmt_cache.end()) {
+        auto it = stmt_cache->find(tmp);
+        if (it != stmt_cache->end()) {
             return it->second;
         }
 
@@ -43,6 +47,716 @@ namespace suil::sql {
         return (*this)(breq);
     }
 
+    static const char *skipcomment(const char *it, const char *end) {
+        // \return the end of the comment starting at \param it, \param it if there's none
+        if (end - it < 2) return it;
+        if (it[0] == '-' && it[1] == '-') {
+            while (it < end && *it != '\n') it++;
+            return it;
+        }
+        if (it[0] == '/' && it[1] == '*') {
+            for (it += 2; it < end-1; it++) {
+                if (it[0] == '*' && it[1] == '/') return it + 2;
+            }
+            return end;
+        }
+        return it;
+    }
+
+    bool PgSqlConnection::preparable(const String& stmt) {
+        /* only these statements can be prepared on the server */
+        static const char *KEYWORDS[] = {"SELECT", "INSERT", "UPDATE", "DELETE", "WITH", "VALUES"};
+        const char *it = stmt.data(), *end = it + stmt.size(), *next;
+        while (it < end) {
+            if (isspace(*it)) it++;
+            else if ((next = skipcomment(it, end)) != it) it = next;
+            else break;
+        }
+
+        size_t len = end-it;
+        bool found{false};
+        for (auto kw: KEYWORDS) {
+            size_t sz = strlen(kw);
+            if (len > sz && strncasecmp(it, kw, sz) == 0 && !isalnum(it[sz])) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+
+        /* a prepared statement is a single command, only whitespace and
+         * comments can follow a semicolon outside quotes */
+        char quote{0};
+        bool ended{false};
+        while (it < end) {
+            if (quote) {
+                if (*it++ == quote) quote = 0;
+            }
+            else if ((next = skipcomment(it, end)) != it) {
+                it = next;
+            }
+            else if (ended) {
+                if (!isspace(*it++)) return false;
+            }
+            else {
+                if (*it == '\'' || *it == '"') quote = *it;
+                else if (*it == ';') ended = true;
+                it++;
+            }
+        }
+        return true;
+    }
+
+    PgSqlPipeline PgSqlConnection::pipeline() {
+        return PgSqlPipeline(Ego);
+    }
+
+    const char* PGSQLStatement::prepare(int nparams, const Oid *oids) {
+        if (prepared == nullptr || prepared->state == prepared_t::Failed) {
+            return nullptr;
+        }
+
+        auto& p = *prepared;
+        if (p.state == prepared_t::Ready) {
+            // the server expects the parameter types it was prepared with
+            if (p.oids.size() == (size_t) nparams && std::equal(p.oids.begin(), p.oids.end(), oids)) {
+                return p.name();
+            }
+            idebug("PREPARE: %s invoked with different parameter types", stmt());
+            return nullptr;
+        }
+
+        if (pipeline != nullptr) {
+            // results of commands sent in pipeline mode are only received on sync
+            return nullptr;
+        }
+
+        PGresult *res = async?
+                (PQsendPrepare(conn, p.name(), stmt(), nparams, oids)? await() : nullptr) :
+                PQprepare(conn, p.name(), stmt(), nparams, oids);
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            iwarn("PREPARE: %s failed: %s", stmt(), PQerrorMessage(conn));
+            PQclear(res);
+            p.state = prepared_t::Failed;
+            return nullptr;
+        }
+        PQclear(res);
+
+        res = async?
+                (PQsendDescribePrepared(conn, p.name())? await() : nullptr) :
+                PQdescribePrepared(conn, p.name());
+        if (PQresultStatus(res) == PGRES_COMMAND_OK) {
+            p.binary = true;
+            for (int i = 0; i < PQnfields(res); i++) {
+                p.binary = p.binary && __internal::binary_result_oid(PQftype(res, i));
+            }
+        }
+        PQclear(res);
+
+        p.oids.assign(oids, oids+nparams);
+        p.state = prepared_t::Ready;
+        itrace("PREPARE: %s prepared as %s binary %d", stmt(), p.name(), p.binary);
+        return p.name();
+    }
+
+    PGresult* PGSQLStatement::await() {
+        bool err{false};
+        PGresult *last{nullptr}, *res;
+        while ((res = receive(err)) != nullptr) {
+            PQclear(last);
+            last = res;
+        }
+        if (err) {
+            PQclear(last);
+            return nullptr;
+        }
+        return last;
+    }
+
+    PGresult* PGSQLStatement::receive(bool &err) {
+        if (async) {
+            while (PQflush(conn)) {
+                if (wait_write()) {
+                    ierror("ASYNC QUERY: %s wait write failed: %s", stmt(), errno_s);
+                    err = true;
+                    return nullptr;
+                }
+            }
+
+            while (PQisBusy(conn)) {
+                if (wait_read() || !PQconsumeInput(conn)) {
+                    ierror("ASYNC QUERY: %s wait read failed: %s", stmt(), PQerrorMessage(conn));
+                    err = true;
+                    return nullptr;
+                }
+            }
+        }
+        return PQgetResult(conn);
+    }
+
+    bool PGSQLStatement::rowmode() {
+#ifdef LIBPQ_HAS_CHUNK_MODE
+        streaming = (chunk > 1)? PQsetChunkedRowsMode(conn, (int) chunk) : PQsetSingleRowMode(conn);
+#else
+        streaming = PQsetSingleRowMode(conn);
+#endif
+        return streaming;
+    }
+
+    bool PGSQLStatement::fetch() {
+        // only the current chunk is kept
+        results.clear();
+
+        bool err{false};
+        PGresult *res = receive(err);
+        switch (PQresultStatus(res)) {
+            case PGRES_SINGLE_TUPLE:
+#ifdef LIBPQ_HAS_CHUNK_MODE
+            case PGRES_TUPLES_CHUNK:
+#endif
+                results.add(res);
+                results.reset();
+                return true;
+            case PGRES_TUPLES_OK:
+            case PGRES_COMMAND_OK:
+                // the end of the rows
+                PQclear(res);
+                break;
+            default:
+                if (!err) {
+                    ierror("STREAM QUERY: %s failed: %s", stmt(), PQresultErrorMessage(res));
+                }
+                PQclear(res);
+                results.fail();
+        }
+
+        finish();
+        return false;
+    }
+
+    void PGSQLStatement::finish() {
+        if (!streaming) {
+            return;
+        }
+
+        streaming = false;
+        bool err{false};
+        PGresult *res;
+        while ((res = receive(err)) != nullptr) {
+            PQclear(res);
+        }
+    }
+
+    PGSQLStatement::~PGSQLStatement() {
+        if (streaming) {
+            idebug("STREAM QUERY: %s discarding unread rows", stmt());
+            finish();
+        }
+    }
+
+    void PGSQLStatement::sent() {
+        pipeline->inflight.push_back(this);
+    }
+
+    PgSqlPipeline::PgSqlPipeline(PgSqlConnection &conn)
+        : conn(conn)
+    {
+#ifdef LIBPQ_HAS_PIPELINING
+        if (!PQenterPipelineMode(conn.conn)) {
+            ierror("PIPELINE: %s", PQerrorMessage(conn.conn));
+            throw Exception::create("entering pipeline mode failed: ", PQerrorMessage(conn.conn));
+        }
+        active = true;
+#else
+        idebug("PIPELINE: not supported by libpq, statements will be executed one by one");
+#endif
+    }
+
+    PGSQLStatement& PgSqlPipeline::queue(PGSQLStatement &&stmt) {
+        stmts.push_back(std::move(stmt));
+        auto& st = stmts.back();
+        if (active) {
+            st.pipeline = this;
+        }
+        return st;
+    }
+
+    PGSQLStatement& PgSqlPipeline::operator()(OBuffer &req) {
+        return queue(conn(req));
+    }
+
+    PGSQLStatement& PgSqlPipeline::operator()(const char *req) {
+        return queue(conn(req));
+    }
+
+    bool PgSqlPipeline::exec() {
+        bool ok{true};
+#ifdef LIBPQ_HAS_PIPELINING
+        if (!inflight.empty()) {
+            PGconn *pg = conn.conn;
+            bool err{false};
+            if (!PQpipelineSync(pg)) {
+                ierror("PIPELINE: sync failed: %s", PQerrorMessage(pg));
+                err = true;
+            }
+
+            int rc;
+            while (!err && (rc = PQflush(pg)) != 0) {
+                // only a non-blocking connection returns before all the data is sent
+                if (rc < 0 || wait(FDW_OUT)) {
+                    ierror("PIPELINE: sending failed: %s", PQerrorMessage(pg));
+                    err = true;
+                }
+            }
+
+            for (auto st: inflight) {
+                bool failed{err};
+                PGresult *res;
+                while (!err && (res = next(err)) != nullptr) {
+                    switch (PQresultStatus(res)) {
+                        case PGRES_TUPLES_OK:
+                        case PGRES_SINGLE_TUPLE:
+                            if (PQntuples(res) > 0) {
+                                st->results.add(res);
+                                res = nullptr;
+                            }
+                            break;
+                        case PGRES_COMMAND_OK:
+                        case PGRES_NONFATAL_ERROR:
+                            break;
+                        case PGRES_PIPELINE_ABORTED:
+                            idebug("PIPELINE QUERY: %s aborted", st->stmt());
+                            failed = true;
+                            break;
+                        default:
+                            ierror("PIPELINE QUERY: %s failed: %s",
+                                   st->stmt(), PQresultErrorMessage(res));
+                            failed = true;
+                    }
+                    if (res) {
+                        PQclear(res);
+                    }
+                }
+
+                if (failed || err) {
+                    st->results.fail();
+                    ok = false;
+                }
+                st->results.reset();
+            }
+
+            if (!err) {
+                // the result of the sync point
+                PGresult *res = next(err);
+                if (res && PQresultStatus(res) != PGRES_PIPELINE_SYNC) {
+                    iwarn("PIPELINE: unexpected result %s", PQresStatus(PQresultStatus(res)));
+                }
+                PQclear(res);
+            }
+            inflight.clear();
+        }
+#endif
+        for (size_t i = pending; i < stmts.size(); i++) {
+            // statements not sent through the pipeline were executed when invoked
+            ok = ok && stmts[i].status();
+        }
+        pending = stmts.size();
+        return ok;
+    }
+
+    PGresult* PgSqlPipeline::next(bool &err) {
+        PGconn *pg = conn.conn;
+        if (conn.async) {
+            while (PQisBusy(pg)) {
+                if (wait(FDW_IN) || !PQconsumeInput(pg)) {
+                    ierror("PIPELINE: receiving results failed: %s", PQerrorMessage(pg));
+                    err = true;
+                    return nullptr;
+                }
+            }
+        }
+        return PQgetResult(pg);
+    }
+
+    int PgSqlPipeline::wait(int events) {
+        int sock = PQsocket(conn.conn);
+        if (sock < 0) {
+            ierror("invalid PGSQL socket");
+            return -EINVAL;
+        }
+
+        if (events & FDW_OUT) {
+            // results are consumed while sending, the server would otherwise
+            // stop reading once it can't send
+            events |= FDW_IN;
+        }
+        int64_t dd = conn.timeout < 0? -1 : mnow() + conn.timeout;
+        int rc = fdwait(sock, events, dd);
+        if (rc & FDW_ERR) {
+            return -1;
+        }
+        if ((rc & FDW_IN) && (events & FDW_OUT)) {
+            return PQconsumeInput(conn.conn)? 0 : -1;
+        }
+        if (rc & events) {
+            return 0;
+        }
+
+        errno = ETIMEDOUT;
+        return ETIMEDOUT;
+    }
+
+    PgSqlPipeline::~PgSqlPipeline() {
+        if (!inflight.empty()) {
+            exec();
+        }
+#ifdef LIBPQ_HAS_PIPELINING
+        if (active && !PQexitPipelineMode(conn.conn)) {
+            iwarn("PIPELINE: exiting pipeline mode failed: %s", PQerrorMessage(conn.conn));
+        }
+#endif
+    }
+
+    PgSqlCopyOut PgSqlConnection::copyout(const char *query) {
+        return PgSqlCopyOut(Ego, query);
+    }
+
+    void PgSqlCopy::start(const char *stmt, ExecStatusType expect) {
+        PGconn *pg = conn.conn;
+        itrace("COPY: %s", stmt);
+        PGresult *res = conn.async?
+                (PQsendQuery(pg, stmt)? result() : nullptr) :
+                PQexec(pg, stmt);
+        if (PQresultStatus(res) != expect) {
+            ierror("COPY: %s failed: %s", stmt, PQerrorMessage(pg));
+            PQclear(res);
+            failed = true;
+            drain();
+            throw Exception::create("COPY failed: ", PQerrorMessage(pg));
+        }
+
+        PQclear(res);
+        active = true;
+    }
+
+    PGresult* PgSqlCopy::result() {
+        PGconn *pg = conn.conn;
+        if (conn.async) {
+            int rc;
+            while ((rc = PQflush(pg)) != 0) {
+                if (rc < 0 || wait(FDW_OUT)) {
+                    ierror("COPY: sending failed: %s", PQerrorMessage(pg));
+                    return nullptr;
+                }
+            }
+
+            while (PQisBusy(pg)) {
+                if (wait(FDW_IN) || !PQconsumeInput(pg)) {
+                    ierror("COPY: receiving failed: %s", PQerrorMessage(pg));
+                    return nullptr;
+                }
+            }
+        }
+        return PQgetResult(pg);
+    }
+
+    bool PgSqlCopy::drain() {
+        bool ok{true};
+        PGresult *res;
+        while ((res = result()) != nullptr) {
+            auto status = PQresultStatus(res);
+            if (status != PGRES_COMMAND_OK) {
+                ierror("COPY: failed: %s", PQresultErrorMessage(res));
+                ok = false;
+            }
+            PQclear(res);
+            if (status == PGRES_COPY_IN || status == PGRES_COPY_OUT) {
+                // the connection is still copying, \see PgSqlCopy::start
+                break;
+            }
+        }
+        return ok;
+    }
+
+    int PgSqlCopy::wait(int events) {
+        int sock = PQsocket(conn.conn);
+        if (sock < 0) {
+            ierror("invalid PGSQL socket");
+            return -EINVAL;
+        }
+
+        int64_t dd = conn.timeout < 0? -1 : mnow() + conn.timeout;
+        int rc = fdwait(sock, events, dd);
+        if (rc & FDW_ERR) {
+            return -1;
+        }
+        if (rc & events) {
+            return 0;
+        }
+
+        errno = ETIMEDOUT;
+        return ETIMEDOUT;
+    }
+
+    PgSqlCopyIn::PgSqlCopyIn(PgSqlConnection &conn)
+        : PgSqlCopy(conn)
+    {
+        // signature, flags and header extension length
+        buf.append("PGCOPY\n\377\r\n\0", 11);
+        uint32_t zero{0};
+        buf.append(&zero, sizeof(zero));
+        buf.append(&zero, sizeof(zero));
+    }
+
+    PgSqlCopyIn::PgSqlCopyIn(PgSqlConnection &conn, const char *stmt)
+        : PgSqlCopyIn(conn)
+    {
+        start(stmt, PGRES_COPY_IN);
+    }
+
+    bool PgSqlCopyIn::send() {
+        PGconn *pg = conn.conn;
+        int rc;
+        while ((rc = PQputCopyData(pg, buf.data(), (int) buf.size())) == 0) {
+            // only a non-blocking connection fails to queue the data
+            if (wait(FDW_OUT) || PQflush(pg) < 0) {
+                rc = -1;
+                break;
+            }
+        }
+        buf.bseek(0);
+
+        if (rc < 0) {
+            ierror("COPY: sending rows failed: %s", PQerrorMessage(pg));
+            failed = true;
+            active = false;
+            PQputCopyEnd(pg, "sending rows failed");
+            drain();
+            return false;
+        }
+        return true;
+    }
+
+    bool PgSqlCopyIn::finish() {
+        if (!active) {
+            return !failed;
+        }
+
+        trailer();
+        if (!send()) {
+            return false;
+        }
+
+        PGconn *pg = conn.conn;
+        active = false;
+        int rc;
+        while ((rc = PQputCopyEnd(pg, nullptr)) == 0) {
+            if (wait(FDW_OUT)) {
+                rc = -1;
+                break;
+            }
+        }
+        if (rc < 0) {
+            ierror("COPY: ending copy failed: %s", PQerrorMessage(pg));
+            failed = true;
+        }
+
+        failed = !drain() || failed;
+        idebug("COPY: %lu rows copied, status %d", rows, !failed);
+        return !failed;
+    }
+
+    PgSqlCopyIn::~PgSqlCopyIn() {
+        if (active) {
+            iwarn("COPY: aborting unfinished copy of %lu rows", rows);
+            active = false;
+            if (PQputCopyEnd(conn.conn, "copy aborted") >= 0) {
+                drain();
+            }
+        }
+    }
+
+    PgSqlCopyOut::PgSqlCopyOut(PgSqlConnection &conn, const char *query)
+        : PgSqlCopy(conn)
+    {
+        OBuffer qb(32);
+        qb << "COPY (" << query << ") TO STDOUT";
+        start((char *) qb, PGRES_COPY_OUT);
+    }
+
+    bool PgSqlCopyOut::next() {
+        if (row) {
+            PQfreemem(row);
+            row = nullptr;
+        }
+        cols.clear();
+        if (!active) {
+            return false;
+        }
+
+        PGconn *pg = conn.conn;
+        int len;
+        while ((len = PQgetCopyData(pg, &row, conn.async)) == 0) {
+            // only returned on a non-blocking connection when a row isn't available
+            if (wait(FDW_IN) || !PQconsumeInput(pg)) {
+                ierror("COPY: receiving rows failed: %s", PQerrorMessage(pg));
+                len = -2;
+                break;
+            }
+        }
+
+        if (len < 0) {
+            active = false;
+            if (len == -2) {
+                ierror("COPY: receiving rows failed: %s", PQerrorMessage(pg));
+                failed = true;
+            }
+            failed = !drain() || failed;
+            return false;
+        }
+
+        // split the fields in place
+        char *it = row, *end = row + len;
+        if (end > row && end[-1] == '\n') {
+            *--end = '\0';
+        }
+        while (it <= end) {
+            char *col = it;
+            while (it < end && *it != '\t') it++;
+            *it++ = '\0';
+            cols.push_back(unescape(col)? col : nullptr);
+        }
+
+        rows++;
+        return true;
+    }
+
+    bool PgSqlCopyOut::unescape(char *s) {
+        if (s[0] == '\\' && s[1] == 'N' && s[2] == '\0') {
+            return false;
+        }
+
+        char *out = s;
+        while (*s) {
+            if (*s != '\\' || s[1] == '\0') {
+                *out++ = *s++;
+                continue;
+            }
+            s++;
+            switch (*s) {
+                case 'b': *out++ = '\b'; s++; break;
+                case 'f': *out++ = '\f'; s++; break;
+                case 'n': *out++ = '\n'; s++; break;
+                case 'r': *out++ = '\r'; s++; break;
+                case 't': *out++ = '\t'; s++; break;
+                case 'v': *out++ = '\v'; s++; break;
+                case 'x':
+                    if (isxdigit(s[1])) {
+                        int v = utils::c2i(*++s);
+                        if (isxdigit(s[1])) v = (v << 4) | utils::c2i(*++s);
+                        *out++ = (char) v;
+                        s++;
+                    }
+                    else {
+                        *out++ = *s++;
+                    }
+                    break;
+                default:
+                    if (*s >= '0' && *s <= '7') {
+                        int v{0};
+                        for (int i = 0; i < 3 && *s >= '0' && *s <= '7'; i++) {
+                            v = (v << 3) | (*s++ - '0');
+                        }
+                        *out++ = (char) v;
+                    }
+                    else {
+                        *out++ = *s++;
+                    }
+            }
+        }
+        *out = '\0';
+        return true;
+    }
+
+    PgSqlCopyOut::~PgSqlCopyOut() {
+        if (active) {
+            idebug("COPY: discarding unread rows");
+            while (next());
+        }
+        if (row) {
+            PQfreemem(row);
+            row = nullptr;
+        }
+    }
+
+    PgSqlCursor PgSqlConnection::cursor(const char *query, size_t rows) {
+        return PgSqlCursor(Ego, query, rows);
+    }
+
+    PgSqlCursor::PgSqlCursor(PgSqlConnection &conn, const char *query, size_t rows)
+        : conn(conn),
+          name(utils::catstr("suil_cursor_", ++conn.ncursors)),
+          query(utils::catstr("DECLARE ", name, " NO SCROLL CURSOR FOR ", query)),
+          page(conn.conn, utils::catstr("FETCH ", MAX(rows, 1), " FROM ", name), conn.async, conn.timeout)
+    {}
+
+    bool PgSqlCursor::exec(const char *stmt) {
+        try {
+            PGSQLStatement st(conn.conn, String(stmt).dup(), conn.async, conn.timeout);
+            return st().status();
+        }
+        catch (...) {
+            ierror("CURSOR: %s '%s' failed: %s", name(), stmt, Exception::fromCurrent().what());
+            return false;
+        }
+    }
+
+    bool PgSqlCursor::begin() {
+        if (declared || failed) {
+            // a cursor is declared once
+            return false;
+        }
+
+        if (PQtransactionStatus(conn.conn) == PQTRANS_IDLE) {
+            began = exec("BEGIN");
+            failed = !began;
+        }
+        return !failed;
+    }
+
+    bool PgSqlCursor::fetch() {
+        if (!declared || done) {
+            return false;
+        }
+
+        try {
+            page();
+        }
+        catch (...) {
+            ierror("CURSOR: %s fetch failed: %s", name(), Exception::fromCurrent().what());
+            failed = true;
+        }
+        failed = failed || !page.status();
+        if (failed || page.empty()) {
+            // all the rows were read
+            done = true;
+            return false;
+        }
+        return true;
+    }
+
+    PgSqlCursor::~PgSqlCursor() {
+        if (began) {
+            // committing the transaction closes the cursor
+            exec(failed? "ROLLBACK" : "COMMIT");
+        }
+        else if (declared) {
+            exec(utils::catstr("CLOSE ", name)());
+        }
+    }
+
     void PgSqlConnection::destroy(bool dctor) {
         if (conn == nullptr || --refs > 0) {
             /* Connection still being used */
@@ -113,56 +827,46 @@ namespace suil::sql {
     }
 
     PgSqlDb::~PgSqlDb() {
-        if (cleaning) {
-            /* unschedule the cleaning coroutine */
-            itrace("notifying cleanup routine to exit");
-            !notify;
-        }
-
-        itrace("cleaning up %lu connections", conns.size());
-        auto it = conns.begin();
-        while (it != conns.end()) {
-            (*it).cleanup();
-            conns.erase(it);
-            it = conns.begin();
-        }
+        itrace("cleaning up %lu connections", pool.size());
+        pool.clear();
     }
 
     PgSqlDb::Connection& PgSqlDb::connection() {
-        PGconn *conn{nullptr};
-        if (conns.empty()) {
-            /* open a new Connection */
-            int y{2};
-            do {
-                conn = open();
-                if (conn) break;
-                yield();
-            } while (conns.empty() && y--);
-        }
-
-        if (conn == nullptr){
-            // try find connection from cached list
-            if(!conns.empty()){
-                conn_handle_t h = conns.back();
-                /* cancel Connection expiry */
-                h.alive = -1;
-                conn = h.conn;
-                conns.pop_back();
-            }
-            else {
-                // connection limit reach
-                throw Exception::create("Postgres SQL connection limit reached");
-            }
+        conn_handle_t h;
+        if (!pool.acquire(h)) {
+            // connection limit reach
+            throw Exception::create("Postgres SQL connection limit reached");
         }
 
         Connection *c = new Connection(
-                conn, dbname, async, timeout,
+                h.conn, dbname, async, timeout,
                 [&](Connection* _conn) {
                     free(_conn);
-                });
+                },
+                std::move(h.stmts));
         return *c;
     }
 
+    PgSqlDb::conn_handle_t PgSqlDb::openHandle() {
+        /* open a new Connection */
+        int y{2};
+        do {
+            PGconn *conn = open();
+            if (conn) return conn_handle_t{conn, nullptr};
+            yield();
+        } while (y--);
+
+        throw Exception::create("connecting to database '", dbname, "' failed");
+    }
+
+    void PgSqlDb::closeHandle(conn_handle_t& h) {
+        if (h.conn) {
+            PQfinish(h.conn);
+            h.conn = nullptr;
+        }
+        h.stmts = nullptr;
+    }
+
     PGconn* PgSqlDb::open() {
         PGconn *conn;
         conn = PQconnectdb(conn_str.data());
@@ -183,74 +887,11 @@ namespace suil::sql {
         return conn;
     }
 
-    void PgSqlDb::cleanup(PgSqlDb& db) {
-        /* cleanup all expired connections */
-        bool status;
-        int64_t expires = db.keep_alive + 5;
-        if (db.conns.empty())
-            return;
-
-        db.cleaning = true;
-
-        do {
-            /* if notified to exit, exit immediately*/
-            uint8_t status{0};
-            if ((db.notify[expires] >> status)) {
-                if (status == 1) break;
-            }
-
-            /* was not forced to exit */
-            auto it = db.conns.begin();
-            /* un-register all expired connections and all that will expire in the
-             * next 500 ms */
-            int64_t t = mnow() + 500;
-            int pruned = 0;
-            ltrace(&db, "starting prune with %ld connections", db.conns.size());
-            while (it != db.conns.end()) {
-                if ((*it).alive <= t) {
-                    (*it).cleanup();
-                    db.conns.erase(it);
-                    it = db.conns.begin();
-                } else {
-                    /* there is no point in going forward */
-                    break;
-                }
-
-                if ((++pruned % 100) == 0) {
-                    /* avoid hogging the CPU */
-                    yield();
-                }
-            }
-            ltrace(&db, "pruned %ld connections", pruned);
-
-            if (it != db.conns.end()) {
-                /*ensure that this will run after at least 3 second*/
-                expires = std::max((*it).alive - t, (int64_t)3000);
-            }
-
-        } while (!db.conns.empty());
-
-        db.cleaning = false;
-    }
-
     void PgSqlDb::free(Connection* conn) {
-        conn_handle_t h {conn->conn, -1};
-
-        if (keep_alive != 0) {
-            /* set connections keep alive */
-            h.alive = mnow() + keep_alive;
-            conns.push_back(h);
-
-            if (!cleaning && keep_alive > 0) {
-                strace("scheduling cleaning...");
-                /* schedule cleanup routine */
-                go(cleanup(*this));
-            }
-        }
-        else {
-            /* cleanup now*/
-            PQfinish(h.conn);
-        }
+        conn_handle_t h {conn->conn, conn->stmt_cache};
+        /* broken connections are not reused */
+        bool ok = PQstatus(h.conn) == CONNECTION_OK;
+        pool.release(std::move(h), ok);
     }
 
     typedef decltype(iod::D(
@@ -280,3 +921,265 @@ namespace suil {
         orm.cifne(reset);
     }
 }
+
+#ifdef unit_test
+#include <catch/catch.hpp>
+
+using namespace suil;
+using namespace suil::sql;
+
+namespace {
+
+    // network order encoders of the binary wire format
+    template <typename T>
+    void be(std::string& b, T v) {
+        char tmp[sizeof(T)];
+        memcpy(tmp, &v, sizeof(T));
+        for (size_t i = 0; i < sizeof(T); i++)
+            b.push_back(tmp[sizeof(T)-1-i]);
+    }
+
+    // a single row result whose columns are in binary format
+    PGresult *binaryRow(const std::vector<std::pair<Oid, std::string>>& cols) {
+        PGresult *res = PQmakeEmptyPGresult(nullptr, PGRES_TUPLES_OK);
+        std::vector<PGresAttDesc> attrs(cols.size());
+        for (size_t i = 0; i < cols.size(); i++) {
+            attrs[i] = PGresAttDesc{(char *) "col", 0, 0, 1, cols[i].first, -1, -1};
+        }
+        PQsetResultAttrs(res, (int) attrs.size(), attrs.data());
+        for (size_t i = 0; i < cols.size(); i++) {
+            PQsetvalue(res, 0, (int) i, (char *) cols[i].second.data(), (int) cols[i].second.size());
+        }
+        return res;
+    }
+}
+
+TEST_CASE("suil::sql::PgSql binary results", "[sql][pgsql]") {
+
+    SECTION("Decoding binary numbers") {
+        std::string b;
+        int n{0};
+        long long ll{0};
+        double d{0};
+        float f{0};
+        bool yes{false};
+        unsigned int u{0};
+
+        be(b, (int16_t) -2);
+        REQUIRE(sql::__internal::binary_to_number(b.data(), INT2OID, n));
+        REQUIRE(n == -2);
+        b.clear(); be(b, (int32_t) 65536);
+        REQUIRE(sql::__internal::binary_to_number(b.data(), INT4OID, n));
+        REQUIRE(n == 65536);
+        b.clear(); be(b, (int64_t) -5000000000LL);
+        REQUIRE(sql::__internal::binary_to_number(b.data(), INT8OID, ll));
+        REQUIRE(ll == -5000000000LL);
+        b.clear(); be(b, (uint32_t) 4000000000u);
+        REQUIRE(sql::__internal::binary_to_number(b.data(), OIDOID, u));
+        REQUIRE(u == 4000000000u);
+        b.clear(); be(b, 0.1);
+        REQUIRE(sql::__internal::binary_to_number(b.data(), FLOAT8OID, d));
+        REQUIRE(d == 0.1);
+        b.clear(); be(b, 1.5f);
+        REQUIRE(sql::__internal::binary_to_number(b.data(), FLOAT4OID, f));
+        REQUIRE(f == 1.5f);
+        // converted to the type read into
+        REQUIRE(sql::__internal::binary_to_number(b.data(), FLOAT4OID, d));
+        REQUIRE(d == 1.5);
+        REQUIRE(sql::__internal::binary_to_number("\1", BOOLOID, yes));
+        REQUIRE(yes);
+        // other types are left to the text decoder
+        REQUIRE_FALSE(sql::__internal::binary_to_number(b.data(), TEXTOID, n));
+    }
+
+    SECTION("Decoding binary arrays") {
+        // one dimension with a NULL element
+        std::string b;
+        be(b, (int32_t) 1); be(b, (int32_t) 1); be(b, (uint32_t) INT4OID);
+        be(b, (int32_t) 3); be(b, (int32_t) 1);
+        be(b, (int32_t) 4); be(b, (int32_t) 7);
+        be(b, (int32_t) -1);
+        be(b, (int32_t) 4); be(b, (int32_t) -9);
+        std::vector<int> ints;
+        REQUIRE(sql::__internal::binary_to_array(ints, b.data(), (int) b.size()));
+        REQUIRE((ints == std::vector<int>{7, 0, -9}));
+
+        std::string t;
+        be(t, (int32_t) 1); be(t, (int32_t) 0); be(t, (uint32_t) TEXTOID);
+        be(t, (int32_t) 2); be(t, (int32_t) 1);
+        be(t, (int32_t) 5); t += "hello";
+        be(t, (int32_t) 0);
+        std::vector<String> strs;
+        REQUIRE(sql::__internal::binary_to_array(strs, t.data(), (int) t.size()));
+        REQUIRE(strs.size() == 2);
+        REQUIRE(strs[0] == "hello");
+        REQUIRE(strs[1].empty());
+
+        // empty arrays have no dimensions
+        std::string e;
+        be(e, (int32_t) 0); be(e, (int32_t) 0); be(e, (uint32_t) INT4OID);
+        ints.clear();
+        REQUIRE(sql::__internal::binary_to_array(ints, e.data(), (int) e.size()));
+        REQUIRE(ints.empty());
+
+        // truncated elements and multiple dimensions are rejected
+        ints.clear();
+        REQUIRE_FALSE(sql::__internal::binary_to_array(ints, b.data(), (int) b.size() - 2));
+        REQUIRE_FALSE(sql::__internal::binary_to_array(ints, b.data(), 16));
+        std::string m;
+        be(m, (int32_t) 2); be(m, (int32_t) 0); be(m, (uint32_t) INT4OID);
+        be(m, (int32_t) 1); be(m, (int32_t) 1); be(m, (int32_t) 1); be(m, (int32_t) 1);
+        REQUIRE_FALSE(sql::__internal::binary_to_array(ints, m.data(), (int) m.size()));
+    }
+
+    SECTION("Binary values read as text match the text format") {
+        std::string i8, f8, f4, inf, bytea{"\x01\xab\x00", 3};
+        be(i8, (int64_t) -42);
+        be(f8, 0.1);
+        be(f4, 0.1f);
+        be(inf, -std::numeric_limits<double>::infinity());
+        PGSQLStatement::pgsql_result r;
+        r.add(binaryRow({{INT8OID, i8}, {FLOAT8OID, f8}, {FLOAT4OID, f4},
+                         {FLOAT8OID, inf}, {BYTEAOID, bytea}, {BYTEAOID, ""}}));
+        r.reset();
+
+        String s;
+        std::string ss;
+        REQUIRE(r.read(s, 0));
+        REQUIRE(s == "-42");
+        REQUIRE(r.read(s, 1));
+        REQUIRE(s == "0.1");
+        REQUIRE(r.read(s, 2));
+        REQUIRE(s == "0.1");
+        REQUIRE(r.read(ss, 3));
+        REQUIRE(ss == "-Infinity");
+        // bytea is hex encoded
+        REQUIRE(r.read(s, 4));
+        REQUIRE(s == "\\x01ab00");
+        REQUIRE(r.read(ss, 5));
+        REQUIRE(ss == "\\x");
+        double d{0};
+        REQUIRE(r.read(d, 1));
+        REQUIRE(d == 0.1);
+    }
+}
+
+TEST_CASE("suil::sql::PgSql COPY", "[sql][pgsql]") {
+
+    SECTION("Decoding text COPY values") {
+        auto unescaped = [](const char *in) {
+            std::string tmp{in};
+            if (!PgSqlCopyOut::unescape(&tmp[0])) return std::string{"NULL"};
+            return std::string(tmp.c_str());
+        };
+
+        REQUIRE(unescaped("\\N") == "NULL");
+        // only the whole value is a NULL
+        REQUIRE(unescaped("\\Nx") == "Nx");
+        REQUIRE(unescaped("N") == "N");
+        REQUIRE(unescaped("") == "");
+        REQUIRE(unescaped("a\\tb\\nc") == "a\tb\nc");
+        REQUIRE(unescaped("\\b\\f\\r\\v") == "\b\f\r\v");
+        REQUIRE(unescaped("c:\\\\dir") == "c:\\dir");
+        // octal and hex escapes
+        REQUIRE(unescaped("\\101\\0602") == "A02");
+        REQUIRE(unescaped("\\x41\\x4g") == "A\x04g");
+        REQUIRE(unescaped("\\xg") == "xg");
+        // other escaped characters are taken literally, a trailing backslash is kept
+        REQUIRE(unescaped("\\q\\") == "q\\");
+    }
+
+    SECTION("Binary COPY framing") {
+        using cstr = const char*;
+        typedef decltype(iod::D(
+            prop(id, int),
+            prop(name, cstr),
+            prop(val, std::vector<int>)
+        )) Row;
+
+        Row first, second;
+        first.id = 7;
+        first.name = "ab";
+        first.val = {1, 2};
+        second.id = -1;
+        second.name = nullptr;
+
+        PgSqlConnection conn;
+        PgSqlCopyIn cp(conn);
+        cp.active = true;
+        cp << first << second;
+        cp.trailer();
+        cp.active = false;
+        REQUIRE(cp.size() == 2);
+
+        std::string expected{"PGCOPY\n\377\r\n\0", 11};
+        // flags and header extension length
+        be(expected, (int32_t) 0); be(expected, (int32_t) 0);
+        // 3 fields of 4, 2 and 40 bytes
+        be(expected, (int16_t) 3);
+        be(expected, (int32_t) 4); be(expected, (int32_t) 7);
+        be(expected, (int32_t) 2); expected += "ab";
+        be(expected, (int32_t) 36);
+        be(expected, (int32_t) 1); be(expected, (int32_t) 0); be(expected, (uint32_t) INT4OID);
+        be(expected, (int32_t) 2); be(expected, (int32_t) 1);
+        be(expected, (int32_t) 4); be(expected, (int32_t) 1);
+        be(expected, (int32_t) 4); be(expected, (int32_t) 2);
+        // NULL's have a length of -1
+        be(expected, (int16_t) 3);
+        be(expected, (int32_t) 4); be(expected, (int32_t) -1);
+        be(expected, (int32_t) -1);
+        be(expected, (int32_t) 20);
+        be(expected, (int32_t) 1); be(expected, (int32_t) 0); be(expected, (uint32_t) INT4OID);
+        be(expected, (int32_t) 0); be(expected, (int32_t) 1);
+        // trailer
+        be(expected, (int16_t) -1);
+
+        REQUIRE(std::string(cp.buf.data(), cp.buf.size()) == expected);
+    }
+}
+
+TEST_CASE("suil::sql::PgSql prepared statements", "[sql][pgsql]") {
+    SECTION("Statements that can be prepared") {
+        const std::pair<const char *, bool> cases[] = {
+            {"SELECT 1", true},
+            {"select * from t", true},
+            {"INSERT INTO t VALUES($1)", true},
+            {"UPDATE t SET a = 1", true},
+            {"DELETE FROM t", true},
+            {"WITH x AS (SELECT 1) SELECT * FROM x", true},
+            {"VALUES (1), (2)", true},
+            {"SELECT(1)", true},
+            // leading whitespace and comments
+            {"  \n\tSELECT 1", true},
+            {"-- the users\nSELECT * FROM users", true},
+            {"/* the users */ SELECT * FROM users", true},
+            {"/* a */ -- b\n /* c */SELECT 1", true},
+            {"-- SELECT 1", false},
+            {"/* SELECT 1", false},
+            // a single statement
+            {"SELECT 1;", true},
+            {"SELECT 1; -- done\n", true},
+            {"SELECT ';' FROM t", true},
+            {"SELECT \"a;b\" FROM t", true},
+            {"SELECT 1 -- ;SELECT 2\n", true},
+            {"SELECT 1; SELECT 2", false},
+            {"INSERT INTO t VALUES('a;'); DELETE FROM t", false},
+            {"SELECT 1;/* x */;", false},
+            // other commands
+            {"", false},
+            {"   ", false},
+            {"SELECT", false},
+            {"SELECTED", false},
+            {"CREATE TABLE t(a INT)", false},
+            {"BEGIN", false},
+            {"COPY t FROM STDIN", false},
+            {"SET search_path TO x; SELECT 1", false},
+        };
+        for (auto& c: cases) {
+            CINFO(c.first);
+            REQUIRE(PgSqlConnection::preparable(c.first) == c.second);
+        }
+    }
+}
+
+#endif
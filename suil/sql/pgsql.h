@@ -8,14 +8,21 @@
 
 #include <libpq-fe.h>
 #include <netinet/in.h>
+#include <cmath>
 #include <deque>
+#include <limits>
 #include <memory>
 
 #include <suil/blob.h>
 #include <suil/channel.h>
+#include <suil/pool.h>
 #include <suil/sql/middleware.h>
 #include <suil/sql/orm.h>
 
+#ifndef SUIL_PGSQL_COPY_CHUNK
+#define SUIL_PGSQL_COPY_CHUNK 65536
+#endif
+
 namespace suil {
     namespace sql {
 
@@ -27,19 +34,26 @@ namespace suil {
         };
 
         enum pg_types_t {
+            BOOLOID  = 16,
             BYTEAOID = 17,
             CHAROID  = 18,
+            NAMEOID  = 19,
             INT8OID  = 20,
             INT2OID  = 21,
             INT4OID  = 23,
             TEXTOID  = 25,
+            OIDOID   = 26,
             JSONOID = 114,
             FLOAT4OID = 700,
             FLOAT8OID = 701,
             INT2ARRAYOID   = 1005,
             INT4ARRAYOID   = 1007,
             TEXTARRAYOID   = 1009,
+            INT8ARRAYOID   = 1016,
             FLOAT4ARRAYOID = 1021,
+            FLOAT8ARRAYOID = 1022,
+            BPCHAROID  = 1042,
+            VARCHAROID = 1043,
             JSONBOID = 3802
 
         };
@@ -285,16 +299,178 @@ namespace suil {
                 to.u32_1 = ntohl(from->u32_2);
                 to.u32_2 = ntohl(from->u32_1);
             }
+
+            /**
+             * @return true if columns of the given type can be requested in binary
+             * format, i.e they can be decoded by \see binary_to_number and
+             * \see binary_to_array or their binary format is their text
+             */
+            inline bool binary_result_oid(Oid oid) {
+                switch (oid) {
+                    case BOOLOID:  case BYTEAOID: case CHAROID:
+                    case NAMEOID:  case INT8OID:  case INT2OID:
+                    case INT4OID:  case TEXTOID:  case OIDOID:
+                    case JSONOID:  case FLOAT4OID: case FLOAT8OID:
+                    case INT2ARRAYOID:   case INT4ARRAYOID:
+                    case TEXTARRAYOID:   case INT8ARRAYOID:
+                    case FLOAT4ARRAYOID: case FLOAT8ARRAYOID:
+                    case BPCHAROID: case VARCHAROID: case JSONBOID:
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+
+            template <typename Args>
+            static bool binary_to_number(const char *buf, Oid oid, Args& v) {
+                switch (oid) {
+                    case BOOLOID:
+                    case CHAROID:
+                        v = (Args) *buf;
+                        return true;
+                    case INT2OID: {
+                        short int n;
+                        vnod_to_vhod(buf, n);
+                        v = (Args) n;
+                        return true;
+                    }
+                    case INT4OID: {
+                        int n;
+                        vnod_to_vhod(buf, n);
+                        v = (Args) n;
+                        return true;
+                    }
+                    case OIDOID: {
+                        unsigned int n;
+                        vnod_to_vhod(buf, n);
+                        v = (Args) n;
+                        return true;
+                    }
+                    case INT8OID: {
+                        long long n;
+                        vnod_to_vhod(buf, n);
+                        v = (Args) n;
+                        return true;
+                    }
+                    case FLOAT4OID: {
+                        float n;
+                        vnod_to_vhod(buf, n);
+                        v = (Args) n;
+                        return true;
+                    }
+                    case FLOAT8OID: {
+                        double n;
+                        vnod_to_vhod(buf, n);
+                        v = (Args) n;
+                        return true;
+                    }
+                    default:
+                        return false;
+                }
+            }
+
+            /**
+             * formats a binary float like the text output of the server, with the least
+             * number of digits that reads back as the same value
+             */
+            template <typename F>
+            static void float_to_text(OBuffer& b, F v) {
+                if (std::isnan(v)) {
+                    b << "NaN";
+                    return;
+                }
+                if (std::isinf(v)) {
+                    b << (v < 0? "-Infinity" : "Infinity");
+                    return;
+                }
+
+                char tmp[32];
+                for (int digits: {std::numeric_limits<F>::digits10, std::numeric_limits<F>::max_digits10}) {
+                    snprintf(tmp, sizeof(tmp), "%.*g", digits, (double) v);
+                    if ((F) strtod(tmp, nullptr) == v) break;
+                }
+                b << tmp;
+            }
+
+            template <typename Args>
+            static typename std::enable_if<std::is_arithmetic<Args>::value, bool>::type
+            binary_array_value(const char *buf, int len, Oid oid, Args& v) {
+                return binary_to_number(buf, oid, v);
+            }
+
+            static bool binary_array_value(const char *buf, int len, Oid oid, String& v) {
+                v = String(buf, (size_t) len, false).dup();
+                return true;
+            }
+
+            template <typename Args>
+            static bool binary_to_array(std::vector<Args>& to, const char *buf, int len) {
+                // dimensions, null flag and element type followed by the size and
+                // lower bound of each dimension
+                if (len < 12) return false;
+                int ndim;
+                unsigned int oid;
+                vnod_to_vhod(buf, ndim);
+                vnod_to_vhod(buf+8, oid);
+                if (ndim == 0) return true;
+                if (ndim != 1 || len < 20) return false;
+
+                int n;
+                vnod_to_vhod(buf+12, n);
+                const char *it = buf+20, *end = buf+len;
+                while (n-- > 0) {
+                    int sz;
+                    if (it+4 > end) return false;
+                    vnod_to_vhod(it, sz);
+                    it += 4;
+                    if (sz < 0) {
+                        // NULL element
+                        to.emplace_back();
+                        continue;
+                    }
+                    if (it+sz > end) return false;
+
+                    Args v{};
+                    if (!binary_array_value(it, sz, oid, v)) return false;
+                    to.push_back(std::move(v));
+                    it += sz;
+                }
+                return true;
+            }
+
+            template <typename T, typename = void>
+            struct copy_schema { using type = T; };
+            template <typename T>
+            struct copy_schema<T, typename std::enable_if<std::is_base_of<iod::MetaType, T>::value>::type> {
+                using type = typename T::Schema;
+            };
+            template <typename T>
+            using copy_schema_t = typename copy_schema<T>::type;
+
+            // the fields written by COPY FROM, the same fields as an insert
+            template <typename T>
+            using copy_in_fields_t = remove_ignore_fields_t<remove_auto_increment_t<copy_schema_t<T>>>;
         };
 
+        struct PgSqlPipeline;
+        struct PgSqlCopyIn;
+        struct PgSqlCopyOut;
+        struct PgSqlCursor;
+
         struct PGSQLStatement : LOGGER(PGSQL_CONN) {
 
-            PGSQLStatement(PGconn *conn, String&& stmt, bool async, int64_t timeout = -1)
+            PGSQLStatement(PGconn *conn, String&& stmt, bool async, int64_t timeout = -1, String&& name = nullptr)
                 : conn(conn),
                   stmt(std::move(stmt)),
                   async(async),
                   timeout(timeout)
-            {}
+            {
+                if (!name.empty()) {
+                    // copies of the statement share its server side state
+                    prepared = std::make_shared<prepared_t>();
+                    prepared->name = std::move(name);
+                }
+            }
 
             template <typename... Args>
             auto& operator()(Args&&... args) {
@@ -329,9 +505,72 @@ namespace suil {
                 };
 
                 // Clear the results (important for reused statements)
+                if (streaming) finish();
                 results.clear();
-                if (async) {
-                    int status = PQsendQueryParams(
+                const char *name = prepare((int) sizeof...(Args), oids);
+                int fmt = (name && prepared->binary)? 1 : 0;
+                if (pipeline != nullptr) {
+                    // results are collected by the pipeline, \see PgSqlPipeline::exec
+                    int status = name?
+                        PQsendQueryPrepared(
+                            conn,
+                            name,
+                            (int) sizeof...(Args),
+                            values,
+                            lens,
+                            bins,
+                            fmt) :
+                        PQsendQueryParams(
+                            conn,
+                            stmt.data(),
+                            (int) sizeof...(Args),
+                            oids,
+                            values,
+                            lens,
+                            bins,
+                            0);
+                    if (!status) {
+                        ierror("PIPELINE QUERY: %s failed: %s", stmt(), PQerrorMessage(conn));
+                        throw Exception::create("queuing query failed: ", PQerrorMessage(conn));
+                    }
+                    sent();
+                }
+                else if (chunk) {
+                    // rows are received as they are read, \see PGSQLStatement::fetch
+                    int status = name?
+                        PQsendQueryPrepared(
+                            conn,
+                            name,
+                            (int) sizeof...(Args),
+                            values,
+                            lens,
+                            bins,
+                            fmt) :
+                        PQsendQueryParams(
+                            conn,
+                            stmt.data(),
+                            (int) sizeof...(Args),
+                            oids,
+                            values,
+                            lens,
+                            bins,
+                            0);
+                    if (!status || !rowmode()) {
+                        ierror("STREAM QUERY: %s failed: %s", stmt(), PQerrorMessage(conn));
+                        throw Exception::create("streaming query failed: ", PQerrorMessage(conn));
+                    }
+                }
+                else if (async) {
+                    int status = name?
+                        PQsendQueryPrepared(
+                            conn,
+                            name,
+                            (int) sizeof...(Args),
+                            values,
+                            lens,
+                            bins,
+                            fmt) :
+                        PQsendQueryParams(
                             conn,
                             stmt.data(),
                             (int) sizeof...(Args),
@@ -413,7 +652,16 @@ namespace suil {
                     itrace("ASYNC QUERY: received %d results", results.results.size());
                 }
                 else {
-                    PGresult *result = PQexecParams(
+                    PGresult *result = name?
+                        PQexecPrepared(
+                            conn,
+                            name,
+                            (int) sizeof...(Args),
+                            values,
+                            lens,
+                            bins,
+                            fmt) :
+                        PQexecParams(
                             conn,
                             stmt.data(),
                             (int) sizeof...(Args),
@@ -444,15 +692,34 @@ namespace suil {
                 return *this;
             }
 
+            /**
+             * the next execution of the statement streams its rows instead of receiving
+             * them all, rows are received as they are read with \see PGSQLStatement::operator|
+             * and only the current chunk of rows is kept in memory
+             *
+             * @param rows the number of rows in each chunk, libpq < 17 receives rows one at a time
+             *
+             * @code
+             *  conn("SELECT * FROM logs WHERE at > $1").stream(500)(since) | [&](Log& log) {...};
+             * @endcode
+             *
+             * The connection can't be used for other statements until all the rows are read
+             * or the statement is destroyed, rows not read are then received and discarded
+             */
+            inline PGSQLStatement& stream(size_t rows = 1) {
+                chunk = MAX(rows, 1);
+                return Ego;
+            }
+
             template <typename... O>
             inline bool operator>>(iod::sio<O...>& o) {
-                if (results.empty()) return false;
+                if (!ready()) return false;
                 return rowToSio(o);
             }
 
             template <typename Args>
             bool operator>>(Args& o) {
-                if (results.empty()) return false;
+                if (!ready()) return false;
                 if constexpr (std::is_base_of<iod::MetaType,Args>::value) {
                     // meta
                     return Ego.rowToMeta(o);
@@ -465,7 +732,7 @@ namespace suil {
 
             template <typename Args>
             bool operator>>(std::vector<Args>& l) {
-                if (results.empty()) return false;
+                if (!ready()) return false;
 
                 do {
                     Args o;
@@ -474,14 +741,14 @@ namespace suil {
                         l.push_back(std::move(o));
                     }
 
-                } while (results.next());
+                } while (advance());
 
                 return !l.empty();
             }
 
             template <typename F>
             void operator|(F f) {
-                if (results.empty()) return;
+                if (!ready()) return;
 
                 typedef iod::callable_arguments_tuple_t<F> __tmp;
                 typedef std::remove_reference_t<std::tuple_element_t<0, __tmp>> Args;
@@ -489,7 +756,7 @@ namespace suil {
                     Args o;
                     if (Ego >> o)
                         f(o);
-                } while (results.next());
+                } while (advance());
 
                 // reset the iterator
                 results.reset();
@@ -507,7 +774,17 @@ namespace suil {
                 return results.empty();
             }
 
-        private:
+            ~PGSQLStatement();
+
+        private suil_ut:
+
+            inline bool ready() {
+                return !results.empty() || (streaming && fetch());
+            }
+
+            inline bool advance() {
+                return results.next() || (streaming && fetch());
+            }
 
             inline int wait_read() {
                 int sock = PQsocket(conn);
@@ -725,8 +1002,11 @@ namespace suil {
                     if (!empty()) {
                         char *data = PQgetvalue(*it, row, col);
                         if (data != nullptr) {
-                            //__internal::vnod_to_vhod(data, v);
-                            String tmp(data);
+                            if (PQfformat(*it, col) &&
+                                __internal::binary_to_number(data, PQftype(*it, col), v))
+                            {
+                                return true;
+                            }
                             utils::cast(data, v);
                             return true;
                         }
@@ -740,6 +1020,9 @@ namespace suil {
                         char *data = PQgetvalue(*it, row, col);
                         if (data != nullptr) {
                             int len = PQgetlength(*it, row, col);
+                            if (PQfformat(*it, col)) {
+                                return __internal::binary_to_array(v, data, len);
+                            }
                             __internal::parse_array(v, data);
                             return true;
                         }
@@ -747,11 +1030,70 @@ namespace suil {
                     return false;
                 }
 
+                /**
+                 * @return the value at the given column in text format, numbers in
+                 * binary results are formatted into \param tmp
+                 */
+                const char *text(int col, int& len, OBuffer& tmp) {
+                    char *data = PQgetvalue(*it, row, col);
+                    len = PQgetlength(*it, row, col);
+                    if (data == nullptr || !PQfformat(*it, col)) {
+                        return data;
+                    }
+
+                    Oid oid = PQftype(*it, col);
+                    switch (oid) {
+                        case JSONBOID:
+                            // binary jsonb is prefixed with its format version
+                            if (len > 0) {
+                                len--;
+                                data++;
+                            }
+                            return data;
+                        case BOOLOID:
+                            tmp << (*data? 't' : 'f');
+                            break;
+                        case BYTEAOID:
+                            // same as the hex text output of bytea
+                            tmp << "\\x";
+                            if (len > 0) {
+                                tmp << utils::hexstr((const uint8_t *) data, (size_t) len);
+                            }
+                            break;
+                        case FLOAT4OID: {
+                            float f;
+                            __internal::binary_to_number(data, oid, f);
+                            __internal::float_to_text(tmp, f);
+                            break;
+                        }
+                        case FLOAT8OID: {
+                            double d;
+                            __internal::binary_to_number(data, oid, d);
+                            __internal::float_to_text(tmp, d);
+                            break;
+                        }
+                        case INT2OID:
+                        case INT4OID:
+                        case INT8OID:
+                        case OIDOID: {
+                            long long n;
+                            __internal::binary_to_number(data, oid, n);
+                            tmp << n;
+                            break;
+                        }
+                        default:
+                            return data;
+                    }
+                    len = (int) tmp.size();
+                    return tmp.data();
+                }
+
                 bool read(std::string& v, int col) {
                     if (!empty()) {
-                        char *data = PQgetvalue(*it, row, col);
+                        OBuffer tmp(0);
+                        int len;
+                        const char *data = text(col, len, tmp);
                         if (data != nullptr) {
-                            int len = PQgetlength(*it, row, col);
                             v.resize((size_t) len);
                             memcpy(&v[0], data, (size_t) len);
                             return true;
@@ -787,9 +1129,10 @@ namespace suil {
 
                 bool read(String& v, int col) {
                     if (!empty()) {
-                        char *data = PQgetvalue(*it, row, col);
+                        OBuffer tmp(0);
+                        int len;
+                        const char *data = text(col, len, tmp);
                         if (data != nullptr) {
-                            int len = PQgetlength(*it, row, col);
                             v = std::move(String(data, len, false).dup());
                             return true;
                         }
@@ -835,11 +1178,55 @@ namespace suil {
                 }
             };
 
+            // records the statement as waiting for its results in the pipeline
+            void sent();
+
+            /**
+             * prepares the statement on the server the first time it is executed
+             * @return the name of the prepared statement or nullptr if the statement
+             * must be sent with its text
+             */
+            const char *prepare(int nparams, const Oid *oids);
+
+            // waits for the results of an async command and returns the last one
+            PGresult *await();
+
+            // waits for the next result of an async command
+            PGresult *receive(bool& err);
+
+            // switches the query that was just sent to single row or chunked rows mode
+            bool rowmode();
+
+            /**
+             * replaces the rows read so far with the next chunk of a streamed query
+             * @return false if there are no more rows
+             */
+            bool fetch();
+
+            // discards the rows of a streamed query that were not read
+            void finish();
+
+            struct prepared_t {
+                enum : uint8_t { Pending, Ready, Failed };
+                String name{nullptr};
+                // the parameter types the statement was prepared with
+                std::vector<Oid> oids;
+                // whether all the result columns can be decoded from the binary format
+                bool    binary{false};
+                uint8_t state{Pending};
+            };
+
+            friend struct PgSqlPipeline;
             String     stmt;
             PGconn       *conn;
             bool         async;
             int64_t      timeout;
             pgsql_result results;
+            PgSqlPipeline *pipeline{nullptr};
+            std::shared_ptr<prepared_t> prepared{nullptr};
+            // the number of rows in each chunk of a streamed query
+            size_t       chunk{0};
+            bool         streaming{false};
         };
 
         struct PgSqlConnection: LOGGER(PGSQL_CONN) {
@@ -848,8 +1235,10 @@ namespace suil {
             typedef std::shared_ptr<stmt_map_t>  stmt_map_ptr_t;
             using free_conn_t = std::function<void(PgSqlConnection*)>;
 
-            PgSqlConnection(PGconn *conn, String& dname, bool async, int64_t timeout, free_conn_t free_conn)
+            PgSqlConnection(PGconn *conn, String& dname, bool async, int64_t timeout,
+                            free_conn_t free_conn, stmt_map_ptr_t stmts = nullptr)
                 : conn(conn),
+                  stmt_cache(stmts? stmts : std::make_shared<stmt_map_t>()),
                   async(async),
                   timeout(timeout),
                   free_conn(free_conn),
@@ -865,6 +1254,29 @@ namespace suil {
 
             PGSQLStatement operator()(const char *req);
 
+            /**
+             * @return a pipeline on this connection, \see PgSqlPipeline
+             */
+            PgSqlPipeline pipeline();
+
+            /**
+             * starts loading objects of type \tparam T into the given table with COPY,
+             * \see PgSqlCopyIn
+             */
+            template <typename T>
+            PgSqlCopyIn copyin(const char *table);
+
+            /**
+             * starts streaming the rows of the given query with COPY, \see PgSqlCopyOut
+             */
+            PgSqlCopyOut copyout(const char *query);
+
+            /**
+             * creates a server side cursor for the given query, \see PgSqlCursor
+             * @param rows the number of rows fetched at a time
+             */
+            PgSqlCursor cursor(const char *query, size_t rows = 1000);
+
             inline bool has_table(const char *name) {
                 const char *schema = "public";
                 return has_table(schema, name);
@@ -950,23 +1362,481 @@ namespace suil {
                 }
             }
 
-        private:
+        private suil_ut:
 
             void destroy(bool dctor = false );
 
+            // whether the statement can be prepared, \see PGSQLStatement::prepare
+            static bool preparable(const String& stmt);
+
             friend struct PgSqlDb;
+            friend struct PgSqlPipeline;
+            friend struct PgSqlCopy;
+            friend struct PgSqlCopyIn;
+            friend struct PgSqlCopyOut;
+            friend struct PgSqlCursor;
             PGconn      *conn{nullptr};
-            stmt_map_t  stmt_cache;
+            // statements prepared on the connection, kept with the connection when it is pooled
+            stmt_map_ptr_t stmt_cache{std::make_shared<stmt_map_t>()};
             bool        async{false};
             int64_t     timeout{-1};
             free_conn_t free_conn;
             active_conns_iterator_t handle;
             int         refs{1};
             bool        deleting{false};
+            // used to name cursors
+            uint32_t    ncursors{0};
             suil::String dbname{"public"};
         };
         typedef std::vector<PgSqlConnection*> active_conns_t;
 
+        /**
+         * Runs statements in libpq's pipeline mode: the statements are sent to the
+         * server as they are queued, without waiting for the results of the previous
+         * ones, and all the results are collected in a single round trip by
+         * \see PgSqlPipeline::exec.
+         *
+         * @code
+         *  auto pl = conn.pipeline();
+         *  pl("INSERT INTO logs VALUES($1, $2)")(at, msg);
+         *  auto& q = pl("SELECT count(*) FROM logs");
+         *  q();
+         *  if (pl.exec()) q >> count;
+         * @endcode
+         *
+         * If a statement fails, the statements queued after it up to the end of the
+         * batch are aborted by the server. Statements queued and not executed when the
+         * pipeline is destroyed are executed. With a libpq that doesn't support
+         * pipelining (< 14) each statement is executed when it is invoked.
+         */
+        struct PgSqlPipeline : LOGGER(PGSQL_CONN) {
+            PgSqlPipeline(PgSqlConnection& conn);
+
+            PgSqlPipeline(const PgSqlPipeline&) = delete;
+            PgSqlPipeline&operator=(const PgSqlPipeline&) = delete;
+
+            /**
+             * queues a statement, the returned statement must be invoked with its
+             * parameters to send it. Its results are available after \see PgSqlPipeline::exec
+             */
+            PGSQLStatement& operator()(OBuffer& req);
+
+            PGSQLStatement& operator()(const char *req);
+
+            /**
+             * sends the statements queued since the last call and receives all their
+             * results
+             * @return true if all the statements succeeded
+             */
+            bool exec();
+
+            inline size_t size() const {
+                return stmts.size();
+            }
+
+            inline PGSQLStatement& operator[](size_t idx) {
+                return stmts.at(idx);
+            }
+
+            ~PgSqlPipeline();
+
+        private suil_ut:
+            PGSQLStatement& queue(PGSQLStatement&& stmt);
+
+            PGresult *next(bool& err);
+
+            int  wait(int events);
+
+            friend struct PGSQLStatement;
+            PgSqlConnection&           conn;
+            // statements are never moved once queued
+            std::deque<PGSQLStatement> stmts;
+            // the statements sent and not executed, in the order they were sent
+            std::vector<PGSQLStatement*> inflight;
+            // the first statement queued after the last execution
+            size_t                     pending{0};
+            bool                       active{false};
+        };
+
+        /**
+         * Common state of COPY operations, the connection can't be used for
+         * other statements while a COPY is in progress
+         */
+        struct PgSqlCopy : LOGGER(PGSQL_CONN) {
+            PgSqlCopy(const PgSqlCopy&) = delete;
+            PgSqlCopy&operator=(const PgSqlCopy&) = delete;
+
+            inline bool status() const {
+                return !failed;
+            }
+
+            /**
+             * @return the number of rows copied so far
+             */
+            inline size_t size() const {
+                return rows;
+            }
+
+        protected suil_ut:
+            PgSqlCopy(PgSqlConnection& conn)
+                : conn(conn)
+            {}
+
+            /**
+             * sends the COPY statement and waits for the server to switch to
+             * the \param expect COPY state
+             * @throws Exception if the statement fails
+             */
+            void start(const char *stmt, ExecStatusType expect);
+
+            // the next result of the connection, nullptr when there are no more results
+            PGresult *result();
+
+            // consumes the remaining results, \return true if none of them is an error
+            bool drain();
+
+            int  wait(int events);
+
+            PgSqlConnection& conn;
+            size_t           rows{0};
+            bool             active{false};
+            bool             failed{false};
+        };
+
+        /**
+         * Loads rows into a table with COPY ... FROM STDIN in binary format. Rows are
+         * buffered and sent in chunks of SUIL_PGSQL_COPY_CHUNK bytes, on an async connection
+         * waiting for the socket yields to other coroutines.
+         *
+         * @code
+         *  auto cp = conn.copyin<Log>("logs");
+         *  for (auto& log: logs)
+         *      cp << log;
+         *  if (!cp.finish()) ...
+         * @endcode
+         *
+         * The columns of the table must have the types \see PgSqlConnection::create_table
+         * creates for the fields of the object. A COPY that wasn't finished when the
+         * writer is destroyed is aborted and none of its rows are committed.
+         */
+        struct PgSqlCopyIn : PgSqlCopy {
+            PgSqlCopyIn(PgSqlConnection& conn, const char *stmt);
+
+            template <typename T>
+            PgSqlCopyIn& operator<<(const T& o) {
+                if (!active) return Ego;
+
+                typedef __internal::copy_in_fields_t<T> Fields;
+                int16_t nfields = htons((uint16_t) Fields::size());
+                buf.append(&nfields, sizeof(nfields));
+                iod::foreach2(Fields()) |
+                [&](auto& m) {
+                    Ego.field(m.symbol().member_access(o));
+                };
+
+                rows++;
+                if (buf.size() >= SUIL_PGSQL_COPY_CHUNK) {
+                    send();
+                }
+                return Ego;
+            }
+
+            /**
+             * sends the remaining rows and ends the COPY
+             * @return true if all the rows were loaded
+             */
+            bool finish();
+
+            ~PgSqlCopyIn();
+
+        private suil_ut:
+            // writes the file header without starting the COPY
+            PgSqlCopyIn(PgSqlConnection& conn);
+
+            // writes the file trailer
+            inline void trailer() {
+                int16_t end = -1;
+                buf.append(&end, sizeof(end));
+            }
+
+            inline void length(int32_t len) {
+                len = htonl((uint32_t) len);
+                buf.append(&len, sizeof(len));
+            }
+
+            inline void data(const void *data, size_t len) {
+                length((int32_t) len);
+                buf.append(data, len);
+            }
+
+            template <typename __V, typename std::enable_if<std::is_arithmetic<__V>::value>::type* = nullptr>
+            void field(const __V& v) {
+                unsigned long long norder{0};
+                data(__internal::vhod_to_vnod(norder, v), sizeof(__V));
+            }
+
+            void field(const bool& v) {
+                char c = v;
+                data(&c, 1);
+            }
+
+            inline void field(const char *v) {
+                if (v == nullptr) {
+                    // NULL
+                    length(-1);
+                    return;
+                }
+                data(v, strlen(v));
+            }
+
+            inline void field(const String& v) {
+                data(v.data(), v.size());
+            }
+
+            inline void field(const std::string& v) {
+                data(v.data(), v.size());
+            }
+
+            inline void field(const strview& v) {
+                data(v.data(), v.size());
+            }
+
+            template <size_t N>
+            void field(const Blob<N>& v) {
+                data(v.cbegin(), N);
+            }
+
+            void field(const iod::json_string& v) {
+                // binary jsonb is prefixed with its format version
+                length((int32_t) v.str.size() + 1);
+                buf << (char) 1;
+                buf.append(v.str.data(), v.str.size());
+            }
+
+            void field(const json::Object& v) {
+                auto tmp = json::encode(v);
+                data(tmp.data(), tmp.size());
+            }
+
+            template <typename __V>
+            void field(const std::vector<__V>& v) {
+                // the element types of the arrays created by create_table
+                typedef typename std::conditional<std::is_integral<__V>::value, int,
+                        typename std::conditional<std::is_floating_point<__V>::value, float, __V>::type>::type E;
+                E tmp{};
+                Oid oid = __internal::type_to_pgsql_oid_type(tmp);
+                // one dimension without NULL's
+                uint32_t hdr[] = {htonl(1), 0, htonl(oid), htonl((uint32_t) v.size()), htonl(1)};
+                size_t off = buf.size();
+                length(0);
+                buf.append(hdr, sizeof(hdr));
+                for (auto& e: v) {
+                    field((const E&) e);
+                }
+                // patch the size of the array
+                int32_t len = htonl((uint32_t) (buf.size() - off - sizeof(int32_t)));
+                memcpy(buf.data() + off, &len, sizeof(len));
+            }
+
+            // sends the buffered rows
+            bool send();
+
+            OBuffer buf{SUIL_PGSQL_COPY_CHUNK + 1024};
+        };
+
+        /**
+         * Streams the rows of a query with COPY ... TO STDOUT, rows are received one at a
+         * time without materializing the whole result.
+         *
+         * @code
+         *  auto rows = conn.copyout("SELECT id, msg FROM logs");
+         *  Log log;
+         *  while (rows >> log) {...}
+         * @endcode
+         *
+         * Columns are assigned to the fields of the object in order, NULL values
+         * leave the field untouched. Rows not read when the reader is destroyed are
+         * received and discarded.
+         */
+        struct PgSqlCopyOut : PgSqlCopy {
+            PgSqlCopyOut(PgSqlConnection& conn, const char *query);
+
+            template <typename T>
+            bool operator>>(T& o) {
+                if (!next()) return false;
+
+                size_t i{0};
+                iod::foreach2(__internal::remove_ignore_fields_t<__internal::copy_schema_t<T>>()) |
+                [&](auto& m) {
+                    if (i < cols.size() && cols[i] != nullptr) {
+                        Ego.assign(m.symbol().member_access(o), cols[i]);
+                    }
+                    i++;
+                };
+                return true;
+            }
+
+            template <typename F>
+            void operator|(F f) {
+                typedef iod::callable_arguments_tuple_t<F> __tmp;
+                typedef std::remove_reference_t<std::tuple_element_t<0, __tmp>> Args;
+                Args o;
+                while (Ego >> o) {
+                    f(o);
+                    o = Args{};
+                }
+            }
+
+            ~PgSqlCopyOut();
+
+        private suil_ut:
+            /**
+             * receives the next row and splits it into \see PgSqlCopyOut::cols
+             * @return false at the end of the rows or on failure
+             */
+            bool next();
+
+            // decodes a text COPY value in place, \return false if the value is NULL
+            static bool unescape(char *s);
+
+            template <typename __V, typename std::enable_if<std::is_arithmetic<__V>::value>::type* = nullptr>
+            void assign(__V& v, const char *s) {
+                utils::cast(String(s), v);
+            }
+
+            inline void assign(bool& v, const char *s) {
+                v = (*s == 't');
+            }
+
+            inline void assign(String& v, const char *s) {
+                v = String(s).dup();
+            }
+
+            inline void assign(std::string& v, const char *s) {
+                v = s;
+            }
+
+            inline void assign(iod::json_string& v, const char *s) {
+                v.str = s;
+            }
+
+            inline void assign(json::Object& v, const char *s) {
+                json::trydecode(String(s), v);
+            }
+
+            template <typename __V>
+            void assign(std::vector<__V>& v, const char *s) {
+                __internal::parse_array(v, s);
+            }
+
+            template <size_t N>
+            void assign(Blob<N>& v, const char *s) {
+                // bytea in hex format
+                if (s[0] == '\\' && s[1] == 'x') {
+                    String hex(s+2);
+                    utils::bytes(String(hex.data(), MIN(hex.size(), N<<1), false), &v[0], N);
+                }
+            }
+
+            char               *row{nullptr};
+            std::vector<char*>  cols;
+        };
+
+        /**
+         * A server side cursor, the rows of the query are fetched a page at a time
+         * when they are read.
+         *
+         * @code
+         *  auto cur = conn.cursor("SELECT * FROM logs WHERE at > $1", 500);
+         *  cur(since) | [&](Log& log) {...};
+         * @endcode
+         *
+         * Cursors only live within a transaction, a transaction is started if the
+         * connection isn't in one and committed when the cursor is destroyed.
+         */
+        struct PgSqlCursor : LOGGER(PGSQL_CONN) {
+            PgSqlCursor(PgSqlConnection& conn, const char *query, size_t rows);
+
+            PgSqlCursor(const PgSqlCursor&) = delete;
+            PgSqlCursor&operator=(const PgSqlCursor&) = delete;
+
+            /**
+             * declares the cursor with the given query parameters
+             */
+            template <typename... Args>
+            PgSqlCursor& operator()(Args&&... args) {
+                if (!begin()) return Ego;
+
+                try {
+                    PGSQLStatement decl(conn.conn, String(query).dup(), conn.async, conn.timeout);
+                    declared = decl(std::forward<Args>(args)...).status();
+                }
+                catch (...) {
+                    ierror("CURSOR: %s declare failed: %s", name(), Exception::fromCurrent().what());
+                }
+                failed = !declared;
+                return Ego;
+            }
+
+            /**
+             * fetches the next page of rows
+             * @return false when all the rows have been read
+             */
+            template <typename T>
+            bool operator>>(std::vector<T>& rows) {
+                return fetch() && (page >> rows);
+            }
+
+            template <typename F>
+            void operator|(F f) {
+                while (fetch()) {
+                    page | f;
+                }
+            }
+
+            inline bool status() const {
+                return !failed;
+            }
+
+            ~PgSqlCursor();
+
+        private suil_ut:
+            // starts a transaction if the connection isn't in one
+            bool begin();
+
+            bool fetch();
+
+            bool exec(const char *stmt);
+
+            PgSqlConnection& conn;
+            String           name;
+            // the DECLARE statement
+            String           query;
+            PGSQLStatement   page;
+            bool             began{false};
+            bool             declared{false};
+            bool             done{false};
+            bool             failed{false};
+        };
+
+        template <typename T>
+        PgSqlCopyIn PgSqlConnection::copyin(const char *table) {
+            OBuffer qb(64);
+            qb << "COPY " << table << " (";
+            bool first{true};
+            iod::foreach2(__internal::copy_in_fields_t<T>()) |
+            [&](auto& m) {
+                if (!first) {
+                    qb << ", ";
+                }
+                first = false;
+                qb << m.symbol().name();
+            };
+            qb << ") FROM STDIN (FORMAT binary)";
+
+            return PgSqlCopyIn(Ego, (char *) qb);
+        }
+
         struct PgSqlTransaction : LOGGER(PGSQL_DB) {
             PgSqlTransaction(PgSqlConnection& conn)
                 : conn(conn)
@@ -1015,6 +1885,13 @@ namespace suil {
 
             Connection& connection();
 
+            /**
+             * @return the counters of the connection pool
+             */
+            pool_stats poolstats() const {
+                return pool.stats();
+            }
+
             template<typename... Opts>
             void init(const char *con_str, Opts... opts) {
                 auto options = iod::D(opts...);
@@ -1040,9 +1917,15 @@ namespace suil {
                     keep_alive = 3000;
                 }
 
+                pool.config.keep_alive = keep_alive;
+                pool.config.max        = (size_t) opts.get(var(POOL_SIZE), 0);
+                pool.config.min_idle   = (size_t) opts.get(var(MIN_IDLE), 0);
+                pool.config.wait       = opts.get(var(POOL_WAIT), -1);
+
                 /* open and close connetion to verify the Connection string*/
                 PGconn *conn = open();
                 PQfinish(conn);
+                pool.warmup();
             }
 
             ~PgSqlDb();
@@ -1051,27 +1934,25 @@ namespace suil {
 
             PGconn *open();
 
-            static coroutine void cleanup(PgSqlDb& db);
-
             void free(Connection* conn);
 
             struct conn_handle_t {
-                PGconn  *conn;
-                int64_t alive;
-                inline void cleanup() {
-                    if (conn) {
-                        PQfinish(conn);
-                        conn = nullptr;
-                    }
-                }
+                PGconn  *conn{nullptr};
+                // prepared statements outlive checkouts of the connection
+                Connection::stmt_map_ptr_t stmts{nullptr};
             };
 
-            std::deque<conn_handle_t> conns;
+            conn_handle_t openHandle();
+
+            static void closeHandle(conn_handle_t& h);
+
+            Pool<conn_handle_t> pool{
+                    [this]() { return openHandle(); },
+                    [](conn_handle_t& h) { closeHandle(h); },
+                    [](conn_handle_t& h) { return PQstatus(h.conn) == CONNECTION_OK; }};
             bool          async{false};
             int64_t       keep_alive{-1};
             int64_t       timeout{-1};
-            Channel<uint8_t> notify{1};
-            bool          cleaning{false};
             String        conn_str;
             String        dbname{"public"};
         };
@@ -0,0 +1,266 @@
+//
+// Created by dc on 18/10/26.
+//
+
+#include <sys/eventfd.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <suil/sql/sqlite.h>
+
+namespace suil::sql {
+
+    struct SQLiteOffload::Executor {
+        struct job_t {
+            sqlite3_stmt *stmt;
+            int           efd;
+            int           rc;
+        };
+
+        Executor(size_t nthreads)
+            : nthreads(nthreads)
+        {
+            for (size_t i = 0; i < nthreads; i++) {
+                std::thread(&Executor::run, this).detach();
+            }
+        }
+
+        void submit(job_t *job) {
+            {
+                std::lock_guard<std::mutex> lk(mutex);
+                jobs.push_back(job);
+            }
+            cond.notify_one();
+        }
+
+        void run() {
+            while (true) {
+                job_t *job{nullptr};
+                {
+                    std::unique_lock<std::mutex> lk(mutex);
+                    cond.wait(lk, [this]() { return !jobs.empty(); });
+                    job = jobs.front();
+                    jobs.pop_front();
+                }
+
+                job->rc = sqlite3_step(job->stmt);
+                uint64_t done{1};
+                while (::write(job->efd, &done, sizeof(done)) < 0 && errno == EINTR);
+            }
+        }
+
+        std::mutex              mutex;
+        std::condition_variable cond;
+        std::deque<job_t*>      jobs;
+        size_t                  nthreads;
+        pid_t                   pid{getpid()};
+    };
+
+    SQLiteOffload::Executor *SQLiteOffload::exec{nullptr};
+
+    SQLiteOffload::SQLiteOffload(size_t nthreads)
+        : nthreads(nthreads)
+    {
+        if (exec != nullptr && exec->pid == getpid() && exec->nthreads != nthreads) {
+            // the executor is shared and sized by the first connection to step a statement
+            iwarn("sqlite - executor already running %lu threads, ignoring requested %lu",
+                  exec->nthreads, nthreads);
+        }
+    }
+
+    SQLiteOffload::Executor& SQLiteOffload::executor(size_t nthreads) {
+        if (exec == nullptr || exec->pid != getpid()) {
+            /* the threads of the parent were not forked, its executor is
+             * abandoned as its lock could be held */
+            exec = new Executor(nthreads);
+        }
+        return *exec;
+    }
+
+    int SQLiteOffload::wakeup() {
+        if (efd < 0 || pid != getpid()) {
+            efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            lfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (efd < 0 || lfd < 0) {
+                throw Exception::create("sqlite - creating eventfd failed: ", errno_s);
+            }
+            pid = getpid();
+        }
+        return efd;
+    }
+
+    void SQLiteOffload::acquire() {
+        if (!busy && waiters == 0) {
+            busy = true;
+            return;
+        }
+
+        /* another statement of the connection is being executed. Only the first
+         * waiter waits on the eventfd, which is signalled on release without yielding
+         * the releasing coroutine before it reads the results of its statement */
+        waiters++;
+        if (waiters > 1) {
+            uint8_t token{0};
+            queue >> token;
+        }
+
+        wakeup();
+        uint64_t n{0};
+        while (busy) {
+            fdwait(lfd, FDW_IN, -1);
+            while (::read(lfd, &n, sizeof(n)) < 0 && errno == EINTR);
+        }
+        busy = true;
+
+        if (--waiters > 0) {
+            // the next waiter waits for this statement
+            queue << (uint8_t) 1;
+        }
+    }
+
+    void SQLiteOffload::release() {
+        busy = false;
+        if (waiters > 0) {
+            uint64_t one{1};
+            while (::write(lfd, &one, sizeof(one)) < 0 && errno == EINTR);
+        }
+    }
+
+    int SQLiteOffload::step(sqlite3_stmt *stmt) {
+        Executor::job_t job{stmt, wakeup(), SQLITE_OK};
+        executor(nthreads).submit(&job);
+        uint64_t n{0};
+        while (::read(job.efd, &n, sizeof(n)) < 0) {
+            /* the executor references the job until it signals the eventfd */
+            fdwait(job.efd, FDW_IN, -1);
+        }
+        return job.rc;
+    }
+
+    SQLiteOffload::~SQLiteOffload() {
+        if (efd >= 0 && pid == getpid()) {
+            fdclean(efd);
+            ::close(efd);
+            fdclean(lfd);
+            ::close(lfd);
+            efd = lfd = -1;
+        }
+    }
+}
+
+#ifdef unit_test
+#include <catch/catch.hpp>
+#include <suil/channel.h>
+
+using namespace suil;
+
+static coroutine void sqliteReader(sql::SQLiteDb& db, int id, Channel<int>& done) {
+    int count{0};
+    auto stmt = db.connection()("SELECT COUNT(*) FROM kv WHERE id <= ?");
+    done << ((stmt(id) >> count)? count : -1);
+}
+
+static coroutine void sqliteIterator(sql::SQLiteDb& db, int from, std::vector<int>& ids, Channel<int>& done) {
+    typedef decltype(iod::D(prop(id, int))) Row;
+    auto stmt = db.connection()("SELECT id FROM kv WHERE id >= ? ORDER BY id");
+    stmt(from) | [&](Row& row) {
+        ids.push_back(row.id);
+    };
+    done << from;
+}
+
+static coroutine void sqliteWaiter(sql::SQLiteOffload& offload, int id, std::vector<int>& order, Channel<int>& done) {
+    offload.acquire();
+    order.push_back(id);
+    offload.release();
+    done << id;
+}
+
+TEST_CASE("SQLite offloaded statements", "[sql][sqlite]") {
+    const char *path = "/tmp/suil_sqlite_test.db";
+    ::unlink(path);
+    sql::SQLiteDb db;
+    db.init(path, opt(ASYNC, true), opt(THREADS, 2));
+    auto& conn = db.connection();
+
+    SECTION("Databases use write ahead logging") {
+        String mode;
+        REQUIRE((conn("PRAGMA journal_mode")() >> mode));
+        REQUIRE(mode == "wal");
+    }
+
+    SECTION("Statements are stepped off the worker's thread") {
+        conn.exec("CREATE TABLE kv(id INTEGER PRIMARY KEY, val TEXT)");
+        auto insert = conn("INSERT INTO kv(id, val) VALUES(?, ?)");
+        for (int i = 1; i <= 10; i++) {
+            insert(i, "value");
+        }
+
+        Channel<int> done{-2};
+        for (int i = 1; i <= 5; i++) {
+            go(sqliteReader(db, i, done));
+        }
+        int total{0};
+        REQUIRE((done[2000](5) | [&](bool, int n) { total += n; }));
+        REQUIRE(total == 15);
+
+        String val;
+        REQUIRE((conn("SELECT val FROM kv WHERE id = ?")(3) >> val));
+        REQUIRE(val == "value");
+    }
+
+    SECTION("Coroutines iterate the same cached statement") {
+        conn.exec("CREATE TABLE kv(id INTEGER PRIMARY KEY, val TEXT)");
+        auto insert = conn("INSERT INTO kv(id, val) VALUES(?, ?)");
+        for (int i = 1; i <= 10; i++) {
+            insert(i, "value");
+        }
+
+        // each step yields, the iterations interleave
+        std::vector<int> first, second;
+        Channel<int> done{-2};
+        go(sqliteIterator(db, 1, first, done));
+        go(sqliteIterator(db, 6, second, done));
+        REQUIRE((done[2000](2) | Void));
+        REQUIRE((first == std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+        REQUIRE((second == std::vector<int>{6, 7, 8, 9, 10}));
+
+        // the cached statement is reused once it has been read
+        int count{0};
+        auto stmt = conn("SELECT COUNT(*) FROM kv WHERE id >= ?");
+        auto cached = stmt.stmt_;
+        REQUIRE((stmt(1) >> count));
+        REQUIRE(count == 10);
+        REQUIRE((conn("SELECT id FROM kv WHERE id >= ? ORDER BY id")(9) >> count));
+        REQUIRE(count == 9);
+        // while a copy reading its results gets a statement of its own
+        auto other = conn("SELECT COUNT(*) FROM kv WHERE id >= ?");
+        REQUIRE((other(5) >> count));
+        REQUIRE(count == 6);
+        REQUIRE(other.stmt_ != cached);
+        REQUIRE((stmt >> count));
+        REQUIRE(count == 10);
+    }
+
+    SECTION("Waiters acquire the connection in order") {
+        sql::SQLiteOffload offload{2};
+        std::vector<int> order;
+        Channel<int> done{-2};
+        offload.acquire();
+        for (int i = 0; i < 3; i++) {
+            go(sqliteWaiter(offload, i, order, done));
+        }
+        REQUIRE(offload.waiters == 3);
+        offload.release();
+        REQUIRE((done[1000](3) | Void));
+        REQUIRE((order == std::vector<int>{0, 1, 2}));
+        REQUIRE(offload.waiters == 0);
+        REQUIRE_FALSE(offload.busy);
+    }
+
+    ::unlink(path);
+}
+#endif
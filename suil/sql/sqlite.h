@@ -10,14 +10,78 @@
 
 #include <iod/sio.hh>
 #include <iod/callable_traits.hh>
+#include <suil/channel.h>
 #include <suil/sql/middleware.h>
 
+#ifndef SUIL_SQLITE_THREADS
+// number of threads the statements of offloaded connections are stepped on
+#define SUIL_SQLITE_THREADS     2
+#endif
+
+#ifndef SUIL_SQLITE_MMAP_SIZE
+#define SUIL_SQLITE_MMAP_SIZE   (64 * 1024 * 1024)
+#endif
+
 namespace suil {
     namespace sql {
 
         define_log_tag(SQLITE_CONN);
         define_log_tag(SQLITE_DB);
 
+        /**
+         * Steps the statements of a connection on a small pool of threads shared
+         * by all the connections of the worker, so that slow queries, lock waits and
+         * fsyncs don't stall the other coroutines. The pool is sized by the first
+         * connection to step a statement. The stepping coroutine waits on
+         * the connection's eventfd which the executor thread signals when done.
+         *
+         * A statement is executed while holding the connection, \see SQLiteOffload::acquire,
+         * since cached statements are shared by the coroutines of the worker. Results
+         * are read on the worker's thread, a coroutine executing a cached statement
+         * whose results are still being read gets a statement of its own. The
+         * connection must be opened in serialized mode (SQLITE_OPEN_FULLMUTEX)
+         */
+        struct SQLiteOffload : LOGGER(SQLITE_CONN) {
+            SQLiteOffload(size_t nthreads = SUIL_SQLITE_THREADS);
+
+            SQLiteOffload(const SQLiteOffload&) = delete;
+            SQLiteOffload& operator=(const SQLiteOffload&) = delete;
+
+            /**
+             * waits until no other coroutine is executing a statement on the connection,
+             * waiters acquire the connection in the order they arrived
+             */
+            void acquire();
+
+            void release();
+
+            /**
+             * invokes sqlite3_step on an executor thread, the connection must
+             * be held by the calling coroutine
+             * @return the result of sqlite3_step
+             */
+            int step(sqlite3_stmt *stmt);
+
+            ~SQLiteOffload();
+
+        private suil_ut:
+            struct Executor;
+            static Executor& executor(size_t nthreads);
+            static Executor *exec;
+
+            int  wakeup();
+
+            size_t      nthreads;
+            int         efd{-1};
+            // signalled when the connection is released while coroutines are waiting
+            int         lfd{-1};
+            // eventfd's and threads are not shared with forked workers
+            pid_t       pid{0};
+            bool        busy{false};
+            size_t      waiters{0};
+            Channel<uint8_t> queue{0};
+        };
+
         struct SQLiteStmt {
 
             static void free_sqlite3_stmt(void *s) {
@@ -29,12 +93,68 @@ namespace suil {
             SQLiteStmt()
             {}
 
-            SQLiteStmt(sqlite3* db, sqlite3_stmt* stmt)
+            SQLiteStmt(sqlite3* db, sqlite3_stmt* stmt, SQLiteOffload *offload = nullptr)
                 : m_db(db),
                   stmt_(stmt),
-                  stmt_ptr_(stmt_ptr(stmt, free_sqlite3_stmt))
+                  stmt_ptr_(stmt_ptr(stmt, free_sqlite3_stmt)),
+                  m_offload(offload),
+                  m_readers(std::make_shared<int>(0))
             {}
 
+            SQLiteStmt(const SQLiteStmt& other)
+                : m_db(other.m_db),
+                  stmt_(other.stmt_),
+                  stmt_ptr_(other.stmt_ptr_),
+                  m_offload(other.m_offload),
+                  last_ret_(other.last_ret_),
+                  m_readers(other.m_readers)
+            {
+                // copies of a reader read the same results
+                if (other.m_reader) {
+                    m_reader = true;
+                    (*m_readers)++;
+                }
+            }
+
+            SQLiteStmt& operator=(const SQLiteStmt& other) {
+                if (this != &other) {
+                    SQLiteStmt tmp(other);
+                    std::swap(*this, tmp);
+                }
+                return *this;
+            }
+
+            SQLiteStmt(SQLiteStmt&& other) noexcept
+                : m_db(other.m_db),
+                  stmt_(other.stmt_),
+                  stmt_ptr_(std::move(other.stmt_ptr_)),
+                  m_offload(other.m_offload),
+                  last_ret_(other.last_ret_),
+                  m_readers(std::move(other.m_readers)),
+                  m_reader(other.m_reader)
+            {
+                other.m_reader = false;
+            }
+
+            SQLiteStmt& operator=(SQLiteStmt&& other) noexcept {
+                if (this != &other) {
+                    unread();
+                    m_db = other.m_db;
+                    stmt_ = other.stmt_;
+                    stmt_ptr_ = std::move(other.stmt_ptr_);
+                    m_offload = other.m_offload;
+                    last_ret_ = other.last_ret_;
+                    m_readers = std::move(other.m_readers);
+                    m_reader = other.m_reader;
+                    other.m_reader = false;
+                }
+                return *this;
+            }
+
+            ~SQLiteStmt() {
+                unread();
+            }
+
             template <typename... A>
             bool operator>>(iod::sio<A...>& o) {
                 if (empty())
@@ -61,6 +181,13 @@ namespace suil {
 
             template<typename... T>
             auto& operator()(T&&... args) {
+                if (m_offload) m_offload->acquire();
+                defer(held, { if (m_offload) m_offload->release(); });
+
+                if (!m_reader && m_readers && *m_readers > 0) {
+                    // another coroutine has not read all the results of the shared statement
+                    detach();
+                }
                 sqlite3_reset(stmt_);
                 sqlite3_clear_bindings(stmt_);
                 int i = 1;
@@ -74,11 +201,22 @@ namespace suil {
                     i++;
                 };
 
-                last_ret_ = sqlite3_step(stmt_);
+                last_ret_ = step();
                 if (last_ret_ != SQLITE_ROW and last_ret_ != SQLITE_DONE) {
+                    unread();
                     throw std::runtime_error(sqlite3_errstr(last_ret_));
                 }
 
+                if (last_ret_ == SQLITE_ROW) {
+                    if (!m_reader && m_readers) {
+                        m_reader = true;
+                        (*m_readers)++;
+                    }
+                }
+                else {
+                    unread();
+                }
+
                 return *this;
             }
 
@@ -90,8 +228,19 @@ namespace suil {
                     T o;
                     row_to_sio(o);
                     f(o);
-                    last_ret_ = sqlite3_step(stmt_);
+                    if (m_offload) {
+                        // not held while invoking f, which can use the connection. Other
+                        // coroutines executing this statement meanwhile get one of their
+                        // own since this one is being read, \see SQLiteStmt::detach
+                        m_offload->acquire();
+                        defer(held, { m_offload->release(); });
+                        last_ret_ = step();
+                    }
+                    else {
+                        last_ret_ = step();
+                    }
                 }
+                unread();
             }
 
             template <typename... __A>
@@ -186,10 +335,44 @@ namespace suil {
                 return sqlite3_bind_text(stmt, pos, s.data(), s.size(), nullptr);
             }
 
+            inline int step() {
+                return m_offload? m_offload->step(stmt_) : sqlite3_step(stmt_);
+            }
+
+            /* done reading the results, the last reader resets the statement */
+            inline void unread() {
+                if (m_reader) {
+                    m_reader = false;
+                    if (--(*m_readers) == 0)
+                        sqlite3_reset(stmt_);
+                }
+            }
+
+            /*
+             * replaces the shared statement, whose results are being read by another
+             * coroutine, with a freshly prepared one private to this copy
+             */
+            void detach() {
+                sqlite3_stmt *stmt{nullptr};
+                int err = sqlite3_prepare_v2(m_db, sqlite3_sql(stmt_), -1, &stmt, nullptr);
+                if (err != SQLITE_OK) {
+                    throw std::runtime_error(
+                            std::string("sqlite3_prepare_v2 : ") + sqlite3_errmsg(m_db));
+                }
+                stmt_ = stmt;
+                stmt_ptr_ = stmt_ptr(stmt, free_sqlite3_stmt);
+                m_readers = std::make_shared<int>(0);
+            }
+
             sqlite3*        m_db;
             sqlite3_stmt*   stmt_;
             stmt_ptr        stmt_ptr_;
+            SQLiteOffload  *m_offload{nullptr};
             int             last_ret_;
+            // the number of copies reading the results of the statement, which
+            // must not be reset under them
+            std::shared_ptr<int> m_readers{nullptr};
+            bool            m_reader{false};
         };
 
         struct SQLiteConnetion : LOGGER(SQLITE_CONN) {
@@ -206,7 +389,18 @@ namespace suil {
                  m_stmtCache(new stmt_map_t())
             {}
 
-            void connect(const char *filename, int flags = SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE) {
+            /**
+             * opens the given database
+             * @param offload the number of threads statements are stepped on, 0 steps
+             * statements on the calling coroutine, \see SQLiteOffload
+             */
+            void connect(const char *filename,
+                         int flags = SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE,
+                         size_t offload = 0)
+            {
+                if (offload) {
+                    flags = (flags & ~SQLITE_OPEN_NOMUTEX) | SQLITE_OPEN_FULLMUTEX;
+                }
                 int r = sqlite3_open_v2(filename, &m_db, flags, nullptr);
                 if (r != SQLITE_OK) {
                     throw std::runtime_error(
@@ -215,6 +409,24 @@ namespace suil {
                 }
 
                 m_dbptr = m_dbptrt(m_db, free_sqlite3_db);
+                if (offload) {
+                    m_offload = std::make_unique<SQLiteOffload>(offload);
+                }
+            }
+
+            /**
+             * executes \param sql which can have multiple statements without caching
+             * it, e.g PRAGMA's
+             */
+            void exec(const char *sql) {
+                itrace("%s", sql);
+                char *err{nullptr};
+                int r = sqlite3_exec(m_db, sql, nullptr, nullptr, &err);
+                if (r != SQLITE_OK) {
+                    std::string msg = std::string("sqlite3_exec: ") + (err? err : sqlite3_errstr(r));
+                    sqlite3_free(err);
+                    throw std::runtime_error(msg);
+                }
             }
 
             template <typename E>
@@ -249,7 +461,7 @@ namespace suil {
                 // take buffer
                 String key(req);
                 auto ret = m_stmtCache->insert(it,
-                                               std::make_pair(std::move(key), SQLiteStmt(m_db, stmt)));
+                                               std::make_pair(std::move(key), SQLiteStmt(m_db, stmt, m_offload.get())));
 
                 return ret->second;
             }
@@ -271,6 +483,13 @@ namespace suil {
                 return (*this)(b);
             }
 
+            /**
+             * sets how long (ms) statements wait for the locks held by other connections
+             */
+            inline void busyTimeout(int64_t ms) {
+                sqlite3_busy_timeout(m_db, (int) ms);
+            }
+
             bool has_table(String& name) {
                 int has = 0;
                 auto stmt = (*this)("SELECT COUNT(*) FROM sqlite_master WHERE type'table' AND name='?'");
@@ -305,7 +524,9 @@ namespace suil {
         private:
             inline void close() {
                 if (m_db) {
-                    sqlite3_close_v2(m_db);
+                    // statements are finalized before the database is closed
+                    m_stmtCache = nullptr;
+                    m_dbptr = nullptr;
                     m_db = nullptr;
                 }
             }
@@ -313,6 +534,7 @@ namespace suil {
             sqlite3*          m_db;
             m_dbptrt          m_dbptr;
             stmt_map_ptr_t    m_stmtCache;
+            std::unique_ptr<SQLiteOffload> m_offload{nullptr};
         };
 
         struct SQLiteDb : LOGGER(SQLITE_DB) {
@@ -335,17 +557,44 @@ namespace suil {
                 configure(options, db);
             }
 
+            /**
+             * opens the database, which uses write ahead logging and memory mapped
+             * I/O unless disabled with `opt(WAL, false)` and `opt(MMAP_SIZE, 0)`. With
+             * `opt(ASYNC, true)` statements are stepped on `opt(THREADS, n)` threads
+             * instead of the worker's thread, \see SQLiteOffload
+             */
             template <typename O>
             void configure(O& opts, const char *db) {
                 path = ::strdup(db);
 
                 if (path != nullptr) {
                     /* database not already initialized */
-                    conn.connect(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
-                    if (opts.has(sym(SYNCHRONOUS))) {
-                        OBuffer qb(32);
-                        qb << "PRAGMA synchronous = " << opts.get(sym(SYNCHRONOUS), 2);
-                        conn(qb);
+                    bool async = opts.get(var(ASYNC), false);
+                    size_t nthreads = async? (size_t) opts.get(var(THREADS), SUIL_SQLITE_THREADS) : 0;
+                    conn.connect(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nthreads);
+
+                    OBuffer qb(64);
+                    bool wal = opts.get(var(WAL), true);
+                    if (wal) {
+                        /* readers don't block the writer and commits append to the log */
+                        conn.exec("PRAGMA journal_mode = WAL");
+                    }
+                    if (opts.has(sym(SYNCHRONOUS)) || wal) {
+                        /* in WAL mode NORMAL only syncs on checkpoints and is still durable
+                         * across application crashes */
+                        qb << "PRAGMA synchronous = " << opts.get(sym(SYNCHRONOUS), 1);
+                        conn.exec((char *) qb);
+                        qb.bseek(0);
+                    }
+
+                    int64_t mmap = opts.get(var(MMAP_SIZE), SUIL_SQLITE_MMAP_SIZE);
+                    qb << "PRAGMA mmap_size = " << mmap;
+                    conn.exec((char *) qb);
+
+                    /* wait for the locks held by other workers, off the worker's thread when async */
+                    int64_t timeout = opts.get(var(TIMEOUT), async? 5000 : 0);
+                    if (timeout > 0) {
+                        conn.busyTimeout(timeout);
                     }
                     itrace("SQLite: `%s` Connection initialized", path);
                 }
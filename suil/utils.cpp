@@ -13,6 +13,7 @@
 
 #include <suil/utils.h>
 #include <suil/logging.h>
+#include <suil/simd.h>
 #include <openssl/evp.h>
 #include <openssl/err.h>
 
@@ -39,12 +40,8 @@ namespace suil {
         if (in == nullptr || out == nullptr || olen < (ilen<<1))
             return 0;
 
-        size_t rc = 0;
-        for (size_t i = 0; i < ilen; i++) {
-            out[rc++] = i2c((uint8_t) (0x0F&(in[i]>>4)));
-            out[rc++] = i2c((uint8_t) (0x0F&in[i]));
-        }
-        return rc;
+        simd::hexencode(in, ilen, out);
+        return ilen<<1;
     }
 
     bool utils::isHexStr(const suil::String &str, int checkCase)  {
@@ -87,11 +84,8 @@ namespace suil {
         if (out == nullptr || olen < size)
             throw Exception::create("utils::bytes - output buffer invalid");
 
-        char v;
-        const char *p = str.data();
-        for (int i = 0; i < size; i++) {
-            out[i] = (uint8_t) (utils::c2i(*p++) << 4 | utils::c2i(*p++));
-        }
+        if (!simd::hexdecode(str.data(), size, out))
+            throw Exception::outOfRange("utils::bytes - character out range");
     }
 
     Data utils::bytes(const uint8_t *data, size_t size, bool b64)
@@ -99,7 +93,7 @@ namespace suil {
         if (!b64) {
             auto outSize{(size / 2) + 3};
             auto out = static_cast<uint8_t *>(malloc(outSize));
-            if (out) {
+            if (out == nullptr) {
                 serror("utils::bytes malloc(%zu) failed: %s", outSize, errno_s);
                 return {};
             }
@@ -152,78 +146,18 @@ namespace suil {
 
     char *__urldecode(const char *src, const int src_len, char *out, int& out_sz)
     {
-#define IS_HEX_CHAR(ch) \
-        (((ch) >= '0' && (ch) <= '9') || \
-         ((ch) >= 'a' && (ch) <= 'f') || \
-         ((ch) >= 'A' && (ch) <= 'F'))
-
-#define HEX_VALUE(ch, value) \
-        if ((ch) >= '0' && (ch) <= '9') \
-        { \
-            (value) = (ch) - '0'; \
-        } \
-        else if ((ch) >= 'a' && (ch) <= 'f') \
-        { \
-            (value) = (ch) - 'a' + 10; \
-        } \
-        else \
-        { \
-            (value) = (ch) - 'A' + 10; \
-        }
-
-        const unsigned char *start;
-        const unsigned char *end;
-        char *dest;
-        unsigned char c_high;
-        unsigned char c_low;
-        int v_high;
-        int v_low;
-
-        dest = out;
-        start = (unsigned char *)src;
-        end = (unsigned char *)src + src_len;
-        while (start < end)
-        {
-            if (*start == '%' && start + 2 < end)
-            {
-                c_high = *(start + 1);
-                c_low  = *(start + 2);
-
-                if (IS_HEX_CHAR(c_high) && IS_HEX_CHAR(c_low))
-                {
-                    HEX_VALUE(c_high, v_high);
-                    HEX_VALUE(c_low, v_low);
-                    *dest++ = (char) ((v_high << 4) | v_low);
-                    start += 3;
-                }
-                else
-                {
-                    *dest++ = *start;
-                    start++;
-                }
-            }
-            else if (*start == '+')
-            {
-                *dest++ = ' ';
-                start++;
-            }
-            else
-            {
-                *dest++ = *start;
-                start++;
-            }
-        }
-
-        out_sz = (int) (dest - out);
-        return dest;
+        out_sz = (int) simd::urldecode(src, (size_t) src_len, out);
+        return out + out_sz;
     }
 
     String utils::urldecode(const char *src, size_t len)
     {
-        char out[1024];
-        int  size{1023};
+        // decoding never grows the input
+        auto out = (char *) malloc(len + 1);
+        int  size{0};
         (void)__urldecode(src, (int)len, out, size);
-        return String{out, (size_t)size, false}.dup();
+        out[size] = '\0';
+        return String{out, (size_t)size, true};
     }
 
     void utils::randbytes(uint8_t out[], size_t size) {
@@ -452,6 +386,44 @@ namespace suil {
         throw Exception::outOfRange("utils::i2c - byte out of range");
     };
 
+    size_t utils::uitoa(char *buf, uint64_t v) {
+        static const char DIGITS[] =
+                "0001020304050607080910111213141516171819"
+                "2021222324252627282930313233343536373839"
+                "4041424344454647484950515253545556575859"
+                "6061626364656667686970717273747576777879"
+                "8081828384858687888990919293949596979899";
+        static const uint64_t POW10[] = {
+                1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+                10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+                100000000000ull, 1000000000000ull, 10000000000000ull,
+                100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+                100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+        };
+
+        // log10 estimated from the bit length (1233/4096 ~ log10(2)), fixed up
+        // by a comparison. v|1 only differs from v for 0 which has 1 digit
+        uint64_t u = v | 1;
+        uint32_t t = ((64 - __builtin_clzll(u)) * 1233) >> 12;
+        size_t len = t + (u >= POW10[t]);
+
+        char *p = buf + len;
+        while (v >= 100) {
+            size_t i = (v % 100) << 1;
+            v /= 100;
+            p -= 2;
+            memcpy(p, &DIGITS[i], 2);
+        }
+        if (v >= 10) {
+            memcpy(p - 2, &DIGITS[v << 1], 2);
+        }
+        else {
+            p[-1] = (char) ('0' + v);
+        }
+
+        return len;
+    }
+
     int64_t utils::strtonum(const String &str, int base, long long int min, long long int max) {
         long long l;
         char *ep;
@@ -745,6 +717,18 @@ TEST_CASE("Utils tests", "[common][utils]") {
             CHECK(str.compare("-1000.009000") == 0);
         }
 
+        WHEN("Writing unsigned numbers with uitoa") {
+            char buf[24];
+            uint64_t nums[] = {0, 7, 9, 10, 99, 100, 101, 999, 1000, 65535,
+                               1234567890, 9999999999, 10000000000, UINT64_MAX};
+            for (auto n : nums) {
+                size_t len = utils::uitoa(buf, n);
+                auto expected = std::to_string(n);
+                REQUIRE(len == expected.size());
+                REQUIRE(strncmp(buf, expected.data(), len) == 0);
+            }
+        }
+
         WHEN("Converting other strings to String") {
             std::string s{"hello"};
             const char *cs{"hello"};
@@ -820,6 +804,36 @@ TEST_CASE("Utils tests", "[common][utils]") {
             REQUIRE_FALSE(mmt == nullptr);
             REQUIRE(strcmp(mmt, "video/mp4") == 0);
         }
+
+        WHEN("Converting bytes to and from hex strings") {
+            uint8_t raw[100], dec[100];
+            for (int i = 0; i < sizeof(raw); i++)
+                raw[i] = (uint8_t) (i * 37);
+            String hex = utils::hexstr(raw, sizeof(raw));
+            REQUIRE(hex.size() == 2*sizeof(raw));
+            REQUIRE(strncmp(hex(), "00254a6f94b9de03", 16) == 0);
+            utils::bytes(hex, dec, sizeof(dec));
+            REQUIRE(memcmp(raw, dec, sizeof(raw)) == 0);
+            // upper case digits decode too, other characters do not
+            utils::bytes(String{"00254A6F94B9DE03"}, dec, sizeof(dec));
+            REQUIRE(memcmp(raw, dec, 8) == 0);
+            REQUIRE_THROWS(utils::bytes(String{"00254a6f94b9de0g"}, dec, sizeof(dec)));
+        }
+
+        WHEN("Decoding URL encoded strings") {
+            REQUIRE(utils::urldecode(String{"Hello+World%21"}) == "Hello World!");
+            REQUIRE(utils::urldecode(String{"%e2%82%AC%2"}) == "\xe2\x82\xac%2");
+            REQUIRE(utils::urldecode(String{"100%+sure%zz"}) == "100% sure%zz");
+            // longer than the kernels' blocks and than the old fixed buffer
+            std::string str, expected;
+            for (int i = 0; i < 200; i++) {
+                str += "a+long%20query%3Dstring";
+                expected += "a long query=string";
+            }
+            REQUIRE(utils::urldecode(str.data(), str.size()) == String{expected});
+            REQUIRE(utils::urlencode(utils::urldecode(str.data(), str.size())) ==
+                    utils::urlencode(String{expected}));
+        }
     }
 }
 
@@ -367,6 +367,7 @@ namespace suil {
         auto to_number(const String& str) -> typename std::enable_if<std::is_floating_point<T>::value, T>::type {
             double f;
             char *end;
+            errno = 0;
             f = strtod(str.data(), &end);
             if (errno || *end != '\0')  {
                 throw std::runtime_error(errno_s);
@@ -386,6 +387,16 @@ namespace suil {
             return String(tmp.c_str(), tmp.size(), false).dup();
         }
 
+        /**
+         * writes the decimal digits of the given number, the number of digits
+         * is computed upfront and the digits are written two at a time from a
+         * lookup table
+         * @param buf the destination buffer, must have room for 20 bytes
+         * @param v the number to write
+         * @return the number of digits written, the buffer is not null terminated
+         */
+        size_t uitoa(char *buf, uint64_t v);
+
         /**
          * converts given string to string
          * @param str
@@ -16,6 +16,13 @@
 #define WORKER_SHM_LOCKS    64
 #endif
 
+#ifndef WORKER_IPC_RING_SIZE
+#define WORKER_IPC_RING_SIZE (1u << 18)
+#endif
+
+static_assert((WORKER_IPC_RING_SIZE & (WORKER_IPC_RING_SIZE-1)) == 0,
+        "WORKER_IPC_RING_SIZE must be a power of 2");
+
 /*
  * On some systems WAIT_ANY is not defined
  * */
@@ -36,6 +43,7 @@ namespace suil {
         uint8_t     Cpu;
         uint8_t     Wid;
         uint8_t     Active;
+        uint8_t     Handlers[SUIL_IPC_MESSAGE_COUNT/8];
         uint8_t     Data[WORKER_DATA_SIZE];
     } __attribute__((packed));
 
@@ -43,14 +51,54 @@ namespace suil {
         uint8_t     nWorkers;
         uint8_t     nActive;
         Lock_t      Locks[WORKER_SHM_LOCKS];
+        volatile uint32_t Turn;
         Worker_t    Workers[0];
     } __attribute__((packed));
 
+    /*
+     * Each worker owns a multi-producer/single-consumer ring in the shared
+     * memory segment. Producers reserve space by advancing Tail, the owning
+     * worker consumes records from Head. A record is committed when its
+     * Ready flag is set, the consumer zeroes the records it consumes. Tail and
+     * Head live on separate cache lines to avoid false sharing between
+     * producers and the consumer
+     */
+    struct IpcRing_t {
+        volatile uint64_t   Tail;
+        volatile uint32_t   Notify;
+        uint8_t             _pad0[52];
+        volatile uint64_t   Head;
+        uint8_t             _pad1[56];
+        uint8_t             Data[0];
+    };
+
+    struct IpcMsg_t {
+        uint32_t            Len;
+        uint8_t             Id;
+        uint8_t             Src;
+        volatile uint8_t    Ready;
+        uint8_t             _pad;
+    };
+
+    static_assert(sizeof(IpcRing_t) == 128, "IpcRing_t header must span 2 cache lines");
+    static_assert(sizeof(IpcMsg_t) == 8, "IpcMsg_t header must be 8 bytes");
+
+    static constexpr size_t IPC_RING_STRIDE = sizeof(IpcRing_t) + WORKER_IPC_RING_SIZE;
+    static constexpr size_t IPC_RING_MASK   = WORKER_IPC_RING_SIZE - 1;
+    // longest sleep, in milliseconds, of a sender waiting for room in a full ring
+    static constexpr int64_t IPC_PUSH_BACKOFF = 16;
+
+    static inline size_t ipcAlign(size_t sz, size_t to = sizeof(IpcMsg_t)) {
+        return (sz + (to-1)) & ~(to-1);
+    }
+
     define_log_tag(WORKER);
     static struct : public LOGGER(WORKER) {} wLog;
     static auto* WLOG{&wLog};
 
     static Ipc_t    *mIpc{nullptr};
+    static uint8_t  *mRings{nullptr};
+    static IpcHandler mHandlers[SUIL_IPC_MESSAGE_COUNT];
     static int      mShmId{0};
     static int      mWorkers{0};
     static bool     mLaunched{false};
@@ -133,7 +181,154 @@ namespace suil {
         }
     }
 
-    static coroutine void asyncReceive(Worker_t& worker){}
+    static inline IpcRing_t& ipcRing(uint8_t wid) {
+        return *((IpcRing_t *) &mRings[(wid-1) * IPC_RING_STRIDE]);
+    }
+
+    static inline bool ipcEnabled() {
+        return (mIpc != nullptr) &&
+               (mRings != nullptr) &&
+               (mIpc->nWorkers > 1) &&
+               !(mLaunchFlags & Worker::IPCDisabled);
+    }
+
+    static inline bool hasHandler(const Worker_t& worker, uint8_t msg) {
+        return (worker.Handlers[msg/8] & (1 << (msg%8))) != 0;
+    }
+
+    static int ringPush(IpcRing_t& ring, uint8_t src, uint8_t msg, const void *data, size_t len,
+                        int64_t dd, const Worker_t *dst = nullptr)
+    {
+        size_t need = ipcAlign(sizeof(IpcMsg_t) + len);
+        if (need > WORKER_IPC_RING_SIZE) {
+            return -EMSGSIZE;
+        }
+
+        uint64_t tail, pad;
+        int64_t  backoff{0};
+        while (true) {
+            tail = ring.Tail;
+            uint64_t head = ring.Head;
+            size_t off = tail & IPC_RING_MASK;
+            // records are never split, skip to the beginning when wrapping around
+            pad = (off + need > WORKER_IPC_RING_SIZE)? (WORKER_IPC_RING_SIZE - off) : 0;
+            if (((tail - head) + pad + need) > WORKER_IPC_RING_SIZE) {
+                // ring full, wait for the consumer to make some room
+                if ((dst != nullptr) && !((volatile const Worker_t *) dst)->Active) {
+                    // the consumer exited, the ring will not be drained
+                    return -ESRCH;
+                }
+                int64_t now = mnow();
+                if ((dd >= 0) && (now >= dd)) {
+                    return -ETIMEDOUT;
+                }
+                // back off exponentially up to IPC_PUSH_BACKOFF milliseconds
+                backoff = std::min<int64_t>(backoff? backoff*2 : 1, IPC_PUSH_BACKOFF);
+                msleep((dd >= 0)? std::min(now + backoff, dd) : now + backoff);
+                continue;
+            }
+
+            if (__sync_bool_compare_and_swap(&ring.Tail, tail, tail + pad + need))
+                break;
+        }
+
+        if (pad) {
+            // mark the end of the ring as padding
+            auto *hdr = (IpcMsg_t *) &ring.Data[tail & IPC_RING_MASK];
+            hdr->Len = (uint32_t) (pad - sizeof(IpcMsg_t));
+            hdr->Id  = 0;
+            hdr->Src = src;
+            __sync_synchronize();
+            hdr->Ready = 1;
+            tail += pad;
+        }
+
+        auto *hdr = (IpcMsg_t *) &ring.Data[tail & IPC_RING_MASK];
+        hdr->Len = (uint32_t) len;
+        hdr->Id  = msg;
+        hdr->Src = src;
+        if (len)
+            memcpy(&hdr[1], data, len);
+        __sync_synchronize();
+        hdr->Ready = 1;
+
+        return 0;
+    }
+
+    template <typename Func>
+    static size_t ringDrain(IpcRing_t& ring, Func func)
+    {
+        size_t count{0};
+        while (ring.Head != ring.Tail) {
+            auto *hdr = (IpcMsg_t *) &ring.Data[ring.Head & IPC_RING_MASK];
+            if (!hdr->Ready) {
+                // producer has reserved but not yet committed
+                break;
+            }
+            __sync_synchronize();
+
+            if (hdr->Id) {
+                func(hdr->Src, hdr->Id, (const void *) &hdr[1], (size_t) hdr->Len);
+                count++;
+            }
+
+            // record boundaries move on every lap, zero the whole record so that the
+            // header of a record reserved over it later reads as not ready
+            size_t sz = ipcAlign(sizeof(IpcMsg_t) + hdr->Len);
+            memset((void *) hdr, 0, sz);
+            __sync_synchronize();
+            ring.Head = ring.Head + sz;
+        }
+
+        return count;
+    }
+
+    static void ipcNotify(Worker_t& worker, IpcRing_t& ring)
+    {
+        // only wake up the worker if it hasn't been signaled already
+        if (__sync_bool_compare_and_swap(&ring.Notify, 0, 1)) {
+            uint8_t c{0x01};
+            if (::write(worker.Fd[1], &c, 1) < 0 && errno != EAGAIN) {
+                lwarn(WLOG, "ipc - notifying worker/%hhu failed: %s", worker.Wid, errno_s);
+            }
+        }
+    }
+
+    static void ipcDispatch(uint8_t src, uint8_t msg, const void *data, size_t len)
+    {
+        auto& handler = mHandlers[msg];
+        if (handler) {
+            handler(src, data, len);
+        }
+        else {
+            ltrace(WLOG, "ipc - worker/%hhu dropping unhandled message %hhu from worker/%hhu",
+                   spid, msg, src);
+        }
+    }
+
+    static coroutine void asyncReceive(Worker_t& worker)
+    {
+        IpcRing_t& ring = ipcRing(worker.Wid);
+        uint8_t buf[64];
+
+        ldebug(WLOG, "ipc - worker/%hhu receiving messages", worker.Wid);
+        while (worker.Active) {
+            int ret = waitRead(worker.Fd[0]);
+            if (ret != 0) {
+                // the pipe hangs up when all the other workers have exited
+                ldebug(WLOG, "ipc - worker/%hhu waiting for messages failed: %d", worker.Wid, ret);
+                break;
+            }
+
+            // drain wakeup notifications before draining the ring
+            while (::read(worker.Fd[0], buf, sizeof(buf)) > 0);
+            ring.Notify = 0;
+            __sync_synchronize();
+
+            ringDrain(ring, ipcDispatch);
+        }
+        ldebug(WLOG, "ipc - worker/%hhu done receiving messages", worker.Wid);
+    }
 
     static int initializeWorkers(int count)
     {
@@ -151,8 +346,9 @@ namespace suil {
         if (count > ncpus)
             lwarn(WLOG, "number of workers more than number of CPU's");
 
-        // create our worker's ipc
-        size_t len = sizeof(Ipc_t) + (sizeof(Worker_t) * count);
+        // create our worker's ipc, message rings are allocated after the workers
+        size_t rings = ipcAlign(sizeof(Ipc_t) + (sizeof(Worker_t) * count), 64);
+        size_t len = rings + (IPC_RING_STRIDE * count);
         mShmId =  shmget(IPC_PRIVATE, len, IPC_EXCL | IPC_CREAT | 0700);
         if (mShmId == -1)
             lcritical(WLOG, "shmget() error: %s", errno_s);
@@ -164,6 +360,7 @@ namespace suil {
             goto ipc_dealloc;
         }
         mIpc = (Ipc_t *)shm;
+        mRings = ((uint8_t *) shm) + rings;
         // clear the attached memory
         memset(mIpc, 0, len);
         // initialize accept lock
@@ -202,6 +399,12 @@ namespace suil {
         snprintf(name, sizeof(name)-1, "worker/%hhu", spid);
         prctl(PR_SET_NAME, name);
 
+        // publish the messages this worker is interested in
+        for (int m = 0; m < SUIL_IPC_MESSAGE_COUNT; m++) {
+            if (mHandlers[m])
+                worker.Handlers[m/8] |= (1 << (m%8));
+        }
+
         if (mIpc->nWorkers > 1) {
             // set process affinity
             cpu_set_t mask;
@@ -209,7 +412,9 @@ namespace suil {
             CPU_SET(worker.Cpu, &mask);
             sched_setaffinity(0, sizeof(mask), &mask);
             ldebug(WLOG, "worker/%hhu scheduled on cpu %hhu", spid, worker.Cpu);
+        }
 
+        if (ipcEnabled()) {
             // Setup pipe's
             for (uint8_t i = 0; i < mIpc->nWorkers; i++) {
                 Worker_t &tmp = mIpc->Workers[i];
@@ -318,7 +523,7 @@ namespace suil {
             return 0;
         }
 
-        if (mIpc->nWorkers > 1) {
+        if (ipcEnabled()) {
             // open communication pipes for the workers
             for (int w = 0; w < mIpc->nWorkers; w++) {
                 auto& wrk = mIpc->Workers[w];
@@ -331,7 +536,7 @@ namespace suil {
         }
         else {
             // if there is only 1 worker, there will be no IPC between the workers
-            ldebug(WLOG, "only 1 worker requested, IPC disabled for 1 worker");
+            ldebug(WLOG, "IPC disabled, workers %hhu, flags %04hX", mIpc->nWorkers, mLaunchFlags);
         }
 
         // spawn worker process
@@ -359,12 +564,12 @@ namespace suil {
             worker.Pid = getpid();
         }
 
-        if (mIpc->nWorkers > 1) {
+        if (ipcEnabled()) {
             // IPC enabled if only more than 1 worker is enabled
-            go (asyncReceive(worker));
+            go (asyncReceive(parent? worker : mIpc->Workers[spid-1]));
         }
 
-        return worker.Wid;
+        return parent? worker.Wid : spid;
     }
 
     int Worker::exit(int code, bool wait)
@@ -420,6 +625,145 @@ namespace suil {
         return spid;
     }
 
+    bool Worker::ipc() {
+        return ipcEnabled();
+    }
+
+    uint8_t Worker::count() {
+        return (uint8_t) (mIpc? mIpc->nWorkers : 1);
+    }
+
+    int Worker::cpu() {
+        if (mIpc == nullptr || spid == 0)
+            return -1;
+        return mIpc->Workers[spid-1].Cpu;
+    }
+
+    int Worker::ordered(const std::function<int()>& func, int64_t timeout)
+    {
+        static uint32_t nCalls{0};
+        if (mIpc == nullptr || spid == 0 || mIpc->nWorkers == 1) {
+            // no other workers to synchronize with
+            return func();
+        }
+
+        uint32_t turn = (nCalls * mIpc->nWorkers) + (spid-1);
+        int64_t dd = timeout < 0? -1 : mnow() + timeout;
+        while (__sync_fetch_and_add(&mIpc->Turn, 0) != turn) {
+            if ((dd >= 0) && (mnow() >= dd)) {
+                lwarn(WLOG, "worker/%hhu timed out waiting for turn %u", spid, turn);
+                return -ETIMEDOUT;
+            }
+            msleep(mnow() + 1);
+        }
+
+        int ret = func();
+        nCalls++;
+        __sync_fetch_and_add(&mIpc->Turn, 1);
+        return ret;
+    }
+
+    bool Worker::reg(uint8_t msg, IpcHandler handler)
+    {
+        if (msg == 0 || msg >= SUIL_IPC_MESSAGE_COUNT) {
+            lerror(WLOG, "ipc - message id %hhu out of range", msg);
+            return false;
+        }
+
+        if (mHandlers[msg]) {
+            lwarn(WLOG, "ipc - replacing handler for message %hhu", msg);
+        }
+        mHandlers[msg] = std::move(handler);
+
+        if (mIpc && spid) {
+            // workers already launched, publish handler
+            Worker_t& worker = mIpc->Workers[spid-1];
+            __sync_fetch_and_or(&worker.Handlers[msg/8], (uint8_t)(1 << (msg%8)));
+        }
+        return true;
+    }
+
+    void Worker::unreg(uint8_t msg)
+    {
+        if (msg == 0 || msg >= SUIL_IPC_MESSAGE_COUNT)
+            return;
+
+        if (mIpc && spid) {
+            Worker_t& worker = mIpc->Workers[spid-1];
+            __sync_fetch_and_and(&worker.Handlers[msg/8], (uint8_t)~(1 << (msg%8)));
+        }
+        mHandlers[msg] = nullptr;
+    }
+
+    int Worker::send(uint8_t dst, uint8_t msg, const void *data, size_t len, int64_t timeout)
+    {
+        if (msg == 0 || msg >= SUIL_IPC_MESSAGE_COUNT) {
+            return -EINVAL;
+        }
+
+        if (dst == spid) {
+            // sending to self, no need to go through the ring
+            ipcDispatch(spid, msg, data, len);
+            return 0;
+        }
+
+        if (!ipcEnabled() || spid == 0) {
+            return -ENOTSUP;
+        }
+
+        if (dst == 0 || dst > mIpc->nWorkers) {
+            return -EINVAL;
+        }
+
+        Worker_t& worker = mIpc->Workers[dst-1];
+        if (!worker.Active) {
+            return -ESRCH;
+        }
+
+        IpcRing_t& ring = ipcRing(dst);
+        int64_t dd = timeout < 0? -1 : mnow() + timeout;
+        int ret = ringPush(ring, spid, msg, data, len, dd, &worker);
+        if (ret) {
+            ltrace(WLOG, "ipc - sending message %hhu to worker/%hhu failed: %s",
+                   msg, dst, strerror(-ret));
+            return ret;
+        }
+
+        ipcNotify(worker, ring);
+        return 0;
+    }
+
+    int Worker::broadcast(uint8_t msg, const void *data, size_t len, int64_t timeout)
+    {
+        if (msg == 0 || msg >= SUIL_IPC_MESSAGE_COUNT) {
+            return -EINVAL;
+        }
+
+        if (!ipcEnabled() || spid == 0) {
+            return 0;
+        }
+
+        int sent{0};
+        int64_t dd = timeout < 0? -1 : mnow() + timeout;
+        for (uint8_t w = 0; w < mIpc->nWorkers; w++) {
+            Worker_t& worker = mIpc->Workers[w];
+            if (worker.Wid == spid || !worker.Active || !hasHandler(worker, msg))
+                continue;
+
+            IpcRing_t& ring = ipcRing(worker.Wid);
+            int ret = ringPush(ring, spid, msg, data, len, dd, &worker);
+            if (ret) {
+                ltrace(WLOG, "ipc - broadcasting message %hhu to worker/%hhu failed: %s",
+                       msg, worker.Wid, strerror(-ret));
+                continue;
+            }
+            ipcNotify(worker, ring);
+            sent++;
+        }
+
+        return sent;
+    }
+
     void Lock::reset(Lock_t& lk, uint32_t id) {
         lk.Serving = 0;
         lk.Next  = 0;
@@ -478,3 +822,115 @@ namespace suil {
         (void) __sync_fetch_and_add(&l.Serving, 1);
     }
 }
+
+#ifdef unit_test
+#include <catch/catch.hpp>
+
+using namespace suil;
+
+TEST_CASE("suil::Worker ipc ring", "[worker][ipc]")
+{
+    auto *ring = (IpcRing_t *) calloc(1, IPC_RING_STRIDE);
+    std::vector<std::pair<uint8_t, std::string>> received;
+    auto collect = [&](uint8_t src, uint8_t msg, const void *data, size_t len) {
+        REQUIRE(src == 2);
+        received.emplace_back(msg, std::string((const char *) data, len));
+    };
+
+    SECTION("push and drain messages in order") {
+        REQUIRE(ringPush(*ring, 2, 1, "Hello", 5, -1) == 0);
+        REQUIRE(ringPush(*ring, 2, 3, "World!", 6, -1) == 0);
+        REQUIRE(ringPush(*ring, 2, 4, nullptr, 0, -1) == 0);
+        REQUIRE(ringDrain(*ring, collect) == 3);
+        REQUIRE(received.size() == 3);
+        REQUIRE(received[0] == std::make_pair((uint8_t)1, std::string("Hello")));
+        REQUIRE(received[1] == std::make_pair((uint8_t)3, std::string("World!")));
+        REQUIRE(received[2] == std::make_pair((uint8_t)4, std::string("")));
+        REQUIRE(ring->Head == ring->Tail);
+    }
+
+    SECTION("messages wrap around the ring") {
+        std::string big(WORKER_IPC_RING_SIZE/3, 'a');
+        for (int i = 0; i < 8; i++) {
+            REQUIRE(ringPush(*ring, 2, 1, big.data(), big.size(), -1) == 0);
+            REQUIRE(ringDrain(*ring, collect) == 1);
+        }
+        REQUIRE(received.size() == 8);
+        for (auto& r: received)
+            REQUIRE(r.second == big);
+    }
+
+    SECTION("records of different sizes wrap the ring several times") {
+        std::vector<std::pair<uint8_t, std::string>> sent;
+        for (int i = 0; ring->Tail < 5*WORKER_IPC_RING_SIZE; i++) {
+            size_t len = (i * 7919) % (WORKER_IPC_RING_SIZE/5);
+            std::string msg(len, (char) ('a' + (i % 26)));
+            sent.emplace_back((uint8_t) (1 + (i % 250)), msg);
+            int ret;
+            while ((ret = ringPush(*ring, 2, sent.back().first, msg.data(), len, mnow())) == -ETIMEDOUT)
+                REQUIRE(ringDrain(*ring, collect) > 0);
+            REQUIRE(ret == 0);
+        }
+        ringDrain(*ring, collect);
+        REQUIRE(ring->Head == ring->Tail);
+        REQUIRE(received.size() == sent.size());
+        REQUIRE(received == sent);
+    }
+
+    SECTION("reserved records are consumed once committed") {
+        std::string first(WORKER_IPC_RING_SIZE/2, '\xff');
+        std::string second(WORKER_IPC_RING_SIZE/2 - 2*sizeof(IpcMsg_t), 'x');
+        REQUIRE(ringPush(*ring, 2, 1, first.data(), first.size(), -1) == 0);
+        REQUIRE(ringPush(*ring, 2, 1, second.data(), second.size(), -1) == 0);
+        REQUIRE(ringDrain(*ring, collect) == 2);
+        REQUIRE((ring->Tail & IPC_RING_MASK) == 0);
+        REQUIRE(ringPush(*ring, 2, 1, nullptr, 0, -1) == 0);
+        REQUIRE(ringDrain(*ring, collect) == 1);
+
+        // a producer reserves a record over the first record's payload, which
+        // must not be mistaken for a committed header
+        uint64_t tail = ring->Tail;
+        ring->Tail = tail + 2*sizeof(IpcMsg_t);
+        REQUIRE(ringDrain(*ring, collect) == 0);
+        REQUIRE(ring->Head == tail);
+
+        auto *hdr = (IpcMsg_t *) &ring->Data[tail & IPC_RING_MASK];
+        hdr->Len = 8;
+        hdr->Id  = 5;
+        hdr->Src = 2;
+        memcpy(&hdr[1], "reserved", 8);
+        hdr->Ready = 1;
+        REQUIRE(ringDrain(*ring, collect) == 1);
+        REQUIRE(received.back() == std::make_pair((uint8_t)5, std::string("reserved")));
+        REQUIRE(ring->Head == ring->Tail);
+    }
+
+    SECTION("full ring and oversized messages") {
+        std::string big(WORKER_IPC_RING_SIZE/2, 'b');
+        REQUIRE(ringPush(*ring, 2, 1, big.data(), big.size(), -1) == 0);
+        // no room left for a second message of the same size
+        REQUIRE(ringPush(*ring, 2, 1, big.data(), big.size(), mnow()) == -ETIMEDOUT);
+        REQUIRE(ringDrain(*ring, collect) == 1);
+        REQUIRE(ringPush(*ring, 2, 1, big.data(), big.size(), mnow()) == 0);
+
+        std::string huge(WORKER_IPC_RING_SIZE, 'c');
+        REQUIRE(ringPush(*ring, 2, 1, huge.data(), huge.size(), -1) == -EMSGSIZE);
+    }
+
+    SECTION("full ring of an exited worker") {
+        Worker_t worker{};
+        worker.Active = 1;
+        std::string big(WORKER_IPC_RING_SIZE/2, 'b');
+        REQUIRE(ringPush(*ring, 2, 1, big.data(), big.size(), -1, &worker) == 0);
+        // the sender backs off until the deadline
+        auto started = mnow();
+        REQUIRE(ringPush(*ring, 2, 1, big.data(), big.size(), started + 20, &worker) == -ETIMEDOUT);
+        REQUIRE((mnow() - started) >= 20);
+        // and gives up as soon as the consumer is gone
+        worker.Active = 0;
+        REQUIRE(ringPush(*ring, 2, 1, big.data(), big.size(), -1, &worker) == -ESRCH);
+    }
+
+    free(ring);
+}
+#endif
@@ -8,12 +8,26 @@
 #include <suil/base.h>
 #include <suil/logging.h>
 
+#include <functional>
+
 
 #ifndef SUIL_IPC_MESSAGE_COUNT
 #define SUIL_IPC_MESSAGE_COUNT 256
 #endif
 
+#ifndef SUIL_IPC_SEND_TIMEOUT
+// default time in milliseconds to wait for room in a destination worker's queue
+#define SUIL_IPC_SEND_TIMEOUT 1000
+#endif
+
 static_assert((SUIL_IPC_MESSAGE_COUNT%8) == 0, "SUIL_IPC_MESSAGE_COUNT must be a multiple of 8");
+static_assert(SUIL_IPC_MESSAGE_COUNT <= 256, "SUIL_IPC_MESSAGE_COUNT must fit in a message id");
+
+/**
+ * declares an IPC message id. message id 0 is reserved and
+ * should not be used by applications
+ */
+#define ipc_msg(id) ((uint8_t)(id))
 
 namespace suil {
 
@@ -43,6 +57,14 @@ namespace suil {
         Lock_t& lk;
     };
 
+    /**
+     * handler invoked when a worker receives an IPC message
+     * @param src the id of the worker which sent the message
+     * @param data the message payload, only valid within the handler
+     * @param len the size of the message payload
+     */
+    using IpcHandler = std::function<void(uint8_t src, const void *data, size_t len)>;
+
     struct Worker {
         enum : uint16_t  {
             IPCDisabled    = 0x0001
@@ -52,6 +74,87 @@ namespace suil {
         static uint8_t launch();
         static uint8_t wpid();
         static int exit(int code = 0, bool wait = true);
+
+        /**
+         * @return the number of workers the system was initialized with
+         */
+        static uint8_t count();
+
+        /**
+         * get the CPU the calling worker is scheduled on
+         * @return the CPU the worker is pinned to, or -1 if workers
+         * haven't been launched
+         */
+        static int cpu();
+
+        /**
+         * invokes \param func on every worker, one worker at a time in worker id
+         * order. All the workers must invoke this function the same number of times
+         * @param func the function to invoke when it's the calling worker's turn
+         * @param timeout the time to wait for the calling worker's turn
+         * @return the value returned by \param func or -ETIMEDOUT if the
+         * calling worker's turn did not come within the timeout
+         */
+        static int ordered(const std::function<int()>& func, int64_t timeout = -1);
+
+        /**
+         * register a handler for the given IPC message. Handlers can be
+         * registered before or after the workers are launched
+         * @param msg the id of the message to handle (see ipc_msg)
+         * @param handler the handler to invoke when the message is received
+         * @return true if the handler was registered, false otherwise
+         */
+        static bool reg(uint8_t msg, IpcHandler handler);
+
+        /**
+         * unregister a previously registered IPC message handler
+         * @param msg the id of the message whose handler should be removed
+         */
+        static void unreg(uint8_t msg);
+
+        /**
+         * send a message to a single worker. The message is copied into the
+         * destination worker's shared memory queue
+         * @param dst the id of the destination worker (see wpid)
+         * @param msg the id of the message being sent
+         * @param data the message payload
+         * @param len the size of the message payload
+         * @param timeout the time to wait for space in the destination queue, -1 to
+         * wait until the destination makes room
+         * @return 0 on success, -ESRCH if the destination worker is not active,
+         * -ETIMEDOUT if its queue stayed full, otherwise a negative error code
+         */
+        static int send(uint8_t dst, uint8_t msg, const void *data, size_t len,
+                        int64_t timeout = SUIL_IPC_SEND_TIMEOUT);
+
+        template <typename T>
+        static inline int send(uint8_t dst, uint8_t msg, const T& data, int64_t timeout = SUIL_IPC_SEND_TIMEOUT) {
+            static_assert(std::is_trivially_copyable<T>::value, "IPC messages must be trivially copyable");
+            return send(dst, msg, &data, sizeof(T), timeout);
+        }
+
+        /**
+         * send a message to all the other active workers which have a handler
+         * registered for the message
+         * @param msg the id of the message being sent
+         * @param data the message payload
+         * @param len the size of the message payload
+         * @param timeout the time to wait for space in each destination queue
+         * @return the number of workers the message was sent to, or a negative
+         * error code
+         */
+        static int broadcast(uint8_t msg, const void *data, size_t len, int64_t timeout = SUIL_IPC_SEND_TIMEOUT);
+
+        template <typename T>
+        static inline int broadcast(uint8_t msg, const T& data, int64_t timeout = SUIL_IPC_SEND_TIMEOUT) {
+            static_assert(std::is_trivially_copyable<T>::value, "IPC messages must be trivially copyable");
+            return broadcast(msg, &data, sizeof(T), timeout);
+        }
+
+        /**
+         * @return true if IPC is enabled between the launched workers
+         */
+        static bool ipc();
     };
 }
 
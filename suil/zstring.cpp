@@ -109,13 +109,22 @@ namespace suil {
     String String::dup() const {
         if (m_str == nullptr || m_len == 0)
             return nullptr;
-        return std::move(String(strndup(m_str, m_len), m_len, true));
+        String tmp(strndup(m_str, m_len), m_len, true);
+        // same contents, the cached hash remains valid
+        tmp.m_hash = m_hash;
+        return std::move(tmp);
     }
 
     String String::peek() const {
         // this will return a dup of the string but as
         // just a reference or simple not owner
-        return std::move(String(m_cstr, m_len, false));
+        String tmp(m_cstr, m_len, false);
+        tmp.m_hash = m_hash;
+        return std::move(tmp);
+    }
+
+    size_t String::hash() const {
+        return hasher{}(Ego);
     }
 
     void String::toupper() {
@@ -342,6 +342,10 @@ namespace suil {
             return Ego.m_len;
         }
 
+        /**
+         * @return the hash of the string, computed on first use and
+         * cached in the string
+         */
         size_t hash() const;
 
         /**
@@ -40,6 +40,42 @@ namespace test {
 #define TEST_IOD_SYMBOL_f
     iod_define_symbol(f)
 #endif
+#ifndef TEST_IOD_SYMBOL_id
+#define TEST_IOD_SYMBOL_id
+    iod_define_symbol(id)
+#endif
+#ifndef TEST_IOD_SYMBOL_name
+#define TEST_IOD_SYMBOL_name
+    iod_define_symbol(name)
+#endif
+#ifndef TEST_IOD_SYMBOL_email
+#define TEST_IOD_SYMBOL_email
+    iod_define_symbol(email)
+#endif
+#ifndef TEST_IOD_SYMBOL_phone
+#define TEST_IOD_SYMBOL_phone
+    iod_define_symbol(phone)
+#endif
+#ifndef TEST_IOD_SYMBOL_token
+#define TEST_IOD_SYMBOL_token
+    iod_define_symbol(token)
+#endif
+#ifndef TEST_IOD_SYMBOL_active
+#define TEST_IOD_SYMBOL_active
+    iod_define_symbol(active)
+#endif
+#ifndef TEST_IOD_SYMBOL_balance
+#define TEST_IOD_SYMBOL_balance
+    iod_define_symbol(balance)
+#endif
+#ifndef TEST_IOD_SYMBOL_roles
+#define TEST_IOD_SYMBOL_roles
+    iod_define_symbol(roles)
+#endif
+#ifndef TEST_IOD_SYMBOL_scores
+#define TEST_IOD_SYMBOL_scores
+    iod_define_symbol(scores)
+#endif
 
 }
 #endif //SUIL_TEST_SYMBOLS_H
@@ -4,6 +4,7 @@
 
 #include <suil/console.h>
 #include <suil/file.h>
+#include <suil/json.h>
 #include <suil/utils.h>
 #include "program.h"
 
@@ -483,6 +484,186 @@ namespace suil::scc {
         hf.close();
     }
 
+    static bool fieldHasAttribute(const Field& field, const char *name)
+    {
+        for (auto& attr: field.Attribs) {
+            if ((attr.isSimple()? attr.Resolved : attr.Parts.back()) == name)
+                return true;
+        }
+        return false;
+    }
+
+    /* finds the smallest table (a mask) and a seed for which suil::json::fieldhash
+     * puts each of the given fields in a slot of its own */
+    static std::pair<uint32_t, uint32_t> fieldsPerfectHash(const std::vector<Field>& fields)
+    {
+        uint32_t mask{1};
+        while ((mask + 1) < fields.size())
+            mask = (mask << 1) | 1;
+
+        while (true) {
+            for (uint32_t seed = 0; seed < 4096; seed++) {
+                std::vector<bool> used(mask + 1, false);
+                bool found{true};
+                for (auto& field: fields) {
+                    auto slot = suil::json::fieldhash(field.Name.data(), field.Name.size(), seed) & mask;
+                    if (used[slot]) {
+                        found = false;
+                        break;
+                    }
+                    used[slot] = true;
+                }
+                if (found)
+                    return {seed, mask};
+            }
+            mask = (mask << 1) | 1;
+        }
+    }
+
+    static void generateMetaJsonCodec(File &sf, const MetaType &mt)
+    {
+        /* the encoder writes the quoted field names (which are identifiers and
+         * need no escaping) as literals, the separating comma is only decided at
+         * runtime when it follows fields which can be omitted */
+        bool needFirst{false}, known{false}, maybe{false};
+        for (auto& field: mt.Fields) {
+            if (fieldHasAttribute(field, "json_skip"))
+                continue;
+            needFirst = needFirst || (!known && maybe);
+            if (fieldHasAttribute(field, "ignore"))
+                maybe = true;
+            else
+                known = true;
+        }
+
+        sf << spaces(4) << "void " << mt.Name << "::toJson(iod::json::jstream& ss) const\n"
+           << spaces(4) << "{\n";
+        if (needFirst)
+            sf << spaces(8) << "bool first{true};\n";
+        sf << spaces(8) << "ss << '{';\n";
+        known = maybe = false;
+        for (auto& field: mt.Fields) {
+            if (fieldHasAttribute(field, "json_skip"))
+                continue;
+
+            bool ignore = fieldHasAttribute(field, "ignore");
+            size_t indent{8};
+            if (ignore) {
+                sf << spaces(8) << "if (!iod::json::json_ignore(Ego." << field.Name << ")) {\n";
+                indent = 12;
+            }
+
+            String key;
+            if (known)
+                key = utils::catstr(",\\\"", field.Name, "\\\":");
+            else
+                key = utils::catstr("\\\"", field.Name, "\\\":");
+            if (!known && maybe)
+                sf << spaces(indent) << "if (!first) ss << ',';\n";
+            sf << spaces(indent) << "ss << iod::stringview(\"" << key << "\", "
+               << utils::tostr(field.Name.size() + (known? 4: 3)) << ");\n";
+            sf << spaces(indent) << "iod::json::json_encode_(Ego." << field.Name << ", ss);\n";
+            if (needFirst && !known)
+                sf << spaces(indent) << "first = false;\n";
+
+            if (ignore) {
+                sf << spaces(8) << "}\n";
+                maybe = true;
+            }
+            else {
+                known = true;
+            }
+        }
+        sf << spaces(8) << "ss << '}';\n"
+           << spaces(4) << "}\n\n";
+
+        /* the decoder dispatches keys to fields on a perfect hash of the field
+         * names, a single comparison confirms the match */
+        auto ph = fieldsPerfectHash(mt.Fields);
+        std::vector<int> slots(ph.second + 1, -1);
+        for (size_t i = 0; i < mt.Fields.size(); i++) {
+            auto& name = mt.Fields[i].Name;
+            slots[suil::json::fieldhash(name.data(), name.size(), ph.first) & ph.second] = (int) i;
+        }
+
+        bool skips{false};
+        for (auto& field: mt.Fields)
+            skips = skips || fieldHasAttribute(field, "json_skip");
+
+        sf << spaces(4) << mt.Name << " " << mt.Name << "::fromJson(iod::json::parser& p)\n"
+           << spaces(4) << "{\n"
+           << spaces(8) << mt.Name << " tmp{};\n"
+           << spaces(8) << "bool filled[" << utils::tostr(mt.Fields.size()) << "]{};\n"
+           << spaces(8) << "iod::stringview key;\n";
+        if (skips)
+            sf << spaces(8) << "iod::json_string skipped;\n";
+        sf << "\n"
+           << spaces(8) << "p >> p.spaces >> '{' >> p.spaces;\n"
+           << spaces(8) << "while (p.peak() != '}') {\n"
+           << spaces(12) << "p >> p.spaces >> '\"' >> iod::json::fill(key) >> '\"' >> p.spaces >> ':' >> p.spaces;\n\n"
+           << spaces(12) << "int field{-1};\n"
+           << spaces(12) << "switch (suil::json::fieldhash(key.data(), key.size(), " << utils::tostr(ph.first)
+           << "u) & " << utils::tostr(ph.second) << "u) {\n";
+        for (size_t slot = 0; slot < slots.size(); slot++) {
+            if (slots[slot] < 0)
+                continue;
+            auto& name = mt.Fields[slots[slot]].Name;
+            sf << spaces(16) << "case " << utils::tostr(slot) << "u:\n"
+               << spaces(20) << "if (key.size() == " << utils::tostr(name.size())
+               << " && !memcmp(key.data(), \"" << name << "\", " << utils::tostr(name.size()) << "))\n"
+               << spaces(24) << "field = " << utils::tostr(slots[slot]) << ";\n"
+               << spaces(20) << "break;\n";
+        }
+        sf << spaces(16) << "default:\n"
+           << spaces(20) << "break;\n"
+           << spaces(12) << "}\n\n"
+           << spaces(12) << "if (field < 0)\n"
+           << spaces(16) << "throw std::runtime_error(\"json_decode error: unexpected key \" + key.to_std_string());\n\n"
+           << spaces(12) << "try {\n"
+           << spaces(16) << "switch (field) {\n";
+        for (size_t i = 0; i < mt.Fields.size(); i++) {
+            auto& field = mt.Fields[i];
+            sf << spaces(20) << "case " << utils::tostr(i) << ":\n";
+            if (fieldHasAttribute(field, "json_skip")) {
+                // the key is accepted but its value is never decoded
+                sf << spaces(24) << "p >> skipped;\n"
+                   << spaces(24) << "break;\n";
+                continue;
+            }
+            sf << spaces(24) << "if (!p.eat_null())\n"
+               << spaces(28) << "iod::json::iod_from_json_((" << field.FieldType << " *) nullptr, tmp."
+               << field.Name << ", p);\n"
+               << spaces(24) << "break;\n";
+        }
+        sf << spaces(20) << "default:\n"
+           << spaces(24) << "break;\n"
+           << spaces(16) << "}\n"
+           << spaces(12) << "}\n"
+           << spaces(12) << "catch (const std::exception& ex) {\n"
+           << spaces(16) << "throw std::runtime_error(\"Error when decoding json attribute \" + key.to_std_string() + \": \" + ex.what());\n"
+           << spaces(12) << "}\n"
+           << spaces(12) << "filled[field] = true;\n\n"
+           << spaces(12) << "p >> p.spaces;\n"
+           << spaces(12) << "if (p.peak() != ',')\n"
+           << spaces(16) << "break;\n"
+           << spaces(12) << "p >> ',' >> p.spaces;\n"
+           << spaces(12) << "if (p.peak() == '}')\n"
+           << spaces(16) << "throw p.json_error(\"Expected a key after , got \", p.peak());\n"
+           << spaces(8) << "}\n\n"
+           << spaces(8) << "if (p.peak() != '}')\n"
+           << spaces(12) << "throw p.json_error(\"Expected } got \", p.peak());\n"
+           << spaces(8) << "p >> '}';\n\n";
+        for (size_t i = 0; i < mt.Fields.size(); i++) {
+            auto& field = mt.Fields[i];
+            if (fieldHasAttribute(field, "json_skip") || fieldHasAttribute(field, "optional"))
+                continue;
+            sf << spaces(8) << "if (!filled[" << utils::tostr(i) << "])\n"
+               << spaces(12) << "throw std::runtime_error(\"json_decode error: missing field " << field.Name << "\");\n";
+        }
+        sf << spaces(8) << "return tmp;\n"
+           << spaces(4) << "}\n\n";
+    }
+
     static void generateMetaTypeSources(File &sf, const MetaType &mt)
     {
         if (mt.Kind == "union") {
@@ -504,19 +685,25 @@ namespace suil::scc {
          * */
         sf << spaces(4) << mt.Name << "::Schema " << mt.Name << "::Meta{};\n\n";
 
-        sf << spaces(4) << mt.Name << " " << mt.Name << "::fromJson(iod::json::parser& p)\n"
-           << spaces(4) << "{\n"
-           << spaces(8) << mt.Name << " tmp{};\n"
-           << spaces(8) << "p >> p.spaces >> '{';\n"
-           << spaces(8) << "iod::json::iod_attr_from_json(&" << mt.Name << "::Meta, tmp, p);\n"
-           << spaces(8) << "p >> p.spaces >> '}';\n"
-           << spaces(8) << "return tmp;\n"
-           << spaces(4) << "}\n\n";
-
-        sf << spaces(4) << "void " << mt.Name << "::toJson(iod::json::jstream& ss) const\n"
-           << spaces(4) << "{\n"
-           << spaces(8) << "suil::json::metaToJson(Ego, ss);\n"
-           << spaces(4) << "}\n\n";
+        if (mt.Kind == "meta") {
+            // meta types get a codec of their own
+            generateMetaJsonCodec(sf, mt);
+        }
+        else {
+            sf << spaces(4) << mt.Name << " " << mt.Name << "::fromJson(iod::json::parser& p)\n"
+               << spaces(4) << "{\n"
+               << spaces(8) << mt.Name << " tmp{};\n"
+               << spaces(8) << "p >> p.spaces >> '{';\n"
+               << spaces(8) << "iod::json::iod_attr_from_json(&" << mt.Name << "::Meta, tmp, p);\n"
+               << spaces(8) << "p >> p.spaces >> '}';\n"
+               << spaces(8) << "return tmp;\n"
+               << spaces(4) << "}\n\n";
+
+            sf << spaces(4) << "void " << mt.Name << "::toJson(iod::json::jstream& ss) const\n"
+               << spaces(4) << "{\n"
+               << spaces(8) << "suil::json::metaToJson(Ego, ss);\n"
+               << spaces(4) << "}\n\n";
+        }
 
         sf << spaces(4) << "size_t " << mt.Name << "::maxByteSize() const\n"
            << spaces(4) << "{\n"
@@ -537,7 +724,8 @@ namespace suil::scc {
 
         sf << spaces(4) << "suil::OBuffer& operator<<(suil::OBuffer& o, const " << mt.Name << "& a)\n"
            << spaces(4) << "{\n"
-           << spaces(8) << "o << suil::json::encode(a);\n"
+           << spaces(8) << "suil::json::encode(a, o);\n"
+           << spaces(8) << "return o;\n"
            << spaces(4) << "}\n\n";
     }
 
@@ -607,3 +795,59 @@ namespace suil::scc {
         generateSourceFile(fname(), cppFile);
     }
 }
+
+#ifdef unit_test
+#include <catch/catch.hpp>
+
+using namespace suil;
+
+static scc::Field sccField(const char *type, const char *name, std::vector<std::string> attribs = {})
+{
+    scc::Field field{};
+    field.FieldType = type;
+    field.Name      = name;
+    for (auto& attrib: attribs) {
+        scc::Attribute attr{};
+        attr.Parts    = {attrib};
+        attr.Resolved = attrib;
+        field.Attribs.push_back(attr);
+    }
+    return field;
+}
+
+TEST_CASE("scc generated JSON codec sources", "[scc][json]")
+{
+    // suil/json.cpp compiles and tests the codec in tests/scc_account.inc, which
+    // must remain the output of the generator for its Account type
+    scc::MetaType mt{};
+    mt.Name   = "Account";
+    mt.Kind   = "meta";
+    mt.Fields = {
+        sccField("int64_t",             "id"),
+        sccField("String",              "name"),
+        sccField("String",              "email"),
+        sccField("String",              "phone", {"optional", "ignore"}),
+        sccField("String",              "token", {"json_skip"}),
+        sccField("bool",                "active"),
+        sccField("double",              "balance"),
+        sccField("std::vector<String>", "roles"),
+        sccField("std::vector<int>",    "scores", {"optional"})
+    };
+
+    auto path = "/tmp/suil-scc-account.inc";
+    {
+        File sf(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+        scc::generateMetaJsonCodec(sf, mt);
+        sf.flush();
+        sf.close();
+    }
+    auto generated = utils::fs::readall(path);
+    utils::fs::remove(path);
+
+    std::string golden{__FILE__};
+    golden.resize(golden.rfind('/'));
+    golden += "/../../tests/scc_account.inc";
+    REQUIRE(generated == utils::fs::readall(golden.c_str()));
+}
+
+#endif
@@ -0,0 +1,26 @@
+extern "C" {
+extern const char swept_main[];
+extern size_t swept_main_size;
+extern const char swept_init[];
+extern size_t swept_init_size;
+extern const char swept_sys_utils[];
+extern size_t swept_sys_utils_size;
+extern const char swept_sys_sh[];
+extern size_t swept_sys_sh_size;
+extern const char swept_sys_argparse[];
+extern size_t swept_sys_argparse_size;
+extern const char swept_sys_json[];
+extern size_t swept_sys_json_size;
+extern const char swept_sys_http[];
+extern size_t swept_sys_http_size;
+extern const char swept_sys_logger[];
+extern size_t swept_sys_logger_size;
+extern const char swept_sys_scripter[];
+extern size_t swept_sys_scripter_size;
+extern const char swept_sys_reporter[];
+extern size_t swept_sys_reporter_size;
+extern const char swept_sys_testcase[];
+extern size_t swept_sys_testcase_size;
+extern const char swept_sys_sweeper[];
+extern size_t swept_sys_sweeper_size;
+};
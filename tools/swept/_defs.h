@@ -0,0 +1,14 @@
+
+{"swept_main", swept_main_size, swept_main },
+{"swept_init", swept_init_size, swept_init },
+{"swept_sys_utils", swept_sys_utils_size, swept_sys_utils },
+{"swept_sys_sh", swept_sys_sh_size, swept_sys_sh },
+{"swept_sys_argparse", swept_sys_argparse_size, swept_sys_argparse },
+{"swept_sys_json", swept_sys_json_size, swept_sys_json },
+{"swept_sys_http", swept_sys_http_size, swept_sys_http },
+{"swept_sys_logger", swept_sys_logger_size, swept_sys_logger },
+{"swept_sys_scripter", swept_sys_scripter_size, swept_sys_scripter },
+{"swept_sys_reporter", swept_sys_reporter_size, swept_sys_reporter },
+{"swept_sys_testcase", swept_sys_testcase_size, swept_sys_testcase },
+{"swept_sys_sweeper", swept_sys_sweeper_size, swept_sys_sweeper },
+{nullptr, 0, nullptr },